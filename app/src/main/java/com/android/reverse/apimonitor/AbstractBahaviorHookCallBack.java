@@ -3,12 +3,18 @@ package com.android.reverse.apimonitor;
 import com.android.reverse.hook.HookParam;
 import com.android.reverse.hook.MethodHookCallBack;
 import com.android.reverse.util.Logger;
+import com.android.reverse.util.Tracer;
 
 public abstract class AbstractBahaviorHookCallBack extends MethodHookCallBack {
 
 	@Override
 	public void beforeHookedMethod(HookParam param) {
-		Logger.log_behavior("Invoke "+ param.method.getDeclaringClass().getName()+"->"+param.method.getName());
+		int event = Tracer.isEnabled() ? Tracer.methodEvent(param.method) : -1;
+		if (event >= 0) {
+			Tracer.event(event, System.identityHashCode(param.thisObject), param.args == null ? 0 : param.args.length);
+		} else {
+			Logger.log_behavior("Invoke "+ param.method.getDeclaringClass().getName()+"->"+param.method.getName());
+		}
 		this.descParam(param);
 		//this.printStackInfo();
 	}
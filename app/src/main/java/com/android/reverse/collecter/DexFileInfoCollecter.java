@@ -8,11 +8,17 @@ import java.io.FileNotFoundException;
 import java.io.FileOutputStream;
 import java.io.IOException;
 import java.lang.reflect.Method;
-import java.nio.ByteBuffer;
-import java.nio.ByteOrder;
+import java.nio.charset.Charset;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.Comparator;
 import java.util.HashMap;
 import java.util.Iterator;
 
+import org.json.JSONArray;
+import org.json.JSONException;
+import org.json.JSONObject;
+
 import com.android.reverse.hook.HookHelperFacktory;
 import com.android.reverse.hook.HookHelperInterface;
 import com.android.reverse.hook.HookParam;
@@ -21,6 +27,7 @@ import com.android.reverse.smali.MemoryBackSmali;
 import com.android.reverse.util.Logger;
 import com.android.reverse.util.NativeFunction;
 import com.android.reverse.util.RefInvoke;
+import com.android.reverse.util.Tracer;
 
 import dalvik.system.DexFile;
 import dalvik.system.PathClassLoader;
@@ -74,9 +81,10 @@ public class DexFileInfoCollecter {
 
                     for (int index = 1; index < longs.length; ++index) {
                         if (longs[index] != 0) {
-                            dynLoadedDexInfo.put(mCookie + "", new DexFileInfo(dexPath, longs[index]));
+                            dynLoadedDexInfo.put(longs[index] + "", new DexFileInfo(dexPath, longs[index]));
                         }
                         Logger.log("openDexFileNative() is invoked with filepath:" + param.args[0] + " result: long[" + index + "]" + longs[index]);
+                        Tracer.text(Tracer.EVENT_OPEN_DEX, dexPath + " " + longs[index]);
 
                     }
 
@@ -108,6 +116,7 @@ public class DexFileInfoCollecter {
                         dynLoadedDexInfo.put(mCookie + "", new DexFileInfo(dexPath, Long.parseLong(mCookie.toString())));
                     }
                     Logger.log("openDexFileNative() is invoked with filepath:" + param.args[0] + " result:" + Long.parseLong(mCookie.toString()));
+                    Tracer.text(Tracer.EVENT_OPEN_DEX, dexPath + " " + mCookie);
 
                 }
             });
@@ -136,6 +145,7 @@ public class DexFileInfoCollecter {
                         for (int index = 1; index < longs.length; ++index) {
                             if (longs[index] != 0) {
                                 setDefineClassLoader(longs[index], (ClassLoader) param.args[1]);
+                                Tracer.event(Tracer.EVENT_DEFINE_CLASS, longs[index], System.identityHashCode(param.args[1]));
                             }
                         }
                     }
@@ -158,6 +168,7 @@ public class DexFileInfoCollecter {
                     if (!param.hasThrowable()) {
                         long mCookie = (long) param.args[2];
                         setDefineClassLoader(mCookie, (ClassLoader) param.args[1]);
+                        Tracer.event(Tracer.EVENT_DEFINE_CLASS, mCookie, System.identityHashCode(param.args[1]));
                     }
                 }
             });
@@ -179,6 +190,7 @@ public class DexFileInfoCollecter {
                     if (!param.hasThrowable()) {
                         int mCookie = (Integer) param.args[2];
                         setDefineClassLoader(mCookie, (ClassLoader) param.args[1]);
+                        Tracer.event(Tracer.EVENT_DEFINE_CLASS, mCookie, System.identityHashCode(param.args[1]));
                     }
                 }
             });
@@ -218,16 +230,36 @@ public class DexFileInfoCollecter {
     }
 
     public String[] dumpLoadableClass(String dexPath) {
-        int mCookie = Integer.parseInt(dexPath);
-//		int mCookie = this.getCookie(dexPath);
-        if (mCookie != 0) {
-            return (String[]) RefInvoke.invokeStaticMethod("dalvik.system.DexFile", "getClassNameList", new Class[]{int.class},
-                    new Object[]{mCookie});
-        } else {
+        return dumpLoadableClass(dexPath, null);
+    }
+
+    //where the sidecar indexes of the dexes are kept, see DexIndexCommandHandler
+    public static String getDexIndexDir() {
+        File dir = new File(ModuleContext.getInstance().getAppContext().getFilesDir(), "dexindex");
+        dir.mkdirs();
+        return dir.getAbsolutePath();
+    }
+
+    //names of the classes the dex defines (dalvik and art), in descriptor order off its index, or in class_def order
+    //read natively from its class_defs if the index can't be opened; prefix may be null
+    public String[] dumpLoadableClass(String dexPath, String prefix) {
+        long mCookie = Long.parseLong(dexPath);
+        if (mCookie == 0) {
             Logger.log("the cookie is not right");
+            return null;
         }
-        return null;
-
+        int version = ModuleContext.getInstance().getApiLevel();
+        byte[] names = NativeFunction.listDexIndexClasses(mCookie, version, getDexIndexDir(), prefix);
+        if (names == null) {
+            names = NativeFunction.listDexClasses(mCookie, version, prefix);
+        }
+        if (names == null) {
+            return null;
+        }
+        if (names.length == 0) {
+            return new String[0];
+        }
+        return new String(names, Charset.forName("UTF-8")).split("\n");
     }
 
     public void backsmaliDexFile(String filename, String dexPath) {
@@ -252,36 +284,105 @@ public class DexFileInfoCollecter {
         }
     }
 
-    public void dumpDexFile(String filename, String mCookie_str) {
-        File file = new File(filename);
-        try {
-            if (!file.exists())
-                file.createNewFile();
-            long mCookie = Long.parseLong(mCookie_str);
+    public void dumpDexFile(String filename, String mCookie_str, int fsyncPolicy, boolean fixChecksum) {
+        long mCookie = Long.parseLong(mCookie_str);
 //			int mCookie = this.getCookie(dexPath);
-            if (mCookie != 0) {
-                FileOutputStream out = new FileOutputStream(file);
-                ByteBuffer data = NativeFunction.dumpDexFileByCookie(mCookie, ModuleContext.getInstance().getApiLevel());
-                data.order(ByteOrder.LITTLE_ENDIAN);
-                byte[] buffer = new byte[8192];
-                data.clear();
-                while (data.hasRemaining()) {
-                    int count = Math.min(buffer.length, data.remaining());
-                    data.get(buffer, 0, count);
-                    try {
-                        out.write(buffer, 0, count);
-                    } catch (IOException e1) {
-                        e1.printStackTrace();
-                    }
+        if (mCookie != 0) {
+            long[] result = NativeFunction.dumpDexFileToFile(mCookie, ModuleContext.getInstance().getApiLevel(), filename, fsyncPolicy, fixChecksum);
+            MemDump.logDumpResult(filename, result);
+        } else {
+            Logger.log("the cookie is not right");
+        }
+    }
+
+    /**
+     * dump every known dex (or only those loaded from dexPath) to dir/classesN.dex in parallel,
+     * and write the sizes, checksums and timings to dir/manifest.json
+     */
+    public void dumpAllDexFile(String dir, String dexPath, int fsyncPolicy, boolean fixChecksum) {
+        ArrayList<DexFileInfo> infos = new ArrayList<DexFileInfo>();
+        for (DexFileInfo info : dumpDexFileInfo().values()) {
+            if (info.getmCookie() != 0 && (dexPath == null || dexPath.equals(info.getDexPath()))) {
+                infos.add(info);
+            }
+        }
+        if (infos.isEmpty()) {
+            Logger.log("no dexfile to dump" + (dexPath == null ? "" : " for " + dexPath));
+            return;
+        }
+        Collections.sort(infos, new Comparator<DexFileInfo>() {
+            @Override
+            public int compare(DexFileInfo a, DexFileInfo b) {
+                int byPath = a.getDexPath().compareTo(b.getDexPath());
+                if (byPath != 0) {
+                    return byPath;
                 }
-            } else {
-                Logger.log("the cookie is not right");
+                return a.getmCookie() < b.getmCookie() ? -1 : (a.getmCookie() == b.getmCookie() ? 0 : 1);
             }
-        } catch (FileNotFoundException e) {
+        });
+        new File(dir).mkdirs();
+        long[] cookies = new long[infos.size()];
+        String[] paths = new String[infos.size()];
+        for (int i = 0; i < cookies.length; i++) {
+            cookies[i] = infos.get(i).getmCookie();
+            paths[i] = dir + "/classes" + (i == 0 ? "" : String.valueOf(i + 1)) + ".dex";
+        }
+        long[] result = NativeFunction.dumpAllDexFiles(cookies, ModuleContext.getInstance().getApiLevel(), paths,
+                fsyncPolicy, fixChecksum);
+        if (result == null) {
+            Logger.log("dump all dexfile failed");
+            return;
+        }
+        try {
+            JSONArray entries = new JSONArray();
+            for (int i = 0; i < cookies.length; i++) {
+                int base = 1 + i * NativeFunction.ALLDEX_FIELDS;
+                JSONObject entry = new JSONObject();
+                entry.put("file", paths[i]);
+                entry.put("dexPath", infos.get(i).getDexPath());
+                entry.put("mCookie", cookies[i]);
+                entry.put("bytes", result[base + NativeFunction.ALLDEX_BYTES]);
+                entry.put("elapsedNs", result[base + NativeFunction.ALLDEX_ELAPSED_NS]);
+                entry.put("errno", result[base + NativeFunction.ALLDEX_ERROR]);
+                entry.put("headerChecksum", String.format("%08x", result[base + NativeFunction.ALLDEX_HEADER_CHECKSUM]));
+                entry.put("checksum", String.format("%08x", result[base + NativeFunction.ALLDEX_CHECKSUM]));
+                entries.put(entry);
+                Logger.log(entry.toString());
+            }
+            JSONObject manifest = new JSONObject();
+            manifest.put("elapsedNs", result[0]);
+            manifest.put("dex", entries);
+            FileOutputStream out = new FileOutputStream(dir + "/manifest.json");
+            try {
+                out.write(manifest.toString(2).getBytes("UTF-8"));
+            } finally {
+                out.close();
+            }
+        } catch (JSONException e) {
             e.printStackTrace();
         } catch (IOException e) {
             e.printStackTrace();
         }
+        Logger.log("dump " + cookies.length + " dexfile to " + dir + " in " + result[0] / 1000000 + "ms");
+    }
+
+    //true if the dex was rebuilt and written to filename, the reason is logged otherwise
+    public boolean rebuildDexFile(String filename, String mCookie_str) {
+        long mCookie = Long.parseLong(mCookie_str);
+        if (mCookie == 0) {
+            Logger.log("the cookie is not right");
+            return false;
+        }
+        long[] result = NativeFunction.rebuildDexFile(mCookie, ModuleContext.getInstance().getApiLevel(), filename);
+        long error = result != null ? result[NativeFunction.REBUILD_ERROR] : 0;
+        if (error == NativeFunction.REBUILD_EINVAL) {
+            Logger.log("rebuild the dex of mCookie " + mCookie + " failed: its header or id tables look broken");
+        } else if (error == NativeFunction.REBUILD_ECANCELED) {
+            Logger.log("rebuild the dex of mCookie " + mCookie + " cancelled, nothing written");
+        } else {
+            MemDump.logDumpResult(filename, result);
+        }
+        return result != null && error == 0;
     }
 
     private Object getCookie(String dexPath) {
@@ -0,0 +1,39 @@
+package com.android.reverse.collecter;
+
+/**
+ * a dex header found by NativeFunction.scanDexFiles, filled in natively
+ */
+public class DexMemoryHit {
+
+    private long address;
+    private long size;
+    private int classCount;
+    private int version;
+    private String mapping;
+
+    public long getAddress() {
+        return address;
+    }
+
+    public long getSize() {
+        return size;
+    }
+
+    public int getClassCount() {
+        return classCount;
+    }
+
+    public int getVersion() {
+        return version;
+    }
+
+    public String getMapping() {
+        return mapping;
+    }
+
+    @Override
+    public String toString() {
+        return "address:0x" + Long.toHexString(address) + " size:" + size + " classCount:" + classCount
+                + " version:" + String.format("%03d", version) + " mapping:" + (mapping.length() == 0 ? "[anon]" : mapping);
+    }
+}
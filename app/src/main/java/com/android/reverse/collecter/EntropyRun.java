@@ -0,0 +1,51 @@
+package com.android.reverse.collecter;
+
+/**
+ * windows of high entropy next to each other, as NativeFunction.entropyMap returns them; filled in natively
+ */
+public class EntropyRun {
+
+    private long start;
+    private long end;
+    private String region;
+    private long regionStart;
+    private float meanEntropy;
+    private float peakEntropy;
+
+    public long getStart() {
+        return start;
+    }
+
+    public long getEnd() {
+        return end;
+    }
+
+    public long getLength() {
+        return end - start;
+    }
+
+    /* path of the mapping the run is in, "" if anonymous */
+    public String getRegion() {
+        return region;
+    }
+
+    public long getRegionStart() {
+        return regionStart;
+    }
+
+    /* bits per byte, 8 at most */
+    public float getMeanEntropy() {
+        return meanEntropy;
+    }
+
+    public float getPeakEntropy() {
+        return peakEntropy;
+    }
+
+    @Override
+    public String toString() {
+        return "start:0x" + Long.toHexString(start) + " length:" + (end - start) + " region:"
+                + (region.length() == 0 ? "[anon]" : region) + "+0x" + Long.toHexString(start - regionStart)
+                + String.format(" entropy:%.3f peak:%.3f", meanEntropy, peakEntropy);
+    }
+}
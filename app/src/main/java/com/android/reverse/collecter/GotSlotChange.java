@@ -0,0 +1,53 @@
+package com.android.reverse.collecter;
+
+/**
+ * a PLT slot whose value changed, filled in natively by NativeFunction.diffGotSnapshot
+ * (against a snapshot) or NativeFunction.drainGotMonitor (seen by the monitor thread)
+ */
+public class GotSlotChange {
+
+    /* the value of a slot that couldn't be read, its library unloaded while it was snapshotted */
+    public static final long UNREADABLE = -1;
+
+    private String library;
+    private String symbol;
+    private long slot;
+    private long oldValue;
+    private long newValue;
+    private long time;
+
+    public String getLibrary() {
+        return library;
+    }
+
+    public String getSymbol() {
+        return symbol;
+    }
+
+    public long getSlot() {
+        return slot;
+    }
+
+    public long getOldValue() {
+        return oldValue;
+    }
+
+    public long getNewValue() {
+        return newValue;
+    }
+
+    /* when the monitor saw the change (System.currentTimeMillis() clock), 0 from a snapshot diff */
+    public long getTime() {
+        return time;
+    }
+
+    @Override
+    public String toString() {
+        return (time != 0 ? "[" + time + "] " : "") + "The " + library + " syslink:" + symbol + " slot:0x" + Long.toHexString(slot) + " oldAddr:"
+                + valueString(oldValue) + " newAddr:" + valueString(newValue);
+    }
+
+    private static String valueString(long value) {
+        return value == UNREADABLE ? "unreadable" : "0x" + Long.toHexString(value);
+    }
+}
@@ -0,0 +1,60 @@
+package com.android.reverse.collecter;
+
+/**
+ * a range of library code that differs from the file on disk, filled in by NativeFunction.scanInlinePatches
+ */
+public class InlinePatch {
+
+    private String library;
+    private long address;
+    private int length;
+    private String symbol;
+    private long symbolAddress;
+    private byte[] original;
+    private byte[] patched;
+
+    public String getLibrary() {
+        return library;
+    }
+
+    public long getAddress() {
+        return address;
+    }
+
+    public int getLength() {
+        return length;
+    }
+
+    /* nearest symbol the library defines at or before address, "" if none */
+    public String getSymbol() {
+        return symbol;
+    }
+
+    public long getSymbolAddress() {
+        return symbolAddress;
+    }
+
+    /* the first bytes of the range in the file, and in memory */
+    public byte[] getOriginal() {
+        return original;
+    }
+
+    public byte[] getPatched() {
+        return patched;
+    }
+
+    private static String toHex(byte[] bytes) {
+        StringBuilder builder = new StringBuilder(bytes.length * 2);
+        for (byte b : bytes) {
+            builder.append(String.format("%02x", b & 0xff));
+        }
+        return builder.toString();
+    }
+
+    @Override
+    public String toString() {
+        String where = symbol.length() == 0 ? "" : " (" + symbol + "+0x" + Long.toHexString(address - symbolAddress) + ")";
+        return library + " address:0x" + Long.toHexString(address) + where + " length:" + length
+                + " original:" + toHex(original) + " patched:" + toHex(patched);
+    }
+}
@@ -0,0 +1,96 @@
+package com.android.reverse.collecter;
+
+/**
+ * a job of the native worker pool, as NativeFunction.jobStatus returns it; filled in natively
+ */
+public class JobInfo {
+
+    public final static int QUEUED = 0;
+    public final static int RUNNING = 1;
+    public final static int DONE = 2;
+    public final static int FAILED = 3;
+    public final static int CANCELLED = 4;
+
+    private final static String[] STATE_NAMES = {"queued", "running", "done", "failed", "cancelled"};
+
+    private int id;
+    private int state;
+    private String kind;
+    private String key;
+    private String unit;
+    private long done;
+    private long total;
+    private boolean cancelRequested;
+    private long waitNs;
+    private long runNs;
+
+    public int getId() {
+        return id;
+    }
+
+    public int getState() {
+        return state;
+    }
+
+    public boolean isFinished() {
+        return state >= DONE;
+    }
+
+    /* the command action */
+    public String getKind() {
+        return kind;
+    }
+
+    /* what makes two jobs the same, "" if nothing does */
+    public String getKey() {
+        return key;
+    }
+
+    /* what done and total count, "" until the job reports progress */
+    public String getUnit() {
+        return unit;
+    }
+
+    public long getDone() {
+        return done;
+    }
+
+    public long getTotal() {
+        return total;
+    }
+
+    public boolean isCancelRequested() {
+        return cancelRequested;
+    }
+
+    /* queued until it started, or until now */
+    public long getWaitNs() {
+        return waitNs;
+    }
+
+    /* started until it finished, or until now */
+    public long getRunNs() {
+        return runNs;
+    }
+
+    @Override
+    public String toString() {
+        StringBuilder text = new StringBuilder();
+        text.append("job:").append(id).append(" ").append(key.length() == 0 ? kind : key).append(" ")
+                .append(state >= 0 && state < STATE_NAMES.length ? STATE_NAMES[state] : String.valueOf(state));
+        if (state == RUNNING && cancelRequested) {
+            text.append(" (cancelling)");
+        }
+        if (unit.length() > 0) {
+            text.append(" ").append(done);
+            if (total > 0) {
+                text.append("/").append(total).append(" ").append(unit)
+                        .append(String.format(" (%.1f%%)", done * 100.0 / total));
+            } else {
+                text.append(" ").append(unit);
+            }
+        }
+        text.append(" waited:").append(waitNs / 1000000).append("ms ran:").append(runNs / 1000000).append("ms");
+        return text.toString();
+    }
+}
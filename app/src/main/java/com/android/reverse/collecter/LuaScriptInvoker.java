@@ -3,6 +3,7 @@ package com.android.reverse.collecter;
 import java.lang.reflect.Method;
 import org.keplerproject.luajava.JavaFunction;
 import org.keplerproject.luajava.LuaException;
+import org.keplerproject.luajava.LuaObject;
 import org.keplerproject.luajava.LuaState;
 import org.keplerproject.luajava.LuaStateFactory;
 
@@ -12,6 +13,7 @@ import com.android.reverse.hook.HookParam;
 import com.android.reverse.hook.MethodHookCallBack;
 import com.android.reverse.util.JsonWriter;
 import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
 import com.android.reverse.util.RefInvoke;
 
 public class LuaScriptInvoker{
@@ -59,6 +61,8 @@ public class LuaScriptInvoker{
 			logfunction.register("log");
 			JavaFunction tostringfunction = new ToStringFunctionCallBack(luaState);
 			tostringfunction.register("tostring");
+			JavaFunction searchmemfunction = new SearchMemFunctionCallBack(luaState);
+			searchmemfunction.register("searchmem");
 		} catch (LuaException e) {
 			e.printStackTrace();
 		}
@@ -113,6 +117,67 @@ public class LuaScriptInvoker{
 		
 	}
 	
+	/**
+	 * searchmem(patterns [, function(hit) [, perms [, path [, maxhits]]]]): patterns is one pattern
+	 * like "4c 8b ?? 24" or a table of them, every MemorySearchHit goes to the function as it is
+	 * found (logged without one); returns the number of hits, nil if a pattern is bad
+	 */
+	public static class SearchMemFunctionCallBack extends JavaFunction{
+
+		public SearchMemFunctionCallBack(LuaState L) {
+			super(L);
+		}
+
+		private String[] getPatterns() {
+			if (!this.L.isTable(2))
+				return new String[] { this.L.toString(2) };
+			String[] patterns = new String[this.L.objLen(2)];
+			for (int i = 0; i < patterns.length; i++) {
+				this.L.rawGetI(2, i + 1);
+				patterns[i] = this.L.toString(-1);
+				this.L.pop(1);
+			}
+			return patterns;
+		}
+
+		@Override
+		public int execute() throws LuaException {
+			String[] patterns = getPatterns();
+			final LuaObject callback = this.L.isFunction(3) ? this.getParam(3) : null;
+			String perms = this.L.isNoneOrNil(4) ? "r" : this.L.toString(4);
+			String path = this.L.isNoneOrNil(5) ? null : this.L.toString(5);
+			int maxHits = this.L.isNoneOrNil(6) ? 1000 : (int) this.L.toNumber(6);
+			long[] result;
+			try {
+				result = MemSearch.search(patterns, perms, path, 16, maxHits, 0, new MemorySearchListener() {
+
+					@Override
+					public void onHit(MemorySearchHit hit) {
+						if (callback == null) {
+							Logger.log(hit.toString());
+							return;
+						}
+						try {
+							callback.call(new Object[] { hit });
+						} catch (LuaException e) {
+							/* stops the search */
+							throw new RuntimeException(e);
+						}
+					}
+				});
+			} catch (RuntimeException e) {
+				Logger.log("searchmem stopped: " + e.getMessage());
+				result = null;
+			}
+			if (result == null)
+				this.L.pushNil();
+			else
+				this.L.pushNumber(result[NativeFunction.MEMSEARCH_HITS]);
+			return 1;
+		}
+		
+	}
+	
 	public static class LogFunctionCallBack extends JavaFunction{
 
 		public LogFunctionCallBack(LuaState L) {
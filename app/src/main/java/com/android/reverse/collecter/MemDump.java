@@ -1,56 +1,48 @@
 package com.android.reverse.collecter;
 
-import java.io.File;
-import java.io.FileNotFoundException;
-import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.OutputStream;
-import java.nio.ByteBuffer;
-import java.nio.ByteOrder;
 
+import com.android.reverse.util.Logger;
 import com.android.reverse.util.NativeFunction;
 
 public class MemDump {
 
-	private static void saveByteBuffer(OutputStream out, ByteBuffer data) {
-		data.order(ByteOrder.LITTLE_ENDIAN);
-		byte[] buffer = new byte[8192];
-		data.clear();
-		while (data.hasRemaining()) {
-			int count = Math.min(buffer.length, data.remaining());
-			data.get(buffer, 0, count);
-			try {
-				out.write(buffer, 0, count);
-			} catch (IOException e1) {
-				e1.printStackTrace();
-			}
+	public static void dumpMem(String filepath, long start, int length, int fsyncPolicy) {
+		long[] result = NativeFunction.dumpMemoryToFile(start, length, filepath, fsyncPolicy);
+		logDumpResult(filepath, result);
+		if (result != null && result[NativeFunction.DUMPMEM_UNREADABLE] + result[NativeFunction.DUMPMEM_ZERO] != 0) {
+			Logger.log("of " + result[NativeFunction.DUMPMEM_PAGES] + " pages, " + result[NativeFunction.DUMPMEM_UNREADABLE]
+					+ " unreadable and " + result[NativeFunction.DUMPMEM_ZERO] + " zero ones are holes in the file");
 		}
-
 	}
 
-	public static void dumpMem(String filepath, long start, int length) {
-		ByteBuffer buffer = NativeFunction.dumpMemory(start, length);
-		File file = new File(filepath);
-		if (!file.exists()) {
-			try {
-				file.createNewFile();
-				file.setWritable(true);
-			} catch (IOException e) {
-				e.printStackTrace();
-			}
-
+	/**
+	 * result is {bytes, elapsed ns, errno} as returned by the native dump writers
+	 */
+	public static void logDumpResult(String filepath, long[] result) {
+		if (result == null) {
+			Logger.log("dump to " + filepath + " failed: can't find the memory region");
+			return;
 		}
-		try {
-			saveByteBuffer(new FileOutputStream(file), buffer);
-		} catch (FileNotFoundException e) {
-			e.printStackTrace();
+		if (result[2] != 0) {
+			Logger.log("dump to " + filepath + " failed: errno=" + result[2] + " after " + result[0] + " bytes");
+			return;
 		}
-
+		long elapsedMs = result[1] / 1000000;
+		Logger.log("dump " + result[0] + " bytes to " + filepath + " in " + elapsedMs + "ms");
 	}
 
 	public static void dumpMem(OutputStream outstream, int start, int length) {
-		ByteBuffer buffer = NativeFunction.dumpMemory(start, length);
-		saveByteBuffer(outstream, buffer);
+		byte[] data = NativeFunction.readMemory(start & 0xffffffffL, length, null);
+		if (data == null) {
+			return;
+		}
+		try {
+			outstream.write(data);
+		} catch (IOException e) {
+			e.printStackTrace();
+		}
 
 	}
 
@@ -0,0 +1,45 @@
+package com.android.reverse.collecter;
+
+import java.io.UnsupportedEncodingException;
+
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class MemSearch {
+
+	/**
+	 * the pattern that matches text as UTF-8
+	 */
+	public static String textPattern(String text) {
+		byte[] bytes;
+		try {
+			bytes = text.getBytes("UTF-8");
+		} catch (UnsupportedEncodingException e) {
+			bytes = text.getBytes();
+		}
+		StringBuilder builder = new StringBuilder(bytes.length * 3);
+		for (byte b : bytes) {
+			builder.append(String.format("%02x ", b & 0xff));
+		}
+		return builder.toString().trim();
+	}
+
+	/**
+	 * search and log the totals; the stats of NativeFunction.searchMemory, null if it failed
+	 */
+	public static long[] search(String[] patterns, String perms, String path, int context, int maxHits, int threads,
+			MemorySearchListener listener) {
+		long[] result = NativeFunction.searchMemory(patterns, perms, path, context, maxHits, threads, listener);
+		if (result == null) {
+			Logger.log("search memory failed: check the patterns");
+			return null;
+		}
+		Logger.log("searched " + result[NativeFunction.MEMSEARCH_REGIONS] + " regions, "
+				+ (result[NativeFunction.MEMSEARCH_BYTES] >> 20) + "MB in "
+				+ result[NativeFunction.MEMSEARCH_ELAPSED_NS] / 1000000 + "ms: "
+				+ result[NativeFunction.MEMSEARCH_HITS] + " hits"
+				+ (result[NativeFunction.MEMSEARCH_TRUNCATED] != 0 ? ", stopped at the limit" : ""));
+		return result;
+	}
+
+}
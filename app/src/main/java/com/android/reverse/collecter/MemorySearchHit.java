@@ -0,0 +1,62 @@
+package com.android.reverse.collecter;
+
+/**
+ * a match of NativeFunction.searchMemory or scanSignatures, filled in natively
+ */
+public class MemorySearchHit {
+
+    private long address;
+    private int pattern;
+    private String name;
+    private String region;
+    private long regionStart;
+    private long contextAddress;
+    private byte[] context;
+
+    public long getAddress() {
+        return address;
+    }
+
+    /* index of the pattern that matched */
+    public int getPattern() {
+        return pattern;
+    }
+
+    /* the pattern as given, or the name of the signature that matched */
+    public String getName() {
+        return name;
+    }
+
+    /* path of the mapping the match is in, "" if anonymous */
+    public String getRegion() {
+        return region;
+    }
+
+    public long getRegionStart() {
+        return regionStart;
+    }
+
+    /* the match with the bytes around it, starting at contextAddress */
+    public long getContextAddress() {
+        return contextAddress;
+    }
+
+    public byte[] getContext() {
+        return context;
+    }
+
+    private static String toHex(byte[] bytes) {
+        StringBuilder builder = new StringBuilder(bytes.length * 2);
+        for (byte b : bytes) {
+            builder.append(String.format("%02x", b & 0xff));
+        }
+        return builder.toString();
+    }
+
+    @Override
+    public String toString() {
+        return "address:0x" + Long.toHexString(address) + " " + name + " region:"
+                + (region.length() == 0 ? "[anon]" : region) + "+0x" + Long.toHexString(address - regionStart)
+                + " context@0x" + Long.toHexString(contextAddress) + ":" + toHex(context);
+    }
+}
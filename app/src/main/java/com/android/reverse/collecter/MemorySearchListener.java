@@ -0,0 +1,10 @@
+package com.android.reverse.collecter;
+
+/**
+ * receives the hits of NativeFunction.searchMemory while the search runs, on the calling thread;
+ * throwing stops the search and the exception comes out of searchMemory
+ */
+public interface MemorySearchListener {
+
+    void onHit(MemorySearchHit hit);
+}
@@ -1,15 +1,13 @@
 package com.android.reverse.collecter;
 
-import java.util.HashMap;
-import java.util.Iterator;
-
 import com.android.reverse.util.Logger;
 import com.android.reverse.util.NativeFunction;
 
 public class NativeHookCollecter{
 
 	private static NativeHookCollecter collecter;
-	private static HashMap<String, HashMap<String, Integer>> initSysLinkInfo;
+	/* native handle of the GOT snapshot taken at init, 0 if none */
+	private static long initGotSnapshot;
 
 	private NativeHookCollecter() {
 
@@ -23,44 +21,21 @@ public class NativeHookCollecter{
 	}
 
 	public void init() {
-		if(initSysLinkInfo == null)
-			initSysLinkInfo = NativeFunction.getSyslinkSnapshot();
+		if(initGotSnapshot == 0)
+			initGotSnapshot = NativeFunction.takeGotSnapshot();
 	}
 
 	public void parserNativeHookInfo() {
 		Logger.log("The parser native hook info start");
-		if (initSysLinkInfo == null) {
+		if (initGotSnapshot == 0) {
 			Logger.log("the init syslink info == null");
 			return;
 		}
 
-		int hookcount =0;
-		HashMap<String, HashMap<String, Integer>> currentInfo = NativeFunction
-				.getSyslinkSnapshot();
-		Iterator<String> libkeys = currentInfo.keySet().iterator();
-		HashMap<String, Integer> currentlinks;
-		HashMap<String, Integer> initlinks;
-		while (libkeys.hasNext()) {
-			String libName = libkeys.next();
-			if (initSysLinkInfo.containsKey(libName)) {
-				currentlinks = currentInfo.get(libName);
-				initlinks = initSysLinkInfo.get(libName);
-				Iterator<String> sysNamekeys = currentlinks.keySet().iterator();
-				while (sysNamekeys.hasNext()) {
-					String sysName = sysNamekeys.next();
-					if (initlinks.containsKey(sysName)) {
-						int currentAddr = currentlinks.get(sysName);
-						int initAddr = initlinks.get(sysName);
-						if (currentAddr != initAddr) {
-							Logger.log("The " + libName + " syslink:" + sysName
-									+ " oldAddr:" + initAddr + " newAddr:"
-									+ currentAddr);
-							hookcount++;
-						} 
-						
-					}
-				}
-			}
+		GotSlotChange[] changes = NativeFunction.diffGotSnapshot(initGotSnapshot);
+		int hookcount = changes == null ? 0 : changes.length;
+		for (int i = 0; i < hookcount; i++) {
+			Logger.log(changes[i].toString());
 		}
 		if(hookcount == 0 ){
 			Logger.log("the app can't hook native function");
@@ -0,0 +1,61 @@
+package com.android.reverse.collecter;
+
+import java.io.File;
+
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class SigScan {
+
+	/**
+	 * the compiled set kept for a signature source, in the app's files
+	 */
+	public static File blobFor(String source) {
+		File dir = ModuleContext.getInstance().getAppContext().getFilesDir();
+		return new File(dir, "sigscan_" + new File(source).getName() + ".bin");
+	}
+
+	/**
+	 * compile source unless its set is there and newer, or compile is asked for; false if it failed
+	 */
+	public static boolean prepare(String source, File blob, boolean compile) {
+		File sourceFile = new File(source);
+		if (!sourceFile.isFile()) {
+			Logger.log("signature source " + source + " not found");
+			return false;
+		}
+		if (!compile && blob.isFile() && blob.lastModified() >= sourceFile.lastModified()) {
+			return true;
+		}
+		String error = NativeFunction.compileSignatures(source, blob.getAbsolutePath());
+		if (error != null) {
+			Logger.log("compile " + source + " failed: " + error);
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * scan and log the totals; the stats of NativeFunction.scanSignatures, null if it failed
+	 */
+	public static long[] scan(String source, boolean compile, boolean allRegions, int context, int maxHits,
+			int threads, MemorySearchListener listener) {
+		File blob = blobFor(source);
+		if (!prepare(source, blob, compile)) {
+			return null;
+		}
+		long[] result = NativeFunction.scanSignatures(blob.getAbsolutePath(), allRegions, context, maxHits, threads,
+				listener);
+		if (result == null) {
+			Logger.log("scan signatures failed: " + blob.getAbsolutePath());
+			return null;
+		}
+		Logger.log("scanned " + result[NativeFunction.MEMSEARCH_REGIONS] + " regions, "
+				+ (result[NativeFunction.MEMSEARCH_BYTES] >> 20) + "MB in "
+				+ result[NativeFunction.MEMSEARCH_ELAPSED_NS] / 1000000 + "ms: "
+				+ result[NativeFunction.MEMSEARCH_HITS] + " hits"
+				+ (result[NativeFunction.MEMSEARCH_TRUNCATED] != 0 ? ", stopped at the limit" : ""));
+		return result;
+	}
+
+}
@@ -4,7 +4,9 @@ import java.util.List;
 
 import com.android.reverse.request.CommandHandler;
 import com.android.reverse.request.CommandHandlerParser;
+import com.android.reverse.request.InstantCommandHandler;
 import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
 import android.content.BroadcastReceiver;
 import android.content.Context;
 import android.content.Intent;
@@ -24,13 +26,15 @@ public class CommandBroadcastReceiver extends BroadcastReceiver {
 					String cmd = arg1.getStringExtra(COMMAND_NAME_KEY);
 					final CommandHandler handler = CommandHandlerParser
 							.parserCommand(cmd);
-					if (handler != null) {
+					if (handler instanceof InstantCommandHandler) {
 						new Thread(new Runnable() {
 							@Override
 							public void run() {
 								handler.doAction();
 							}
 						}).start();
+					} else if (handler != null) {
+						submitJob(cmd, handler);
 					}else{
 						Logger.log("the cmd is invalid");
 					}
@@ -40,5 +44,26 @@ public class CommandBroadcastReceiver extends BroadcastReceiver {
 			}
 		}
 	}
-	
+
+	/*
+	 * the long commands (dumps, scans, rebuilds, indexes...) run on the native job pool: a couple at a time,
+	 * the same command with the same parameters only once, and job_status / job_cancel can follow them
+	 */
+	private static void submitJob(String cmd, final CommandHandler handler) {
+		String[] job = CommandHandlerParser.jobOf(cmd);
+		int[] result = NativeFunction.jobSubmit(job[0], job[1], new Runnable() {
+			@Override
+			public void run() {
+				handler.doAction();
+			}
+		});
+		if (result == null) {
+			Logger.log("queue the " + job[0] + " job failed");
+		} else if (result[NativeFunction.JOB_EXISTING] != 0) {
+			Logger.log("the same " + job[0] + " is job " + result[NativeFunction.JOB_ID] + " already");
+		} else {
+			Logger.log(job[0] + " queued as job " + result[NativeFunction.JOB_ID]);
+		}
+	}
+
 }
@@ -0,0 +1,31 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class BenchDexSumCommandHandler implements CommandHandler {
+
+    private int sizeMb;
+
+    public BenchDexSumCommandHandler(int sizeMb) {
+        this.sizeMb = sizeMb;
+    }
+
+    private static long throughput(int sizeMb, long elapsedNs) {
+        return elapsedNs == 0 ? 0 : sizeMb * 1000000000L / elapsedNs;
+    }
+
+    @Override
+    public void doAction() {
+        long[] result = NativeFunction.benchmarkDexSum(sizeMb);
+        if (result == null) {
+            Logger.log("dexsum benchmark failed");
+            return;
+        }
+        Logger.log("adler32 " + throughput(sizeMb, result[0]) + " MB/s (scalar " + throughput(sizeMb, result[2]) + " MB/s)");
+        Logger.log("sha1 " + throughput(sizeMb, result[1]) + " MB/s (scalar " + throughput(sizeMb, result[3]) + " MB/s)");
+    }
+
+
+}
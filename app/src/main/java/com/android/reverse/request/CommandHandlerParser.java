@@ -1,28 +1,98 @@
 package com.android.reverse.request;
 
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.Iterator;
+import java.util.List;
+
+import org.json.JSONArray;
 import org.json.JSONException;
 import org.json.JSONObject;
 
+import com.android.reverse.collecter.MemSearch;
 import com.android.reverse.request.InvokeScriptCommandHandler.ScriptType;
 import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
 
 public class CommandHandlerParser {
 
 	private static String ACTION_NAME_KEY = "action";
+	/* worker threads of any multithreaded command, 0 or absent for one per cpu */
+	private static String PARAM_THREADS = "threads";
 
 	private static String ACTION_DUMP_DEXINFO = "dump_dexinfo";
 	private static String ACTION_DUMP_HEAP = "dump_heap";
 
 	private static String ACTION_DUMP_DEXCLASS = "dump_class";
 	private static String PARAM_MCOOKIE_DUMPDEXCLASS = "mCookie";
+	private static String PARAM_PREFIX_DUMPDEXCLASS = "prefix";
 
 	private static String ACTION_DUMP_DEXFILE = "dump_dexfile";
 	private static String ACTION_BACKSMALI_DEXFILE = "backsmali";
+	private static String ACTION_REBUILD_DEXFILE = "rebuild_dexfile";
 	private static String PARAM_MCOOKIE_DUMP_DEXFILE = "mCookie";
+	private static String PARAM_FIX_CHECKSUM_DUMP_DEXFILE = "fix_checksum";
+
+	private static String ACTION_DUMP_ALLDEX = "dump_alldex";
+	private static String PARAM_DEXPATH_DUMP_ALLDEX = "dexpath";
+
+	private static String ACTION_SCAN_DEX = "scan_dex";
+	private static String PARAM_DUMP_SCAN_DEX = "dump";
+
+	private static String ACTION_FIX_DEXFILE = "fix_dexfile";
+	private static String PARAM_VERIFY_FIX_DEXFILE = "verify";
+	private static String ACTION_BENCH_DEXSUM = "bench_dexsum";
+	private static String PARAM_SIZE_BENCH_DEXSUM = "size";
+
+	private static String ACTION_SCAN_INLINE = "scan_inline";
+
+	private static String ACTION_DUMP_DELTA = "dump_delta";
+	private static String PARAM_STOP_DUMP_DELTA = "stop";
+
+	private static String ACTION_HARVEST_CODE = "harvest_code";
+	private static String PARAM_REBUILD_HARVEST_CODE = "rebuild";
+
+	private static String ACTION_DEX_INDEX = "dex_index";
+	private static String PARAM_CLASS_DEX_INDEX = "class";
+	private static String PARAM_STRING_DEX_INDEX = "string";
+	private static String PARAM_METHOD_DEX_INDEX = "method";
+
+	private static String ACTION_GOT_MONITOR = "got_monitor";
+	private static String PARAM_INTERVAL_GOT_MONITOR = "interval";
 
 	private static String ACTION_DUMP_MEMERY = "dump_mem";
 	private static String PARAM_START_DUMP_MEMERY = "start";
 	private static String PARAM_LENGTH_DUMP_MEMERY = "length";
+	private static String PARAM_FSYNC_DUMP = "fsync";
+
+	private static String ACTION_SNAPSHOT_MEMERY = "snapshot_mem";
+	private static String PARAM_PERMS_SNAPSHOT_MEMERY = "perms";
+	private static String PARAM_PATH_SNAPSHOT_MEMERY = "path";
+	private static String PARAM_MAX_SIZE_SNAPSHOT_MEMERY = "max_size";
+
+	private static String ACTION_SEARCH_MEMERY = "search_mem";
+	private static String PARAM_PATTERN_SEARCH_MEMERY = "pattern";
+	private static String PARAM_STRING_SEARCH_MEMERY = "string";
+	private static String PARAM_CONTEXT_SEARCH_MEMERY = "context";
+	private static String PARAM_MAX_HITS_SEARCH_MEMERY = "max_hits";
+
+	private static String ACTION_SCAN_SIGNATURES = "scan_sig";
+	private static String PARAM_SOURCE_SCAN_SIGNATURES = "signatures";
+	private static String PARAM_COMPILE_SCAN_SIGNATURES = "compile";
+	private static String PARAM_ALL_SCAN_SIGNATURES = "all";
+
+	private static String ACTION_ENTROPY_MAP = "entropy_map";
+	private static String PARAM_WINDOW_ENTROPY_MAP = "window";
+	private static String PARAM_MIN_ENTROPY_MAP = "min_entropy";
+	private static String PARAM_MIN_WINDOWS_ENTROPY_MAP = "min_windows";
+	private static String PARAM_DUMP_ENTROPY_MAP = "dump";
+
+	private static String ACTION_TRACE = "trace";
+	private static String PARAM_ENABLE_TRACE = "enable";
+
+	private static String ACTION_JOB_STATUS = "job_status";
+	private static String ACTION_JOB_CANCEL = "job_cancel";
+	private static String PARAM_ID_JOB = "id";
 
 	private static String ACTION_INVOKE_SCRIPT = "invoke";
 	private static String FILE_SCRIPT = "filepath";
@@ -38,7 +108,9 @@ public class CommandHandlerParser {
 			} else if (ACTION_DUMP_DEXFILE.equals(action)) {
 				if (jsoncmd.has(PARAM_MCOOKIE_DUMP_DEXFILE)) {
 					String mCookie = jsoncmd.getString(PARAM_MCOOKIE_DUMP_DEXFILE);
-					handler = new DumpDexFileCommandHandler(mCookie);
+					int fsyncPolicy = jsoncmd.optInt(PARAM_FSYNC_DUMP, NativeFunction.DUMP_FSYNC_NONE);
+					boolean fixChecksum = jsoncmd.optBoolean(PARAM_FIX_CHECKSUM_DUMP_DEXFILE, false);
+					handler = new DumpDexFileCommandHandler(mCookie, fsyncPolicy, fixChecksum);
 				} else {
 					Logger.log("please set the " + PARAM_MCOOKIE_DUMP_DEXFILE + " value");
 				}
@@ -49,10 +121,76 @@ public class CommandHandlerParser {
 				} else {
 					Logger.log("please set the " + PARAM_MCOOKIE_DUMP_DEXFILE + " value");
 				}
+			} else if (ACTION_REBUILD_DEXFILE.equals(action)) {
+				if (jsoncmd.has(PARAM_MCOOKIE_DUMP_DEXFILE)) {
+					String mCookie = jsoncmd.getString(PARAM_MCOOKIE_DUMP_DEXFILE);
+					handler = new RebuildDexFileCommandHandler(mCookie);
+				} else {
+					Logger.log("please set the " + PARAM_MCOOKIE_DUMP_DEXFILE + " value");
+				}
+			} else if (ACTION_DUMP_ALLDEX.equals(action)) {
+				String dexPath = jsoncmd.has(PARAM_DEXPATH_DUMP_ALLDEX) ? jsoncmd.getString(PARAM_DEXPATH_DUMP_ALLDEX) : null;
+				int fsyncPolicy = jsoncmd.optInt(PARAM_FSYNC_DUMP, NativeFunction.DUMP_FSYNC_NONE);
+				boolean fixChecksum = jsoncmd.optBoolean(PARAM_FIX_CHECKSUM_DUMP_DEXFILE, false);
+				handler = new DumpAllDexCommandHandler(dexPath, fsyncPolicy, fixChecksum);
+			} else if (ACTION_SCAN_DEX.equals(action)) {
+				boolean dump = jsoncmd.optBoolean(PARAM_DUMP_SCAN_DEX, false);
+				int threads = jsoncmd.optInt(PARAM_THREADS, 0);
+				int fsyncPolicy = jsoncmd.optInt(PARAM_FSYNC_DUMP, NativeFunction.DUMP_FSYNC_NONE);
+				handler = new ScanDexCommandHandler(dump, threads, fsyncPolicy);
+			} else if (ACTION_FIX_DEXFILE.equals(action)) {
+				if (jsoncmd.has(FILE_SCRIPT)) {
+					String filepath = jsoncmd.getString(FILE_SCRIPT);
+					boolean verifyOnly = jsoncmd.optBoolean(PARAM_VERIFY_FIX_DEXFILE, false);
+					handler = new FixDexFileCommandHandler(filepath, verifyOnly);
+				} else {
+					Logger.log("please set the " + FILE_SCRIPT);
+				}
+			} else if (ACTION_BENCH_DEXSUM.equals(action)) {
+				int sizeMb = jsoncmd.optInt(PARAM_SIZE_BENCH_DEXSUM, 16);
+				handler = new BenchDexSumCommandHandler(sizeMb);
+			} else if (ACTION_SCAN_INLINE.equals(action)) {
+				int threads = jsoncmd.optInt(PARAM_THREADS, 0);
+				handler = new ScanInlineCommandHandler(threads);
+			} else if (ACTION_DUMP_DELTA.equals(action)) {
+				if (jsoncmd.has(PARAM_MCOOKIE_DUMP_DEXFILE)) {
+					String mCookie = jsoncmd.getString(PARAM_MCOOKIE_DUMP_DEXFILE);
+					if (jsoncmd.optBoolean(PARAM_STOP_DUMP_DELTA, false)) {
+						handler = new DumpDeltaStopCommandHandler(mCookie);
+					} else {
+						handler = new DumpDeltaCommandHandler(mCookie);
+					}
+				} else {
+					Logger.log("please set the " + PARAM_MCOOKIE_DUMP_DEXFILE + " value");
+				}
+			} else if (ACTION_HARVEST_CODE.equals(action)) {
+				if (jsoncmd.has(PARAM_MCOOKIE_DUMP_DEXFILE)) {
+					String mCookie = jsoncmd.getString(PARAM_MCOOKIE_DUMP_DEXFILE);
+					int threads = jsoncmd.optInt(PARAM_THREADS, 0);
+					boolean rebuild = jsoncmd.optBoolean(PARAM_REBUILD_HARVEST_CODE, false);
+					handler = new HarvestCodeCommandHandler(mCookie, threads, rebuild);
+				} else {
+					Logger.log("please set the " + PARAM_MCOOKIE_DUMP_DEXFILE + " value");
+				}
+			} else if (ACTION_DEX_INDEX.equals(action)) {
+				if (jsoncmd.has(PARAM_MCOOKIE_DUMP_DEXFILE)) {
+					String mCookie = jsoncmd.getString(PARAM_MCOOKIE_DUMP_DEXFILE);
+					int threads = jsoncmd.optInt(PARAM_THREADS, 0);
+					String className = jsoncmd.has(PARAM_CLASS_DEX_INDEX) ? jsoncmd.getString(PARAM_CLASS_DEX_INDEX) : null;
+					String string = jsoncmd.has(PARAM_STRING_DEX_INDEX) ? jsoncmd.getString(PARAM_STRING_DEX_INDEX) : null;
+					int methodIdx = jsoncmd.optInt(PARAM_METHOD_DEX_INDEX, DexIndexCommandHandler.NO_METHOD);
+					handler = new DexIndexCommandHandler(mCookie, threads, className, string, methodIdx);
+				} else {
+					Logger.log("please set the " + PARAM_MCOOKIE_DUMP_DEXFILE + " value");
+				}
+			} else if (ACTION_GOT_MONITOR.equals(action)) {
+				int intervalMs = jsoncmd.optInt(PARAM_INTERVAL_GOT_MONITOR, GotMonitorCommandHandler.INTERVAL_DRAIN);
+				handler = new GotMonitorCommandHandler(intervalMs);
 			} else if (ACTION_DUMP_DEXCLASS.equals(action)) {
 				if (jsoncmd.has(PARAM_MCOOKIE_DUMPDEXCLASS)) {
 					String mCookie = jsoncmd.getString(PARAM_MCOOKIE_DUMPDEXCLASS);
-					handler = new DumpClassCommandHandler(mCookie);
+					String prefix = jsoncmd.has(PARAM_PREFIX_DUMPDEXCLASS) ? jsoncmd.getString(PARAM_PREFIX_DUMPDEXCLASS) : null;
+					handler = new DumpClassCommandHandler(mCookie, prefix);
 				} else {
 					Logger.log("please set the " + PARAM_MCOOKIE_DUMPDEXCLASS + " value");
 				}
@@ -69,7 +207,56 @@ public class CommandHandlerParser {
 			} else if (ACTION_DUMP_MEMERY.equals(action)) {
 				long start = jsoncmd.getLong(PARAM_START_DUMP_MEMERY);
 				int length = jsoncmd.getInt(PARAM_LENGTH_DUMP_MEMERY);
-				handler = new DumpMemCommandHandler(start, length);
+				int fsyncPolicy = jsoncmd.optInt(PARAM_FSYNC_DUMP, NativeFunction.DUMP_FSYNC_NONE);
+				handler = new DumpMemCommandHandler(start, length, fsyncPolicy);
+			} else if (ACTION_SNAPSHOT_MEMERY.equals(action)) {
+				String perms = jsoncmd.optString(PARAM_PERMS_SNAPSHOT_MEMERY, "r");
+				String pattern = jsoncmd.has(PARAM_PATH_SNAPSHOT_MEMERY) ? jsoncmd.getString(PARAM_PATH_SNAPSHOT_MEMERY) : null;
+				long maxSize = jsoncmd.optLong(PARAM_MAX_SIZE_SNAPSHOT_MEMERY, 0);
+				handler = new SnapshotMemCommandHandler(perms, pattern, maxSize);
+			} else if (ACTION_SEARCH_MEMERY.equals(action)) {
+				String[] patterns = searchPatterns(jsoncmd);
+				if (patterns.length > 0) {
+					String perms = jsoncmd.optString(PARAM_PERMS_SNAPSHOT_MEMERY, "r");
+					String path = jsoncmd.has(PARAM_PATH_SNAPSHOT_MEMERY) ? jsoncmd.getString(PARAM_PATH_SNAPSHOT_MEMERY) : null;
+					int context = jsoncmd.optInt(PARAM_CONTEXT_SEARCH_MEMERY, 16);
+					int maxHits = jsoncmd.optInt(PARAM_MAX_HITS_SEARCH_MEMERY, 1000);
+					int threads = jsoncmd.optInt(PARAM_THREADS, 0);
+					handler = new SearchMemCommandHandler(patterns, perms, path, context, maxHits, threads);
+				} else {
+					Logger.log("please set the " + PARAM_PATTERN_SEARCH_MEMERY + " or the " + PARAM_STRING_SEARCH_MEMERY);
+				}
+			} else if (ACTION_SCAN_SIGNATURES.equals(action)) {
+				if (jsoncmd.has(PARAM_SOURCE_SCAN_SIGNATURES)) {
+					String source = jsoncmd.getString(PARAM_SOURCE_SCAN_SIGNATURES);
+					boolean compile = jsoncmd.optBoolean(PARAM_COMPILE_SCAN_SIGNATURES, false);
+					boolean all = jsoncmd.optBoolean(PARAM_ALL_SCAN_SIGNATURES, false);
+					int context = jsoncmd.optInt(PARAM_CONTEXT_SEARCH_MEMERY, 16);
+					int maxHits = jsoncmd.optInt(PARAM_MAX_HITS_SEARCH_MEMERY, 1000);
+					int threads = jsoncmd.optInt(PARAM_THREADS, 0);
+					handler = new ScanSignaturesCommandHandler(source, compile, all, context, maxHits, threads);
+				} else {
+					Logger.log("please set the " + PARAM_SOURCE_SCAN_SIGNATURES);
+				}
+			} else if (ACTION_ENTROPY_MAP.equals(action)) {
+				String perms = jsoncmd.optString(PARAM_PERMS_SNAPSHOT_MEMERY, "r");
+				String path = jsoncmd.has(PARAM_PATH_SNAPSHOT_MEMERY) ? jsoncmd.getString(PARAM_PATH_SNAPSHOT_MEMERY) : null;
+				int window = jsoncmd.optInt(PARAM_WINDOW_ENTROPY_MAP, 4096);
+				float minEntropy = (float) jsoncmd.optDouble(PARAM_MIN_ENTROPY_MAP, 7.2);
+				int minWindows = jsoncmd.optInt(PARAM_MIN_WINDOWS_ENTROPY_MAP, 4);
+				boolean dump = jsoncmd.optBoolean(PARAM_DUMP_ENTROPY_MAP, false);
+				int threads = jsoncmd.optInt(PARAM_THREADS, 0);
+				handler = new EntropyMapCommandHandler(perms, path, window, minEntropy, minWindows, dump, threads);
+			} else if (ACTION_TRACE.equals(action)) {
+				handler = new TraceCommandHandler(jsoncmd.optBoolean(PARAM_ENABLE_TRACE, true));
+			} else if (ACTION_JOB_STATUS.equals(action)) {
+				handler = new JobCommandHandler(jsoncmd.optInt(PARAM_ID_JOB, JobCommandHandler.ALL_JOBS), false);
+			} else if (ACTION_JOB_CANCEL.equals(action)) {
+				if (jsoncmd.has(PARAM_ID_JOB)) {
+					handler = new JobCommandHandler(jsoncmd.getInt(PARAM_ID_JOB), true);
+				} else {
+					Logger.log("please set the " + PARAM_ID_JOB + " of the job");
+				}
 			} else {
 				Logger.log(action + " cmd is invalid! ");
 			}
@@ -79,4 +266,58 @@ public class CommandHandlerParser {
 		return handler;
 	}
 
+	/*
+	 * {kind, key} of the job running cmd: the action, and what makes two commands the same job, every parameter
+	 * but the thread count, which doesn't change what the command does. In name order, so the same command
+	 * written in another order is still the same job
+	 */
+	public static String[] jobOf(String cmd) {
+		try {
+			JSONObject jsoncmd = new JSONObject(cmd);
+			String action = jsoncmd.getString(ACTION_NAME_KEY);
+			ArrayList<String> names = new ArrayList<String>();
+			Iterator<?> it = jsoncmd.keys();
+			while (it.hasNext()) {
+				String name = (String) it.next();
+				if (!PARAM_THREADS.equals(name)) {
+					names.add(name);
+				}
+			}
+			Collections.sort(names);
+			StringBuilder key = new StringBuilder();
+			for (String name : names) {
+				Object value = jsoncmd.get(name);
+				key.append(JSONObject.quote(name)).append(':')
+						.append(value instanceof String ? JSONObject.quote((String) value) : value.toString()).append(',');
+			}
+			return new String[] {action, key.toString()};
+		} catch (JSONException e) {
+			return new String[] {cmd, cmd};
+		}
+	}
+
+	/* "pattern" and "string" may each be one value or an array of them */
+	private static String[] searchPatterns(JSONObject jsoncmd) throws JSONException {
+		ArrayList<String> patterns = new ArrayList<String>();
+		addSearchPatterns(jsoncmd, PARAM_PATTERN_SEARCH_MEMERY, false, patterns);
+		addSearchPatterns(jsoncmd, PARAM_STRING_SEARCH_MEMERY, true, patterns);
+		return patterns.toArray(new String[patterns.size()]);
+	}
+
+	private static void addSearchPatterns(JSONObject jsoncmd, String key, boolean text, List<String> patterns)
+			throws JSONException {
+		if (!jsoncmd.has(key))
+			return;
+		JSONArray values = jsoncmd.optJSONArray(key);
+		if (values == null) {
+			String value = jsoncmd.getString(key);
+			patterns.add(text ? MemSearch.textPattern(value) : value);
+			return;
+		}
+		for (int i = 0; i < values.length(); i++) {
+			String value = values.getString(i);
+			patterns.add(text ? MemSearch.textPattern(value) : value);
+		}
+	}
+
 }
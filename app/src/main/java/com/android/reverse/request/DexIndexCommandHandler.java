@@ -0,0 +1,55 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.DexFileInfoCollecter;
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class DexIndexCommandHandler implements CommandHandler {
+
+    public final static int NO_METHOD = -1;
+
+    private String mCookie;
+    private int threads;
+    private String className;
+    private String string;
+    private int methodIdx;
+
+    public DexIndexCommandHandler(String mCookie, int threads, String className, String string, int methodIdx) {
+        this.mCookie = mCookie;
+        this.threads = threads;
+        this.className = className;
+        this.string = string;
+        this.methodIdx = methodIdx;
+    }
+
+    @Override
+    public void doAction() {
+        String dir = DexFileInfoCollecter.getDexIndexDir();
+        long cookie = Long.parseLong(mCookie);
+        int version = ModuleContext.getInstance().getApiLevel();
+        long[] result = NativeFunction.openDexIndex(cookie, version, dir, threads);
+        if (result == null) {
+            Logger.log("open the dex index failed");
+            return;
+        }
+        Logger.log((result[NativeFunction.DEXINDEX_BUILT] != 0 ? "built" : "opened") + " the dex index in "
+                + result[NativeFunction.DEXINDEX_ELAPSED_NS] / 1000 + "us: " + result[NativeFunction.DEXINDEX_CLASSES]
+                + " classes, " + result[NativeFunction.DEXINDEX_METHODS] + " methods, "
+                + result[NativeFunction.DEXINDEX_STRINGS] + " strings");
+        if (className != null) {
+            String descriptor = className.endsWith(";") ? className : "L" + className.replace('.', '/') + ";";
+            Logger.log("class " + descriptor + " -> class_def " + NativeFunction.findDexIndexClass(cookie, version, dir, descriptor));
+        }
+        if (string != null) {
+            Logger.log("string \"" + string + "\" -> string_id " + NativeFunction.findDexIndexString(cookie, version, dir, string));
+        }
+        if (methodIdx != NO_METHOD) {
+            Logger.log("method_id " + methodIdx + " -> code_item 0x"
+                    + Long.toHexString(NativeFunction.getDexIndexCode(cookie, version, dir, methodIdx)));
+        }
+    }
+
+
+}
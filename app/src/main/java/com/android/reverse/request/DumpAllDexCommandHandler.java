@@ -0,0 +1,28 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.DexFileInfoCollecter;
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+
+public class DumpAllDexCommandHandler implements CommandHandler {
+
+    private String dexPath;
+    private int fsyncPolicy;
+    private boolean fixChecksum;
+
+    public DumpAllDexCommandHandler(String dexPath, int fsyncPolicy, boolean fixChecksum) {
+        this.dexPath = dexPath;
+        this.fsyncPolicy = fsyncPolicy;
+        this.fixChecksum = fixChecksum;
+    }
+
+    @Override
+    public void doAction() {
+        String dir = ModuleContext.getInstance().getAppContext().getFilesDir() + "/dexdump_all";
+        DexFileInfoCollecter.getInstance().dumpAllDexFile(dir, dexPath, fsyncPolicy, fixChecksum);
+        Logger.log("the manifest save to =" + dir + "/manifest.json");
+    }
+
+
+}
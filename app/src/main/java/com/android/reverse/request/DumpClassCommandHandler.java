@@ -6,14 +6,20 @@ import com.android.reverse.util.Logger;
 public class DumpClassCommandHandler implements CommandHandler {
 
 	private String mCookie;
+	private String prefix;
 
 	public DumpClassCommandHandler(String mCookie) {
+		this(mCookie, null);
+	}
+
+	public DumpClassCommandHandler(String mCookie, String prefix) {
 		this.mCookie = mCookie;
+		this.prefix = prefix;
 	}
 
 	@Override
 	public void doAction() {
-		String[] loadClass = DexFileInfoCollecter.getInstance().dumpLoadableClass(mCookie);
+		String[] loadClass = DexFileInfoCollecter.getInstance().dumpLoadableClass(mCookie, prefix);
 		if (loadClass != null) {
 			Logger.log("Start Loadable ClassName ->");
 			String className = null;
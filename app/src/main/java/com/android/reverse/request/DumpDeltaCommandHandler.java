@@ -0,0 +1,71 @@
+package com.android.reverse.request;
+
+
+import java.util.HashMap;
+
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class DumpDeltaCommandHandler implements CommandHandler {
+
+    private static class Tracker {
+        long handle;
+        int round;
+    }
+
+    /* native trackers by cookie, alive between commands until stopped */
+    private static HashMap<String, Tracker> trackers = new HashMap<String, Tracker>();
+
+    private String mCookie;
+
+    public DumpDeltaCommandHandler(String mCookie) {
+        this.mCookie = mCookie;
+    }
+
+    /* for DumpDeltaStopCommandHandler: waits for a round in progress, then frees the tracker */
+    static void stop(String mCookie) {
+        synchronized (trackers) {
+            Tracker tracker = trackers.remove(mCookie);
+            if (tracker != null) {
+                NativeFunction.endDumpDelta(tracker.handle);
+                Logger.log("stop the incremental dump of " + mCookie);
+            }
+        }
+    }
+
+    @Override
+    public void doAction() {
+        synchronized (trackers) {
+            Tracker tracker = trackers.get(mCookie);
+            String prefix = ModuleContext.getInstance().getAppContext().getFilesDir() + "/dexdelta" + mCookie + "_";
+            if (tracker == null) {
+                String filename = prefix + "0.bin";
+                long handle = NativeFunction.beginDumpDelta(Long.parseLong(mCookie), ModuleContext.getInstance().getApiLevel(), filename);
+                if (handle == 0) {
+                    Logger.log("start the incremental dump failed");
+                    return;
+                }
+                tracker = new Tracker();
+                tracker.handle = handle;
+                trackers.put(mCookie, tracker);
+                Logger.log("the base of the incremental dump save to =" + filename);
+                return;
+            }
+            String filename = prefix + (tracker.round + 1) + ".bin";
+            long[] result = NativeFunction.nextDumpDelta(tracker.handle, filename);
+            if (result == null) {
+                Logger.log("the incremental dump failed");
+                return;
+            }
+            tracker.round++;
+            Logger.log("round " + result[NativeFunction.DELTA_ROUND] + ": " + result[NativeFunction.DELTA_PAGES_CHANGED]
+                    + " of " + result[NativeFunction.DELTA_PAGES_READ] + " pages read changed, "
+                    + result[NativeFunction.DELTA_BYTES] + " bytes"
+                    + (result[NativeFunction.DELTA_SOFT_DIRTY] != 0 ? " (soft-dirty)" : "") + " in "
+                    + result[NativeFunction.DELTA_ELAPSED_NS] / 1000 + "us, save to =" + filename);
+        }
+    }
+
+
+}
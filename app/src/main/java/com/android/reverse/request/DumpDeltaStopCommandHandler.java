@@ -0,0 +1,19 @@
+package com.android.reverse.request;
+
+
+/* dump_delta {"stop":true}: instant, so it is never queued behind, or taken for, a round of the dump */
+public class DumpDeltaStopCommandHandler implements InstantCommandHandler {
+
+    private String mCookie;
+
+    public DumpDeltaStopCommandHandler(String mCookie) {
+        this.mCookie = mCookie;
+    }
+
+    @Override
+    public void doAction() {
+        DumpDeltaCommandHandler.stop(mCookie);
+    }
+
+
+}
@@ -8,15 +8,19 @@ import com.android.reverse.util.Logger;
 public class DumpDexFileCommandHandler implements CommandHandler {
 
     private String mCookie;
+    private int fsyncPolicy;
+    private boolean fixChecksum;
 
-    public DumpDexFileCommandHandler(String mCookie) {
+    public DumpDexFileCommandHandler(String mCookie, int fsyncPolicy, boolean fixChecksum) {
         this.mCookie = mCookie;
+        this.fsyncPolicy = fsyncPolicy;
+        this.fixChecksum = fixChecksum;
     }
 
     @Override
     public void doAction() {
         String filename = ModuleContext.getInstance().getAppContext().getFilesDir() + "/dexdump" + mCookie + ".odex";
-        DexFileInfoCollecter.getInstance().dumpDexFile(filename, mCookie);
+        DexFileInfoCollecter.getInstance().dumpDexFile(filename, mCookie, fsyncPolicy, fixChecksum);
         Logger.log("the dexfile data save to =" + filename);
     }
 
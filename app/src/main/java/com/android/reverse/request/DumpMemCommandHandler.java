@@ -10,17 +10,19 @@ public class DumpMemCommandHandler implements CommandHandler {
 	private String dumpFileName;
 	private long start;
 	private int length;
+	private int fsyncPolicy;
 	
-	public DumpMemCommandHandler(long start, int length){
+	public DumpMemCommandHandler(long start, int length, int fsyncPolicy){
 		this.start = start;
 		this.length = length;
+		this.fsyncPolicy = fsyncPolicy;
 		this.dumpFileName = String.valueOf(start);
 	}
 
 	@Override
 	public void doAction() {
 		String memfilePath = ModuleContext.getInstance().getAppContext().getFilesDir()+"/"+dumpFileName;
-        MemDump.dumpMem(memfilePath, start, length);
+        MemDump.dumpMem(memfilePath, start, length, fsyncPolicy);
         Logger.log("the mem data save to ="+ memfilePath);
 	}
 
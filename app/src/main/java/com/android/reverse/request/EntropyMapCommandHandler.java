@@ -0,0 +1,54 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.EntropyRun;
+import com.android.reverse.collecter.MemDump;
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class EntropyMapCommandHandler implements CommandHandler {
+
+    private String perms;
+    private String path;
+    private int window;
+    private float minEntropy;
+    private int minWindows;
+    private boolean dump;
+    private int threads;
+
+    public EntropyMapCommandHandler(String perms, String path, int window, float minEntropy, int minWindows,
+            boolean dump, int threads) {
+        this.perms = perms;
+        this.path = path;
+        this.window = window;
+        this.minEntropy = minEntropy;
+        this.minWindows = minWindows;
+        this.dump = dump;
+        this.threads = threads;
+    }
+
+    @Override
+    public void doAction() {
+        String dir = ModuleContext.getInstance().getAppContext().getFilesDir().toString();
+        String mapPath = dir + "/entropy_" + System.currentTimeMillis() + ".map";
+        long start = System.currentTimeMillis();
+        EntropyRun[] runs = NativeFunction.entropyMap(perms, path, window, minEntropy, minWindows, threads, mapPath);
+        if (runs == null) {
+            Logger.log("entropy map failed");
+            return;
+        }
+        Logger.log("entropy map saved to =" + mapPath + " in " + (System.currentTimeMillis() - start) + "ms, "
+                + runs.length + " runs of " + minEntropy + " bits or more ->");
+        for (EntropyRun run : runs) {
+            Logger.log(run.toString());
+            if (dump) {
+                MemDump.dumpMem(dir + "/entropy_0x" + Long.toHexString(run.getStart()) + ".bin", run.getStart(),
+                        (int) run.getLength(), NativeFunction.DUMP_FSYNC_NONE);
+            }
+        }
+        Logger.log("End entropy map");
+    }
+
+
+}
@@ -0,0 +1,39 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class FixDexFileCommandHandler implements CommandHandler {
+
+    private String filepath;
+    private boolean verifyOnly;
+
+    public FixDexFileCommandHandler(String filepath, boolean verifyOnly) {
+        this.filepath = filepath;
+        this.verifyOnly = verifyOnly;
+    }
+
+    @Override
+    public void doAction() {
+        long[] result = NativeFunction.fixDexFileChecksum(filepath, verifyOnly);
+        if (result == null) {
+            Logger.log("can't find a dex image in " + filepath);
+            return;
+        }
+        int status = (int) result[0];
+        String state;
+        if (status == 0) {
+            state = "checksum and signature are up to date";
+        } else {
+            state = ((status & NativeFunction.DEX_CHECKSUM_STALE) != 0 ? "checksum " : "")
+                    + ((status & NativeFunction.DEX_SIGNATURE_STALE) != 0 ? "signature " : "")
+                    + (verifyOnly ? "stale" : "stale, fixed");
+        }
+        long elapsedUs = Math.max(result[2] / 1000, 1);
+        Logger.log(filepath + ": " + state + " (" + result[1] + " bytes in " + elapsedUs + "us, "
+                + (result[1] / elapsedUs) + " MB/s)");
+    }
+
+
+}
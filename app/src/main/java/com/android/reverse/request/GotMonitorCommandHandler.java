@@ -0,0 +1,44 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.GotSlotChange;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class GotMonitorCommandHandler implements InstantCommandHandler {
+
+    public final static int INTERVAL_DRAIN = -1;
+    public final static int INTERVAL_STOP = 0;
+
+    private int intervalMs;
+
+    public GotMonitorCommandHandler(int intervalMs) {
+        this.intervalMs = intervalMs;
+    }
+
+    @Override
+    public void doAction() {
+        if (intervalMs == INTERVAL_STOP) {
+            NativeFunction.stopGotMonitor();
+            Logger.log("got monitor stopped");
+        } else if (intervalMs != INTERVAL_DRAIN) {
+            if (NativeFunction.startGotMonitor(intervalMs)) {
+                Logger.log("got monitor running, interval " + intervalMs + "ms");
+            } else {
+                Logger.log("start got monitor failed");
+            }
+            return;
+        }
+        GotSlotChange[] changes = NativeFunction.drainGotMonitor();
+        if (changes == null) {
+            return;
+        }
+        Logger.log("got monitor logged " + changes.length + " changes ->");
+        for (GotSlotChange change : changes) {
+            Logger.log(change.toString());
+        }
+        Logger.log("End got monitor");
+    }
+
+
+}
@@ -0,0 +1,49 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class HarvestCodeCommandHandler implements CommandHandler {
+
+    private String mCookie;
+    private int threads;
+    private boolean rebuild;
+
+    public HarvestCodeCommandHandler(String mCookie, int threads, boolean rebuild) {
+        this.mCookie = mCookie;
+        this.threads = threads;
+        this.rebuild = rebuild;
+    }
+
+    @Override
+    public void doAction() {
+        String dir = ModuleContext.getInstance().getAppContext().getFilesDir().toString();
+        String filename = dir + "/dexcode" + mCookie + ".bin";
+        String dexname = rebuild ? dir + "/dexrebuild" + mCookie + ".dex" : null;
+        long[] result = NativeFunction.harvestDexCode(Long.parseLong(mCookie), ModuleContext.getInstance().getApiLevel(),
+                filename, dexname, threads);
+        if (result == null) {
+            Logger.log("harvest the code items failed");
+            return;
+        }
+        Logger.log(result[NativeFunction.HARVEST_OUTSIDE] + " of " + result[NativeFunction.HARVEST_METHODS]
+                + " code items in " + result[NativeFunction.HARVEST_CLASSES] + " classes lie outside the dex, "
+                + result[NativeFunction.HARVEST_UNREADABLE] + " unreadable, " + result[NativeFunction.HARVEST_BYTES]
+                + " bytes in " + result[NativeFunction.HARVEST_ELAPSED_NS] / 1000 + "us, saved to =" + filename);
+        if (dexname != null) {
+            if (result[NativeFunction.HARVEST_REBUILT_BYTES] != 0) {
+                Logger.log("the rebuilt dexfile save to =" + dexname);
+                if (result[NativeFunction.HARVEST_STUBBED] != 0) {
+                    Logger.log(result[NativeFunction.HARVEST_STUBBED]
+                            + " methods of it throw instead of running their unreadable code");
+                }
+            } else {
+                Logger.log("rebuild the dexfile failed");
+            }
+        }
+    }
+
+
+}
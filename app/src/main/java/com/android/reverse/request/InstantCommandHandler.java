@@ -0,0 +1,9 @@
+package com.android.reverse.request;
+
+/*
+ * a command that returns at once, run on its own thread instead of queued behind the jobs of the native pool,
+ * so asking about or stopping a job never waits for one
+ */
+public interface InstantCommandHandler extends CommandHandler {
+
+}
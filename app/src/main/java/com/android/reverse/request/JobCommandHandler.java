@@ -0,0 +1,46 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.JobInfo;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class JobCommandHandler implements InstantCommandHandler {
+
+    public final static int ALL_JOBS = 0;
+
+    private int id;
+    private boolean cancel;
+
+    public JobCommandHandler(int id, boolean cancel) {
+        this.id = id;
+        this.cancel = cancel;
+    }
+
+    @Override
+    public void doAction() {
+        if (cancel) {
+            if (NativeFunction.jobCancel(id)) {
+                Logger.log("job " + id + " cancelled");
+            } else {
+                Logger.log("job " + id + " is neither queued nor running");
+            }
+            return;
+        }
+        JobInfo[] jobs = NativeFunction.jobStatus(id);
+        if (jobs == null) {
+            return;
+        }
+        if (jobs.length == 0) {
+            Logger.log(id == ALL_JOBS ? "no jobs" : "no job " + id);
+            return;
+        }
+        Logger.log("the jobs ->");
+        for (JobInfo job : jobs) {
+            Logger.log(job.toString());
+        }
+        Logger.log("End jobs");
+    }
+
+
+}
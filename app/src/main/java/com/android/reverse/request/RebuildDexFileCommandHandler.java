@@ -0,0 +1,25 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.DexFileInfoCollecter;
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+
+public class RebuildDexFileCommandHandler implements CommandHandler {
+
+    private String mCookie;
+
+    public RebuildDexFileCommandHandler(String mCookie) {
+        this.mCookie = mCookie;
+    }
+
+    @Override
+    public void doAction() {
+        String filename = ModuleContext.getInstance().getAppContext().getFilesDir() + "/dexrebuild" + mCookie + ".dex";
+        if (DexFileInfoCollecter.getInstance().rebuildDexFile(filename, mCookie)) {
+            Logger.log("the rebuilt dexfile save to =" + filename);
+        }
+    }
+
+
+}
@@ -0,0 +1,43 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.DexMemoryHit;
+import com.android.reverse.collecter.MemDump;
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class ScanDexCommandHandler implements CommandHandler {
+
+    private boolean dump;
+    private int threads;
+    private int fsyncPolicy;
+
+    public ScanDexCommandHandler(boolean dump, int threads, int fsyncPolicy) {
+        this.dump = dump;
+        this.threads = threads;
+        this.fsyncPolicy = fsyncPolicy;
+    }
+
+    @Override
+    public void doAction() {
+        long start = System.nanoTime();
+        DexMemoryHit[] hits = NativeFunction.scanDexFiles(threads);
+        if (hits == null) {
+            Logger.log("scan dex failed");
+            return;
+        }
+        Logger.log("found " + hits.length + " dex in memory in " + (System.nanoTime() - start) / 1000000 + "ms ->");
+        for (DexMemoryHit hit : hits) {
+            Logger.log(hit.toString());
+            if (dump) {
+                String filename = ModuleContext.getInstance().getAppContext().getFilesDir() + "/dexscan_"
+                        + Long.toHexString(hit.getAddress()) + ".dex";
+                MemDump.dumpMem(filename, hit.getAddress(), (int) hit.getSize(), fsyncPolicy);
+            }
+        }
+        Logger.log("End scan dex");
+    }
+
+
+}
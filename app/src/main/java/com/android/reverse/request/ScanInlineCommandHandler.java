@@ -0,0 +1,32 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.InlinePatch;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class ScanInlineCommandHandler implements CommandHandler {
+
+    private int threads;
+
+    public ScanInlineCommandHandler(int threads) {
+        this.threads = threads;
+    }
+
+    @Override
+    public void doAction() {
+        long start = System.nanoTime();
+        InlinePatch[] patches = NativeFunction.scanInlinePatches(threads);
+        if (patches == null) {
+            Logger.log("scan inline patches failed");
+            return;
+        }
+        Logger.log("found " + patches.length + " patched code ranges in " + (System.nanoTime() - start) / 1000000 + "ms ->");
+        for (InlinePatch patch : patches) {
+            Logger.log(patch.toString());
+        }
+        Logger.log("End scan inline patches");
+    }
+
+
+}
@@ -0,0 +1,50 @@
+package com.android.reverse.request;
+
+import java.util.Map;
+import java.util.TreeMap;
+
+import com.android.reverse.collecter.MemorySearchHit;
+import com.android.reverse.collecter.MemorySearchListener;
+import com.android.reverse.collecter.SigScan;
+import com.android.reverse.util.Logger;
+
+public class ScanSignaturesCommandHandler implements CommandHandler {
+
+    private String source;
+    private boolean compile;
+    private boolean allRegions;
+    private int context;
+    private int maxHits;
+    private int threads;
+
+    public ScanSignaturesCommandHandler(String source, boolean compile, boolean allRegions, int context, int maxHits,
+            int threads) {
+        this.source = source;
+        this.compile = compile;
+        this.allRegions = allRegions;
+        this.context = context;
+        this.maxHits = maxHits;
+        this.threads = threads;
+    }
+
+    @Override
+    public void doAction() {
+        Logger.log("scan " + (allRegions ? "memory" : "modules") + " for the signatures of " + source + " ->");
+        final Map<String, Integer> counts = new TreeMap<String, Integer>();
+        SigScan.scan(source, compile, allRegions, context, maxHits, threads, new MemorySearchListener() {
+
+            @Override
+            public void onHit(MemorySearchHit hit) {
+                Logger.log(hit.toString());
+                Integer count = counts.get(hit.getName());
+                counts.put(hit.getName(), count == null ? 1 : count + 1);
+            }
+        });
+        for (Map.Entry<String, Integer> entry : counts.entrySet()) {
+            Logger.log(entry.getKey() + ": " + entry.getValue() + " hits");
+        }
+        Logger.log("End scan signatures");
+    }
+
+
+}
@@ -0,0 +1,41 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.MemSearch;
+import com.android.reverse.collecter.MemorySearchHit;
+import com.android.reverse.collecter.MemorySearchListener;
+import com.android.reverse.util.Logger;
+
+public class SearchMemCommandHandler implements CommandHandler {
+
+    private String[] patterns;
+    private String perms;
+    private String path;
+    private int context;
+    private int maxHits;
+    private int threads;
+
+    public SearchMemCommandHandler(String[] patterns, String perms, String path, int context, int maxHits, int threads) {
+        this.patterns = patterns;
+        this.perms = perms;
+        this.path = path;
+        this.context = context;
+        this.maxHits = maxHits;
+        this.threads = threads;
+    }
+
+    @Override
+    public void doAction() {
+        Logger.log("search memory for " + patterns.length + " patterns ->");
+        MemSearch.search(patterns, perms, path, context, maxHits, threads, new MemorySearchListener() {
+
+            @Override
+            public void onHit(MemorySearchHit hit) {
+                Logger.log(hit.toString());
+            }
+        });
+        Logger.log("End search memory");
+    }
+
+
+}
@@ -0,0 +1,38 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+
+public class SnapshotMemCommandHandler implements CommandHandler {
+
+    private String perms;
+    private String pattern;
+    private long maxSize;
+
+    public SnapshotMemCommandHandler(String perms, String pattern, long maxSize) {
+        this.perms = perms;
+        this.pattern = pattern;
+        this.maxSize = maxSize;
+    }
+
+    @Override
+    public void doAction() {
+        String filename = ModuleContext.getInstance().getAppContext().getFilesDir() + "/memsnap_"
+                + System.currentTimeMillis() + ".bin";
+        long[] result = NativeFunction.snapshotMemory(filename, perms, pattern, maxSize);
+        if (result == null) {
+            Logger.log("snapshot the memory to " + filename + " failed");
+            return;
+        }
+        Logger.log("snapshot " + result[NativeFunction.SNAPSHOT_REGIONS] + " regions, "
+                + result[NativeFunction.SNAPSHOT_PAGES] + " pages (" + result[NativeFunction.SNAPSHOT_STORED] + " stored, "
+                + result[NativeFunction.SNAPSHOT_DUPLICATE] + " duplicate, " + result[NativeFunction.SNAPSHOT_ZERO]
+                + " zero, " + result[NativeFunction.SNAPSHOT_UNREADABLE] + " unreadable), "
+                + result[NativeFunction.SNAPSHOT_BYTES] + " bytes in " + result[NativeFunction.SNAPSHOT_ELAPSED_NS] / 1000000
+                + "ms, saved to =" + filename);
+    }
+
+
+}
@@ -0,0 +1,40 @@
+package com.android.reverse.request;
+
+
+import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.Logger;
+import com.android.reverse.util.NativeFunction;
+import com.android.reverse.util.Tracer;
+
+public class TraceCommandHandler implements InstantCommandHandler {
+
+    private boolean enable;
+
+    public TraceCommandHandler(boolean enable) {
+        this.enable = enable;
+    }
+
+    @Override
+    public void doAction() {
+        if (enable) {
+            String filename = ModuleContext.getInstance().getAppContext().getFilesDir() + "/trace_"
+                    + System.currentTimeMillis() + ".bin";
+            if (Tracer.start(filename)) {
+                Logger.log("tracing the api monitor and collector events to =" + filename);
+            } else {
+                Logger.log("start the trace failed: one is running already or " + filename + " can't be created");
+            }
+            return;
+        }
+        long[] result = Tracer.stop();
+        if (result == null) {
+            Logger.log("no trace is running");
+            return;
+        }
+        Logger.log("trace stopped: " + result[NativeFunction.TRACE_RECORDS] + " records, "
+                + result[NativeFunction.TRACE_DROPPED] + " dropped, " + result[NativeFunction.TRACE_BYTES] + " bytes in "
+                + result[NativeFunction.TRACE_ELAPSED_NS] / 1000000 + "ms");
+    }
+
+
+}
@@ -27,7 +27,9 @@ import org.jf.dexlib2.util.SyntheticAccessorResolver;
 import org.jf.util.ClassFileNameHandler;
 import org.jf.util.IndentingWriter;
 
+import com.android.reverse.collecter.DexFileInfoCollecter;
 import com.android.reverse.collecter.ModuleContext;
+import com.android.reverse.util.DexMemoryReader;
 import com.android.reverse.util.Logger;
 import com.android.reverse.util.NativeFunction;
 import com.google.common.collect.Ordering;
@@ -56,6 +58,20 @@ public class MemoryBackSmali {
 		return options;
 	}
 
+	// the classes in the order of the dex index, already sorted by descriptor; null without one
+	private static List<ClassDef> indexedClasses(long mCookie, DexBackedDexFile dexFile) {
+		int[] order = NativeFunction.getDexIndexClassOrder(mCookie,
+				ModuleContext.getInstance().getApiLevel(), DexFileInfoCollecter.getDexIndexDir());
+		if (order == null) {
+			return null;
+		}
+		List<ClassDef> classDefs = new ArrayList<ClassDef>(order.length);
+		for (int classIndex : order) {
+			classDefs.add(new DexBackedClassDef(dexFile, dexFile.getClassDefItemOffset(classIndex)));
+		}
+		return classDefs;
+	}
+
 	public static boolean disassembleDexFile(long mCookie, String outDexName) {
 
 		long startTime = System.currentTimeMillis();
@@ -73,7 +89,7 @@ public class MemoryBackSmali {
 
 		Opcodes opcodes = new Opcodes(ModuleContext.getInstance().getApiLevel());
 
-		MemoryReader reader = new NativeFunction();
+		MemoryReader reader = new DexMemoryReader(mCookie);
 		MemoryDexFileItemPointer pointer = NativeFunction
 				.queryDexFileItemPointer(mCookie);
 		DexBackedDexFile mmDexFile = new DexBackedDexFile(opcodes, pointer,
@@ -86,8 +102,10 @@ public class MemoryBackSmali {
 		options.inlineResolver = new CustomInlineMethodResolver(
 				options.classPath, inlineString);
 
-		List<? extends ClassDef> classDefs = Ordering.natural().sortedCopy(
-				mmDexFile.getClasses());
+		List<? extends ClassDef> classDefs = indexedClasses(mCookie, mmDexFile);
+		if (classDefs == null) {
+			classDefs = Ordering.natural().sortedCopy(mmDexFile.getClasses());
+		}
 
 		if (!options.noAccessorComments) {
 			options.syntheticAccessorResolver = new SyntheticAccessorResolver(
@@ -110,8 +128,15 @@ public class MemoryBackSmali {
 		}
 
 		boolean errorOccurred = false;
+		int done = 0;
 		try {
 			for (Future<Boolean> task : tasks) {
+				// run as a job, it can be cancelled between two classes
+				if (NativeFunction.jobCancelled()) {
+					executor.shutdownNow();
+					Logger.log("disassemble the mCookie " + mCookie + " cancelled after " + done + " classes");
+					return false;
+				}
 				while (true) {
 					try {
 						if (!task.get()) {
@@ -124,6 +149,7 @@ public class MemoryBackSmali {
 					}
 					break;
 				}
+				NativeFunction.jobProgress("classes", ++done, tasks.size());
 			}
 		} finally {
 			executor.shutdown();
@@ -0,0 +1,63 @@
+package com.android.reverse.util;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+import org.jf.dexlib2.dexbacked.MemoryReader;
+
+import com.android.reverse.collecter.ModuleContext;
+
+/**
+ * MemoryReader over one pinned direct ByteBuffer that covers the whole dex mapping of a cookie,
+ * so the reads of BaseDexBuffer don't cross JNI for every field.
+ * Reads outside of the mapping (tables moved away by a packer) fall back to NativeFunction.
+ */
+public class DexMemoryReader implements MemoryReader {
+
+	private final MemoryReader fallback = new NativeFunction();
+	private ByteBuffer view;
+	private long viewStart;
+	private long viewLength;
+
+	public DexMemoryReader(long cookie) {
+		long[] region = NativeFunction.getDexFileRegion(cookie, ModuleContext.getInstance().getApiLevel());
+		if (region == null || region[1] <= 0) {
+			Logger.log("can't pin the dex region of mCookie " + cookie + ", reading through jni");
+			return;
+		}
+		// MemoryReader addresses are ints, a region past 4 GiB can't be asked for through them
+		if (region[0] + region[1] > 0x100000000L) {
+			Logger.log("the dex region of mCookie " + cookie + " at " + Long.toHexString(region[0])
+					+ " is above 4 GiB, reading through jni");
+			return;
+		}
+		this.view = NativeFunction.dumpMemory(region[0], (int) region[1]);
+		if (this.view != null) {
+			this.view.order(ByteOrder.LITTLE_ENDIAN);
+			this.viewStart = region[0];
+			this.viewLength = region[1];
+			Logger.log("pinned the dex region start=" + region[0] + " length=" + region[1]);
+		}
+	}
+
+	public byte[] readBytes(int start, int length) {
+		long offset = (start & 0xffffffffL) - viewStart;
+		if (view == null || offset < 0 || offset + length > viewLength) {
+			return fallback.readBytes(start, length);
+		}
+		byte[] buffer = new byte[length];
+		int index = (int) offset;
+		if (length <= 8) {
+			for (int i = 0; i < length; i++) {
+				buffer[i] = view.get(index + i);
+			}
+		} else {
+			// absolute bulk get needs its own position, the view is shared by the backsmali jobs
+			ByteBuffer data = view.duplicate();
+			data.position(index);
+			data.get(buffer, 0, length);
+		}
+		return buffer;
+	}
+
+}
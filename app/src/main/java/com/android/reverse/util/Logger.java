@@ -15,7 +15,9 @@ public class Logger {
 	}
 	
 	public static void log_behavior(String message){
-		if(DEBUG_ENABLE)
+		if(Tracer.isEnabled())
+			Tracer.text(Tracer.EVENT_BEHAVIOR, message);
+		else if(DEBUG_ENABLE)
 			Log.e(LOGTAG_WORKFLOW+PACKAGENAME,message);
 	}
 	
@@ -1,12 +1,16 @@
 package com.android.reverse.util;
 
 import java.nio.ByteBuffer;
-import java.nio.ByteOrder;
-import java.util.HashMap;
 
 import org.jf.dexlib2.dexbacked.MemoryDexFileItemPointer;
 import org.jf.dexlib2.dexbacked.MemoryReader;
 
+import com.android.reverse.collecter.DexMemoryHit;
+import com.android.reverse.collecter.EntropyRun;
+import com.android.reverse.collecter.GotSlotChange;
+import com.android.reverse.collecter.InlinePatch;
+import com.android.reverse.collecter.JobInfo;
+import com.android.reverse.collecter.MemorySearchListener;
 import com.android.reverse.collecter.ModuleContext;
 import com.android.reverse.smali.DexFileHeadersPointer;
 
@@ -15,6 +19,86 @@ public class NativeFunction implements MemoryReader {
 	
 	private final static String DVMNATIVE_LIB = "dvmnative";
 
+	public final static int DUMP_FSYNC_NONE = 0;
+	public final static int DUMP_FSYNC_END = 1;
+	public final static int DUMP_FSYNC_CHUNK = 2;
+
+	public final static int DEX_CHECKSUM_STALE = 1;
+	public final static int DEX_SIGNATURE_STALE = 2;
+
+	/* dumpMemoryToFile returns {bytes, elapsed ns, errno, pages, unreadable pages, zero pages} */
+	public final static int DUMPMEM_PAGES = 3;
+	public final static int DUMPMEM_UNREADABLE = 4;
+	public final static int DUMPMEM_ZERO = 5;
+
+	/* snapshotMemory returns {regions, pages, stored, duplicate, zero, unreadable, bytes, elapsed ns} */
+	public final static int SNAPSHOT_REGIONS = 0;
+	public final static int SNAPSHOT_PAGES = 1;
+	public final static int SNAPSHOT_STORED = 2;
+	public final static int SNAPSHOT_DUPLICATE = 3;
+	public final static int SNAPSHOT_ZERO = 4;
+	public final static int SNAPSHOT_UNREADABLE = 5;
+	public final static int SNAPSHOT_BYTES = 6;
+	public final static int SNAPSHOT_ELAPSED_NS = 7;
+
+	/* searchMemory returns {regions, bytes searched, hits, stopped early (0/1), elapsed ns} */
+	public final static int MEMSEARCH_REGIONS = 0;
+	public final static int MEMSEARCH_BYTES = 1;
+	public final static int MEMSEARCH_HITS = 2;
+	public final static int MEMSEARCH_TRUNCATED = 3;
+	public final static int MEMSEARCH_ELAPSED_NS = 4;
+
+	/* traceStop returns {records, dropped, bytes, elapsed ns} */
+	public final static int TRACE_RECORDS = 0;
+	public final static int TRACE_DROPPED = 1;
+	public final static int TRACE_BYTES = 2;
+	public final static int TRACE_ELAPSED_NS = 3;
+
+	/* rebuildDexFile returns {bytes, elapsed ns, errno} */
+	public final static int REBUILD_BYTES = 0;
+	public final static int REBUILD_ELAPSED_NS = 1;
+	public final static int REBUILD_ERROR = 2;
+	/* the errno when the dex couldn't be rebuilt at all, and when its job was cancelled halfway */
+	public final static int REBUILD_EINVAL = 22;
+	public final static int REBUILD_ECANCELED = 125;
+
+	/* jobSubmit returns {job id, existing} */
+	public final static int JOB_ID = 0;
+	public final static int JOB_EXISTING = 1;
+
+	/* dumpAllDexFiles returns {total elapsed ns, then ALLDEX_FIELDS values per cookie} */
+	public final static int ALLDEX_BYTES = 0;
+	public final static int ALLDEX_ELAPSED_NS = 1;
+	public final static int ALLDEX_ERROR = 2;
+	public final static int ALLDEX_HEADER_CHECKSUM = 3;
+	public final static int ALLDEX_CHECKSUM = 4;
+	public final static int ALLDEX_FIELDS = 5;
+
+	/* nextDumpDelta returns {round, pages read, pages changed, bytes, soft-dirty, elapsed ns} */
+	public final static int DELTA_ROUND = 0;
+	public final static int DELTA_PAGES_READ = 1;
+	public final static int DELTA_PAGES_CHANGED = 2;
+	public final static int DELTA_BYTES = 3;
+	public final static int DELTA_SOFT_DIRTY = 4;
+	public final static int DELTA_ELAPSED_NS = 5;
+
+	/* openDexIndex returns {classes, methods, strings, built, elapsed ns} */
+	public final static int DEXINDEX_CLASSES = 0;
+	public final static int DEXINDEX_METHODS = 1;
+	public final static int DEXINDEX_STRINGS = 2;
+	public final static int DEXINDEX_BUILT = 3;
+	public final static int DEXINDEX_ELAPSED_NS = 4;
+
+	/* harvestDexCode returns {classes, methods, outside, unreadable, bytes, elapsed ns, rebuilt bytes, stubbed} */
+	public final static int HARVEST_CLASSES = 0;
+	public final static int HARVEST_METHODS = 1;
+	public final static int HARVEST_OUTSIDE = 2;
+	public final static int HARVEST_UNREADABLE = 3;
+	public final static int HARVEST_BYTES = 4;
+	public final static int HARVEST_ELAPSED_NS = 5;
+	public final static int HARVEST_REBUILT_BYTES = 6;
+	public final static int HARVEST_STUBBED = 7;
+
 	static{
 
 		SoFileLoader.loadLibrary(DVMNATIVE_LIB);
@@ -23,16 +107,84 @@ public class NativeFunction implements MemoryReader {
 	public static native ByteBuffer dumpDexFileByClass(Class classInDex,int version);
 	public static native ByteBuffer dumpDexFileByCookie(long cookie,int version);
 	public static native ByteBuffer dumpMemory(long start,int length);
+	/* a copy that never faults: unreadable pages come back as zeros, their bit clear in readablePages unless it is null */
+	public static native byte[] readMemory(long start,int length,byte[] readablePages);
+	public static native long[] getDexFileRegion(long cookie,int version);
+	public static native long[] dumpDexFileToFile(long cookie,int version,String path,int fsyncPolicy,boolean fixChecksum);
+	public static native long[] dumpMemoryToFile(long start,long length,String path,int fsyncPolicy);
+	/* the regions with all of perms ("rwxs"), a path matching pattern (fnmatch, any if null) and at most maxSize bytes (0: any) */
+	public static native long[] snapshotMemory(String path,String perms,String pattern,long maxSize);
+	public static native long[] rebuildDexFile(long cookie,int version,String path);
+	/* the code_items outside the dex region to path, and the dex rebuilt with them to rebuildPath unless it is null */
+	public static native long[] harvestDexCode(long cookie,int version,String path,String rebuildPath,int maxThreads);
+	public static native long[] fixDexFileChecksum(String path,boolean verifyOnly);
+	public static native long[] benchmarkDexSum(int sizeMb);
+	public static native long[] dumpAllDexFiles(long[] cookies,int version,String[] paths,int fsyncPolicy,boolean fixChecksum);
+	public static native DexMemoryHit[] scanDexFiles(int maxThreads);
 	private static native DexFileHeadersPointer getHeaderItemPtr(long cookie,int version);
+	/* class names of the dex, '\n' separated UTF-8; only those starting with prefix unless it is null */
+	public static native byte[] listDexClasses(long cookie,int version,String prefix);
+	/* incremental dump of a dex: the whole of it to path, then only the pages changed since the last round */
+	public static native long beginDumpDelta(long cookie,int version,String path);
+	public static native long[] nextDumpDelta(long tracker,String path);
+	public static native void endDumpDelta(long tracker);
+	/* the sidecar index of a dex in dir, built there (on maxThreads threads) unless it already is */
+	public static native long[] openDexIndex(long cookie,int version,String dir,int maxThreads);
+	public static native int findDexIndexClass(long cookie,int version,String dir,String descriptor);
+	public static native int findDexIndexString(long cookie,int version,String dir,String string);
+	public static native long getDexIndexCode(long cookie,int version,String dir,int methodIdx);
+	/* listDexClasses and the class_def order backsmali sorts to, off the index in dir; null if it can't be opened */
+	public static native byte[] listDexIndexClasses(long cookie,int version,String dir,String prefix);
+	public static native int[] getDexIndexClassOrder(long cookie,int version,String dir);
     public static native String getInlineOperation();
-    public static native HashMap getSyslinkSnapshot();
+    /* a native GOT snapshot handle, 0 on failure; diff it as often as needed, then release it */
+    public static native long takeGotSnapshot();
+    public static native GotSlotChange[] diffGotSnapshot(long snapshot);
+    public static native void releaseGotSnapshot(long snapshot);
+    /* background GOT monitor: intervalMs <= 0 uses the default, calling it again changes the interval */
+    public static native boolean startGotMonitor(int intervalMs);
+    public static native void stopGotMonitor();
+    public static native GotSlotChange[] drainGotMonitor();
+    public static native InlinePatch[] scanInlinePatches(int maxThreads);
+    /*
+     * search the regions with all of perms ("rwxs", r implied) and a path matching path (fnmatch, any if null)
+     * for patterns like "4c 8b ?? 24 e?"; every hit goes to listener as it is found, with context bytes each side
+     */
+    public static native long[] searchMemory(String[] patterns, String perms, String path, int context, int maxHits,
+            int maxThreads, MemorySearchListener listener);
+    /* compile a signature source ("name = pattern" lines) to a set file; null when it did, else the bad line */
+    public static native String compileSignatures(String source, String blob);
+    /* scan for all signatures of a compiled set in one pass; modules only unless allRegions, returns as searchMemory */
+    public static native long[] scanSignatures(String blob, boolean allRegions, int context, int maxHits, int maxThreads,
+            MemorySearchListener listener);
+    /*
+     * entropy of every window bytes long (a power of two, 256 to 64k, 0 for 4096) of the regions picked as in
+     * searchMemory; the whole map is written to mapPath unless null, the runs of at least minWindows windows
+     * with minEntropy bits a byte or more come back
+     */
+    public static native EntropyRun[] entropyMap(String perms, String path, int window, float minEntropy, int minWindows,
+            int maxThreads, String mapPath);
+    /* a binary event trace in a lock-free native ring, flushed to path in batches; slots <= 0 for the default */
+    public static native boolean traceStart(String path, int slots);
+    public static native long[] traceStop();
+    public static native void traceDefineEvent(int event, String name);
+    /* false when not tracing or the ring is full; neither call allocates */
+    public static native boolean traceEvent(int event, long arg0, long arg1);
+    public static native boolean traceText(int event, String text);
+    /*
+     * run job on the native worker pool; a queued or running job with the same key is returned instead of a new one
+     * queued. returns {job id, 1 if it was such a job}
+     */
+    public static native int[] jobSubmit(String kind, String key, Runnable job);
+    /* the job id, or every job the pool remembers if id <= 0 */
+    public static native JobInfo[] jobStatus(int id);
+    public static native boolean jobCancel(int id);
+    /* for the code a job runs: done of total units so far, and whether to give up; no-ops outside a job */
+    public static native void jobProgress(String unit, long done, long total);
+    public static native boolean jobCancelled();
 	
 	public byte[] readBytes(int arg0, int arg1) {
-		ByteBuffer data = dumpMemory(arg0, arg1);
-		data.order(ByteOrder.LITTLE_ENDIAN);
-		byte[] buffer = new byte[data.capacity()];
-		data.get(buffer, 0, data.capacity());
-		return buffer;
+		return readMemory(arg0 & 0xffffffffL, arg1, null);
 	}
 	
 	public static MemoryDexFileItemPointer queryDexFileItemPointer(long cookie){
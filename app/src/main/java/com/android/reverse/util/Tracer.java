@@ -0,0 +1,84 @@
+package com.android.reverse.util;
+
+import java.lang.reflect.Member;
+import java.util.concurrent.ConcurrentHashMap;
+
+/**
+ * feeds the native trace ring; while it runs the api monitor and the collectors record binary
+ * events there instead of building log lines for logcat
+ */
+public class Tracer {
+
+	public static final int EVENT_BEHAVIOR = 1;
+	public static final int EVENT_OPEN_DEX = 2;
+	public static final int EVENT_DEFINE_CLASS = 3;
+	/* hooked methods are numbered from here as they are first hit */
+	private static final int FIRST_METHOD_EVENT = 64;
+	private static final int MAX_EVENT = 0xffff;
+
+	private static volatile boolean enabled = false;
+	private static boolean defined = false;
+	private static int nextEvent = FIRST_METHOD_EVENT;
+	private static final ConcurrentHashMap<Member, Integer> methodEvents = new ConcurrentHashMap<Member, Integer>();
+
+	public static boolean isEnabled() {
+		return enabled;
+	}
+
+	public static synchronized boolean start(String path) {
+		if (enabled) {
+			return false;
+		}
+		if (!defined) {
+			NativeFunction.traceDefineEvent(EVENT_BEHAVIOR, "behavior");
+			NativeFunction.traceDefineEvent(EVENT_OPEN_DEX, "openDexFileNative");
+			NativeFunction.traceDefineEvent(EVENT_DEFINE_CLASS, "defineClassNative(cookie,loader)");
+			defined = true;
+		}
+		enabled = NativeFunction.traceStart(path, 0);
+		return enabled;
+	}
+
+	/**
+	 * {records, dropped, bytes, elapsed ns}, null if no trace was running
+	 */
+	public static synchronized long[] stop() {
+		enabled = false;
+		return NativeFunction.traceStop();
+	}
+
+	/**
+	 * the event of a hooked method, or -1 once the ids are used up
+	 */
+	public static int methodEvent(Member method) {
+		Integer event = methodEvents.get(method);
+		if (event != null) {
+			return event;
+		}
+		synchronized (Tracer.class) {
+			event = methodEvents.get(method);
+			if (event == null) {
+				if (nextEvent > MAX_EVENT) {
+					return -1;
+				}
+				event = nextEvent++;
+				NativeFunction.traceDefineEvent(event, method.getDeclaringClass().getName() + "->" + method.getName());
+				methodEvents.put(method, event);
+			}
+			return event;
+		}
+	}
+
+	public static void event(int event, long arg0, long arg1) {
+		if (enabled) {
+			NativeFunction.traceEvent(event, arg0, arg1);
+		}
+	}
+
+	public static void text(int event, String text) {
+		if (enabled) {
+			NativeFunction.traceText(event, text);
+		}
+	}
+
+}
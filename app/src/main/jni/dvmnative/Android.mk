@@ -14,6 +14,12 @@
 #
 LOCAL_PATH := $(call my-dir)
 
+# ndk-build ZJDROID_LOG_LEVEL=<0 verbose .. 4 none> compiles the native logging below it out (see util.h);
+# every module that includes util.h takes it, or its LOGV lines would stay in
+ZJDROID_LOG_CFLAGS :=
+ifdef ZJDROID_LOG_LEVEL
+ZJDROID_LOG_CFLAGS := -DZJDROID_LOG_LEVEL=$(ZJDROID_LOG_LEVEL)
+endif
 
 
 # elfinfo
@@ -22,11 +28,32 @@ LOCAL_CPP_EXTENSION := .cxx .cpp .cc
 
 LOCAL_MODULE    := elfinfo
 LOCAL_SRC_FILES := C:\Users\jxht\AndroidStudioProjects\ZjDroid\app\src\main\jni\dvmnative\elfinfo.cpp
+LOCAL_CFLAGS    := $(ZJDROID_LOG_CFLAGS)
 LOCAL_LDLIBS    := -ldl -llog
 
 include $(BUILD_STATIC_LIBRARY)
 
 
+# dexsum_simd
+# the checksum kernels are picked at runtime, so only their own library is built with the
+# instructions they use (NEON on v7, the crypto extension on arm64); a flag on dvmnative
+# would let the compiler use them anywhere, on cores that don't have them too
+include $(CLEAR_VARS)
+LOCAL_CPP_EXTENSION := .cxx .cpp .cc
+
+LOCAL_MODULE    := dexsum_simd
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES := dexsum_simd.cpp.neon
+else
+LOCAL_SRC_FILES := dexsum_simd.cpp
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_CFLAGS    := -march=armv8-a+crypto
+endif
+
+include $(BUILD_STATIC_LIBRARY)
+
+
 # dvmnative
 
 include $(CLEAR_VARS)
@@ -34,9 +61,35 @@ LOCAL_CPP_EXTENSION := .cxx .cpp .cc
 
 LOCAL_MODULE    := dvmnative
 
-LOCAL_SRC_FILES := dvmnative.cpp
-LOCAL_STATIC_LIBRARIES := libelfinfo
+LOCAL_SRC_FILES := dvmnative.cpp \
+                   dumpfile.cpp \
+                   dexparse.cpp \
+                   dexsum.cpp \
+                   dexrebuild.cpp \
+                   threadpool.cpp \
+                   memread.cpp \
+                   dexscan.cpp \
+                   mapsindex.cpp \
+                   gotsnap.cpp \
+                   gotmon.cpp \
+                   textscan.cpp \
+                   runtimesym.cpp \
+                   runtimelayout.cpp \
+                   dexclasses.cpp \
+                   dexindex.cpp \
+                   dumpdelta.cpp \
+                   codeharvest.cpp \
+                   memsnap.cpp \
+                   memsearch.cpp \
+                   sigscan.cpp \
+                   mementropy.cpp \
+                   tracering.cpp \
+                   jobengine.cpp
+LOCAL_CFLAGS    := $(ZJDROID_LOG_CFLAGS)
+LOCAL_STATIC_LIBRARIES := libelfinfo libdexsum_simd cpufeatures
 LOCAL_LDLIBS    := -ldl -llog
 
 include $(BUILD_SHARED_LIBRARY)
 
+$(call import-module,android/cpufeatures)
+
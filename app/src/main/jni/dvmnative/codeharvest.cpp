@@ -0,0 +1,198 @@
+#include <string.h>
+#include <algorithm>
+#include <android/log.h>
+#include "codeharvest.h"
+#include "memread.h"
+#include "threadpool.h"
+
+#define HARVEST_CHUNK_CLASSES   256
+/* the first read of an item; bigger ones are read again twice as long, up to the cap */
+#define HARVEST_FIRST_READ      256
+#define HARVEST_MAX_ITEM        (16 * 1024 * 1024)
+
+struct harvest_chunk {
+    std::vector<code_harvest_record> records;   /* data offsets from data below */
+    std::vector<u1> data;
+    u4 methods;
+};
+
+struct harvest_job {
+    const dex_tables *tables;
+    uintptr_t begin;
+    uintptr_t end;
+    std::vector<harvest_chunk> chunks;
+};
+
+static void align_data(std::vector<u1> *data) {
+    data->resize((data->size() + 3) & ~(size_t) 3, 0);
+}
+
+/* copy the item at addr to the end of out, its size; 0 if it can't be read whole */
+static u4 copy_item(uintptr_t addr, size_t (*size_within)(const u1 *, const u1 *), std::vector<u1> *window,
+                    std::vector<u1> *out, u4 *data_off) {
+    for (size_t length = HARVEST_FIRST_READ; length <= HARVEST_MAX_ITEM; length *= 2) {
+        window->resize(length);
+        ssize_t got = mem_read((const void *) addr, &(*window)[0], length);
+        if (got <= 0)
+            return 0;
+        size_t size = size_within(&(*window)[0], &(*window)[0] + got);
+        if (size != 0) {
+            align_data(out);
+            *data_off = out->size();
+            out->insert(out->end(), window->begin(), window->begin() + size);
+            return size;
+        }
+        if ((size_t) got < length)
+            return 0;
+    }
+    return 0;
+}
+
+static void harvest_method(harvest_job *job, harvest_chunk *chunk, u4 class_def_idx, u4 method_idx, u4 code_off,
+                           std::vector<u1> *window) {
+    const u1 *base = job->tables->base;
+    uintptr_t addr = (uintptr_t) base + code_off;
+    chunk->methods++;
+    if (addr >= job->begin && addr < job->end)
+        return;
+    code_harvest_record record;
+    memset(&record, 0, sizeof(record));
+    record.class_def_idx = class_def_idx;
+    record.method_idx = method_idx;
+    record.code_off = code_off;
+    record.code_size = copy_item(addr, code_item_size_within, window, &chunk->data, &record.code_data_off);
+    if (record.code_size != 0) {
+        memcpy(&record.debug_info_off, &chunk->data[record.code_data_off + 8], 4);
+        if (record.debug_info_off != 0)
+            record.debug_size = copy_item((uintptr_t) base + record.debug_info_off, debug_info_size_within, window,
+                                          &chunk->data, &record.debug_data_off);
+    }
+    chunk->records.push_back(record);
+}
+
+static void harvest_task(size_t task, void *arg) {
+    harvest_job *job = (harvest_job *) arg;
+    const dex_tables *tables = job->tables;
+    harvest_chunk *chunk = &job->chunks[task];
+    chunk->methods = 0;
+    std::vector<u1> window;
+    u4 end = std::min((size_t) tables->header->class_defs_size_, (task + 1) * HARVEST_CHUNK_CLASSES);
+    for (u4 i = task * HARVEST_CHUNK_CLASSES; i < end; i++) {
+        if (tables->class_defs[i].class_data_off_ == 0)
+            continue;
+        const u1 *ptr = tables->base + tables->class_defs[i].class_data_off_;
+        u4 sizes[4];
+        for (int list = 0; list < 4; list++)
+            sizes[list] = read_uleb128(&ptr);
+        for (u4 field = 0; field < sizes[0] + sizes[1]; field++) {
+            read_uleb128(&ptr);
+            read_uleb128(&ptr);
+        }
+        /* method_idx restarts from the diff for the virtual methods */
+        for (int list = 2; list < 4; list++) {
+            u4 method_idx = 0;
+            for (u4 method = 0; method < sizes[list]; method++) {
+                method_idx += read_uleb128(&ptr);
+                read_uleb128(&ptr);
+                u4 code_off = read_uleb128(&ptr);
+                if (code_off != 0)
+                    harvest_method(job, chunk, i, method_idx, code_off, &window);
+            }
+        }
+    }
+}
+
+/* one copy per code_off: a packer's shared stub is harvested once however many methods use it */
+static void merge_chunks(harvest_job *job, code_harvest *harvest) {
+    for (size_t c = 0; c < job->chunks.size(); c++) {
+        harvest_chunk *chunk = &job->chunks[c];
+        harvest->stats.methods += chunk->methods;
+        for (size_t i = 0; i < chunk->records.size(); i++) {
+            code_harvest_record record = chunk->records[i];
+            harvest->stats.outside++;
+            std::unordered_map<u4, u4>::iterator it = harvest->by_code_off.find(record.code_off);
+            if (it != harvest->by_code_off.end()) {
+                const code_harvest_record &first = harvest->records[it->second];
+                record.code_data_off = first.code_data_off;
+                record.code_size = first.code_size;
+                record.debug_info_off = first.debug_info_off;
+                record.debug_data_off = first.debug_data_off;
+                record.debug_size = first.debug_size;
+            } else {
+                harvest->by_code_off[record.code_off] = harvest->records.size();
+                if (record.code_size != 0) {
+                    align_data(&harvest->data);
+                    u4 data_off = harvest->data.size();
+                    harvest->data.insert(harvest->data.end(), chunk->data.begin() + record.code_data_off,
+                                         chunk->data.begin() + record.code_data_off + record.code_size);
+                    record.code_data_off = data_off;
+                }
+                if (record.debug_size != 0) {
+                    align_data(&harvest->data);
+                    u4 data_off = harvest->data.size();
+                    harvest->data.insert(harvest->data.end(), chunk->data.begin() + record.debug_data_off,
+                                         chunk->data.begin() + record.debug_data_off + record.debug_size);
+                    record.debug_data_off = data_off;
+                }
+            }
+            if (record.code_size == 0)
+                harvest->stats.unreadable++;
+            harvest->records.push_back(record);
+        }
+    }
+    harvest->stats.bytes = harvest->data.size();
+}
+
+void code_harvest_collect(const dex_tables *tables, const void *begin, size_t length, int max_threads,
+                          code_harvest *harvest) {
+    u8 start = dump_now_ns();
+    harvest->base = tables->base;
+    harvest->records.clear();
+    harvest->data.clear();
+    harvest->by_code_off.clear();
+    memset(&harvest->stats, 0, sizeof(harvest->stats));
+    harvest->stats.classes = tables->header->class_defs_size_;
+
+    harvest_job job;
+    job.tables = tables;
+    job.begin = (uintptr_t) begin;
+    job.end = job.begin + length;
+    job.chunks.resize((tables->header->class_defs_size_ + HARVEST_CHUNK_CLASSES - 1) / HARVEST_CHUNK_CLASSES);
+    parallel_for(job.chunks.size(), max_threads, harvest_task, &job);
+    merge_chunks(&job, harvest);
+    harvest->stats.elapsed_ns = dump_now_ns() - start;
+    LOGV("harvested %u of %u code items outside the dex (%u unreadable), %llu bytes in %u us",
+         harvest->stats.outside, harvest->stats.methods, harvest->stats.unreadable,
+         (unsigned long long) harvest->stats.bytes, (unsigned int) (harvest->stats.elapsed_ns / 1000));
+}
+
+const code_harvest_record *code_harvest_find(const code_harvest *harvest, u4 code_off) {
+    std::unordered_map<u4, u4>::const_iterator it = harvest->by_code_off.find(code_off);
+    if (it == harvest->by_code_off.end() || harvest->records[it->second].code_size == 0)
+        return NULL;
+    return &harvest->records[it->second];
+}
+
+bool code_harvest_write(const code_harvest *harvest, const dex_tables *tables, const void *begin, size_t length,
+                        const char *path, dump_result *result) {
+    code_harvest_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CODE_HARVEST_MAGIC, sizeof(header.magic));
+    memcpy(header.signature, tables->header->signature_, SHA1_DIGEST_SIZE);
+    header.base_addr = (uintptr_t) tables->base;
+    header.region_addr = (uintptr_t) begin;
+    header.region_length = length;
+    header.method_count = harvest->stats.methods;
+    header.record_count = harvest->records.size();
+    header.records_off = sizeof(header);
+    header.data_off = header.records_off + header.record_count * sizeof(code_harvest_record);
+    header.data_size = harvest->data.size();
+
+    std::vector<u1> file(header.data_off + header.data_size);
+    memcpy(&file[0], &header, sizeof(header));
+    if (!harvest->records.empty())
+        memcpy(&file[header.records_off], &harvest->records[0], header.record_count * sizeof(code_harvest_record));
+    if (!harvest->data.empty())
+        memcpy(&file[header.data_off], &harvest->data[0], header.data_size);
+    return dump_region_to_file(path, &file[0], file.size(), DUMP_FSYNC_NONE, result);
+}
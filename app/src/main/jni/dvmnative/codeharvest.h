@@ -0,0 +1,75 @@
+#ifndef CODEHARVEST_H_
+#define CODEHARVEST_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+#include "util.h"
+#include "dexparse.h"
+#include "dexsum.h"
+#include "dumpfile.h"
+
+#define CODE_HARVEST_MAGIC  "dexcod1"
+
+/*
+ * The code_items a packer moved out of the dex region, saved next to a dump of it: the
+ * header, record_count records (class_def order), then the copied items. A dump is fixed
+ * up by putting every record's item back at code_off, or by appending the items and
+ * pointing the methods at them.
+ */
+struct code_harvest_header {
+    char magic[8];
+    u1 signature[SHA1_DIGEST_SIZE];     /* of the dex */
+    u8 base_addr;                       /* what the offsets in the dex are relative to */
+    u8 region_addr;                     /* items in [region_addr, +region_length) were left alone */
+    u8 region_length;
+    u4 method_count;                    /* methods with a code_item */
+    u4 record_count;
+    u4 records_off;                     /* code_harvest_record[record_count] */
+    u4 data_off;
+    u4 data_size;
+};
+
+struct code_harvest_record {
+    u4 class_def_idx;
+    u4 method_idx;
+    u4 code_off;                        /* as class_data_item has it */
+    u4 code_data_off;                   /* from data_off: the code_item with its tries and handlers */
+    u4 code_size;                       /* 0: it couldn't be read */
+    u4 debug_info_off;                  /* as the code_item has it */
+    u4 debug_data_off;                  /* from data_off */
+    u4 debug_size;                      /* 0: none, or it couldn't be read */
+};
+
+struct code_harvest_stats {
+    u4 classes;
+    u4 methods;                         /* with a code_item */
+    u4 outside;                         /* of those, the ones outside the region */
+    u4 unreadable;
+    u8 bytes;                           /* of copied items */
+    u8 elapsed_ns;
+};
+
+struct code_harvest {
+    const u1 *base;                     /* tables->base */
+    std::vector<code_harvest_record> records;
+    std::vector<u1> data;
+    std::unordered_map<u4, u4> by_code_off;     /* record of each harvested code_off */
+    code_harvest_stats stats;
+};
+
+/*
+ * Walk every class_data_item of the dex and copy out each code_item (and its debug_info)
+ * that lies outside [begin, begin + length), with mem_read, so one pointing at nothing is
+ * an unreadable record rather than a crash. The classes are split over max_threads threads
+ * (<= 0: one per cpu).
+ */
+void code_harvest_collect(const dex_tables *tables, const void *begin, size_t length, int max_threads,
+                          code_harvest *harvest);
+
+/* the harvested copy of the code_item at code_off, NULL if it wasn't outside or couldn't be read */
+const code_harvest_record *code_harvest_find(const code_harvest *harvest, u4 code_off);
+
+bool code_harvest_write(const code_harvest *harvest, const dex_tables *tables, const void *begin, size_t length,
+                        const char *path, dump_result *result);
+#endif
@@ -0,0 +1,120 @@
+#include <string.h>
+#include "dexclasses.h"
+
+static void append_utf8(std::string *out, u4 code_point) {
+    if (code_point < 0x80) {
+        out->push_back((char) code_point);
+    } else if (code_point < 0x800) {
+        out->push_back((char) (0xc0 | (code_point >> 6)));
+        out->push_back((char) (0x80 | (code_point & 0x3f)));
+    } else if (code_point < 0x10000) {
+        out->push_back((char) (0xe0 | (code_point >> 12)));
+        out->push_back((char) (0x80 | ((code_point >> 6) & 0x3f)));
+        out->push_back((char) (0x80 | (code_point & 0x3f)));
+    } else {
+        out->push_back((char) (0xf0 | (code_point >> 18)));
+        out->push_back((char) (0x80 | ((code_point >> 12) & 0x3f)));
+        out->push_back((char) (0x80 | ((code_point >> 6) & 0x3f)));
+        out->push_back((char) (0x80 | (code_point & 0x3f)));
+    }
+}
+
+/* one UTF-16 unit of MUTF-8, advancing data; a truncated sequence ends the string */
+static u4 read_mutf8_unit(const u1 **data, const u1 *end) {
+    const u1 *ptr = *data;
+    u4 unit = *ptr++;
+    if (unit >= 0x80) {
+        if ((unit & 0xe0) == 0xc0 && ptr < end) {
+            unit = ((unit & 0x1f) << 6) | (*ptr++ & 0x3f);
+        } else if ((unit & 0xf0) == 0xe0 && ptr + 1 < end) {
+            unit = ((unit & 0x0f) << 12) | ((ptr[0] & 0x3f) << 6) | (ptr[1] & 0x3f);
+            ptr += 2;
+        } else {
+            ptr = end;
+        }
+    }
+    *data = ptr;
+    return unit;
+}
+
+/* the slow path: surrogate pairs become one 4-byte sequence, '/' becomes '.' */
+static void append_mutf8(std::string *out, const u1 *data, const u1 *end) {
+    while (data < end) {
+        u4 unit = read_mutf8_unit(&data, end);
+        if (unit >= 0xd800 && unit < 0xdc00 && data < end) {
+            const u1 *next = data;
+            u4 low = read_mutf8_unit(&next, end);
+            if (low >= 0xdc00 && low < 0xe000) {
+                unit = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+                data = next;
+            }
+        }
+        append_utf8(out, unit == '/' ? '.' : unit);
+    }
+}
+
+static void append_name(std::string *out, const u1 *descriptor, size_t length) {
+    /* Lcom/foo/Bar; -> com.foo.Bar */
+    if (length >= 2 && descriptor[0] == 'L' && descriptor[length - 1] == ';') {
+        descriptor++;
+        length -= 2;
+    }
+    bool ascii = true;
+    for (size_t i = 0; i < length; i++) {
+        if (descriptor[i] >= 0x80) {
+            ascii = false;
+            break;
+        }
+    }
+    if (ascii) {
+        size_t start = out->size();
+        out->append((const char *) descriptor, length);
+        for (std::string::iterator it = out->begin() + start; it != out->end(); ++it) {
+            if (*it == '/')
+                *it = '.';
+        }
+    } else {
+        append_mutf8(out, descriptor, descriptor + length);
+    }
+    out->push_back('\n');
+}
+
+std::string dex_descriptor_prefix(const char *prefix) {
+    std::string match;
+    if (prefix != NULL && prefix[0] != '\0') {
+        match = "L";
+        match += prefix;
+        for (size_t i = 1; i < match.size(); i++) {
+            if (match[i] == '.')
+                match[i] = '/';
+        }
+    }
+    return match;
+}
+
+void dex_append_class_name(const char *descriptor, std::string *names) {
+    append_name(names, (const u1 *) descriptor, strlen(descriptor));
+}
+
+size_t dex_class_names(const dex_tables *tables, const char *prefix, std::string *names) {
+    const art::DexFile::Header *header = tables->header;
+    /* the prefix in descriptor form, so classes that don't match are never decoded */
+    std::string match = dex_descriptor_prefix(prefix);
+    size_t count = 0;
+    names->reserve(names->size() + header->class_defs_size_ * 32);
+    for (u4 i = 0; i < header->class_defs_size_; i++) {
+        u4 type_idx = tables->class_defs[i].class_idx_;
+        if (type_idx >= header->type_ids_size_)
+            continue;
+        u4 string_idx = tables->type_ids[type_idx].descriptor_idx_;
+        if (string_idx >= header->string_ids_size_)
+            continue;
+        const u1 *descriptor = (const u1 *) dex_string_by_idx(tables, string_idx);
+        size_t length = strlen((const char *) descriptor);
+        if (!match.empty() && (length < match.size() || memcmp(descriptor, match.data(), match.size()) != 0))
+            continue;
+        append_name(names, descriptor, length);
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,23 @@
+#ifndef DEXCLASSES_H_
+#define DEXCLASSES_H_
+#include <stddef.h>
+#include <string>
+#include "util.h"
+#include "dexparse.h"
+
+/*
+ * Append the name of every class_def of a loaded dex to names, in class_def order, as
+ * Class.getName() spells it (com.foo.Bar$Inner), each followed by '\n' which no valid
+ * name contains. The MUTF-8 descriptors are converted to standard UTF-8; ASCII ones,
+ * nearly all of them, are copied without decoding. With a (dotted) prefix only the
+ * matching names are kept; the test runs on the raw descriptor. Returns the names
+ * appended, class_defs pointing outside the id tables are skipped.
+ */
+size_t dex_class_names(const dex_tables *tables, const char *prefix, std::string *names);
+
+/* a dotted class name prefix (com.foo) in descriptor form (Lcom/foo), "" for none */
+std::string dex_descriptor_prefix(const char *prefix);
+
+/* the name of one descriptor appended to names as dex_class_names spells it, '\n' included */
+void dex_append_class_name(const char *descriptor, std::string *names);
+#endif
@@ -2,6 +2,9 @@
 // Created by jxht on 2018/5/4.
 //
 
+#ifndef ZJDROID_DEXFILE_ART_H
+#define ZJDROID_DEXFILE_ART_H
+
 #include <jni.h>
 #include <memory>
 #include <string>
@@ -9,11 +12,6 @@
 #include "jvalue.h"
 //#include <bits/unique_ptr.h>
 
-#ifndef ZJDROID_DEXFILE_ART_H
-#define ZJDROID_DEXFILE_ART_H
-
-#endif //ZJDROID_DEXFILE_ART_H
-
 namespace art {
 
     class OatDexFile;
@@ -504,4 +502,6 @@ namespace art {
         ART_FRIEND_TEST(ClassLinkerTest, RegisterDexFileName
         );  // for constructor
     };
-}
\ No newline at end of file
+}
+
+#endif //ZJDROID_DEXFILE_ART_H
@@ -0,0 +1,430 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <android/log.h>
+#include "dexindex.h"
+#include "dumpfile.h"
+#include "threadpool.h"
+#include "jobengine.h"
+
+/* tasks small enough to balance over the threads, big enough to amortize handing them out */
+#define INDEX_CHUNK_CLASSES 512
+#define INDEX_CHUNK_STRINGS 8192
+#define INDEX_MIN_SLOTS     16
+
+struct index_build {
+    const dex_tables *tables;
+    art::DexFile::Header dex;                               /* the header it was started from */
+    size_t class_chunks;
+    size_t string_chunks;
+    std::vector<u1> done;                                   /* per chunk, kept over a cancel */
+    std::vector<size_t> pending;                            /* the chunks this run hands out */
+    std::vector<std::vector<std::pair<u4, u4> > > codes;    /* (method_idx, code_off) per class chunk */
+    std::vector<u4> hashes;                                 /* per string_id */
+};
+
+/*
+ * open indexes by signature, never unmapped: callers keep the pointers. A signature alone
+ * doesn't pin the dex (a dump with its checksum fixed keeps it), so each hit is checked again.
+ * The lock covers the maps only; one caller per signature opens or builds, the others wait.
+ */
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t index_opened = PTHREAD_COND_INITIALIZER;
+static std::map<std::string, dex_index *> open_indexes;
+static std::set<std::string> opening;
+/* what cancelled builds got done, resumed by the next open of the same dex */
+static std::map<std::string, index_build *> partial_builds;
+
+u4 dex_index_hash(const char *string) {
+    /* FNV-1a */
+    u4 hash = 2166136261u;
+    for (const u1 *ptr = (const u1 *) string; *ptr != 0; ptr++) {
+        hash ^= *ptr;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void collect_codes(const dex_tables *tables, u4 class_data_off, std::vector<std::pair<u4, u4> > *codes) {
+    const u1 *ptr = tables->base + class_data_off;
+    u4 sizes[4];
+    for (int i = 0; i < 4; i++)
+        sizes[i] = read_uleb128(&ptr);
+    for (u4 i = 0; i < sizes[0] + sizes[1]; i++) {
+        read_uleb128(&ptr);
+        read_uleb128(&ptr);
+    }
+    /* method_idx restarts from the diff for the virtual methods */
+    for (int list = 2; list < 4; list++) {
+        u4 method_idx = 0;
+        for (u4 i = 0; i < sizes[list]; i++) {
+            method_idx += read_uleb128(&ptr);
+            read_uleb128(&ptr);
+            u4 code_off = read_uleb128(&ptr);
+            if (code_off != 0)
+                codes->push_back(std::make_pair(method_idx, code_off));
+        }
+    }
+}
+
+/* a chunk once started runs to its end, so a cancel leaves every chunk done or untouched */
+static void build_task(size_t next, void *arg) {
+    index_build *build = (index_build *) arg;
+    const dex_tables *tables = build->tables;
+    size_t task = build->pending[next];
+    if (job_cancelled())
+        return;
+    job_progress_add(1);
+    if (task < build->class_chunks) {
+        u4 end = std::min((size_t) tables->header->class_defs_size_, (task + 1) * INDEX_CHUNK_CLASSES);
+        for (u4 i = task * INDEX_CHUNK_CLASSES; i < end; i++) {
+            if (tables->class_defs[i].class_data_off_ != 0)
+                collect_codes(tables, tables->class_defs[i].class_data_off_, &build->codes[task]);
+        }
+    } else {
+        size_t chunk = task - build->class_chunks;
+        u4 end = std::min((size_t) tables->header->string_ids_size_, (chunk + 1) * INDEX_CHUNK_STRINGS);
+        for (u4 i = chunk * INDEX_CHUNK_STRINGS; i < end; i++)
+            build->hashes[i] = dex_index_hash(dex_string_by_idx(tables, i));
+    }
+    build->done[task] = 1;
+}
+
+static index_build *new_build(const dex_tables *tables) {
+    const art::DexFile::Header *dex = tables->header;
+    index_build *build = new index_build;
+    build->dex = *dex;
+    build->class_chunks = (dex->class_defs_size_ + INDEX_CHUNK_CLASSES - 1) / INDEX_CHUNK_CLASSES;
+    build->string_chunks = (dex->string_ids_size_ + INDEX_CHUNK_STRINGS - 1) / INDEX_CHUNK_STRINGS;
+    build->done.resize(build->class_chunks + build->string_chunks);
+    build->codes.resize(build->class_chunks);
+    build->hashes.resize(dex->string_ids_size_);
+    return build;
+}
+
+/* the partial build was started on this very dex */
+static bool build_matches(const index_build *build, const art::DexFile::Header *dex) {
+    return memcmp(build->dex.signature_, dex->signature_, SHA1_DIGEST_SIZE) == 0 &&
+           build->dex.checksum_ == dex->checksum_ && build->dex.file_size_ == dex->file_size_ &&
+           build->dex.class_defs_size_ == dex->class_defs_size_ &&
+           build->dex.method_ids_size_ == dex->method_ids_size_ && build->dex.string_ids_size_ == dex->string_ids_size_;
+}
+
+/* what map_index takes for a code_item offset: code_items are 4-aligned and past the header */
+static bool code_off_valid(u4 code_off) {
+    return code_off == 0 || (code_off >= DEX_HEADER_SIZE && (code_off & 3) == 0);
+}
+
+struct name_before {
+    const char *names;
+    bool operator()(const dex_index_class &a, const dex_index_class &b) const {
+        return strcmp(names + a.name_off, names + b.name_off) < 0;
+    }
+};
+
+static u4 align4(size_t size) {
+    return (u4) ((size + 3) & ~(size_t) 3);
+}
+
+/*
+ * false only if the job it runs in was cancelled halfway, the chunks done so far stay in
+ * build and are skipped by the next call on it
+ */
+static bool build_index(index_build *build, int max_threads, std::vector<u1> *file) {
+    const dex_tables *tables = build->tables;
+    const art::DexFile::Header *dex = tables->header;
+    build->pending.clear();
+    for (size_t task = 0; task < build->done.size(); task++) {
+        if (!build->done[task])
+            build->pending.push_back(task);
+    }
+    job_progress_begin("chunks", build->done.size());
+    job_progress_add(build->done.size() - build->pending.size());
+    parallel_for(build->pending.size(), max_threads, build_task, build);
+    if (std::find(build->done.begin(), build->done.end(), 0) != build->done.end())
+        return false;
+
+    std::string names;
+    std::vector<dex_index_class> classes;
+    classes.reserve(dex->class_defs_size_);
+    for (u4 i = 0; i < dex->class_defs_size_; i++) {
+        u4 type_idx = tables->class_defs[i].class_idx_;
+        if (type_idx >= dex->type_ids_size_ || tables->type_ids[type_idx].descriptor_idx_ >= dex->string_ids_size_)
+            continue;
+        dex_index_class entry;
+        entry.name_off = names.size();
+        entry.class_def_idx = i;
+        names += dex_string_by_idx(tables, tables->type_ids[type_idx].descriptor_idx_);
+        names.push_back('\0');
+        classes.push_back(entry);
+    }
+    /* stable: of duplicate definitions the runtime loads the first, so does the lookup */
+    name_before before = {names.c_str()};
+    std::stable_sort(classes.begin(), classes.end(), before);
+
+    u4 slots = INDEX_MIN_SLOTS;
+    while (slots < (u8) dex->string_ids_size_ * 2)
+        slots <<= 1;
+
+    dex_index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DEX_INDEX_MAGIC, sizeof(header.magic));
+    memcpy(header.signature, dex->signature_, SHA1_DIGEST_SIZE);
+    header.dex_checksum = dex->checksum_;
+    header.dex_size = dex->file_size_;
+    header.class_count = classes.size();
+    header.classes_off = align4(sizeof(header));
+    header.method_count = dex->method_ids_size_;
+    header.methods_off = header.classes_off + classes.size() * sizeof(dex_index_class);
+    header.string_count = dex->string_ids_size_;
+    header.string_slots = slots;
+    header.strings_off = header.methods_off + header.method_count * sizeof(u4);
+    header.names_off = header.strings_off + slots * sizeof(dex_index_string);
+    header.names_size = names.size();
+    header.file_size = align4(header.names_off + names.size());
+
+    file->assign(header.file_size, 0);
+    u1 *out = &(*file)[0];
+    memcpy(out, &header, sizeof(header));
+    if (!classes.empty())
+        memcpy(out + header.classes_off, &classes[0], classes.size() * sizeof(dex_index_class));
+    u4 *methods = (u4 *) (out + header.methods_off);
+    for (size_t chunk = 0; chunk < build->codes.size(); chunk++) {
+        for (size_t i = 0; i < build->codes[chunk].size(); i++) {
+            const std::pair<u4, u4> &code = build->codes[chunk][i];
+            /* past the dex is fine, packers put code_items there, but never what map_index rejects */
+            if (code.first < header.method_count && methods[code.first] == 0 && code_off_valid(code.second))
+                methods[code.first] = code.second;
+        }
+    }
+    dex_index_string *strings = (dex_index_string *) (out + header.strings_off);
+    for (u4 i = 0; i < header.string_count; i++) {
+        u4 slot = build->hashes[i] & (slots - 1);
+        while (strings[slot].idx_plus_one != 0)
+            slot = (slot + 1) & (slots - 1);
+        strings[slot].hash = build->hashes[i];
+        strings[slot].idx_plus_one = i + 1;
+    }
+    memcpy(out + header.names_off, names.data(), names.size());
+    return true;
+}
+
+static bool section_fits(u4 off, u8 size, u4 file_size) {
+    return off <= file_size && size <= file_size - off;
+}
+
+/* the index was built from this very dex */
+static bool index_matches(const dex_index_header *header, const art::DexFile::Header *dex) {
+    return memcmp(header->signature, dex->signature_, SHA1_DIGEST_SIZE) == 0 &&
+           header->dex_checksum == dex->checksum_ && header->dex_size == dex->file_size_ &&
+           header->method_count == dex->method_ids_size_ && header->string_count == dex->string_ids_size_;
+}
+
+/* every entry points inside its section or the dex, and a lookup always meets an empty slot */
+static bool entries_valid(const dex_index *index, const art::DexFile::Header *dex) {
+    const dex_index_header *header = index->header;
+    if ((header->classes_off | header->methods_off | header->strings_off) & 3)
+        return false;
+    if (header->class_count > dex->class_defs_size_ ||
+        (header->names_size != 0 && index->names[header->names_size - 1] != '\0'))
+        return false;
+    for (u4 i = 0; i < header->class_count; i++) {
+        if (index->classes[i].name_off >= header->names_size || index->classes[i].class_def_idx >= dex->class_defs_size_)
+            return false;
+    }
+    for (u4 i = 0; i < header->method_count; i++) {
+        if (!code_off_valid(index->methods[i]))
+            return false;
+    }
+    u4 empty = 0;
+    for (u4 i = 0; i < header->string_slots; i++) {
+        if (index->strings[i].idx_plus_one > header->string_count)
+            return false;
+        if (index->strings[i].idx_plus_one == 0)
+            empty++;
+    }
+    return empty != 0;
+}
+
+static dex_index *map_index(const char *path, const art::DexFile::Header *dex) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(dex_index_header))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    const dex_index_header *header = (const dex_index_header *) map;
+    bool valid = memcmp(header->magic, DEX_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                 index_matches(header, dex) && header->file_size == (u8) st.st_size &&
+                 section_fits(header->classes_off, (u8) header->class_count * sizeof(dex_index_class), header->file_size) &&
+                 section_fits(header->methods_off, (u8) header->method_count * sizeof(u4), header->file_size) &&
+                 section_fits(header->strings_off, (u8) header->string_slots * sizeof(dex_index_string), header->file_size) &&
+                 section_fits(header->names_off, header->names_size, header->file_size) &&
+                 header->string_slots != 0 && (header->string_slots & (header->string_slots - 1)) == 0;
+    dex_index *index = NULL;
+    if (valid) {
+        index = new dex_index;
+        index->header = header;
+        index->classes = (const dex_index_class *) ((const u1 *) map + header->classes_off);
+        index->methods = (const u4 *) ((const u1 *) map + header->methods_off);
+        index->strings = (const dex_index_string *) ((const u1 *) map + header->strings_off);
+        index->names = (const char *) map + header->names_off;
+        if (!entries_valid(index, dex)) {
+            delete index;
+            index = NULL;
+        }
+    }
+    if (index == NULL) {
+        LOGV("stale dex index %s", path);
+        munmap(map, st.st_size);
+    }
+    return index;
+}
+
+/* built and written outside index_lock; a cancelled build is kept in build for the next caller */
+static dex_index *build_and_map(const char *key, const std::string &path, const dex_tables *tables,
+                                int max_threads, index_build **build, bool *built) {
+    if (*build != NULL && !build_matches(*build, tables->header)) {
+        delete *build;
+        *build = NULL;
+    }
+    if (*build == NULL)
+        *build = new_build(tables);
+    (*build)->tables = tables;
+    u8 start = dump_now_ns();
+    std::vector<u1> file;
+    if (!build_index(*build, max_threads, &file)) {
+        size_t done = std::count((*build)->done.begin(), (*build)->done.end(), 1);
+        LOGV("dex index %s cancelled, %zu of %zu chunks kept", key, done, (*build)->done.size());
+        return NULL;
+    }
+    delete *build;
+    *build = NULL;
+    /* written aside, so a reader never maps half an index */
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), ".tmp%d", getpid());
+    std::string tmp_path = path + tmp;
+    dex_index *index = NULL;
+    dump_result result;
+    if (dump_region_to_file(tmp_path.c_str(), &file[0], file.size(), DUMP_FSYNC_END, &result) &&
+        rename(tmp_path.c_str(), path.c_str()) == 0) {
+        index = map_index(path.c_str(), tables->header);
+        *built = index != NULL;
+    } else {
+        LOGE("write dex index %s failed: %s", path.c_str(), strerror(result.error != 0 ? result.error : errno));
+        unlink(tmp_path.c_str());
+    }
+    LOGV("dex index %s built in %u us", key, (unsigned int) ((dump_now_ns() - start) / 1000));
+    return index;
+}
+
+const dex_index *dex_index_open(const char *dir, const dex_tables *tables, int max_threads, bool *built) {
+    char key[SHA1_DIGEST_SIZE * 2 + 1];
+    for (int i = 0; i < SHA1_DIGEST_SIZE; i++)
+        sprintf(key + i * 2, "%02x", tables->header->signature_[i]);
+    std::string path = std::string(dir) + "/" + key + DEX_INDEX_SUFFIX;
+    *built = false;
+
+    pthread_mutex_lock(&index_lock);
+    dex_index *index;
+    for (;;) {
+        std::map<std::string, dex_index *>::iterator it = open_indexes.find(key);
+        index = it != open_indexes.end() ? it->second : NULL;
+        /* a stale one stays mapped for whoever holds it, the rebuilt one takes its place */
+        if (index != NULL && !index_matches(index->header, tables->header))
+            index = NULL;
+        if (index != NULL || opening.count(key) == 0)
+            break;
+        pthread_cond_wait(&index_opened, &index_lock);
+    }
+    if (index != NULL) {
+        pthread_mutex_unlock(&index_lock);
+        return index;
+    }
+    opening.insert(key);
+    index_build *build = NULL;
+    std::map<std::string, index_build *>::iterator partial = partial_builds.find(key);
+    if (partial != partial_builds.end()) {
+        build = partial->second;
+        partial_builds.erase(partial);
+    }
+    pthread_mutex_unlock(&index_lock);
+
+    index = map_index(path.c_str(), tables->header);
+    if (index == NULL)
+        index = build_and_map(key, path, tables, max_threads, &build, built);
+
+    pthread_mutex_lock(&index_lock);
+    opening.erase(key);
+    if (index != NULL)
+        open_indexes[key] = index;
+    if (build != NULL && index == NULL)
+        partial_builds[key] = build;
+    else
+        delete build;
+    pthread_cond_broadcast(&index_opened);
+    pthread_mutex_unlock(&index_lock);
+    return index;
+}
+
+struct name_less {
+    const char *names;
+    bool operator()(const dex_index_class &a, const char *b) const {
+        return strcmp(names + a.name_off, b) < 0;
+    }
+};
+
+u4 dex_index_find_class(const dex_index *index, const char *descriptor) {
+    const dex_index_class *end = index->classes + index->header->class_count;
+    name_less less = {index->names};
+    const dex_index_class *found = std::lower_bound(index->classes, end, descriptor, less);
+    if (found == end || strcmp(index->names + found->name_off, descriptor) != 0)
+        return DEX_NO_INDEX;
+    return found->class_def_idx;
+}
+
+size_t dex_index_class_range(const dex_index *index, const char *prefix, const dex_index_class **first) {
+    const dex_index_class *end = index->classes + index->header->class_count;
+    name_less less = {index->names};
+    const dex_index_class *found = std::lower_bound(index->classes, end, prefix, less);
+    size_t length = strlen(prefix);
+    /* sorted, so the matches run on from the first one */
+    const dex_index_class *last = found;
+    while (last != end && strncmp(index->names + last->name_off, prefix, length) == 0)
+        last++;
+    *first = found;
+    return last - found;
+}
+
+u4 dex_index_find_string(const dex_index *index, const dex_tables *tables, const char *string) {
+    u4 hash = dex_index_hash(string);
+    u4 mask = index->header->string_slots - 1;
+    u4 slot = hash & mask;
+    for (u4 probes = 0; probes < index->header->string_slots && index->strings[slot].idx_plus_one != 0; probes++) {
+        const dex_index_string *entry = &index->strings[slot];
+        slot = (slot + 1) & mask;
+        if (entry->hash == hash && strcmp(dex_string_by_idx(tables, entry->idx_plus_one - 1), string) == 0)
+            return entry->idx_plus_one - 1;
+    }
+    return DEX_NO_INDEX;
+}
+
+u4 dex_index_code_off(const dex_index *index, u4 method_idx) {
+    if (method_idx >= index->header->method_count)
+        return 0;
+    return index->methods[method_idx];
+}
@@ -0,0 +1,79 @@
+#ifndef DEXINDEX_H_
+#define DEXINDEX_H_
+#include <stdint.h>
+#include <stddef.h>
+#include "util.h"
+#include "dexparse.h"
+#include "dexsum.h"
+
+#define DEX_INDEX_MAGIC     "dexidx1"
+#define DEX_INDEX_SUFFIX    ".dexidx"
+
+/*
+ * On-disk lookup tables of one dex, a sidecar file named after the signature (SHA-1) in
+ * its header. The file is used in place through mmap; all offsets are from its start.
+ */
+struct dex_index_header {
+    char magic[8];
+    u1 signature[SHA1_DIGEST_SIZE];     /* of the dex, the key */
+    u4 dex_checksum;
+    u4 dex_size;
+    u4 file_size;                       /* of the index */
+    u4 class_count;
+    u4 classes_off;                     /* dex_index_class[class_count], sorted by descriptor */
+    u4 method_count;
+    u4 methods_off;                     /* u4[method_count]: code_off of each method_id, 0 if none */
+    u4 string_count;
+    u4 string_slots;                    /* power of 2, at least twice string_count */
+    u4 strings_off;                     /* dex_index_string[string_slots], linear probing */
+    u4 names_off;                       /* the class descriptors, NUL terminated MUTF-8 */
+    u4 names_size;
+};
+
+struct dex_index_class {
+    u4 name_off;                        /* from names_off */
+    u4 class_def_idx;
+};
+
+struct dex_index_string {
+    u4 hash;
+    u4 idx_plus_one;                    /* 0: empty slot */
+};
+
+struct dex_index {
+    const dex_index_header *header;
+    const dex_index_class *classes;
+    const u4 *methods;
+    const dex_index_string *strings;
+    const char *names;
+};
+
+/*
+ * The index of the dex behind tables, from dir/<signature>.dexidx. A missing, stale or
+ * malformed sidecar (checksum, size or id counts differ from tables, or an entry points
+ * outside its section) is built first, in chunks over max_threads threads (<= 0: one per
+ * cpu), written aside and renamed into place. Indexes stay mapped for the life of the
+ * process, so the next open of the same dex is a map lookup. Only one caller builds a
+ * given dex, the others wait for it; different dexes build at once. built tells whether
+ * this call had to build it. NULL on failure, or if the job it runs in is cancelled
+ * mid-build: nothing is written then, and the next open resumes from the chunks done.
+ */
+const dex_index *dex_index_open(const char *dir, const dex_tables *tables, int max_threads, bool *built);
+
+/* class_def index of a descriptor (Lcom/foo/Bar;), DEX_NO_INDEX if the dex doesn't define it */
+u4 dex_index_find_class(const dex_index *index, const char *descriptor);
+
+/*
+ * The classes whose descriptor starts with prefix ("" for all), in descriptor order: the
+ * count of them, from *first on.
+ */
+size_t dex_index_class_range(const dex_index *index, const char *prefix, const dex_index_class **first);
+
+/* string_id index of a MUTF-8 string, DEX_NO_INDEX if absent */
+u4 dex_index_find_string(const dex_index *index, const dex_tables *tables, const char *string);
+
+/* code_item offset of a method_id, 0 for abstract/native methods or ones no class defines */
+u4 dex_index_code_off(const dex_index *index, u4 method_idx);
+
+u4 dex_index_hash(const char *string);
+#endif
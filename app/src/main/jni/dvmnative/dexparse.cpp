@@ -0,0 +1,233 @@
+#include "dexparse.h"
+
+u4 read_uleb128(const u1 **data) {
+    const u1 *ptr = *data;
+    u4 result = 0;
+    int shift = 0;
+    u1 cur;
+    do {
+        cur = *ptr++;
+        result |= (u4) (cur & 0x7f) << shift;
+        shift += 7;
+    } while ((cur & 0x80) && shift < 35);
+    *data = ptr;
+    return result;
+}
+
+s4 read_sleb128(const u1 **data) {
+    const u1 *ptr = *data;
+    s4 result = 0;
+    int shift = 0;
+    u1 cur;
+    do {
+        cur = *ptr++;
+        result |= (s4) (cur & 0x7f) << shift;
+        shift += 7;
+    } while ((cur & 0x80) && shift < 35);
+    if (shift < 32 && (cur & 0x40)) {
+        result |= -(1 << shift);
+    }
+    *data = ptr;
+    return result;
+}
+
+void write_uleb128(std::vector<u1> *out, u4 value) {
+    while (value > 0x7f) {
+        out->push_back((u1) ((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back((u1) value);
+}
+
+static inline void skip_leb128(const u1 **data) {
+    const u1 *ptr = *data;
+    int count = 0;
+    while ((*ptr++ & 0x80) && ++count < 5) {
+    }
+    *data = ptr;
+}
+
+size_t string_data_size(const u1 *item) {
+    const u1 *ptr = item;
+    skip_leb128(&ptr);
+    while (*ptr != 0) {
+        ptr++;
+    }
+    return ptr + 1 - item;
+}
+
+size_t type_list_size(const u1 *item) {
+    u4 size = *(const u4 *) item;
+    return 4 + size * 2;
+}
+
+/* the bounded readers: false once the value would run past end */
+static inline bool read_uleb128_within(const u1 **data, const u1 *end, u4 *value) {
+    const u1 *ptr = *data;
+    u4 result = 0;
+    int shift = 0;
+    u1 cur;
+    do {
+        if (ptr >= end)
+            return false;
+        cur = *ptr++;
+        result |= (u4) (cur & 0x7f) << shift;
+        shift += 7;
+    } while ((cur & 0x80) && shift < 35);
+    *data = ptr;
+    *value = result;
+    return true;
+}
+
+static inline bool skip_leb128_within(const u1 **data, const u1 *end) {
+    const u1 *ptr = *data;
+    int count = 0;
+    do {
+        if (ptr >= end)
+            return false;
+    } while ((*ptr++ & 0x80) && ++count < 5);
+    *data = ptr;
+    return true;
+}
+
+/* no real item ends here, so the unbounded sizes are the bounded ones */
+#define NO_END ((const u1 *) UINTPTR_MAX)
+
+size_t code_item_size(const u1 *item) {
+    return code_item_size_within(item, NO_END);
+}
+
+size_t code_item_size_within(const u1 *item, const u1 *end) {
+    if ((size_t) (end - item) < 16)
+        return 0;
+    const art::DexFile::CodeItem *code = (const art::DexFile::CodeItem *) item;
+    u8 size = 16 + (u8) code->insns_size_in_code_units_ * 2;
+    if (code->tries_size_ == 0)
+        return size <= (u8) (end - item) ? (size_t) size : 0;
+    if (code->insns_size_in_code_units_ & 1) {
+        size += 2;
+    }
+    size += code->tries_size_ * sizeof(art::DexFile::TryItem);
+    if (size >= (u8) (end - item))
+        return 0;
+    const u1 *ptr = item + size;
+    u4 handlers;
+    if (!read_uleb128_within(&ptr, end, &handlers))
+        return 0;
+    for (u4 i = 0; i < handlers; i++) {
+        /* the sleb128 takes the bytes the bounded skip let through */
+        const u1 *count_ptr = ptr;
+        if (!skip_leb128_within(&ptr, end))
+            return 0;
+        s4 count = read_sleb128(&count_ptr);
+        s4 pairs = count < 0 ? -count : count;
+        for (s4 j = 0; j < pairs; j++) {
+            if (!skip_leb128_within(&ptr, end) || !skip_leb128_within(&ptr, end))
+                return 0;
+        }
+        if (count <= 0 && !skip_leb128_within(&ptr, end))
+            return 0;
+    }
+    return ptr - item;
+}
+
+size_t debug_info_size(const u1 *item) {
+    return debug_info_size_within(item, NO_END);
+}
+
+size_t debug_info_size_within(const u1 *item, const u1 *end) {
+    const u1 *ptr = item;
+    u4 parameters;
+    if (!skip_leb128_within(&ptr, end) || !read_uleb128_within(&ptr, end, &parameters))
+        return 0;
+    for (u4 i = 0; i < parameters; i++) {
+        if (!skip_leb128_within(&ptr, end))
+            return 0;
+    }
+    for (;;) {
+        if (ptr >= end)
+            return 0;
+        u1 opcode = *ptr++;
+        int operands;
+        switch (opcode) {
+            case art::DexFile::DBG_END_SEQUENCE:
+                return ptr - item;
+            case art::DexFile::DBG_ADVANCE_PC:
+            case art::DexFile::DBG_ADVANCE_LINE:
+            case art::DexFile::DBG_END_LOCAL:
+            case art::DexFile::DBG_RESTART_LOCAL:
+            case art::DexFile::DBG_SET_FILE:
+                operands = 1;
+                break;
+            case art::DexFile::DBG_START_LOCAL:
+                operands = 3;
+                break;
+            case art::DexFile::DBG_START_LOCAL_EXTENDED:
+                operands = 4;
+                break;
+            default:
+                operands = 0;
+                break;
+        }
+        for (int i = 0; i < operands; i++) {
+            if (!skip_leb128_within(&ptr, end))
+                return 0;
+        }
+    }
+}
+
+static void skip_encoded_value(const u1 **data);
+
+static void skip_encoded_array(const u1 **data) {
+    u4 size = read_uleb128(data);
+    for (u4 i = 0; i < size; i++) {
+        skip_encoded_value(data);
+    }
+}
+
+static void skip_encoded_annotation(const u1 **data) {
+    skip_leb128(data);
+    u4 size = read_uleb128(data);
+    for (u4 i = 0; i < size; i++) {
+        skip_leb128(data);
+        skip_encoded_value(data);
+    }
+}
+
+static void skip_encoded_value(const u1 **data) {
+    u1 header = *(*data)++;
+    u1 type = header & art::DexFile::kDexAnnotationValueTypeMask;
+    u1 arg = header >> art::DexFile::kDexAnnotationValueArgShift;
+    switch (type) {
+        case art::DexFile::kDexAnnotationArray:
+            skip_encoded_array(data);
+            break;
+        case art::DexFile::kDexAnnotationAnnotation:
+            skip_encoded_annotation(data);
+            break;
+        case art::DexFile::kDexAnnotationNull:
+        case art::DexFile::kDexAnnotationBoolean:
+            break;
+        default:
+            *data += arg + 1;
+            break;
+    }
+}
+
+size_t encoded_array_size(const u1 *item) {
+    const u1 *ptr = item;
+    skip_encoded_array(&ptr);
+    return ptr - item;
+}
+
+size_t annotation_item_size(const u1 *item) {
+    const u1 *ptr = item + 1;
+    skip_encoded_annotation(&ptr);
+    return ptr - item;
+}
+
+const char *dex_string_by_idx(const dex_tables *tables, u4 idx) {
+    const u1 *ptr = tables->base + tables->string_ids[idx].string_data_off_;
+    skip_leb128(&ptr);
+    return (const char *) ptr;
+}
@@ -0,0 +1,46 @@
+#ifndef DEXPARSE_H_
+#define DEXPARSE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "util.h"
+#include "dexfile_art.h"
+
+/*
+ * The tables of a loaded dex, wherever the runtime (or a packer) put them.
+ * Offsets stored inside the items are relative to base.
+ */
+struct dex_tables {
+    const u1 *base;
+    const art::DexFile::Header *header;
+    const art::DexFile::StringId *string_ids;
+    const art::DexFile::TypeId *type_ids;
+    const art::DexFile::FieldId *field_ids;
+    const art::DexFile::MethodId *method_ids;
+    const art::DexFile::ProtoId *proto_ids;
+    const art::DexFile::ClassDef *class_defs;
+};
+
+#define DEX_HEADER_SIZE     0x70
+#define DEX_ENDIAN_CONSTANT 0x12345678
+#define DEX_NO_INDEX        0xffffffff
+
+u4 read_uleb128(const u1 **data);
+s4 read_sleb128(const u1 **data);
+void write_uleb128(std::vector<u1> *out, u4 value);
+
+/* sizes of the variable length data items, in bytes */
+size_t string_data_size(const u1 *item);
+size_t type_list_size(const u1 *item);
+size_t code_item_size(const u1 *item);
+size_t debug_info_size(const u1 *item);
+size_t encoded_array_size(const u1 *item);
+size_t annotation_item_size(const u1 *item);
+
+/* the same for an item copied into a buffer ending at end, 0 if it runs past end */
+size_t code_item_size_within(const u1 *item, const u1 *end);
+size_t debug_info_size_within(const u1 *item, const u1 *end);
+
+/* MUTF-8 string of a string_id, NUL terminated */
+const char *dex_string_by_idx(const dex_tables *tables, u4 idx);
+#endif
@@ -0,0 +1,560 @@
+#include <string.h>
+#include <map>
+#include <unordered_map>
+#include <android/log.h>
+#include "dexrebuild.h"
+#include "dexsum.h"
+#include "jobengine.h"
+
+namespace {
+
+typedef art::DexFile DF;
+
+/* data sections, in the order they are laid out after the id tables */
+enum DataSection {
+    kStringData,
+    kTypeList,
+    kEncodedArray,
+    kAnnotation,
+    kAnnotationSet,
+    kAnnotationSetRefList,
+    kAnnotationsDirectory,
+    kDebugInfo,
+    kCodeItem,
+    kClassData,
+    kDataSectionCount
+};
+
+/* the header and the id tables, fixups inside them use this section number */
+const int kIdsSection = kDataSectionCount;
+
+struct DataSectionInfo {
+    u2 map_type;
+    u4 alignment;
+};
+
+const DataSectionInfo kSectionInfo[kDataSectionCount] = {
+        {DF::kDexTypeStringDataItem,           1},
+        {DF::kDexTypeTypeList,                 4},
+        {DF::kDexTypeEncodedArrayItem,         1},
+        {DF::kDexTypeAnnotationItem,           1},
+        {DF::kDexTypeAnnotationSetItem,        4},
+        {DF::kDexTypeAnnotationSetRefList,     4},
+        {DF::kDexTypeAnnotationsDirectoryItem, 4},
+        {DF::kDexTypeDebugInfoItem,            1},
+        {DF::kDexTypeCodeItem,                 4},
+        {DF::kDexTypeClassDataItem,            1},
+};
+
+/* the u4 at (section, pos) must hold the final offset of (target, target_rel) */
+struct Fixup {
+    int section;
+    u4 pos;
+    int target;
+    u4 target_rel;
+};
+
+/* class_data_item decoded to its uleb128 values, code_off values are code section offsets */
+struct PendingClassData {
+    std::vector<u4> values;
+    std::vector<bool> is_code;
+    u4 rel;
+};
+
+/* sanity bound for the table sizes read from a header we don't trust */
+const u4 kMaxTableSize = 0x1000000;
+
+const u4 kAccStatic = 0x0008;
+
+inline u4 align_up(u4 value, u4 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+inline void put_u4(u1 *dst, u4 value) {
+    memcpy(dst, &value, 4);
+}
+
+class DexRebuilder {
+public:
+    DexRebuilder(const dex_tables *tables, const code_harvest *harvest) : tables_(tables), harvest_(harvest),
+                                                                          stubbed_code_(0) {
+        memset(counts_, 0, sizeof(counts_));
+        memset(base_, 0, sizeof(base_));
+    }
+
+    bool build(std::vector<u1> *out);
+
+    u4 stubbed_code() const {
+        return stubbed_code_;
+    }
+
+private:
+    const u1 *at(u4 off) const {
+        return tables_->base + off;
+    }
+
+    u4 place(int section, const u1 *src, size_t size, bool *is_new);
+
+    void link(int section, u4 pos, int target, u4 target_rel) {
+        Fixup fixup = {section, pos, target, target_rel};
+        fixups_.push_back(fixup);
+    }
+
+    u4 copy_simple(int section, u4 off, size_t (*size_of)(const u1 *));
+    u4 copy_annotation_set(u4 off);
+    u4 copy_annotation_set_ref_list(u4 off);
+    u4 copy_annotations_directory(u4 off);
+    u4 copy_code_item(u4 off);
+    bool code_lost(u4 off) const;
+    u4 ins_size(u4 method_idx, u4 access_flags) const;
+    u4 place_stub_code(u4 ins);
+    u4 copy_class_data(u4 off);
+
+    void build_ids();
+    void encode_class_data();
+    void write_map_list(u1 *dst, u4 map_off);
+
+    const dex_tables *tables_;
+    const code_harvest *harvest_;
+    u4 stubbed_code_;
+    /* the stub code_items by ins_size, kept for place() to find again */
+    std::map<u4, std::vector<u1> > stubs_;
+    std::vector<u1> ids_;
+    std::vector<u1> data_[kDataSectionCount];
+    u4 counts_[kDataSectionCount];
+    u4 base_[kDataSectionCount];
+    std::unordered_map<const u1 *, u4> placed_[kDataSectionCount];
+    std::vector<Fixup> fixups_;
+    std::vector<PendingClassData> class_data_;
+    std::unordered_map<const u1 *, u4> class_data_index_;
+    /* (pos in ids, index in class_data_) of every class_def.class_data_off */
+    std::vector<std::pair<u4, u4> > class_data_refs_;
+};
+
+u4 DexRebuilder::place(int section, const u1 *src, size_t size, bool *is_new) {
+    std::unordered_map<const u1 *, u4>::iterator it = placed_[section].find(src);
+    if (it != placed_[section].end()) {
+        *is_new = false;
+        return it->second;
+    }
+    std::vector<u1> &data = data_[section];
+    data.resize(align_up(data.size(), kSectionInfo[section].alignment), 0);
+    u4 rel = data.size();
+    data.insert(data.end(), src, src + size);
+    counts_[section]++;
+    placed_[section][src] = rel;
+    *is_new = true;
+    return rel;
+}
+
+u4 DexRebuilder::copy_simple(int section, u4 off, size_t (*size_of)(const u1 *)) {
+    bool is_new;
+    const u1 *src = at(off);
+    return place(section, src, size_of(src), &is_new);
+}
+
+u4 DexRebuilder::copy_annotation_set(u4 off) {
+    const u1 *src = at(off);
+    u4 size = *(const u4 *) src;
+    bool is_new;
+    u4 rel = place(kAnnotationSet, src, 4 + size * 4, &is_new);
+    if (!is_new) {
+        return rel;
+    }
+    for (u4 i = 0; i < size; i++) {
+        u4 entry = ((const u4 *) (src + 4))[i];
+        link(kAnnotationSet, rel + 4 + i * 4, kAnnotation,
+             copy_simple(kAnnotation, entry, annotation_item_size));
+    }
+    return rel;
+}
+
+u4 DexRebuilder::copy_annotation_set_ref_list(u4 off) {
+    const u1 *src = at(off);
+    u4 size = *(const u4 *) src;
+    bool is_new;
+    u4 rel = place(kAnnotationSetRefList, src, 4 + size * 4, &is_new);
+    if (!is_new) {
+        return rel;
+    }
+    for (u4 i = 0; i < size; i++) {
+        u4 entry = ((const u4 *) (src + 4))[i];
+        if (entry != 0) {
+            link(kAnnotationSetRefList, rel + 4 + i * 4, kAnnotationSet, copy_annotation_set(entry));
+        }
+    }
+    return rel;
+}
+
+u4 DexRebuilder::copy_annotations_directory(u4 off) {
+    const DF::AnnotationsDirectoryItem *dir = (const DF::AnnotationsDirectoryItem *) at(off);
+    u4 entries = dir->fields_size_ + dir->methods_size_ + dir->parameters_size_;
+    bool is_new;
+    u4 rel = place(kAnnotationsDirectory, (const u1 *) dir, 16 + entries * 8, &is_new);
+    if (!is_new) {
+        return rel;
+    }
+    if (dir->class_annotations_off_ != 0) {
+        link(kAnnotationsDirectory, rel, kAnnotationSet, copy_annotation_set(dir->class_annotations_off_));
+    }
+    const u4 *items = (const u4 *) (dir + 1);
+    for (u4 i = 0; i < entries; i++) {
+        u4 target_off = items[i * 2 + 1];
+        if (target_off == 0) {
+            continue;
+        }
+        u4 pos = rel + 16 + i * 8 + 4;
+        if (i < dir->fields_size_ + dir->methods_size_) {
+            link(kAnnotationsDirectory, pos, kAnnotationSet, copy_annotation_set(target_off));
+        } else {
+            link(kAnnotationsDirectory, pos, kAnnotationSetRefList, copy_annotation_set_ref_list(target_off));
+        }
+    }
+    return rel;
+}
+
+u4 DexRebuilder::copy_code_item(u4 off) {
+    const code_harvest_record *harvested = harvest_ != NULL ? code_harvest_find(harvest_, off) : NULL;
+    const u1 *src = harvested != NULL ? &harvest_->data[harvested->code_data_off] : at(off);
+    bool is_new;
+    u4 rel = place(kCodeItem, src, harvested != NULL ? harvested->code_size : code_item_size(src), &is_new);
+    if (!is_new) {
+        return rel;
+    }
+    u4 debug_info_off = ((const DF::CodeItem *) src)->debug_info_off_;
+    if (debug_info_off == 0) {
+        return rel;
+    }
+    if (harvested == NULL) {
+        link(kCodeItem, rel + 8, kDebugInfo, copy_simple(kDebugInfo, debug_info_off, debug_info_size));
+    } else if (harvested->debug_size != 0) {
+        link(kCodeItem, rel + 8, kDebugInfo,
+             place(kDebugInfo, &harvest_->data[harvested->debug_data_off], harvested->debug_size, &is_new));
+    } else {
+        put_u4(&data_[kCodeItem][rel + 8], 0);
+    }
+    return rel;
+}
+
+/* out of place and unreadable: following it would fault */
+bool DexRebuilder::code_lost(u4 off) const {
+    if (harvest_ == NULL) {
+        return false;
+    }
+    std::unordered_map<u4, u4>::const_iterator it = harvest_->by_code_off.find(off);
+    return it != harvest_->by_code_off.end() && harvest_->records[it->second].code_size == 0;
+}
+
+/* words of incoming arguments of a method: its parameters, and this unless it is static */
+u4 DexRebuilder::ins_size(u4 method_idx, u4 access_flags) const {
+    const DF::Header *header = tables_->header;
+    u4 ins = (access_flags & kAccStatic) != 0 ? 0 : 1;
+    if (method_idx >= header->method_ids_size_) {
+        return ins;
+    }
+    u4 proto_idx = tables_->method_ids[method_idx].proto_idx_;
+    if (proto_idx >= header->proto_ids_size_ || tables_->proto_ids[proto_idx].shorty_idx_ >= header->string_ids_size_) {
+        return ins;
+    }
+    /* the shorty: the return type, then a letter per parameter, J and D take two words */
+    const char *shorty = dex_string_by_idx(tables_, tables_->proto_ids[proto_idx].shorty_idx_);
+    for (const char *type = shorty[0] != '\0' ? shorty + 1 : shorty; *type != '\0'; type++) {
+        ins += *type == 'J' || *type == 'D' ? 2 : 1;
+    }
+    return ins;
+}
+
+/*
+ * A code_item for a method whose own the harvest couldn't read: a concrete method must have
+ * one for the dex to verify. const/4 v0, 0; throw v0, a NullPointerException if it is ever
+ * run; v0 is the one register below the arguments.
+ */
+u4 DexRebuilder::place_stub_code(u4 ins) {
+    std::vector<u1> &stub = stubs_[ins];
+    if (stub.empty()) {
+        /* registers, ins, outs, tries, debug_info_off (2 words), insns_size (2 words), insns */
+        const u2 words[10] = {(u2) (ins + 1), (u2) ins, 0, 0, 0, 0, 2, 0, 0x0012, 0x0027};
+        stub.assign((const u1 *) words, (const u1 *) words + sizeof(words));
+    }
+    bool is_new;
+    return place(kCodeItem, &stub[0], stub.size(), &is_new);
+}
+
+u4 DexRebuilder::copy_class_data(u4 off) {
+    const u1 *ptr = at(off);
+    std::unordered_map<const u1 *, u4>::iterator it = class_data_index_.find(ptr);
+    if (it != class_data_index_.end()) {
+        return it->second;
+    }
+    u4 index = class_data_.size();
+    class_data_index_[ptr] = index;
+    class_data_.push_back(PendingClassData());
+
+    PendingClassData pending;
+    u4 sizes[4];
+    for (int i = 0; i < 4; i++) {
+        sizes[i] = read_uleb128(&ptr);
+        pending.values.push_back(sizes[i]);
+        pending.is_code.push_back(false);
+    }
+    for (u4 i = 0; i < sizes[0] + sizes[1]; i++) {
+        pending.values.push_back(read_uleb128(&ptr));
+        pending.values.push_back(read_uleb128(&ptr));
+        pending.is_code.push_back(false);
+        pending.is_code.push_back(false);
+    }
+    u4 method_idx = 0;
+    for (u4 i = 0; i < sizes[2] + sizes[3]; i++) {
+        /* method_idx restarts from the diff for the virtual methods */
+        u4 idx_diff = read_uleb128(&ptr);
+        method_idx = i == sizes[2] ? idx_diff : method_idx + idx_diff;
+        u4 access_flags = read_uleb128(&ptr);
+        pending.values.push_back(idx_diff);
+        pending.values.push_back(access_flags);
+        pending.is_code.push_back(false);
+        pending.is_code.push_back(false);
+        u4 code_off = read_uleb128(&ptr);
+        if (code_off != 0 && code_lost(code_off)) {
+            stubbed_code_++;
+            pending.values.push_back(place_stub_code(ins_size(method_idx, access_flags)));
+            pending.is_code.push_back(true);
+        } else if (code_off != 0) {
+            pending.values.push_back(copy_code_item(code_off));
+            pending.is_code.push_back(true);
+        } else {
+            pending.values.push_back(0);
+            pending.is_code.push_back(false);
+        }
+    }
+    class_data_[index] = pending;
+    return index;
+}
+
+void DexRebuilder::build_ids() {
+    const DF::Header *header = tables_->header;
+    ids_.assign(DEX_HEADER_SIZE, 0);
+
+    for (u4 i = 0; i < header->string_ids_size_; i++) {
+        u4 pos = ids_.size();
+        ids_.resize(pos + 4, 0);
+        link(kIdsSection, pos, kStringData,
+             copy_simple(kStringData, tables_->string_ids[i].string_data_off_, string_data_size));
+    }
+
+    const u1 *type_ids = (const u1 *) tables_->type_ids;
+    ids_.insert(ids_.end(), type_ids, type_ids + header->type_ids_size_ * sizeof(DF::TypeId));
+
+    for (u4 i = 0; i < header->proto_ids_size_; i++) {
+        const DF::ProtoId *proto = &tables_->proto_ids[i];
+        u4 pos = ids_.size();
+        ids_.insert(ids_.end(), (const u1 *) proto, (const u1 *) (proto + 1));
+        put_u4(&ids_[pos + 8], 0);
+        if (proto->parameters_off_ != 0) {
+            link(kIdsSection, pos + 8, kTypeList,
+                 copy_simple(kTypeList, proto->parameters_off_, type_list_size));
+        }
+    }
+
+    const u1 *field_ids = (const u1 *) tables_->field_ids;
+    ids_.insert(ids_.end(), field_ids, field_ids + header->field_ids_size_ * sizeof(DF::FieldId));
+    const u1 *method_ids = (const u1 *) tables_->method_ids;
+    ids_.insert(ids_.end(), method_ids, method_ids + header->method_ids_size_ * sizeof(DF::MethodId));
+
+    for (u4 i = 0; i < header->class_defs_size_; i++) {
+        /* build() gives up on the half-copied dex */
+        if (job_cancelled()) {
+            return;
+        }
+        const DF::ClassDef *class_def = &tables_->class_defs[i];
+        u4 pos = ids_.size();
+        ids_.insert(ids_.end(), (const u1 *) class_def, (const u1 *) (class_def + 1));
+        memset(&ids_[pos + 12], 0, 4);
+        memset(&ids_[pos + 20], 0, 12);
+        if (class_def->interfaces_off_ != 0) {
+            link(kIdsSection, pos + 12, kTypeList,
+                 copy_simple(kTypeList, class_def->interfaces_off_, type_list_size));
+        }
+        if (class_def->annotations_off_ != 0) {
+            link(kIdsSection, pos + 20, kAnnotationsDirectory,
+                 copy_annotations_directory(class_def->annotations_off_));
+        }
+        if (class_def->class_data_off_ != 0) {
+            class_data_refs_.push_back(std::make_pair(pos + 24, copy_class_data(class_def->class_data_off_)));
+        }
+        if (class_def->static_values_off_ != 0) {
+            link(kIdsSection, pos + 28, kEncodedArray,
+                 copy_simple(kEncodedArray, class_def->static_values_off_, encoded_array_size));
+        }
+        job_progress_add(1);
+    }
+}
+
+/* code_off is an uleb128, so class_data can only be encoded once the code section is placed */
+void DexRebuilder::encode_class_data() {
+    std::vector<u1> &data = data_[kClassData];
+    for (size_t i = 0; i < class_data_.size(); i++) {
+        PendingClassData &pending = class_data_[i];
+        pending.rel = data.size();
+        for (size_t j = 0; j < pending.values.size(); j++) {
+            u4 value = pending.values[j];
+            write_uleb128(&data, pending.is_code[j] ? base_[kCodeItem] + value : value);
+        }
+    }
+    counts_[kClassData] = class_data_.size();
+    for (size_t i = 0; i < class_data_refs_.size(); i++) {
+        link(kIdsSection, class_data_refs_[i].first, kClassData,
+             class_data_[class_data_refs_[i].second].rel);
+    }
+}
+
+void DexRebuilder::write_map_list(u1 *dst, u4 map_off) {
+    const DF::Header *header = tables_->header;
+    std::vector<DF::MapItem> items;
+    DF::MapItem item;
+    item.unused_ = 0;
+
+    item.type_ = DF::kDexTypeHeaderItem;
+    item.size_ = 1;
+    item.offset_ = 0;
+    items.push_back(item);
+
+    const u4 ids_sizes[] = {header->string_ids_size_, header->type_ids_size_, header->proto_ids_size_,
+                            header->field_ids_size_, header->method_ids_size_, header->class_defs_size_};
+    const u4 ids_item_sizes[] = {4, 4, 12, 8, 8, 32};
+    const u2 ids_types[] = {DF::kDexTypeStringIdItem, DF::kDexTypeTypeIdItem, DF::kDexTypeProtoIdItem,
+                            DF::kDexTypeFieldIdItem, DF::kDexTypeMethodIdItem, DF::kDexTypeClassDefItem};
+    u4 offset = DEX_HEADER_SIZE;
+    for (int i = 0; i < 6; i++) {
+        if (ids_sizes[i] != 0) {
+            item.type_ = ids_types[i];
+            item.size_ = ids_sizes[i];
+            item.offset_ = offset;
+            items.push_back(item);
+        }
+        offset += ids_sizes[i] * ids_item_sizes[i];
+    }
+    for (int s = 0; s < kDataSectionCount; s++) {
+        if (counts_[s] != 0) {
+            item.type_ = kSectionInfo[s].map_type;
+            item.size_ = counts_[s];
+            item.offset_ = base_[s];
+            items.push_back(item);
+        }
+    }
+    item.type_ = DF::kDexTypeMapList;
+    item.size_ = 1;
+    item.offset_ = map_off;
+    items.push_back(item);
+
+    put_u4(dst, items.size());
+    memcpy(dst + 4, &items[0], items.size() * sizeof(DF::MapItem));
+}
+
+bool DexRebuilder::build(std::vector<u1> *out) {
+    const DF::Header *header = tables_->header;
+    if (header == NULL || tables_->base == NULL) {
+        LOGE("rebuild dex: no header");
+        return false;
+    }
+    if (header->string_ids_size_ > kMaxTableSize || header->type_ids_size_ > 0xffff ||
+        header->proto_ids_size_ > 0xffff || header->field_ids_size_ > kMaxTableSize ||
+        header->method_ids_size_ > kMaxTableSize || header->class_defs_size_ > 0xffff) {
+        LOGE("rebuild dex: the header looks broken");
+        return false;
+    }
+    job_progress_begin("classes", header->class_defs_size_);
+    build_ids();
+    if (job_cancelled()) {
+        LOGV("rebuild dex: cancelled");
+        return false;
+    }
+
+    u4 offset = ids_.size();
+    u4 data_off = offset;
+    for (int s = 0; s < kClassData; s++) {
+        if (counts_[s] == 0) {
+            continue;
+        }
+        offset = align_up(offset, 4);
+        base_[s] = offset;
+        offset += data_[s].size();
+    }
+    encode_class_data();
+    base_[kClassData] = offset;
+    offset += data_[kClassData].size();
+
+    u4 map_off = align_up(offset, 4);
+    u4 map_entries = 2 + 6 + kDataSectionCount;
+    out->assign(map_off + 4 + map_entries * sizeof(DF::MapItem), 0);
+    u1 *dst = &(*out)[0];
+    memcpy(dst, &ids_[0], ids_.size());
+    for (int s = 0; s < kDataSectionCount; s++) {
+        if (!data_[s].empty()) {
+            memcpy(dst + base_[s], &data_[s][0], data_[s].size());
+        }
+    }
+    write_map_list(dst + map_off, map_off);
+    u4 file_size = map_off + 4 + *(u4 *) (dst + map_off) * sizeof(DF::MapItem);
+    out->resize(file_size);
+    dst = &(*out)[0];
+
+    for (size_t i = 0; i < fixups_.size(); i++) {
+        const Fixup &fixup = fixups_[i];
+        u4 pos = fixup.section == kIdsSection ? fixup.pos : base_[fixup.section] + fixup.pos;
+        put_u4(dst + pos, base_[fixup.target] + fixup.target_rel);
+    }
+
+    DF::Header *new_header = (DF::Header *) dst;
+    if (memcmp(header->magic_, "dex\n", 4) == 0) {
+        memcpy(new_header->magic_, header->magic_, 8);
+    } else {
+        memcpy(new_header->magic_, "dex\n035", 8);
+    }
+    new_header->file_size_ = file_size;
+    new_header->header_size_ = DEX_HEADER_SIZE;
+    new_header->endian_tag_ = DEX_ENDIAN_CONSTANT;
+    new_header->map_off_ = map_off;
+    u4 ids_off = DEX_HEADER_SIZE;
+    new_header->string_ids_size_ = header->string_ids_size_;
+    new_header->string_ids_off_ = header->string_ids_size_ ? ids_off : 0;
+    ids_off += header->string_ids_size_ * 4;
+    new_header->type_ids_size_ = header->type_ids_size_;
+    new_header->type_ids_off_ = header->type_ids_size_ ? ids_off : 0;
+    ids_off += header->type_ids_size_ * 4;
+    new_header->proto_ids_size_ = header->proto_ids_size_;
+    new_header->proto_ids_off_ = header->proto_ids_size_ ? ids_off : 0;
+    ids_off += header->proto_ids_size_ * 12;
+    new_header->field_ids_size_ = header->field_ids_size_;
+    new_header->field_ids_off_ = header->field_ids_size_ ? ids_off : 0;
+    ids_off += header->field_ids_size_ * 8;
+    new_header->method_ids_size_ = header->method_ids_size_;
+    new_header->method_ids_off_ = header->method_ids_size_ ? ids_off : 0;
+    ids_off += header->method_ids_size_ * 8;
+    new_header->class_defs_size_ = header->class_defs_size_;
+    new_header->class_defs_off_ = header->class_defs_size_ ? ids_off : 0;
+    new_header->data_off_ = data_off;
+    new_header->data_size_ = file_size - data_off;
+
+    dex_fix_checksum(dst, file_size);
+    LOGV("rebuild dex: %u bytes, %u classes, %u code items", file_size, header->class_defs_size_,
+         counts_[kCodeItem]);
+    if (stubbed_code_ != 0) {
+        LOGE("rebuild dex: %u methods lost their unreadable code items to a throwing stub", stubbed_code_);
+    }
+    return true;
+}
+
+}  // namespace
+
+bool dex_rebuild(const dex_tables *tables, std::vector<u1> *out) {
+    DexRebuilder rebuilder(tables, NULL);
+    return rebuilder.build(out);
+}
+
+bool dex_rebuild_harvested(const dex_tables *tables, const code_harvest *harvest, std::vector<u1> *out,
+                           u4 *stubbed) {
+    DexRebuilder rebuilder(tables, harvest);
+    bool ok = rebuilder.build(out);
+    *stubbed = rebuilder.stubbed_code();
+    return ok;
+}
@@ -0,0 +1,22 @@
+#ifndef DEXREBUILD_H_
+#define DEXREBUILD_H_
+#include <vector>
+#include "dexparse.h"
+#include "codeharvest.h"
+
+/*
+ * Rebuild a standalone dex from the tables of a loaded one. Every item reachable from the
+ * id tables and class_defs is copied into a fresh contiguous layout, wherever it lives in
+ * memory, then map_list, offsets, checksum and signature are regenerated. Run as a job it
+ * counts the classes copied, and stops with false when the job is cancelled.
+ */
+bool dex_rebuild(const dex_tables *tables, std::vector<u1> *out);
+
+/*
+ * The same, taking the code_items a harvest copied out of place from the harvest instead of
+ * memory. Methods whose code_item the harvest couldn't read get a stub that throws, so the
+ * dex stays valid; stubbed is set to how many did.
+ */
+bool dex_rebuild_harvested(const dex_tables *tables, const code_harvest *harvest, std::vector<u1> *out,
+                           u4 *stubbed);
+#endif
@@ -0,0 +1,245 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <android/log.h>
+#include "dexscan.h"
+#include "dexparse.h"
+#include "mapsindex.h"
+#include "memread.h"
+#include "threadpool.h"
+#include "jobengine.h"
+
+/*
+ * Regions are cut into units so a single huge heap mapping still spreads over the threads,
+ * and a unit is read through a per-thread buffer so an unreadable page never faults.
+ */
+#define SCAN_UNIT_SIZE      (16 * 1024 * 1024)
+#define SCAN_BUFFER_SIZE    (1024 * 1024)
+/* consecutive reads overlap by the magic minus one byte, so no magic is cut in two */
+#define SCAN_MAGIC_SIZE     8
+#define SCAN_MAX_DEX_SIZE   (1024 * 1024 * 1024)
+#define SCAN_MAX_THREADS    16
+
+struct scan_region {
+    uintptr_t start;
+    uintptr_t end;
+    uintptr_t extent_end;   /* end of the run of adjacent readable regions this one is in */
+    const char *name;       /* interned by the maps index */
+};
+
+struct scan_unit {
+    uintptr_t start;
+    uintptr_t end;
+    size_t region;
+};
+
+struct scan_context {
+    std::vector<scan_region> regions;
+    std::vector<scan_unit> units;
+    volatile size_t next_unit;
+    u1 *buffers;
+    size_t page_size;
+    pthread_mutex_t lock;
+    std::vector<dex_scan_hit> *hits;
+};
+
+static bool section_fits(u4 size, u4 off, u4 item_size, u4 file_size) {
+    if (size == 0)
+        return true;
+    return off >= DEX_HEADER_SIZE && off < file_size &&
+           (u8) size * item_size <= (u8) (file_size - off);
+}
+
+bool dex_header_plausible(const art::DexFile::Header *header, size_t available) {
+    const u1 *magic = header->magic_;
+    if (memcmp(magic, "dex\n", 4) != 0 || magic[7] != 0)
+        return false;
+    for (int i = 4; i < 7; i++) {
+        if (magic[i] < '0' || magic[i] > '9')
+            return false;
+    }
+    u4 file_size = header->file_size_;
+    if (header->header_size_ != DEX_HEADER_SIZE || header->endian_tag_ != DEX_ENDIAN_CONSTANT)
+        return false;
+    if (file_size < DEX_HEADER_SIZE || file_size > available || file_size > SCAN_MAX_DEX_SIZE)
+        return false;
+    if (header->map_off_ < DEX_HEADER_SIZE || header->map_off_ >= file_size || (header->map_off_ & 3) != 0)
+        return false;
+    if ((u8) header->data_off_ + header->data_size_ > file_size)
+        return false;
+    return section_fits(header->string_ids_size_, header->string_ids_off_, 4, file_size) &&
+           section_fits(header->type_ids_size_, header->type_ids_off_, 4, file_size) &&
+           section_fits(header->proto_ids_size_, header->proto_ids_off_, 12, file_size) &&
+           section_fits(header->field_ids_size_, header->field_ids_off_, 8, file_size) &&
+           section_fits(header->method_ids_size_, header->method_ids_off_, 8, file_size) &&
+           section_fits(header->class_defs_size_, header->class_defs_off_, 32, file_size) &&
+           section_fits(header->link_size_, header->link_off_, 1, file_size);
+}
+
+static void add_scan_region(scan_context *ctx, uintptr_t start, uintptr_t end, const char *name) {
+    scan_region region;
+    region.start = start;
+    region.end = end;
+    region.extent_end = end;
+    region.name = name;
+    ctx->regions.push_back(region);
+}
+
+static void read_scan_regions(scan_context *ctx, uintptr_t skip_start, uintptr_t skip_end) {
+    std::vector<map_region> maps;
+    maps_snapshot(&maps);
+    for (size_t i = 0; i < maps.size(); i++) {
+        const map_region &map = maps[i];
+        if (!(map.perms & MAPS_PERM_READ) || maps_is_device(map.path))
+            continue;
+        /* anonymous mappings get merged, so the buffers may sit in the middle of a heap region */
+        if (map.start < skip_end && map.end > skip_start) {
+            if (map.start < skip_start)
+                add_scan_region(ctx, map.start, skip_start, map.path);
+            if (map.end > skip_end)
+                add_scan_region(ctx, skip_end, map.end, map.path);
+        } else {
+            add_scan_region(ctx, map.start, map.end, map.path);
+        }
+    }
+    /* a dex may run on into the next mapping (e.g. a different protection), so bound it by the run */
+    for (size_t i = ctx->regions.size(); i-- > 1;) {
+        if (ctx->regions[i - 1].end == ctx->regions[i].start)
+            ctx->regions[i - 1].extent_end = ctx->regions[i].extent_end;
+    }
+    for (size_t i = 0; i < ctx->regions.size(); i++) {
+        for (uintptr_t start = ctx->regions[i].start; start < ctx->regions[i].end; start += SCAN_UNIT_SIZE) {
+            scan_unit unit;
+            unit.start = start;
+            unit.end = std::min(start + SCAN_UNIT_SIZE, ctx->regions[i].end);
+            unit.region = i;
+            ctx->units.push_back(unit);
+        }
+    }
+}
+
+static void check_candidate(scan_context *ctx, const scan_region *region, uintptr_t addr,
+                            const u1 *data, size_t length) {
+    art::DexFile::Header header;
+    if (length >= sizeof(header)) {
+        memcpy(&header, data, sizeof(header));
+    } else if (mem_read((const void *) addr, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+        return;
+    }
+    if (!dex_header_plausible(&header, region->extent_end - addr))
+        return;
+    dex_scan_hit hit;
+    hit.addr = addr;
+    hit.file_size = header.file_size_;
+    hit.class_count = header.class_defs_size_;
+    hit.version = (header.magic_[4] - '0') * 100 + (header.magic_[5] - '0') * 10 + (header.magic_[6] - '0');
+    hit.mapping = region->name;
+    pthread_mutex_lock(&ctx->lock);
+    ctx->hits->push_back(hit);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/*
+ * 'x' is the rarest byte of "dex\n" in both code and text, so the (vectorized) memchr over
+ * it stops least often; the rest of the magic is checked around each stop.
+ */
+static void scan_buffer(scan_context *ctx, const scan_unit *unit, uintptr_t pos, const u1 *data, size_t length) {
+    if (length < SCAN_MAGIC_SIZE)
+        return;
+    const scan_region *region = &ctx->regions[unit->region];
+    const u1 *cursor = data + 2;
+    /*
+     * the last magic that fits starts at length - SCAN_MAGIC_SIZE, one byte before the next
+     * buffer (which overlaps this one by SCAN_MAGIC_SIZE - 1), so its 'x' must be searched too
+     */
+    const u1 *last = data + length - (SCAN_MAGIC_SIZE - 3);
+    while (cursor < last) {
+        const u1 *x = (const u1 *) memchr(cursor, 'x', last - cursor);
+        if (x == NULL)
+            break;
+        cursor = x + 1;
+        const u1 *magic = x - 2;
+        if (magic[0] != 'd' || magic[1] != 'e' || magic[3] != '\n' || magic[7] != 0)
+            continue;
+        uintptr_t addr = pos + (magic - data);
+        if (addr >= unit->end)
+            break;
+        check_candidate(ctx, region, addr, magic, data + length - magic);
+    }
+}
+
+static void scan_one_unit(scan_context *ctx, const scan_unit *unit, u1 *buffer) {
+    const scan_region *region = &ctx->regions[unit->region];
+    uintptr_t limit = std::min(unit->end + SCAN_MAGIC_SIZE - 1, region->extent_end);
+    uintptr_t pos = unit->start;
+    while (pos < unit->end) {
+        size_t want = std::min((uintptr_t) SCAN_BUFFER_SIZE, limit - pos);
+        ssize_t got = mem_read((const void *) pos, buffer, want);
+        if (got <= 0) {
+            pos = (pos & ~(ctx->page_size - 1)) + ctx->page_size;
+            continue;
+        }
+        scan_buffer(ctx, unit, pos, buffer, got);
+        if ((size_t) got < want) {
+            /* reads stop at the first bad page, which starts right after what we got */
+            pos += got + ctx->page_size;
+            continue;
+        }
+        if (pos + got >= limit)
+            break;
+        pos += got - (SCAN_MAGIC_SIZE - 1);
+    }
+}
+
+static void scan_worker(size_t index, void *arg) {
+    scan_context *ctx = (scan_context *) arg;
+    u1 *buffer = ctx->buffers + index * SCAN_BUFFER_SIZE;
+    for (;;) {
+        size_t unit = __sync_fetch_and_add(&ctx->next_unit, 1);
+        if (unit >= ctx->units.size() || job_cancelled())
+            break;
+        scan_one_unit(ctx, &ctx->units[unit], buffer);
+        job_progress_add(ctx->units[unit].end - ctx->units[unit].start);
+    }
+}
+
+static bool hit_before(const dex_scan_hit &a, const dex_scan_hit &b) {
+    return a.addr < b.addr;
+}
+
+bool dex_scan_process(int max_threads, std::vector<dex_scan_hit> *hits) {
+    if (max_threads <= 0)
+        max_threads = threadpool_cpu_count();
+    if (max_threads > SCAN_MAX_THREADS)
+        max_threads = SCAN_MAX_THREADS;
+
+    scan_context ctx;
+    ctx.next_unit = 0;
+    ctx.page_size = sysconf(_SC_PAGESIZE);
+    ctx.hits = hits;
+    /* the buffers hold copies of whatever they scan, so they are kept out of the scan */
+    size_t buffers_size = (size_t) max_threads * SCAN_BUFFER_SIZE;
+    void *buffers = mmap(NULL, buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        LOGE("map scan buffers failed: %s", strerror(errno));
+        return false;
+    }
+    ctx.buffers = (u1 *) buffers;
+    read_scan_regions(&ctx, (uintptr_t) buffers, (uintptr_t) buffers + buffers_size);
+    u8 total = 0;
+    for (size_t i = 0; i < ctx.units.size(); i++)
+        total += ctx.units[i].end - ctx.units[i].start;
+    job_progress_begin("bytes", total);
+    pthread_mutex_init(&ctx.lock, NULL);
+    parallel_for(max_threads, max_threads, scan_worker, &ctx);
+    pthread_mutex_destroy(&ctx.lock);
+    munmap(buffers, buffers_size);
+    /* a scan stopped halfway would pass for one that found fewer dex files */
+    if (job_cancelled())
+        return false;
+    std::sort(hits->begin(), hits->end(), hit_before);
+    return true;
+}
@@ -0,0 +1,31 @@
+#ifndef DEXSCAN_H_
+#define DEXSCAN_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "util.h"
+#include "dexfile_art.h"
+
+struct dex_scan_hit {
+    uintptr_t addr;
+    u4 file_size;
+    u4 class_count;
+    u4 version;             /* 35..39, from the magic */
+    std::string mapping;    /* name of the mapping the header is in, empty if anonymous */
+};
+
+/*
+ * Whether a header looks like the start of a real dex: magic, header_size, endian_tag and
+ * every section inside file_size, which must itself fit in the available bytes.
+ */
+bool dex_header_plausible(const art::DexFile::Header *header, size_t available);
+
+/*
+ * Scan every readable mapping of this process for dex headers on max_threads threads
+ * (<= 0: one per cpu). Device mappings and [vvar] are skipped, unreadable pages are
+ * stepped over. Hits come back sorted by address. Run as a job it reports the bytes scanned,
+ * and a cancelled scan returns false.
+ */
+bool dex_scan_process(int max_threads, std::vector<dex_scan_hit> *hits);
+#endif
@@ -0,0 +1,271 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cpu-features.h>
+#include "dexsum.h"
+#include "dexsum_simd.h"
+
+#define ADLER_BASE 65521
+/* largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits in 32 bits */
+#define ADLER_NMAX 5552
+
+u4 adler32_scalar(u4 adler, const u1 *data, size_t length) {
+    u4 a = adler & 0xffff;
+    u4 b = adler >> 16;
+    while (length > 0) {
+        size_t block = length < ADLER_NMAX ? length : ADLER_NMAX;
+        length -= block;
+        while (block--) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return (b << 16) | a;
+}
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_transform(u4 state[5], const u1 block[64]) {
+    u4 w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (u4) block[i * 4] << 24 | (u4) block[i * 4 + 1] << 16 |
+               (u4) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    u4 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        u4 f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        u4 temp = ROL32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL32(b, 30);
+        b = a;
+        a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void sha1_blocks_scalar(u4 state[5], const u1 *data, size_t blocks) {
+    while (blocks--) {
+        sha1_transform(state, data);
+        data += 64;
+    }
+}
+
+/*
+ * The kernels are picked once, from what cpufeatures reports for the running cpu, so an
+ * armeabi-v7a build without NEON hardware or an x86 emulator without SHA-NI still works.
+ */
+static u4 (*adler32_impl)(u4, const u1 *, size_t) = adler32_scalar;
+static void (*sha1_blocks_impl)(u4 *, const u1 *, size_t) = sha1_blocks_scalar;
+static const char *adler32_kernel = "scalar";
+static const char *sha1_kernel = "scalar";
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels() {
+    AndroidCpuFamily family = android_getCpuFamily();
+    uint64_t features = android_getCpuFeatures();
+#ifdef DEXSUM_NEON_KERNELS
+    if ((family == ANDROID_CPU_FAMILY_ARM && (features & ANDROID_CPU_ARM_FEATURE_NEON)) ||
+        (family == ANDROID_CPU_FAMILY_ARM64 && (features & ANDROID_CPU_ARM64_FEATURE_ASIMD))) {
+        adler32_impl = adler32_neon;
+        adler32_kernel = "neon";
+    }
+#endif
+#ifdef DEXSUM_ARMV8_SHA1_KERNEL
+    if (family == ANDROID_CPU_FAMILY_ARM64 && (features & ANDROID_CPU_ARM64_FEATURE_SHA1)) {
+        sha1_blocks_impl = sha1_blocks_armv8;
+        sha1_kernel = "armv8-sha1";
+    }
+#endif
+#ifdef DEXSUM_X86_KERNELS
+    if (family == ANDROID_CPU_FAMILY_X86 || family == ANDROID_CPU_FAMILY_X86_64) {
+        if (features & ANDROID_CPU_X86_FEATURE_SSSE3) {
+            adler32_impl = adler32_ssse3;
+            adler32_kernel = "ssse3";
+        }
+        if ((features & ANDROID_CPU_X86_FEATURE_SHA_NI) && (features & ANDROID_CPU_X86_FEATURE_SSE4_1)) {
+            sha1_blocks_impl = sha1_blocks_shani;
+            sha1_kernel = "sha-ni";
+        }
+    }
+#endif
+    LOGV("dexsum kernels: adler32=%s sha1=%s", adler32_kernel, sha1_kernel);
+}
+
+void dexsum_kernels(const char **adler, const char **sha1) {
+    pthread_once(&kernels_once, select_kernels);
+    *adler = adler32_kernel;
+    *sha1 = sha1_kernel;
+}
+
+u4 adler32(u4 adler, const u1 *data, size_t length) {
+    pthread_once(&kernels_once, select_kernels);
+    return adler32_impl(adler, data, length);
+}
+
+static const u4 sha1_iv[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+void sha1_init(sha1_ctx *ctx) {
+    pthread_once(&kernels_once, select_kernels);
+    memcpy(ctx->state, sha1_iv, sizeof(sha1_iv));
+    ctx->count = 0;
+}
+
+void sha1_update(sha1_ctx *ctx, const u1 *data, size_t length) {
+    size_t used = ctx->count & 63;
+    ctx->count += length;
+    if (used != 0) {
+        size_t fill = 64 - used;
+        if (length < fill) {
+            memcpy(ctx->buffer + used, data, length);
+            return;
+        }
+        memcpy(ctx->buffer + used, data, fill);
+        sha1_blocks_impl(ctx->state, ctx->buffer, 1);
+        data += fill;
+        length -= fill;
+    }
+    if (length >= 64) {
+        sha1_blocks_impl(ctx->state, data, length / 64);
+        data += length & ~(size_t) 63;
+        length &= 63;
+    }
+    memcpy(ctx->buffer, data, length);
+}
+
+void sha1_final(sha1_ctx *ctx, u1 digest[SHA1_DIGEST_SIZE]) {
+    u8 bits = ctx->count << 3;
+    u1 pad[72];
+    size_t used = ctx->count & 63;
+    size_t padlen = (used < 56) ? 56 - used : 120 - used;
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        pad[padlen + i] = (u1) (bits >> (56 - i * 8));
+    }
+    sha1_update(ctx, pad, padlen + 8);
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (u1) (ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (u1) (ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (u1) (ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (u1) ctx->state[i];
+    }
+}
+
+/* header layout: magic[8], checksum u4, signature[20], file_size ... */
+void dex_compute_checksum(const u1 *dex, size_t length, u4 *checksum, u1 signature[SHA1_DIGEST_SIZE]) {
+    sha1_ctx ctx;
+    sha1_init(&ctx);
+    sha1_update(&ctx, dex + 32, length - 32);
+    sha1_final(&ctx, signature);
+    /* the checksum covers the new signature, so it has to be chained after it */
+    u4 adler = adler32(1, signature, SHA1_DIGEST_SIZE);
+    *checksum = adler32(adler, dex + 32, length - 32);
+}
+
+void dex_fix_checksum(u1 *dex, size_t length) {
+    u4 checksum;
+    dex_compute_checksum(dex, length, &checksum, dex + 12);
+    memcpy(dex + 8, &checksum, 4);
+}
+
+int dex_verify_checksum(const u1 *dex, size_t length) {
+    u4 checksum;
+    u1 signature[SHA1_DIGEST_SIZE];
+    dex_compute_checksum(dex, length, &checksum, signature);
+    int status = 0;
+    if (memcmp(dex + 8, &checksum, 4) != 0)
+        status |= DEX_CHECKSUM_STALE;
+    if (memcmp(dex + 12, signature, SHA1_DIGEST_SIZE) != 0)
+        status |= DEX_SIGNATURE_STALE;
+    return status;
+}
+
+/*
+ * Find the dex image in a dumped region: a plain dex starts at 0, an odex ("dey\n") points at
+ * it from its opt header. The length comes from file_size_, clamped to the region.
+ */
+bool dex_locate_image(const u1 *data, size_t length, size_t *offset, size_t *dex_length) {
+    size_t start = 0;
+    if (length >= 40 && memcmp(data, "dey\n", 4) == 0) {
+        u4 dex_offset;
+        memcpy(&dex_offset, data + 8, 4);
+        start = dex_offset;
+    }
+    if (start > length || length - start < 0x70 || memcmp(data + start, "dex\n", 4) != 0) {
+        LOGE("no dex magic in the region (%02x %02x %02x %02x)", data[0], data[1], data[2], data[3]);
+        return false;
+    }
+    u4 file_size;
+    memcpy(&file_size, data + start + 32, 4);
+    if (file_size < 0x70 || file_size > length - start) {
+        LOGE("dex file_size %u does not fit the region (%u)", file_size, (unsigned int) (length - start));
+        return false;
+    }
+    *offset = start;
+    *dex_length = file_size;
+    return true;
+}
+
+static u8 dexsum_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+bool dexsum_benchmark(size_t length, u8 elapsed_ns[4]) {
+    u1 *buffer = (u1 *) malloc(length);
+    if (buffer == NULL)
+        return false;
+    u4 seed = 0x12345678;
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        buffer[i] = (u1) (seed >> 16);
+    }
+    pthread_once(&kernels_once, select_kernels);
+    u4 fast_state[5];
+    u4 slow_state[5];
+    memcpy(fast_state, sha1_iv, sizeof(sha1_iv));
+    memcpy(slow_state, sha1_iv, sizeof(sha1_iv));
+    u8 start = dexsum_now_ns();
+    u4 fast_adler = adler32_impl(1, buffer, length);
+    elapsed_ns[0] = dexsum_now_ns() - start;
+    start = dexsum_now_ns();
+    sha1_blocks_impl(fast_state, buffer, length / 64);
+    elapsed_ns[1] = dexsum_now_ns() - start;
+    start = dexsum_now_ns();
+    u4 slow_adler = adler32_scalar(1, buffer, length);
+    elapsed_ns[2] = dexsum_now_ns() - start;
+    start = dexsum_now_ns();
+    sha1_blocks_scalar(slow_state, buffer, length / 64);
+    elapsed_ns[3] = dexsum_now_ns() - start;
+    free(buffer);
+    if (fast_adler != slow_adler || memcmp(fast_state, slow_state, sizeof(fast_state)) != 0) {
+        LOGE("dexsum kernels disagree with the scalar code: %s/%s", adler32_kernel, sha1_kernel);
+        return false;
+    }
+    return true;
+}
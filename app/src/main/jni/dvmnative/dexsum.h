@@ -0,0 +1,46 @@
+#ifndef DEXSUM_H_
+#define DEXSUM_H_
+#include <stddef.h>
+#include <stdint.h>
+#include "util.h"
+
+#define SHA1_DIGEST_SIZE 20
+
+struct sha1_ctx {
+    u4 state[5];
+    u8 count;
+    u1 buffer[64];
+};
+
+u4 adler32(u4 adler, const u1 *data, size_t length);
+
+void sha1_init(sha1_ctx *ctx);
+void sha1_update(sha1_ctx *ctx, const u1 *data, size_t length);
+void sha1_final(sha1_ctx *ctx, u1 digest[SHA1_DIGEST_SIZE]);
+
+/* names of the adler32/sha1 kernels picked for this cpu, for the logs */
+void dexsum_kernels(const char **adler, const char **sha1);
+
+/* checksum and signature a dex image should carry, the header itself is not touched */
+void dex_compute_checksum(const u1 *dex, size_t length, u4 *checksum, u1 signature[SHA1_DIGEST_SIZE]);
+
+/*
+ * Recompute the checksum (adler32 of everything after it) and the signature
+ * (sha1 of everything after it) of a dex image in place.
+ */
+void dex_fix_checksum(u1 *dex, size_t length);
+
+/* dex_verify_checksum() status bits, 0 means the header is up to date */
+#define DEX_CHECKSUM_STALE   1
+#define DEX_SIGNATURE_STALE  2
+int dex_verify_checksum(const u1 *dex, size_t length);
+
+/* offset and length of the dex image inside a dumped dex or odex */
+bool dex_locate_image(const u1 *data, size_t length, size_t *offset, size_t *dex_length);
+
+/*
+ * Time the selected kernels against the scalar ones over length bytes of noise:
+ * {adler32, sha1, scalar adler32, scalar sha1} in ns. Fails if the results differ.
+ */
+bool dexsum_benchmark(size_t length, u8 elapsed_ns[4]);
+#endif
@@ -0,0 +1,240 @@
+#include "dexsum_simd.h"
+
+#define ADLER_BASE 65521
+#define ADLER_NMAX 5552
+/* bytes per vector iteration; NMAX / BLOCK iterations keep every lane from overflowing */
+#define ADLER_BLOCK 32
+
+#ifdef DEXSUM_NEON_KERNELS
+#include <arm_neon.h>
+
+/*
+ * s1 is a plain byte sum. s2 gains 32 * s1 per block plus the bytes of the block weighted
+ * 32..1, so the per-column byte sums are kept in u16 lanes and weighted once per NMAX run.
+ */
+u4 adler32_neon(u4 adler, const u1 *data, size_t length) {
+    u4 s1 = adler & 0xffff;
+    u4 s2 = adler >> 16;
+    size_t blocks = length / ADLER_BLOCK;
+    length -= blocks * ADLER_BLOCK;
+    static const u2 taps[32] = {32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+    while (blocks) {
+        size_t n = ADLER_NMAX / ADLER_BLOCK;
+        if (n > blocks)
+            n = blocks;
+        blocks -= n;
+        u4 init[4] = {0, 0, 0, s1 * (u4) n};
+        uint32x4_t v_s2 = vld1q_u32(init);
+        uint32x4_t v_s1 = vdupq_n_u32(0);
+        uint16x8_t col1 = vdupq_n_u16(0);
+        uint16x8_t col2 = vdupq_n_u16(0);
+        uint16x8_t col3 = vdupq_n_u16(0);
+        uint16x8_t col4 = vdupq_n_u16(0);
+        do {
+            uint8x16_t bytes1 = vld1q_u8(data);
+            uint8x16_t bytes2 = vld1q_u8(data + 16);
+            v_s2 = vaddq_u32(v_s2, v_s1);
+            v_s1 = vpadalq_u16(v_s1, vpadalq_u8(vpaddlq_u8(bytes1), bytes2));
+            col1 = vaddw_u8(col1, vget_low_u8(bytes1));
+            col2 = vaddw_u8(col2, vget_high_u8(bytes1));
+            col3 = vaddw_u8(col3, vget_low_u8(bytes2));
+            col4 = vaddw_u8(col4, vget_high_u8(bytes2));
+            data += ADLER_BLOCK;
+        } while (--n);
+        v_s2 = vshlq_n_u32(v_s2, 5);
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(col1), vld1_u16(taps));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(col1), vld1_u16(taps + 4));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(col2), vld1_u16(taps + 8));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(col2), vld1_u16(taps + 12));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(col3), vld1_u16(taps + 16));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(col3), vld1_u16(taps + 20));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(col4), vld1_u16(taps + 24));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(col4), vld1_u16(taps + 28));
+        uint32x2_t sum1 = vpadd_u32(vget_low_u32(v_s1), vget_high_u32(v_s1));
+        uint32x2_t sum2 = vpadd_u32(vget_low_u32(v_s2), vget_high_u32(v_s2));
+        uint32x2_t s1s2 = vpadd_u32(sum1, sum2);
+        s1 += vget_lane_u32(s1s2, 0);
+        s2 += vget_lane_u32(s1s2, 1);
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+    }
+    return adler32_scalar((s2 << 16) | s1, data, length);
+}
+#endif
+
+#ifdef DEXSUM_ARMV8_SHA1_KERNEL
+/*
+ * Four rounds per step. Step g consumes the message words of group g (in tmp[g & 1], with
+ * the round constant added), prepares tmp for group g + 2 and extends the schedule with
+ * sha1su0/sha1su1 so msg[g & 3] holds group g + 4 once step g + 1 is done.
+ */
+#define SHA1_K0 0x5a827999
+#define SHA1_K1 0x6ed9eba1
+#define SHA1_K2 0x8f1bbcdc
+#define SHA1_K3 0xca62c1d6
+#define SHA1_K(g) ((g) < 5 ? SHA1_K0 : (g) < 10 ? SHA1_K1 : (g) < 15 ? SHA1_K2 : SHA1_K3)
+
+#define SHA1_ROUNDS(OP, g, e_in, e_out)                                                 \
+    e_out = vsha1h_u32(vgetq_lane_u32(abcd, 0));                                        \
+    abcd = OP(abcd, e_in, tmp[(g) & 1]);                                                \
+    if ((g) <= 17)                                                                      \
+        tmp[(g) & 1] = vaddq_u32(msg[((g) + 2) & 3], vdupq_n_u32(SHA1_K((g) + 2)));     \
+    if ((g) >= 1 && (g) <= 16)                                                          \
+        msg[((g) + 3) & 3] = vsha1su1q_u32(msg[((g) + 3) & 3], msg[((g) + 2) & 3]);     \
+    if ((g) <= 15)                                                                      \
+        msg[(g) & 3] = vsha1su0q_u32(msg[(g) & 3], msg[((g) + 1) & 3], msg[((g) + 2) & 3]);
+
+void sha1_blocks_armv8(u4 state[5], const u1 *data, size_t blocks) {
+    uint32x4_t abcd = vld1q_u32(state);
+    u4 e0 = state[4];
+    u4 e1;
+    while (blocks--) {
+        uint32x4_t abcd_saved = abcd;
+        u4 e0_saved = e0;
+        uint32x4_t msg[4];
+        uint32x4_t tmp[2];
+        for (int i = 0; i < 4; i++)
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+        tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(SHA1_K0));
+        tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(SHA1_K0));
+
+        SHA1_ROUNDS(vsha1cq_u32, 0, e0, e1)
+        SHA1_ROUNDS(vsha1cq_u32, 1, e1, e0)
+        SHA1_ROUNDS(vsha1cq_u32, 2, e0, e1)
+        SHA1_ROUNDS(vsha1cq_u32, 3, e1, e0)
+        SHA1_ROUNDS(vsha1cq_u32, 4, e0, e1)
+        SHA1_ROUNDS(vsha1pq_u32, 5, e1, e0)
+        SHA1_ROUNDS(vsha1pq_u32, 6, e0, e1)
+        SHA1_ROUNDS(vsha1pq_u32, 7, e1, e0)
+        SHA1_ROUNDS(vsha1pq_u32, 8, e0, e1)
+        SHA1_ROUNDS(vsha1pq_u32, 9, e1, e0)
+        SHA1_ROUNDS(vsha1mq_u32, 10, e0, e1)
+        SHA1_ROUNDS(vsha1mq_u32, 11, e1, e0)
+        SHA1_ROUNDS(vsha1mq_u32, 12, e0, e1)
+        SHA1_ROUNDS(vsha1mq_u32, 13, e1, e0)
+        SHA1_ROUNDS(vsha1mq_u32, 14, e0, e1)
+        SHA1_ROUNDS(vsha1pq_u32, 15, e1, e0)
+        SHA1_ROUNDS(vsha1pq_u32, 16, e0, e1)
+        SHA1_ROUNDS(vsha1pq_u32, 17, e1, e0)
+        SHA1_ROUNDS(vsha1pq_u32, 18, e0, e1)
+        SHA1_ROUNDS(vsha1pq_u32, 19, e1, e0)
+
+        e0 += e0_saved;
+        abcd = vaddq_u32(abcd_saved, abcd);
+        data += 64;
+    }
+    vst1q_u32(state, abcd);
+    state[4] = e0;
+}
+#endif
+
+#ifdef DEXSUM_X86_KERNELS
+#include <immintrin.h>
+
+/*
+ * Same split as the NEON kernel: psadbw gives s1, pmaddubsw against the 32..1 taps gives the
+ * weighted part of s2, and the running s1 of every earlier block is added back as ps << 5.
+ */
+__attribute__((target("ssse3")))
+u4 adler32_ssse3(u4 adler, const u1 *data, size_t length) {
+    u4 s1 = adler & 0xffff;
+    u4 s2 = adler >> 16;
+    size_t blocks = length / ADLER_BLOCK;
+    length -= blocks * ADLER_BLOCK;
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    while (blocks) {
+        size_t n = ADLER_NMAX / ADLER_BLOCK;
+        if (n > blocks)
+            n = blocks;
+        blocks -= n;
+        __m128i v_ps = _mm_set_epi32(0, 0, 0, (int) (s1 * (u4) n));
+        __m128i v_s2 = _mm_set_epi32(0, 0, 0, (int) s2);
+        __m128i v_s1 = _mm_setzero_si128();
+        do {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *) data);
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i *) (data + 16));
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+            data += ADLER_BLOCK;
+        } while (--n);
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (u4) _mm_cvtsi128_si32(v_s1);
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (u4) _mm_cvtsi128_si32(v_s2);
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+    }
+    return adler32_scalar((s2 << 16) | s1, data, length);
+}
+
+/*
+ * Four rounds per step. Step g runs sha1rnds4 on group g (folded into e by sha1nexte) and
+ * pushes the schedule forward: msg2 finishes group g + 1's successor, msg1 starts group
+ * g + 3's, and the xor carries the w[i-8] term between the two.
+ */
+#define SHANI_ROUNDS(g, e_in, e_out)                                                    \
+    if ((g) == 0)                                                                       \
+        e_in = _mm_add_epi32(e_in, msg[0]);                                             \
+    else                                                                                \
+        e_in = _mm_sha1nexte_epu32(e_in, msg[(g) & 3]);                                 \
+    e_out = abcd;                                                                       \
+    if ((g) >= 3 && (g) <= 18)                                                          \
+        msg[((g) + 1) & 3] = _mm_sha1msg2_epu32(msg[((g) + 1) & 3], msg[(g) & 3]);      \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_in, (g) / 5);                                    \
+    if ((g) >= 1 && (g) <= 16)                                                          \
+        msg[((g) + 3) & 3] = _mm_sha1msg1_epu32(msg[((g) + 3) & 3], msg[(g) & 3]);      \
+    if ((g) >= 2 && (g) <= 17)                                                          \
+        msg[((g) + 2) & 3] = _mm_xor_si128(msg[((g) + 2) & 3], msg[(g) & 3]);
+
+__attribute__((target("sha,sse4.1")))
+void sha1_blocks_shani(u4 state[5], const u1 *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+    __m128i e0 = _mm_set_epi32((int) state[4], 0, 0, 0);
+    __m128i e1;
+    while (blocks--) {
+        __m128i abcd_saved = abcd;
+        __m128i e0_saved = e0;
+        __m128i msg[4];
+        for (int i = 0; i < 4; i++)
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + i * 16)), mask);
+
+        SHANI_ROUNDS(0, e0, e1)
+        SHANI_ROUNDS(1, e1, e0)
+        SHANI_ROUNDS(2, e0, e1)
+        SHANI_ROUNDS(3, e1, e0)
+        SHANI_ROUNDS(4, e0, e1)
+        SHANI_ROUNDS(5, e1, e0)
+        SHANI_ROUNDS(6, e0, e1)
+        SHANI_ROUNDS(7, e1, e0)
+        SHANI_ROUNDS(8, e0, e1)
+        SHANI_ROUNDS(9, e1, e0)
+        SHANI_ROUNDS(10, e0, e1)
+        SHANI_ROUNDS(11, e1, e0)
+        SHANI_ROUNDS(12, e0, e1)
+        SHANI_ROUNDS(13, e1, e0)
+        SHANI_ROUNDS(14, e0, e1)
+        SHANI_ROUNDS(15, e1, e0)
+        SHANI_ROUNDS(16, e0, e1)
+        SHANI_ROUNDS(17, e1, e0)
+        SHANI_ROUNDS(18, e0, e1)
+        SHANI_ROUNDS(19, e1, e0)
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_saved);
+        abcd = _mm_add_epi32(abcd, abcd_saved);
+        data += 64;
+    }
+    _mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = (u4) _mm_extract_epi32(e0, 3);
+}
+#endif
@@ -0,0 +1,38 @@
+#ifndef DEXSUM_SIMD_H_
+#define DEXSUM_SIMD_H_
+#include <stddef.h>
+#include <stdint.h>
+#include "util.h"
+
+/*
+ * Vector kernels behind adler32() and sha1_update(). They are compiled per ABI in
+ * dexsum_simd.cpp and only called once cpufeatures has confirmed the instructions exist.
+ * That file is a library of its own, built with NEON on armeabi-v7a and the crypto
+ * extension on arm64-v8a while the rest of the module stays baseline, so the availability
+ * checks below key off the ABI, not __ARM_NEON__.
+ */
+#if defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH_7A__))
+#define DEXSUM_NEON_KERNELS 1
+#endif
+#if defined(__aarch64__)
+#define DEXSUM_ARMV8_SHA1_KERNEL 1
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+#define DEXSUM_X86_KERNELS 1
+#endif
+
+#ifdef DEXSUM_NEON_KERNELS
+u4 adler32_neon(u4 adler, const u1 *data, size_t length);
+#endif
+#ifdef DEXSUM_ARMV8_SHA1_KERNEL
+void sha1_blocks_armv8(u4 state[5], const u1 *data, size_t blocks);
+#endif
+#ifdef DEXSUM_X86_KERNELS
+u4 adler32_ssse3(u4 adler, const u1 *data, size_t length);
+void sha1_blocks_shani(u4 state[5], const u1 *data, size_t blocks);
+#endif
+
+/* scalar tails and fallbacks, defined in dexsum.cpp */
+u4 adler32_scalar(u4 adler, const u1 *data, size_t length);
+void sha1_blocks_scalar(u4 state[5], const u1 *data, size_t blocks);
+#endif
@@ -0,0 +1,272 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <android/log.h>
+#include "dumpdelta.h"
+#include "dexsum.h"
+#include "dumpfile.h"
+#include "memread.h"
+
+#define PAGEMAP_SOFT_DIRTY  (1ULL << 55)
+#define CLEAR_SOFT_DIRTY    "4"
+/* pages read per mem_read while writing round 0 */
+#define DELTA_BASE_PAGES    256
+
+struct dump_delta_tracker {
+    uintptr_t addr;
+    size_t length;
+    uintptr_t first_page;           /* page holding addr */
+    size_t page_size;
+    std::vector<u4> hashes;         /* per page, of the bytes inside the region */
+    u4 round;
+    u4 clear_generation;            /* of the clear that started this round, 0: none */
+};
+
+static pthread_once_t soft_dirty_once = PTHREAD_ONCE_INIT;
+static bool soft_dirty_works = false;
+/*
+ * clear_refs resets the bits of the whole process, so every clear starts a new generation;
+ * a tracker whose round didn't start with the latest clear can't trust the bits.
+ */
+static pthread_mutex_t clear_lock = PTHREAD_MUTEX_INITIALIZER;
+static u4 clear_generation = 0;
+
+static bool clear_soft_dirty() {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0)
+        return false;
+    bool ok = write(fd, CLEAR_SOFT_DIRTY, 1) == 1;
+    close(fd);
+    return ok;
+}
+
+static bool read_pagemap(uintptr_t page, size_t pages, size_t page_size, u8 *entries) {
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd < 0)
+        return false;
+    size_t length = pages * sizeof(u8);
+    ssize_t got = pread(fd, entries, length, (off_t) (page / page_size * sizeof(u8)));
+    close(fd);
+    return got == (ssize_t) length;
+}
+
+/* a page written to after a clear must show the bit, one left alone must not */
+static void probe_soft_dirty() {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    void *page = mmap(NULL, page_size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED)
+        return;
+    memset(page, 1, page_size * 2);
+    u8 entries[2];
+    if (clear_soft_dirty()) {
+        ((volatile u1 *) page)[0] = 2;
+        soft_dirty_works = read_pagemap((uintptr_t) page, 2, page_size, entries) &&
+                           (entries[0] & PAGEMAP_SOFT_DIRTY) && !(entries[1] & PAGEMAP_SOFT_DIRTY);
+    }
+    munmap(page, page_size * 2);
+    LOGV("soft-dirty tracking %s", soft_dirty_works ? "works" : "is not available");
+}
+
+bool dump_delta_soft_dirty() {
+    pthread_once(&soft_dirty_once, probe_soft_dirty);
+    return soft_dirty_works;
+}
+
+/* start a round: the bits say what was written since the previous start */
+static u4 start_round() {
+    if (!dump_delta_soft_dirty())
+        return 0;
+    pthread_mutex_lock(&clear_lock);
+    u4 generation = clear_soft_dirty() ? ++clear_generation : 0;
+    pthread_mutex_unlock(&clear_lock);
+    return generation;
+}
+
+static size_t page_count(const dump_delta_tracker *tracker) {
+    uintptr_t end = tracker->addr + tracker->length;
+    return (end - tracker->first_page + tracker->page_size - 1) / tracker->page_size;
+}
+
+/* the part of page i inside the region */
+static void page_span(const dump_delta_tracker *tracker, size_t i, uintptr_t *start, size_t *length) {
+    uintptr_t page = tracker->first_page + i * tracker->page_size;
+    uintptr_t end = std::min(page + tracker->page_size, tracker->addr + tracker->length);
+    *start = std::max(page, tracker->addr);
+    *length = end - *start;
+}
+
+/* unreadable bytes read as zeros: a page that comes back later still differs */
+static void read_region(uintptr_t start, u1 *buffer, size_t length) {
+    ssize_t got = mem_read((const void *) start, buffer, length);
+    if (got < 0)
+        got = 0;
+    if ((size_t) got < length)
+        memset(buffer + got, 0, length - got);
+}
+
+static bool write_all(int fd, const void *data, size_t length) {
+    struct dump_result result;
+    return dump_region_to_fd(fd, data, length, DUMP_FSYNC_NONE, &result);
+}
+
+static void fill_header(const dump_delta_tracker *tracker, u4 round, u4 records, bool soft_dirty,
+                        dump_delta_header *header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, DUMP_DELTA_MAGIC, sizeof(header->magic));
+    header->region_addr = tracker->addr;
+    header->region_length = tracker->length;
+    header->round = round;
+    header->page_size = tracker->page_size;
+    header->record_count = records;
+    header->soft_dirty = soft_dirty;
+}
+
+dump_delta_tracker *dump_delta_begin(const void *addr, size_t length, const char *path, dump_delta_stats *stats) {
+    u8 start = dump_now_ns();
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        LOGE("open %s failed: %s", path, strerror(errno));
+        return NULL;
+    }
+    dump_delta_tracker *tracker = new dump_delta_tracker;
+    tracker->addr = (uintptr_t) addr;
+    tracker->length = length;
+    tracker->page_size = sysconf(_SC_PAGESIZE);
+    tracker->first_page = tracker->addr & ~(tracker->page_size - 1);
+    tracker->round = 0;
+    tracker->hashes.resize(page_count(tracker));
+    /* the bits from here on belong to round 1 */
+    tracker->clear_generation = start_round();
+
+    dump_delta_header header;
+    fill_header(tracker, 0, 1, false, &header);
+    dump_delta_record record;
+    record.offset = 0;
+    record.length = length;
+    record.adler32 = 1;
+    bool ok = write_all(fd, &header, sizeof(header)) && write_all(fd, &record, sizeof(record));
+    std::vector<u1> buffer(DELTA_BASE_PAGES * tracker->page_size);
+    for (size_t i = 0; ok && i < tracker->hashes.size(); i += DELTA_BASE_PAGES) {
+        uintptr_t chunk_start;
+        size_t chunk_length, last_length;
+        uintptr_t last_start;
+        size_t pages = std::min((size_t) DELTA_BASE_PAGES, tracker->hashes.size() - i);
+        page_span(tracker, i, &chunk_start, &chunk_length);
+        page_span(tracker, i + pages - 1, &last_start, &last_length);
+        chunk_length = last_start + last_length - chunk_start;
+        read_region(chunk_start, &buffer[0], chunk_length);
+        for (size_t page = i; page < i + pages; page++) {
+            uintptr_t page_start;
+            size_t page_length;
+            page_span(tracker, page, &page_start, &page_length);
+            tracker->hashes[page] = adler32(1, &buffer[page_start - chunk_start], page_length);
+        }
+        record.adler32 = adler32(record.adler32, &buffer[0], chunk_length);
+        ok = write_all(fd, &buffer[0], chunk_length);
+    }
+    ok = ok && pwrite(fd, &record, sizeof(record), sizeof(header)) == (ssize_t) sizeof(record);
+    close(fd);
+    if (!ok) {
+        LOGE("write %s failed: %s", path, strerror(errno));
+        delete tracker;
+        return NULL;
+    }
+    memset(stats, 0, sizeof(*stats));
+    stats->pages_read = tracker->hashes.size();
+    stats->pages_changed = tracker->hashes.size();
+    stats->bytes = sizeof(header) + sizeof(record) + length;
+    stats->soft_dirty = tracker->clear_generation != 0;
+    stats->elapsed_ns = dump_now_ns() - start;
+    return tracker;
+}
+
+bool dump_delta_next(dump_delta_tracker *tracker, const char *path, dump_delta_stats *stats) {
+    u8 start = dump_now_ns();
+    /* before the hashes move on, so a file that can't be created loses nothing */
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        LOGE("open %s failed: %s", path, strerror(errno));
+        return false;
+    }
+    size_t pages = tracker->hashes.size();
+    std::vector<u8> entries;
+    /* the bits have to be read before the clear, the pages after it: a write in between shows next round */
+    pthread_mutex_lock(&clear_lock);
+    bool soft_dirty = tracker->clear_generation != 0 && tracker->clear_generation == clear_generation;
+    if (soft_dirty) {
+        entries.resize(pages);
+        soft_dirty = read_pagemap(tracker->first_page, pages, tracker->page_size, &entries[0]);
+    }
+    pthread_mutex_unlock(&clear_lock);
+    u4 generation = start_round();
+    u4 round = tracker->round + 1;
+
+    memset(stats, 0, sizeof(*stats));
+    std::vector<u1> page(tracker->page_size);
+    std::vector<dump_delta_record> records;
+    std::vector<u1> data;
+    /* (page, hash) of the changed pages, kept aside until the round is on disk */
+    std::vector<std::pair<size_t, u4> > changed;
+    for (size_t i = 0; i < pages; i++) {
+        if (soft_dirty && !(entries[i] & PAGEMAP_SOFT_DIRTY))
+            continue;
+        uintptr_t page_start;
+        size_t page_length;
+        page_span(tracker, i, &page_start, &page_length);
+        read_region(page_start, &page[0], page_length);
+        stats->pages_read++;
+        u4 hash = adler32(1, &page[0], page_length);
+        if (hash == tracker->hashes[i])
+            continue;
+        changed.push_back(std::make_pair(i, hash));
+        stats->pages_changed++;
+        u8 offset = page_start - tracker->addr;
+        /* neighbouring pages are one record */
+        if (!records.empty() && records.back().offset + records.back().length == offset) {
+            records.back().length += page_length;
+        } else {
+            dump_delta_record record;
+            record.offset = offset;
+            record.length = page_length;
+            records.push_back(record);
+        }
+        data.insert(data.end(), page.begin(), page.begin() + page_length);
+    }
+
+    dump_delta_header header;
+    fill_header(tracker, round, records.size(), soft_dirty, &header);
+    bool ok = write_all(fd, &header, sizeof(header));
+    size_t data_offset = 0;
+    for (size_t i = 0; ok && i < records.size(); i++) {
+        records[i].adler32 = adler32(1, &data[data_offset], records[i].length);
+        ok = write_all(fd, &records[i], sizeof(records[i])) && write_all(fd, &data[data_offset], records[i].length);
+        data_offset += records[i].length;
+    }
+    close(fd);
+    if (!ok) {
+        LOGE("write %s failed: %s", path, strerror(errno));
+        /*
+         * the clear above already dropped the bits of the pages this round saw, so the next
+         * round hashes every page, against the hashes of the last round that was written
+         */
+        tracker->clear_generation = 0;
+        return false;
+    }
+    tracker->clear_generation = generation;
+    tracker->round = round;
+    for (size_t i = 0; i < changed.size(); i++)
+        tracker->hashes[changed[i].first] = changed[i].second;
+    stats->round = round;
+    stats->bytes = sizeof(header) + records.size() * sizeof(dump_delta_record) + data.size();
+    stats->soft_dirty = soft_dirty;
+    stats->elapsed_ns = dump_now_ns() - start;
+    return true;
+}
+
+void dump_delta_end(dump_delta_tracker *tracker) {
+    delete tracker;
+}
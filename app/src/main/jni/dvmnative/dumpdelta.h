@@ -0,0 +1,61 @@
+#ifndef DUMPDELTA_H_
+#define DUMPDELTA_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "util.h"
+
+#define DUMP_DELTA_MAGIC    "dexdlt1"
+
+/*
+ * A delta file: the header, then record_count records, each a dump_delta_record followed
+ * by its length bytes. Round 0 is the whole region as one record; merging is writing every
+ * record of rounds 0..n at its offset, in round order.
+ */
+struct dump_delta_header {
+    char magic[8];
+    u8 region_addr;
+    u8 region_length;
+    u4 round;
+    u4 page_size;
+    u4 record_count;
+    u4 soft_dirty;                  /* 1 if this round only looked at soft-dirty pages */
+};
+
+struct dump_delta_record {
+    u8 offset;                      /* from region_addr */
+    u4 length;
+    u4 adler32;                     /* of the data that follows */
+};
+
+struct dump_delta_stats {
+    u4 round;
+    u4 pages_read;                  /* pages hashed this round */
+    u4 pages_changed;
+    u8 bytes;                       /* written to the delta file */
+    bool soft_dirty;
+    u8 elapsed_ns;
+};
+
+struct dump_delta_tracker;
+
+/*
+ * Start tracking [addr, addr + length): write the whole region to path as round 0 and
+ * keep a hash per page. NULL if the file can't be written.
+ */
+dump_delta_tracker *dump_delta_begin(const void *addr, size_t length, const char *path, dump_delta_stats *stats);
+
+/*
+ * Write the pages changed since the previous round to path. When the kernel tracks
+ * soft-dirty bits (/proc/self/pagemap) only the pages written to since then are hashed,
+ * otherwise every page is; either way a page goes out only if its hash changed. A round
+ * that can't be written leaves the tracker at the previous one, and the next round then
+ * hashes every page, so nothing changed in between is lost.
+ */
+bool dump_delta_next(dump_delta_tracker *tracker, const char *path, dump_delta_stats *stats);
+
+void dump_delta_end(dump_delta_tracker *tracker);
+
+/* whether soft-dirty tracking works in this process, probed once */
+bool dump_delta_soft_dirty();
+#endif
@@ -0,0 +1,174 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include <android/log.h>
+#include "dumpfile.h"
+#include "memread.h"
+#include "jobengine.h"
+
+/*
+ * The region is written straight from its mapping. A chunk is large enough to keep the
+ * syscall count low and small enough that a chunked fsync still means something.
+ */
+#define DUMP_CHUNK_SIZE (8 * 1024 * 1024)
+
+u8 dump_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u8) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+bool dump_region_to_fd(int fd, const void *addr, size_t length, int fsync_policy, struct dump_result *result) {
+    u8 start = dump_now_ns();
+    const u1 *data = (const u1 *) addr;
+    size_t done = 0;
+    result->bytes = 0;
+    result->error = 0;
+    while (done < length) {
+        size_t count = length - done;
+        if (count > DUMP_CHUNK_SIZE)
+            count = DUMP_CHUNK_SIZE;
+        if (job_cancelled()) {
+            result->error = ECANCELED;
+            break;
+        }
+        ssize_t written = write(fd, data + done, count);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0) {
+            /* a write that takes nothing would never finish the loop */
+            result->error = written < 0 ? errno : EIO;
+            LOGE("write dump failed at %u: %s", (unsigned int) done, strerror(result->error));
+            break;
+        }
+        done += written;
+        job_progress_bytes(written);
+        if (fsync_policy == DUMP_FSYNC_CHUNK && fdatasync(fd) != 0) {
+            result->error = errno;
+            LOGE("sync dump failed at %u: %s", (unsigned int) done, strerror(errno));
+            break;
+        }
+    }
+    if (result->error == 0 && fsync_policy == DUMP_FSYNC_END && fdatasync(fd) != 0)
+        result->error = errno;
+    result->bytes = done;
+    result->elapsed_ns = dump_now_ns() - start;
+    return result->error == 0;
+}
+
+bool dump_region_to_file(const char *path, const void *addr, size_t length, int fsync_policy, struct dump_result *result) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        result->bytes = 0;
+        result->elapsed_ns = 0;
+        result->error = errno;
+        LOGE("open %s failed: %s", path, strerror(errno));
+        return false;
+    }
+    bool ok = dump_region_to_fd(fd, addr, length, fsync_policy, result);
+    close(fd);
+    LOGV("dump %u bytes to %s in %u us", (unsigned int) result->bytes, path,
+         (unsigned int) (result->elapsed_ns / 1000));
+    return ok;
+}
+
+static bool all_zero(const u1 *data, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        u8 word;
+        memcpy(&word, data + i, 8);
+        if (word != 0)
+            return false;
+    }
+    for (; i < length; i++) {
+        if (data[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+bool dump_write_at(int fd, const void *data, size_t length, u8 offset, struct dump_result *result) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t written = pwrite64(fd, (const u1 *) data + done, length - done, (off64_t) (offset + done));
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0) {
+            result->error = written < 0 ? errno : EIO;
+            LOGE("write dump failed at %llu: %s", (unsigned long long) (offset + done), strerror(result->error));
+            return false;
+        }
+        done += written;
+    }
+    result->bytes += done;
+    return true;
+}
+
+bool dump_memory_sparse(const char *path, const void *addr, size_t length, int fsync_policy,
+                        struct dump_result *result, struct dump_sparse_stats *stats) {
+    u8 start_ns = dump_now_ns();
+    result->bytes = 0;
+    result->error = 0;
+    memset(stats, 0, sizeof(*stats));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        result->elapsed_ns = 0;
+        result->error = errno;
+        LOGE("open %s failed: %s", path, strerror(errno));
+        return false;
+    }
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) addr;
+    uintptr_t end = start + length;
+    std::vector<u1> buffer(DUMP_CHUNK_SIZE);
+    std::vector<u1> readable(DUMP_CHUNK_SIZE / page_size / 8 + 1);
+    uintptr_t chunk = start;
+    while (chunk < end && result->error == 0) {
+        /* chunks end on a page boundary, so a page is never split between two bitmaps */
+        uintptr_t chunk_end = std::min(end, (chunk & ~(page_size - 1)) + DUMP_CHUNK_SIZE);
+        mem_read_pages((const void *) chunk, &buffer[0], chunk_end - chunk, &readable[0]);
+        uintptr_t first_page = chunk & ~(page_size - 1);
+        uintptr_t run = 0;      /* start of the pending run of pages to write, 0 if none */
+        for (uintptr_t page = first_page; page < chunk_end && result->error == 0; page += page_size) {
+            uintptr_t from = std::max(page, chunk);
+            uintptr_t to = std::min(page + page_size, chunk_end);
+            size_t bit = (page - first_page) / page_size;
+            bool keep = false;
+            stats->pages++;
+            if (!(readable[bit >> 3] & (1 << (bit & 7))))
+                stats->unreadable++;
+            else if (all_zero(&buffer[from - chunk], to - from))
+                stats->zero++;
+            else
+                keep = true;
+            if (keep && run == 0)
+                run = from;
+            if (run != 0 && (!keep || to == chunk_end)) {
+                uintptr_t run_end = keep ? to : from;
+                dump_write_at(fd, &buffer[run - chunk], run_end - run, run - start, result);
+                run = 0;
+            }
+        }
+        if (result->error == 0 && fsync_policy == DUMP_FSYNC_CHUNK && fdatasync(fd) != 0)
+            result->error = errno;
+        job_progress_bytes(chunk_end - chunk);
+        chunk = chunk_end;
+        if (result->error == 0 && chunk < end && job_cancelled())
+            result->error = ECANCELED;
+    }
+    /* the holes at the end need the length set explicitly */
+    if (result->error == 0 && ftruncate64(fd, (off64_t) length) != 0)
+        result->error = errno;
+    if (result->error == 0 && fsync_policy == DUMP_FSYNC_END && fdatasync(fd) != 0)
+        result->error = errno;
+    close(fd);
+    result->elapsed_ns = dump_now_ns() - start_ns;
+    LOGV("dump %llu of %u bytes to %s in %u us, %llu unreadable and %llu zero pages left as holes",
+         (unsigned long long) result->bytes, (unsigned int) length, path, (unsigned int) (result->elapsed_ns / 1000),
+         (unsigned long long) stats->unreadable, (unsigned long long) stats->zero);
+    return result->error == 0;
+}
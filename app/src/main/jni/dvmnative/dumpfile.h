@@ -0,0 +1,38 @@
+#ifndef DUMPFILE_H_
+#define DUMPFILE_H_
+#include <stddef.h>
+#include <stdint.h>
+#include "util.h"
+
+/* fsync policy of the dump writers */
+#define DUMP_FSYNC_NONE   0   /* leave it to the page cache */
+#define DUMP_FSYNC_END    1   /* fdatasync once, after the last chunk */
+#define DUMP_FSYNC_CHUNK  2   /* fdatasync after every chunk */
+
+struct dump_result {
+    u8 bytes;          /* bytes written to the file */
+    u8 elapsed_ns;     /* wall time of the write, including the sync */
+    int error;         /* errno of the failing call, 0 on success, ECANCELED if the job was cancelled */
+};
+
+struct dump_sparse_stats {
+    u8 pages;           /* of the range */
+    u8 unreadable;      /* left as holes */
+    u8 zero;            /* readable, all zero, left as holes too */
+};
+
+u8 dump_now_ns();
+bool dump_region_to_fd(int fd, const void *addr, size_t length, int fsync_policy, struct dump_result *result);
+bool dump_region_to_file(const char *path, const void *addr, size_t length, int fsync_policy, struct dump_result *result);
+
+/* pwrite all of data at offset, adding to result->bytes; result->error is set on failure */
+bool dump_write_at(int fd, const void *data, size_t length, u8 offset, struct dump_result *result);
+
+/*
+ * Dump arbitrary memory without ever touching it directly: it is copied a chunk at a time
+ * with mem_read_pages, and pages that couldn't be read or are all zero become holes of a
+ * sparse file that is still length bytes long. result->bytes counts the data written.
+ */
+bool dump_memory_sparse(const char *path, const void *addr, size_t length, int fsync_policy,
+                        struct dump_result *result, struct dump_sparse_stats *stats);
+#endif
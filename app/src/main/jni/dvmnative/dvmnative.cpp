@@ -5,10 +5,40 @@
 #include <stdint.h>
 #include <android/log.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <deque>
 //#include <utils/Log.h>
 #include "util.h"
 #include "elfinfo.h"
 #include "dexfile_art.h"
+#include "dumpfile.h"
+#include "memread.h"
+#include "dexparse.h"
+#include "dexrebuild.h"
+#include "dexsum.h"
+#include "threadpool.h"
+#include "dexscan.h"
+#include "mapsindex.h"
+#include "gotsnap.h"
+#include "gotmon.h"
+#include "textscan.h"
+#include "runtimesym.h"
+#include "runtimelayout.h"
+#include "dexclasses.h"
+#include "dexindex.h"
+#include "dumpdelta.h"
+#include "codeharvest.h"
+#include "memsnap.h"
+#include "memsearch.h"
+#include "sigscan.h"
+#include "mementropy.h"
+#include "tracering.h"
+#include "jobengine.h"
 
 #define DEX_MAGIC       "dex\n"
 #define DEX_MAGIC_VERS  "036\0"
@@ -17,16 +47,6 @@
 #define DEX_OPT_MAGIC_VERS  "036\0"
 #define DEX_DEP_MAGIC   "deps"
 
-typedef void *(*dvmDecodeIndirectRef_func)(void *self, jobject jobj);
-
-typedef void *(*dvmThreadSelf_func)();
-
-typedef int (*dvmGetInlineOpsTableLengthPtr)();
-
-void *(*dvmDecodeIndirectRef_ptr)(void *self, jobject jobj);
-
-void *(*dvmThreadSelf_ptr)();
-
 struct DexHeader {
     u1 magic[8];           /* includes version number */
     u4 checksum;           /* adler32 checksum */
@@ -220,62 +240,7 @@ struct DexOrJar {
     u1 *pDexMemory; // Android4.0 bytes
 };
 
-//Android 4.0
-struct DvmDex {
-    /* pointer to the DexFile we're associated with */
-    void *pDexFile;
-
-    /* clone of pDexFile->pHeader (it's used frequently enough) */
-    void *pHeader;
-
-    /* interned strings; parallel to "stringIds" */
-    void *pResStrings;
-
-    /* resolved classes; parallel to "typeIds" */
-    void *pResClasses;
-
-    /* resolved methods; parallel to "methodIds" */
-    void *pResMethods;
-
-    /* resolved instance fields; parallel to "fieldIds" */
-    /* (this holds both InstField and StaticField) */
-    void *pResFields;
-
-    /* interface method lookup cache */
-    void *pInterfaceCache;
-
-    /* shared memory region with file contents */
-    bool isMappedReadOnly;
-    MemMapping memMap;
-};
-
-//Android 4.0
-struct DvmDex2 {
-    /* pointer to the DexFile we're associated with */
-    void *pDexFile;
-
-    /* clone of pDexFile->pHeader (it's used frequently enough) */
-    void *pHeader;
-
-    /* interned strings; parallel to "stringIds" */
-    void *pResStrings;
-
-    /* resolved classes; parallel to "typeIds" */
-    void *pResClasses;
-
-    /* resolved methods; parallel to "methodIds" */
-    void *pResMethods;
-
-    /* resolved instance fields; parallel to "fieldIds" */
-    /* (this holds both InstField and StaticField) */
-    void *pResFields;
-
-    /* interface method lookup cache */
-    void *pInterfaceCache;
-
-    /* shared memory region with file contents */
-    MemMapping memMap;
-};
+//DvmDex (pDexFile, pHeader ... memMap) is read through runtimelayout, its memMap moved in 4.0
 
 struct ClassObject {
     u4 a[2];
@@ -308,28 +273,6 @@ struct Method {
     const u2 *insns;          /* instructions, in memory-mapped .dex */
 };
 
-class MemMap;
-
-static void descArtDexFile(art::DexFile *dexFile) {
-    if (dexFile != NULL) {
-//        LOGV("the dexFile fileName =%s", dexFile->location_.c_str());
-//        LOGV("the dexFile oat_dex_file =%d", dexFile->oat_dex_file_);
-
-        std::string s = "2333";
-
-        LOGV("the string size = %d", sizeof(std::string));
-        LOGV("the string_s size = %d", sizeof(s));
-        LOGV("the uint32_t size = %d", sizeof(uint32_t));
-        LOGV("the std::unique_ptr<MemMap> size = %d", sizeof(std::unique_ptr<MemMap>));
-
-
-        LOGV("the head address = %d", dexFile->header_);
-
-        LOGV("the dexFile address_begin =%d", dexFile->begin_);
-        LOGV("the dexFile size =%d", dexFile->size_);
-    }
-}
-
 static void descDexOrJar(DexOrJar *pDexOrJar) {
     if (pDexOrJar != NULL) {
         LOGV("the pDexOrJar fileName =%s", pDexOrJar->fileName);
@@ -354,24 +297,6 @@ static void descJarFile(JarFile *pJarFile) {
     }
 }
 
-static void descDvmDex(DvmDex *pDvmDex) {
-    if (pDvmDex != NULL) {
-        LOGV("the pDvmDex memMap addr =%d", pDvmDex->memMap.addr);
-        LOGV("the pDvmDex memMap length =%d", pDvmDex->memMap.length);
-        LOGV("the pDvmDex memMap baseAddr =%d", pDvmDex->memMap.baseAddr);
-        LOGV("the pDvmDex memMap baseLength =%d", pDvmDex->memMap.baseLength);
-    }
-}
-
-static void descDvmDex2(DvmDex2 *pDvmDex) {
-    if (pDvmDex != NULL) {
-        LOGV("the pDvmDex memMap addr =%d", pDvmDex->memMap.addr);
-        LOGV("the pDvmDex memMap length =%d", pDvmDex->memMap.length);
-        LOGV("the pDvmDex memMap baseAddr =%d", pDvmDex->memMap.baseAddr);
-        LOGV("the pDvmDex memMap baseLength =%d", pDvmDex->memMap.baseLength);
-    }
-}
-
 static bool dexHasValidMagic(const DexHeader *pHeader) {
     const u1 *magic = pHeader->magic;
     const u1 *version = &magic[4];
@@ -410,290 +335,1162 @@ static DexFile *queryDexFilePoint(int cookie, int ver) {
     DexOrJar *pDexOrJar = (DexOrJar *) cookie;
     LOGV("the pDexOrJar mCookie=%d", pDexOrJar);
     descDexOrJar(pDexOrJar);
-    DexFile *pDexFile;
-    if (ver >= 14) {
-        DvmDex *pDvmDex;
-        if (pDexOrJar->isDex) {
-            descRawDexFile((RawDexFile *) pDexOrJar->pRawDexFile);
-            pDvmDex = (DvmDex *) pDexOrJar->pRawDexFile->pDvmDex;
-        } else {
-            descJarFile((JarFile *) pDexOrJar->pJarFile);
-            pDvmDex = (DvmDex *) pDexOrJar->pJarFile->pDvmDex;
-            descDvmDex(pDvmDex);
-        }
-        pDexFile = (DexFile *) pDvmDex->pDexFile;
+    void *pDvmDex;
+    if (pDexOrJar->isDex) {
+        descRawDexFile((RawDexFile *) pDexOrJar->pRawDexFile);
+        pDvmDex = pDexOrJar->pRawDexFile->pDvmDex;
     } else {
-        DvmDex2 *pDvmDex;
-        if (pDexOrJar->isDex) {
-            descRawDexFile((RawDexFile *) pDexOrJar->pRawDexFile);
-            pDvmDex = (DvmDex2 *) pDexOrJar->pRawDexFile->pDvmDex;
-        } else {
-            descJarFile((JarFile *) pDexOrJar->pJarFile);
-            pDvmDex = (DvmDex2 *) pDexOrJar->pJarFile->pDvmDex;
-        }
-        pDexFile = (DexFile *) pDvmDex->pDexFile;
+        descJarFile((JarFile *) pDexOrJar->pJarFile);
+        pDvmDex = pDexOrJar->pJarFile->pDvmDex;
     }
-    return pDexFile;
+    return (DexFile *) layout_dvm_dex_file(ver, pDvmDex);
 }
 
 //find the memMap of dexfile which load the certain class;
 static jobject dump_ClassObject_DvmDex_MemMap(JNIEnv *env, jclass obj, jclass arg0, jint version) {
-    char *dvm_lib_path = "libdvm.so";
-    void *handle;
     int ver = version;
-    handle = dlopen(dvm_lib_path, 0);
-    if (handle == 0) {
-        LOGV("dlopen the libdvm error");
-        return 0;
+    const runtime_symbols *symbols = runtime_symbols_get();
+    if (symbols->art) {
+        LOGV("the ClassObject dump needs dalvik");
+        return NULL;
     }
-    dvmDecodeIndirectRef_ptr = (dvmDecodeIndirectRef_func) dlsym(handle,
-                                                                 "_Z20dvmDecodeIndirectRefP6ThreadP8_jobject");
-    if (dvmDecodeIndirectRef_ptr == 0) {
-        LOGV("dlsym the dvmDecodeIndirectRef_ptr error");
-        return 0;
+    ClassObject *classobj = (ClassObject *) runtime_decode_jobject(arg0);
+    if (classobj == NULL) {
+        LOGV("can not decode the ClassObject");
+        return NULL;
     }
-
-    dvmThreadSelf_ptr = (dvmThreadSelf_func) dlsym(handle, "_Z13dvmThreadSelfv");
-    if (dvmThreadSelf_ptr == 0) {
-        LOGV("dlsym the dvmThreadSelf_ptr error");
-        return 0;
+    void *addr;
+    size_t length;
+    if (!layout_dvm_dex_region(ver, classobj->pDvmDex, &addr, &length)) {
+        LOGV("can not find the pDvmDex in the ClassObject*");
+        return NULL;
     }
+    LOGV("the pDvmDex in ClassObject =%d", classobj->pDvmDex);
+    return env->NewDirectByteBuffer(addr, length);
+}
 
-    ClassObject *classobj = (ClassObject *) dvmDecodeIndirectRef_ptr(dvmThreadSelf_ptr(), arg0);
-    if (ver >= 14) {
-        DvmDex *dvm_dex = (DvmDex *) classobj->pDvmDex;
-        if (dvm_dex == NULL) {
-            LOGV("can not find the pDvmDex in the ClassObject*");
-            return NULL;
+/*
+ * Locate the memory region that backs the dex behind a cookie: art::DexFile begin_/size_
+ * on art, the DvmDex memMap (or the raw dex memory of an in-memory dex) on dalvik.
+ */
+static bool query_DexFile_region(jlong cookie, int version, void **addr, size_t *length) {
+    if (version > 19) {// art
+        LOGV("the art_dexFile mCookie=%d", cookie);
+        const u1 *begin;
+        if (!layout_art_dexfile_region(version, (const void *) cookie, &begin, length)) {
+            return false;
         }
-        LOGV("the pDvmDex in ClassObject =%d", dvm_dex);
-        descDvmDex(dvm_dex);
-        jobject byte_buffer = env->NewDirectByteBuffer(dvm_dex->memMap.addr,
-                                                       dvm_dex->memMap.length);
-        if (byte_buffer == NULL) {
-            return NULL;
+        *addr = (void *) begin;
+        return true;
+    }
+
+    DexOrJar *pDexOrJar = (DexOrJar *) cookie;
+    LOGV("the pDexOrJar mCookie=%d", pDexOrJar);
+    descDexOrJar(pDexOrJar);
+    if (pDexOrJar == NULL) {
+        return false;
+    }
+    void *dvm_dex;
+    if (pDexOrJar->isDex) {
+        if (version >= 14 && pDexOrJar->pDexMemory != NULL) {
+            DexHeader *dexHeader = (DexHeader *) pDexOrJar->pDexMemory;
+            *addr = pDexOrJar->pDexMemory;
+            *length = dexHeader->fileSize;
+            return true;
         }
-        return byte_buffer;
+        descRawDexFile((RawDexFile *) pDexOrJar->pRawDexFile);
+        dvm_dex = pDexOrJar->pRawDexFile->pDvmDex;
     } else {
-        DvmDex2 *dvm_dex = (DvmDex2 *) classobj->pDvmDex;
-        if (dvm_dex == NULL) {
-            return NULL;
-        }
-        LOGV("the pDvmDex in ClassObject =%d", dvm_dex);
-        descDvmDex((DvmDex *) dvm_dex);
-        jobject byte_buffer = env->NewDirectByteBuffer(dvm_dex->memMap.addr,
-                                                       dvm_dex->memMap.length);
-        if (byte_buffer == NULL) {
-            return NULL;
-        }
-        return byte_buffer;
+        descJarFile((JarFile *) pDexOrJar->pJarFile);
+        dvm_dex = pDexOrJar->pJarFile->pDvmDex;
+    }
+    if (dvm_dex == NULL) {
+        return false;
     }
+    return layout_dvm_dex_region(version, dvm_dex, addr, length);
 }
 
 static jobject
 dump_DexFile_mCookie_DexOrJar_memMap(JNIEnv *env, jclass obj, jlong cookie, jint version) {
-    if (version > 19) {// art
-        art::DexFile *dexFile = (art::DexFile *) cookie;
+    void *addr;
+    size_t length;
+    if (!query_DexFile_region(cookie, version, &addr, &length)) {
+        return NULL;
+    }
+    jobject byte_buffer = env->NewDirectByteBuffer(addr, length);
+    if (byte_buffer == NULL) {
+        return NULL;
+    }
+    return byte_buffer;
+}
+
+//return {start, length} of the dex region, so java can pin one view over it
+static jlongArray getDexFileRegion(JNIEnv *env, jclass obj, jlong cookie, jint version) {
+    void *addr;
+    size_t length;
+    if (!query_DexFile_region(cookie, version, &addr, &length)) {
+        LOGE("can not find the dex region of mCookie=%lld", cookie);
+        return NULL;
+    }
+    jlong region[2] = {(jlong) (uintptr_t) addr, (jlong) length};
+    jlongArray result = env->NewLongArray(2);
+    if (result == NULL) {
+        return NULL;
+    }
+    env->SetLongArrayRegion(result, 0, 2, region);
+    return result;
+}
 
-        LOGV("the art_dexFile mCookie=%d", dexFile);
+static jobject dump_Memory(JNIEnv *env, jclass obj, jlong start, jint length) {
+    jobject byte_buffer = env->NewDirectByteBuffer((void *) start, length);
+    LOGV("starting dump memory from %lld length %d", start, length);
+    if (byte_buffer == NULL) {
+        return NULL;
+    }
+    return byte_buffer;
+}
 
-        descArtDexFile(dexFile);
+//copy [start, start + length) without faulting; unreadable pages read as zeros and, when readable
+//is not null, have their bit clear in it (one bit per page, LSB first)
+static jbyteArray read_Memory(JNIEnv *env, jclass obj, jlong start, jint length, jbyteArray readable) {
+    if (length < 0) {
+        return NULL;
+    }
+    const void *addr = (const void *) (uintptr_t) start;
+    std::vector<u1> data(length);
+    jsize bitmap_size = (mem_page_count(addr, length) + 7) / 8;
+    std::vector<u1> bitmap(bitmap_size + 1);
+    mem_read_pages(addr, data.data(), length, &bitmap[0]);
+    if (readable != NULL) {
+        jsize count = std::min(bitmap_size, env->GetArrayLength(readable));
+        env->SetByteArrayRegion(readable, 0, count, (const jbyte *) &bitmap[0]);
+    }
+    jbyteArray result = env->NewByteArray(length);
+    if (result != NULL) {
+        env->SetByteArrayRegion(result, 0, length, (const jbyte *) data.data());
+    }
+    return result;
+}
 
-        jobject byte_buffer = env->NewDirectByteBuffer((void *) dexFile->begin_, dexFile->size_);
-        if (byte_buffer == NULL) {
-            return NULL;
+static jlongArray make_dump_result(JNIEnv *env, const dump_result &result) {
+    jlong values[3] = {(jlong) result.bytes, (jlong) result.elapsed_ns, result.error};
+    jlongArray array = env->NewLongArray(3);
+    if (array == NULL) {
+        return NULL;
+    }
+    env->SetLongArrayRegion(array, 0, 3, values);
+    return array;
+}
+
+static void log_dexsum_throughput(const char *what, size_t length, u8 elapsed_ns) {
+    const char *adler_kernel;
+    const char *sha1_kernel;
+    dexsum_kernels(&adler_kernel, &sha1_kernel);
+    u8 mb_per_s = elapsed_ns ? (u8) length * 1000000000ULL / elapsed_ns / (1024 * 1024) : 0;
+    LOGV("%s: %u bytes in %u us, %u MB/s (adler32=%s sha1=%s)", what, (unsigned int) length,
+         (unsigned int) (elapsed_ns / 1000), (unsigned int) mb_per_s, adler_kernel, sha1_kernel);
+}
+
+/*
+ * The checksum and signature in memory are usually stale once a packer has patched the dex.
+ * Hash the image straight from the region and patch only the 24 header bytes of the dump,
+ * the target's memory is never written. Returns the dex_verify_checksum() status, or -errno
+ * if the dump couldn't be patched (-EINVAL: the region holds no dex image). The checksum the
+ * image really has goes to checksum unless it is NULL.
+ */
+static int fix_dumped_checksum(const char *path, const u1 *region, size_t length, u4 *checksum_out) {
+    size_t offset;
+    size_t dex_length;
+    if (!dex_locate_image(region, length, &offset, &dex_length)) {
+        LOGE("no dex image to fix the checksum of in %s", path);
+        return -EINVAL;
+    }
+    u8 start = dump_now_ns();
+    u4 checksum;
+    u1 fields[4 + SHA1_DIGEST_SIZE];
+    dex_compute_checksum(region + offset, dex_length, &checksum, fields + 4);
+    memcpy(fields, &checksum, 4);
+    if (checksum_out != NULL)
+        *checksum_out = checksum;
+    int status = 0;
+    if (memcmp(region + offset + 8, fields, 4) != 0)
+        status |= DEX_CHECKSUM_STALE;
+    if (memcmp(region + offset + 12, fields + 4, SHA1_DIGEST_SIZE) != 0)
+        status |= DEX_SIGNATURE_STALE;
+    if (status != 0) {
+        int fd = open(path, O_WRONLY);
+        ssize_t written = fd >= 0 ? pwrite(fd, fields, sizeof(fields), offset + 8) : -1;
+        if (written != (ssize_t) sizeof(fields)) {
+            int error = written < 0 ? errno : EIO;
+            LOGE("patch the checksum of %s failed: %s", path, strerror(error));
+            if (fd >= 0)
+                close(fd);
+            return -error;
         }
-        return byte_buffer;
+        close(fd);
+    }
+    log_dexsum_throughput(status ? "dex checksum fixed" : "dex checksum up to date", dex_length,
+                          dump_now_ns() - start);
+    return status;
+}
 
+//write the dex region straight to a file, return {bytes, elapsed ns, errno}
+static jlongArray dump_DexFile_to_file(JNIEnv *env, jclass obj, jlong cookie, jint version,
+                                       jstring path, jint fsync_policy, jboolean fix_checksum) {
+    void *addr;
+    size_t length;
+    if (!query_DexFile_region(cookie, version, &addr, &length)) {
+        LOGE("can not find the dex region of mCookie=%lld", cookie);
+        return NULL;
+    }
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    dump_result result;
+    job_progress_begin("bytes", length);
+    if (dump_region_to_file(file_path, addr, length, fsync_policy, &result) && fix_checksum) {
+        /* the dump is written, but with the stale checksum the caller asked to have fixed */
+        int status = fix_dumped_checksum(file_path, (const u1 *) addr, length, NULL);
+        if (status < 0) {
+            result.error = -status;
+        }
+    }
+    env->ReleaseStringUTFChars(path, file_path);
+    return make_dump_result(env, result);
+}
 
-    } else {
-        DexOrJar *pDexOrJar = (DexOrJar *) cookie;
-        LOGV("the pDexOrJar mCookie=%d", pDexOrJar);
-        descDexOrJar(pDexOrJar);
-        int ver = version;
-        if (ver >= 14) {
-            MemMapping memMap;
-            DvmDex *dvm_dex;
-            if (pDexOrJar->isDex) {
-                if (pDexOrJar->pDexMemory == NULL) {
-                    descRawDexFile((RawDexFile *) pDexOrJar->pRawDexFile);
-                    dvm_dex = (DvmDex *) pDexOrJar->pRawDexFile->pDvmDex;
-                    memMap = dvm_dex->memMap;
-                    jobject byte_buffer = env->NewDirectByteBuffer(memMap.addr, memMap.length);
-                    if (byte_buffer == NULL) {
-                        return NULL;
-                    }
-                    return byte_buffer;
-                } else {
-                    DexHeader *dexHeader = (DexHeader *) pDexOrJar->pDexMemory;
-                    jobject byte_buffer = env->NewDirectByteBuffer(pDexOrJar->pDexMemory,
-                                                                   dexHeader->fileSize);
-                    if (byte_buffer == NULL) {
-                        return NULL;
-                    }
-                    return byte_buffer;
-                }
-            } else {
-                descJarFile((JarFile *) pDexOrJar->pJarFile);
-                dvm_dex = (DvmDex *) pDexOrJar->pJarFile->pDvmDex;
-                descDvmDex(dvm_dex);
-                memMap = dvm_dex->memMap;
-            }
-            if (dvm_dex == NULL) {
-                return NULL;
-            }
-            jobject byte_buffer = env->NewDirectByteBuffer(memMap.addr, memMap.length);
-            if (byte_buffer == NULL) {
-                return NULL;
-            }
-            return byte_buffer;
-        } else {
-            MemMapping memMap;
-            DvmDex2 *dvm_dex;
-            if (pDexOrJar->isDex) {
-                descRawDexFile((RawDexFile *) pDexOrJar->pRawDexFile);
-                dvm_dex = (DvmDex2 *) pDexOrJar->pRawDexFile->pDvmDex;
-            } else {
-                descJarFile((JarFile *) pDexOrJar->pJarFile);
-                dvm_dex = (DvmDex2 *) pDexOrJar->pJarFile->pDvmDex;
-            }
-            if (dvm_dex == NULL) {
-                return NULL;
-            }
-            memMap = dvm_dex->memMap;
-            jobject byte_buffer = env->NewDirectByteBuffer(memMap.addr, memMap.length);
-            if (byte_buffer == NULL) {
-                return NULL;
-            }
-            return byte_buffer;
+//verify (and unless verify_only, fix) the checksum of a dex/odex file, return {status, dex bytes, elapsed ns}
+static jlongArray fix_DexFile_checksum(JNIEnv *env, jclass obj, jstring path, jboolean verify_only) {
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    int fd = open(file_path, verify_only ? O_RDONLY : O_RDWR);
+    if (fd < 0) {
+        LOGE("open %s failed: %s", file_path, strerror(errno));
+        env->ReleaseStringUTFChars(path, file_path);
+        return NULL;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, verify_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOGE("map %s failed: %s", file_path, strerror(errno));
+        env->ReleaseStringUTFChars(path, file_path);
+        return NULL;
+    }
+    env->ReleaseStringUTFChars(path, file_path);
+    size_t offset;
+    size_t dex_length;
+    jlongArray result = NULL;
+    if (dex_locate_image((const u1 *) map, st.st_size, &offset, &dex_length)) {
+        u1 *dex = (u1 *) map + offset;
+        u8 start = dump_now_ns();
+        int status = dex_verify_checksum(dex, dex_length);
+        if (status != 0 && !verify_only) {
+            dex_fix_checksum(dex, dex_length);
+            msync(map, st.st_size, MS_SYNC);
+        }
+        u8 elapsed_ns = dump_now_ns() - start;
+        log_dexsum_throughput(verify_only ? "dex checksum verified" : "dex checksum checked", dex_length,
+                              elapsed_ns);
+        jlong values[3] = {status, (jlong) dex_length, (jlong) elapsed_ns};
+        result = env->NewLongArray(3);
+        if (result != NULL) {
+            env->SetLongArrayRegion(result, 0, 3, values);
         }
     }
+    munmap(map, st.st_size);
+    return result;
 }
 
-static jobject dump_Memory(JNIEnv *env, jclass obj, jlong start, jint length) {
-    jobject byte_buffer = env->NewDirectByteBuffer((void *) start, length);
-    LOGV("starting dump memory from %lld length %d", start, length);
-    if (byte_buffer == NULL) {
+//time the checksum kernels over size_mb of noise, return {adler32, sha1, scalar adler32, scalar sha1} in ns
+static jlongArray benchmark_DexSum(JNIEnv *env, jclass obj, jint size_mb) {
+    size_t length = (size_t) size_mb * 1024 * 1024;
+    u8 elapsed_ns[4];
+    if (size_mb <= 0 || !dexsum_benchmark(length, elapsed_ns)) {
         return NULL;
     }
-    return byte_buffer;
+    log_dexsum_throughput("adler32 benchmark", length, elapsed_ns[0]);
+    log_dexsum_throughput("sha1 benchmark", length, elapsed_ns[1]);
+    jlong values[4];
+    for (int i = 0; i < 4; i++) {
+        values[i] = (jlong) elapsed_ns[i];
+    }
+    jlongArray result = env->NewLongArray(4);
+    if (result == NULL) {
+        return NULL;
+    }
+    env->SetLongArrayRegion(result, 0, 4, values);
+    return result;
 }
 
+//dump arbitrary memory to a sparse file, unreadable and zero pages left as holes
+//return {bytes, elapsed ns, errno, pages, unreadable pages, zero pages}
+static jlongArray dump_Memory_to_file(JNIEnv *env, jclass obj, jlong start, jlong length,
+                                      jstring path, jint fsync_policy) {
+    LOGV("starting dump memory from %lld length %lld", start, length);
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    dump_result result;
+    dump_sparse_stats stats;
+    job_progress_begin("bytes", (u8) length);
+    dump_memory_sparse(file_path, (void *) start, (size_t) length, fsync_policy, &result, &stats);
+    env->ReleaseStringUTFChars(path, file_path);
+    jlong values[6] = {(jlong) result.bytes, (jlong) result.elapsed_ns, result.error, (jlong) stats.pages,
+                       (jlong) stats.unreadable, (jlong) stats.zero};
+    jlongArray array = env->NewLongArray(6);
+    if (array != NULL) {
+        env->SetLongArrayRegion(array, 0, 6, values);
+    }
+    return array;
+}
 
-static jobject getHeaderItemPtr(JNIEnv *env, jclass obj, jlong mCookie, jint version) {
+//snapshot the regions with all of perms ("rwxs" letters) whose path matches pattern (any if null) and that
+//are at most max_size bytes (0: any) into one container file
+//return {regions, pages, stored, duplicate, zero, unreadable, bytes, elapsed ns}
+static jlongArray snapshot_Memory(JNIEnv *env, jclass obj, jstring path, jstring perms, jstring pattern,
+                                  jlong max_size) {
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    const char *perms_chars = perms != NULL ? env->GetStringUTFChars(perms, NULL) : NULL;
+    const char *pattern_chars = pattern != NULL ? env->GetStringUTFChars(pattern, NULL) : NULL;
+    mem_snapshot_filter filter;
+    filter.perms = perms_chars != NULL ? maps_parse_perms(perms_chars) : 0;
+    filter.pattern = pattern_chars;
+    filter.max_region_size = max_size > 0 ? (u8) max_size : 0;
+    mem_snapshot_stats stats;
+    bool ok = mem_snapshot_write(file_path, &filter, &stats);
+    if (pattern_chars != NULL) {
+        env->ReleaseStringUTFChars(pattern, pattern_chars);
+    }
+    if (perms_chars != NULL) {
+        env->ReleaseStringUTFChars(perms, perms_chars);
+    }
+    env->ReleaseStringUTFChars(path, file_path);
+    if (!ok) {
+        return NULL;
+    }
+    jlong values[8] = {stats.regions, (jlong) stats.pages, (jlong) stats.stored, (jlong) stats.duplicate,
+                       (jlong) stats.zero, (jlong) stats.unreadable, (jlong) stats.bytes, (jlong) stats.elapsed_ns};
+    jlongArray array = env->NewLongArray(8);
+    if (array != NULL) {
+        env->SetLongArrayRegion(array, 0, 8, values);
+    }
+    return array;
+}
 
+//find the id tables of the dex behind a cookie, wherever the runtime keeps them
+static bool query_DexFile_tables(jlong mCookie, jint version, dex_tables *tables) {
     if (version > 19) {
-        art::DexFile *pDexFile = (art::DexFile *) mCookie;
-
-        long *head_ptr = (long *) &(pDexFile->begin_);
-
-        for (int i = 1; i < 24; ++i) {
-            LOGV("search at %d, value=%d", head_ptr + i, *(head_ptr + i));
-
-            if ((*(head_ptr + i)) == (long) (pDexFile->begin_)) {
-                LOGV("find at %d, value=%d", head_ptr + i, *(head_ptr + i));
-                head_ptr = head_ptr + i;
-
-                art::DexFile::Header **Header_ptr_ptr = (art::DexFile::Header **) head_ptr;
-                art::DexFile::StringId **StringId_ptr_ptr = (art::DexFile::StringId **) (
-                        Header_ptr_ptr +
-                        1);
-                art::DexFile::TypeId **TypeId_ptr_ptr = (art::DexFile::TypeId **) (
-                        StringId_ptr_ptr + 1);
-                art::DexFile::FieldId **FieldId_ptr_ptr = (art::DexFile::FieldId **) (
-                        TypeId_ptr_ptr + 1);
-                art::DexFile::MethodId **MethodId_ptr_ptr = (art::DexFile::MethodId **) (
-                        FieldId_ptr_ptr +
-                        1);
-                art::DexFile::ProtoId **ProtoId_ptr_ptr = (art::DexFile::ProtoId **) (
-                        MethodId_ptr_ptr + 1);
-                art::DexFile::ClassDef **ClassDef_ptr_ptr = (art::DexFile::ClassDef **) (
-                        ProtoId_ptr_ptr +
-                        1);
-
-
-                jclass dexFileHeadersPointer_class = env->FindClass(
-                        "com/android/reverse/smali/DexFileHeadersPointer");
-                jobject dexFileItemInfo_obj = env->AllocObject(dexFileHeadersPointer_class);
-
-                jfieldID stringIdField = env->GetFieldID(dexFileHeadersPointer_class, "pStringIds",
-                                                         "J");
-                env->SetLongField(dexFileItemInfo_obj, stringIdField, (jlong) (*StringId_ptr_ptr));
-
-                jfieldID typeIdField = env->GetFieldID(dexFileHeadersPointer_class, "pTypeIds",
-                                                       "J");
-                env->SetLongField(dexFileItemInfo_obj, typeIdField, (jlong) (*TypeId_ptr_ptr));
-
-                jfieldID fieldIdField = env->GetFieldID(dexFileHeadersPointer_class, "pFieldIds",
-                                                        "J");
-                env->SetLongField(dexFileItemInfo_obj, fieldIdField, (jlong) (*FieldId_ptr_ptr));
-
-                jfieldID methodIdField = env->GetFieldID(dexFileHeadersPointer_class, "pMethodIds",
-                                                         "J");
-                env->SetLongField(dexFileItemInfo_obj, methodIdField, (jlong) (*MethodId_ptr_ptr));
-
-                jfieldID protoIdField = env->GetFieldID(dexFileHeadersPointer_class, "pProtoIds",
-                                                        "J");
-                env->SetLongField(dexFileItemInfo_obj, protoIdField, (jlong) (*ProtoId_ptr_ptr));
-
-                jfieldID classdefsField = env->GetFieldID(dexFileHeadersPointer_class, "pClassDefs",
-                                                          "J");
-                env->SetLongField(dexFileItemInfo_obj, classdefsField, (jlong) (*ClassDef_ptr_ptr));
-
-                jfieldID baseAddrField = env->GetFieldID(dexFileHeadersPointer_class, "baseAddr",
-                                                         "J");
-                env->SetLongField(dexFileItemInfo_obj, baseAddrField, (jlong) (*Header_ptr_ptr));
-
-                jfieldID classCountField = env->GetFieldID(dexFileHeadersPointer_class,
-                                                           "classCount",
-                                                           "J");
-                env->SetLongField(dexFileItemInfo_obj, classCountField,
-                                  (*Header_ptr_ptr)->class_defs_size_);
-                return dexFileItemInfo_obj;
-
-            }
+        return layout_art_dexfile_tables(version, (const void *) mCookie, tables);
+    } else {
+        DexFile *pDexFile = queryDexFilePoint(mCookie, version);
+        if (pDexFile == NULL) {
+            return false;
         }
+        tables->base = pDexFile->baseAddr;
+        tables->header = (const art::DexFile::Header *) pDexFile->pHeader;
+        tables->string_ids = (const art::DexFile::StringId *) pDexFile->pStringIds;
+        tables->type_ids = (const art::DexFile::TypeId *) pDexFile->pTypeIds;
+        tables->field_ids = (const art::DexFile::FieldId *) pDexFile->pFieldIds;
+        tables->method_ids = (const art::DexFile::MethodId *) pDexFile->pMethodIds;
+        tables->proto_ids = (const art::DexFile::ProtoId *) pDexFile->pProtoIds;
+        tables->class_defs = (const art::DexFile::ClassDef *) pDexFile->pClassDefs;
+        return true;
+    }
+}
+
+static jobject getHeaderItemPtr(JNIEnv *env, jclass obj, jlong mCookie, jint version) {
+    dex_tables tables;
+    if (!query_DexFile_tables(mCookie, version, &tables)) {
         return nullptr;
+    }
+
+    jclass dexFileHeadersPointer_class = env->FindClass(
+            "com/android/reverse/smali/DexFileHeadersPointer");
+    jobject dexFileItemInfo_obj = env->AllocObject(dexFileHeadersPointer_class);
+
+    jfieldID stringIdField = env->GetFieldID(dexFileHeadersPointer_class, "pStringIds",
+                                             "J");
+    env->SetLongField(dexFileItemInfo_obj, stringIdField, (jlong) tables.string_ids);
+
+    jfieldID typeIdField = env->GetFieldID(dexFileHeadersPointer_class, "pTypeIds", "J");
+    env->SetLongField(dexFileItemInfo_obj, typeIdField, (jlong) tables.type_ids);
+
+    jfieldID fieldIdField = env->GetFieldID(dexFileHeadersPointer_class, "pFieldIds", "J");
+    env->SetLongField(dexFileItemInfo_obj, fieldIdField, (jlong) tables.field_ids);
+
+    jfieldID methodIdField = env->GetFieldID(dexFileHeadersPointer_class, "pMethodIds",
+                                             "J");
+    env->SetLongField(dexFileItemInfo_obj, methodIdField, (jlong) tables.method_ids);
+
+    jfieldID protoIdField = env->GetFieldID(dexFileHeadersPointer_class, "pProtoIds", "J");
+    env->SetLongField(dexFileItemInfo_obj, protoIdField, (jlong) tables.proto_ids);
 
+    jfieldID classdefsField = env->GetFieldID(dexFileHeadersPointer_class, "pClassDefs",
+                                              "J");
+    env->SetLongField(dexFileItemInfo_obj, classdefsField, (jlong) tables.class_defs);
+
+    jfieldID baseAddrField = env->GetFieldID(dexFileHeadersPointer_class, "baseAddr", "J");
+    env->SetLongField(dexFileItemInfo_obj, baseAddrField, (jlong) tables.base);
+
+    jfieldID classCountField = env->GetFieldID(dexFileHeadersPointer_class, "classCount",
+                                               "J");
+    env->SetLongField(dexFileItemInfo_obj, classCountField,
+                      tables.header->class_defs_size_);
+
+    return dexFileItemInfo_obj;
+}
+
+//names of the classes defined by the dex behind a cookie, '\n' separated UTF-8 in one byte[]
+static jbyteArray list_DexClasses(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring prefix) {
+    u8 start = dump_now_ns();
+    dex_tables tables;
+    if (!query_DexFile_tables(cookie, version, &tables)) {
+        return NULL;
+    }
+    const char *prefix_chars = prefix != NULL ? env->GetStringUTFChars(prefix, NULL) : NULL;
+    std::string names;
+    size_t count = dex_class_names(&tables, prefix_chars, &names);
+    if (prefix_chars != NULL) {
+        env->ReleaseStringUTFChars(prefix, prefix_chars);
+    }
+    LOGV("listed %u of %u classes in %u us", (unsigned int) count, tables.header->class_defs_size_,
+         (unsigned int) ((dump_now_ns() - start) / 1000));
+    jbyteArray result = env->NewByteArray(names.size());
+    if (result != NULL) {
+        env->SetByteArrayRegion(result, 0, names.size(), (const jbyte *) names.data());
+    }
+    return result;
+}
+
+static void log_dump_delta(const char *path, const dump_delta_stats &stats) {
+    LOGV("delta round %u to %s: %u of %u pages read changed, %llu bytes%s in %u us", stats.round, path,
+         stats.pages_changed, stats.pages_read, (unsigned long long) stats.bytes,
+         stats.soft_dirty ? " (soft-dirty)" : "", (unsigned int) (stats.elapsed_ns / 1000));
+}
+
+//start an incremental dump of the dex behind a cookie, round 0 (all of it) to path; the tracker handle, 0 on failure
+static jlong begin_DumpDelta(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring path) {
+    void *addr;
+    size_t length;
+    if (!query_DexFile_region(cookie, version, &addr, &length)) {
+        return 0;
+    }
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    dump_delta_stats stats;
+    dump_delta_tracker *tracker = dump_delta_begin(addr, length, file_path, &stats);
+    if (tracker != NULL) {
+        log_dump_delta(file_path, stats);
+    }
+    env->ReleaseStringUTFChars(path, file_path);
+    return (jlong) (uintptr_t) tracker;
+}
+
+//write the pages changed since the last round to path, return {round, pages read, pages changed, bytes, soft-dirty, elapsed ns}
+static jlongArray next_DumpDelta(JNIEnv *env, jclass obj, jlong handle, jstring path) {
+    if (handle == 0) {
+        return NULL;
+    }
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    dump_delta_stats stats;
+    bool ok = dump_delta_next((dump_delta_tracker *) (uintptr_t) handle, file_path, &stats);
+    if (ok) {
+        log_dump_delta(file_path, stats);
+    }
+    env->ReleaseStringUTFChars(path, file_path);
+    if (!ok) {
+        return NULL;
+    }
+    jlong values[6] = {stats.round, stats.pages_read, stats.pages_changed, (jlong) stats.bytes, stats.soft_dirty,
+                       (jlong) stats.elapsed_ns};
+    jlongArray result = env->NewLongArray(6);
+    if (result != NULL) {
+        env->SetLongArrayRegion(result, 0, 6, values);
+    }
+    return result;
+}
+
+static void end_DumpDelta(JNIEnv *env, jclass obj, jlong handle) {
+    dump_delta_end((dump_delta_tracker *) (uintptr_t) handle);
+}
+
+//the sidecar index of the dex behind a cookie, mapped from dir or built there first
+static const dex_index *open_dex_index(JNIEnv *env, jlong cookie, jint version, jstring dir, int max_threads,
+                                       dex_tables *tables, bool *built) {
+    if (!query_DexFile_tables(cookie, version, tables)) {
+        return NULL;
+    }
+    const char *dir_chars = env->GetStringUTFChars(dir, NULL);
+    const dex_index *index = dex_index_open(dir_chars, tables, max_threads, built);
+    env->ReleaseStringUTFChars(dir, dir_chars);
+    return index;
+}
+
+//return {classes, methods, strings, built, elapsed ns}
+static jlongArray open_DexIndex(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring dir,
+                                jint max_threads) {
+    u8 start = dump_now_ns();
+    dex_tables tables;
+    bool built;
+    const dex_index *index = open_dex_index(env, cookie, version, dir, max_threads, &tables, &built);
+    if (index == NULL) {
+        return NULL;
+    }
+    jlong values[5] = {index->header->class_count, index->header->method_count, index->header->string_count,
+                       built, (jlong) (dump_now_ns() - start)};
+    jlongArray result = env->NewLongArray(5);
+    if (result != NULL) {
+        env->SetLongArrayRegion(result, 0, 5, values);
+    }
+    return result;
+}
+
+//class_def index of a descriptor, -1 if the dex doesn't define it
+static jint find_DexIndexClass(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring dir,
+                               jstring descriptor) {
+    dex_tables tables;
+    bool built;
+    const dex_index *index = open_dex_index(env, cookie, version, dir, 0, &tables, &built);
+    if (index == NULL) {
+        return -1;
+    }
+    const char *chars = env->GetStringUTFChars(descriptor, NULL);
+    u4 idx = dex_index_find_class(index, chars);
+    env->ReleaseStringUTFChars(descriptor, chars);
+    return (jint) idx;
+}
+
+//string_id index of a string, -1 if absent
+static jint find_DexIndexString(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring dir,
+                                jstring string) {
+    dex_tables tables;
+    bool built;
+    const dex_index *index = open_dex_index(env, cookie, version, dir, 0, &tables, &built);
+    if (index == NULL) {
+        return -1;
+    }
+    const char *chars = env->GetStringUTFChars(string, NULL);
+    u4 idx = dex_index_find_string(index, &tables, chars);
+    env->ReleaseStringUTFChars(string, chars);
+    return (jint) idx;
+}
+
+//code_item offset of a method_id, 0 if it has none, -1 without an index
+static jlong get_DexIndexCode(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring dir,
+                              jint method_idx) {
+    dex_tables tables;
+    bool built;
+    const dex_index *index = open_dex_index(env, cookie, version, dir, 0, &tables, &built);
+    if (index == NULL) {
+        return -1;
+    }
+    return dex_index_code_off(index, (u4) method_idx);
+}
+
+//listDexClasses through the index: the names in descriptor order, found by a binary search on the prefix; NULL without an index
+static jbyteArray list_DexIndexClasses(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring dir,
+                                       jstring prefix) {
+    u8 start = dump_now_ns();
+    dex_tables tables;
+    bool built;
+    const dex_index *index = open_dex_index(env, cookie, version, dir, 0, &tables, &built);
+    if (index == NULL) {
+        return NULL;
+    }
+    const char *prefix_chars = prefix != NULL ? env->GetStringUTFChars(prefix, NULL) : NULL;
+    std::string match = dex_descriptor_prefix(prefix_chars);
+    if (prefix_chars != NULL) {
+        env->ReleaseStringUTFChars(prefix, prefix_chars);
+    }
+    const dex_index_class *first;
+    size_t count = dex_index_class_range(index, match.c_str(), &first);
+    std::string names;
+    for (size_t i = 0; i < count; i++) {
+        dex_append_class_name(index->names + first[i].name_off, &names);
+    }
+    LOGV("listed %u of %u classes from the index in %u us", (unsigned int) count, index->header->class_count,
+         (unsigned int) ((dump_now_ns() - start) / 1000));
+    jbyteArray result = env->NewByteArray(names.size());
+    if (result != NULL) {
+        env->SetByteArrayRegion(result, 0, names.size(), (const jbyte *) names.data());
+    }
+    return result;
+}
+
+//class_def indexes in descriptor order, the order backsmali writes the classes in; NULL without an index
+static jintArray get_DexIndexClassOrder(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring dir) {
+    dex_tables tables;
+    bool built;
+    const dex_index *index = open_dex_index(env, cookie, version, dir, 0, &tables, &built);
+    if (index == NULL) {
+        return NULL;
+    }
+    u4 count = index->header->class_count;
+    std::vector<jint> order(count);
+    for (u4 i = 0; i < count; i++) {
+        order[i] = index->classes[i].class_def_idx;
+    }
+    jintArray result = env->NewIntArray(count);
+    if (result != NULL && count != 0) {
+        env->SetIntArrayRegion(result, 0, count, &order[0]);
+    }
+    return result;
+}
+
+//rebuild a standalone dex from the (possibly scattered) tables, return {bytes, elapsed ns, errno}
+static jlongArray rebuild_DexFile(JNIEnv *env, jclass obj, jlong cookie, jint version,
+                                  jstring path) {
+    u8 start = dump_now_ns();
+    dex_tables tables;
+    if (!query_DexFile_tables(cookie, version, &tables)) {
+        LOGE("can not find the dex tables of mCookie=%lld", cookie);
+        return NULL;
+    }
+    std::vector<u1> dex;
+    dump_result result;
+    if (!dex_rebuild(&tables, &dex)) {
+        /* null would read as a missing dex, so the reason goes back as the errno of the result */
+        LOGE("rebuild the dex of mCookie=%lld failed", cookie);
+        result.bytes = 0;
+        result.error = job_cancelled() ? ECANCELED : EINVAL;
+        result.elapsed_ns = dump_now_ns() - start;
+        return make_dump_result(env, result);
+    }
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    dump_region_to_file(file_path, &dex[0], dex.size(), DUMP_FSYNC_NONE, &result);
+    env->ReleaseStringUTFChars(path, file_path);
+    result.elapsed_ns = dump_now_ns() - start;
+    return make_dump_result(env, result);
+}
+
+//copy the code_items lying outside the dex region to path, and rebuild the dex with them to rebuild_path
+//unless it is null; return {classes, methods, outside, unreadable, bytes, elapsed ns, rebuilt bytes, stubbed}
+static jlongArray harvest_DexCode(JNIEnv *env, jclass obj, jlong cookie, jint version, jstring path,
+                                  jstring rebuild_path, jint max_threads) {
+    u8 start = dump_now_ns();
+    void *addr;
+    size_t length;
+    dex_tables tables;
+    if (!query_DexFile_region(cookie, version, &addr, &length) || !query_DexFile_tables(cookie, version, &tables)) {
+        LOGE("can not find the dex of mCookie=%lld", cookie);
+        return NULL;
+    }
+    code_harvest harvest;
+    code_harvest_collect(&tables, addr, length, max_threads, &harvest);
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    dump_result result;
+    bool ok = code_harvest_write(&harvest, &tables, addr, length, file_path, &result);
+    if (!ok) {
+        LOGE("write %s failed: %s", file_path, strerror(result.error));
+    }
+    env->ReleaseStringUTFChars(path, file_path);
+    std::vector<u1> dex;
+    u4 stubbed = 0;
+    if (ok && rebuild_path != NULL && dex_rebuild_harvested(&tables, &harvest, &dex, &stubbed)) {
+        const char *dex_path = env->GetStringUTFChars(rebuild_path, NULL);
+        dump_result dex_result;
+        if (!dump_region_to_file(dex_path, &dex[0], dex.size(), DUMP_FSYNC_NONE, &dex_result)) {
+            dex.clear();
+        }
+        env->ReleaseStringUTFChars(rebuild_path, dex_path);
+    }
+    if (!ok) {
+        return NULL;
+    }
+    const code_harvest_stats &stats = harvest.stats;
+    jlong values[8] = {stats.classes, stats.methods, stats.outside, stats.unreadable, (jlong) stats.bytes,
+                       (jlong) (dump_now_ns() - start), (jlong) dex.size(), stubbed};
+    jlongArray array = env->NewLongArray(8);
+    if (array != NULL) {
+        env->SetLongArrayRegion(array, 0, 8, values);
+    }
+    return array;
+}
+
+/* per-dex fields of the dumpAllDexFiles manifest, after the leading total wall time */
+#define ALLDEX_BYTES            0
+#define ALLDEX_ELAPSED_NS       1
+#define ALLDEX_ERROR            2
+#define ALLDEX_HEADER_CHECKSUM  3   /* as in the dump, after the fix if one was asked for */
+#define ALLDEX_CHECKSUM         4
+#define ALLDEX_FIELDS           5
+
+struct alldex_job {
+    const u1 *addr;
+    size_t length;
+    const char *path;
+    int fsync_policy;
+    bool fix_checksum;
+    dump_result result;
+    u4 header_checksum;
+    u4 checksum;
+};
+
+static void dump_alldex_task(size_t index, void *arg) {
+    alldex_job *job = (alldex_job *) arg + index;
+    if (job->addr == NULL) {
+        return;
+    }
+    if (!dump_region_to_file(job->path, job->addr, job->length, job->fsync_policy, &job->result)) {
+        return;
+    }
+    /* the checksum the content really has, next to the one the dump's header holds */
+    size_t offset;
+    size_t dex_length;
+    if (!dex_locate_image(job->addr, job->length, &offset, &dex_length)) {
+        return;
+    }
+    memcpy(&job->header_checksum, job->addr + offset + 8, 4);
+    if (!job->fix_checksum) {
+        job->checksum = adler32(1, job->addr + offset + 12, dex_length - 12);
+        return;
+    }
+    /* checks the signature too, so a dex with only a stale signature is fixed as well */
+    int status = fix_dumped_checksum(job->path, job->addr, job->length, &job->checksum);
+    if (status < 0) {
+        job->result.error = -status;
     } else {
+        job->header_checksum = job->checksum;
+    }
+}
 
+/*
+ * dump every cookie to its path on the thread pool, return the manifest
+ * {total elapsed ns, then ALLDEX_FIELDS values per cookie}
+ */
+static jlongArray dump_AllDexFiles(JNIEnv *env, jclass obj, jlongArray cookies, jint version,
+                                   jobjectArray paths, jint fsync_policy, jboolean fix_checksum) {
+    u8 start = dump_now_ns();
+    jsize count = env->GetArrayLength(cookies);
+    if (count != env->GetArrayLength(paths)) {
+        LOGE("%d cookies but %d paths", count, env->GetArrayLength(paths));
+        return NULL;
+    }
+    std::vector<jlong> cookie_values(count + 1);
+    env->GetLongArrayRegion(cookies, 0, count, &cookie_values[0]);
+    std::vector<jstring> path_strings(count);
+    std::vector<alldex_job> jobs(count + 1);
+    for (jsize i = 0; i < count; i++) {
+        alldex_job *job = &jobs[i];
+        memset(job, 0, sizeof(*job));
+        path_strings[i] = (jstring) env->GetObjectArrayElement(paths, i);
+        job->path = env->GetStringUTFChars(path_strings[i], NULL);
+        job->fsync_policy = fsync_policy;
+        job->fix_checksum = fix_checksum;
+        void *addr;
+        if (query_DexFile_region(cookie_values[i], version, &addr, &job->length)) {
+            job->addr = (const u1 *) addr;
+        } else {
+            LOGE("can not find the dex region of mCookie=%lld", cookie_values[i]);
+            job->result.error = ENOENT;
+        }
+    }
 
-        DexFile *pDexFile = queryDexFilePoint(mCookie, version);
-        jclass dexFileHeadersPointer_class = env->FindClass(
-                "com/android/reverse/smali/DexFileHeadersPointer");
-        jobject dexFileItemInfo_obj = env->AllocObject(dexFileHeadersPointer_class);
+    u8 total = 0;
+    for (jsize i = 0; i < count; i++) {
+        total += jobs[i].length;
+    }
+    job_progress_begin("bytes", total);
+    parallel_for(count, 0, dump_alldex_task, &jobs[0]);
+
+    std::vector<jlong> manifest(1 + count * ALLDEX_FIELDS);
+    for (jsize i = 0; i < count; i++) {
+        alldex_job *job = &jobs[i];
+        jlong *fields = &manifest[1 + i * ALLDEX_FIELDS];
+        fields[ALLDEX_BYTES] = (jlong) job->result.bytes;
+        fields[ALLDEX_ELAPSED_NS] = (jlong) job->result.elapsed_ns;
+        fields[ALLDEX_ERROR] = job->result.error;
+        fields[ALLDEX_HEADER_CHECKSUM] = job->header_checksum;
+        fields[ALLDEX_CHECKSUM] = job->checksum;
+        env->ReleaseStringUTFChars(path_strings[i], job->path);
+        env->DeleteLocalRef(path_strings[i]);
+    }
+    manifest[0] = (jlong) (dump_now_ns() - start);
+    LOGV("dumped %d dex files in %u us", count, (unsigned int) (manifest[0] / 1000));
+    jlongArray result = env->NewLongArray(manifest.size());
+    if (result == NULL) {
+        return NULL;
+    }
+    env->SetLongArrayRegion(result, 0, manifest.size(), &manifest[0]);
+    return result;
+}
+
+//scan every readable mapping for dex headers, return DexMemoryHit[] sorted by address
+static jobjectArray scan_DexFiles(JNIEnv *env, jclass obj, jint max_threads) {
+    u8 start = dump_now_ns();
+    std::vector<dex_scan_hit> hits;
+    if (!dex_scan_process(max_threads, &hits)) {
+        return NULL;
+    }
+    LOGV("found %u dex headers in %u us", (unsigned int) hits.size(),
+         (unsigned int) ((dump_now_ns() - start) / 1000));
+
+    jclass hit_class = env->FindClass("com/android/reverse/collecter/DexMemoryHit");
+    if (hit_class == NULL) {
+        return NULL;
+    }
+    jfieldID addr_field = env->GetFieldID(hit_class, "address", "J");
+    jfieldID size_field = env->GetFieldID(hit_class, "size", "J");
+    jfieldID class_count_field = env->GetFieldID(hit_class, "classCount", "I");
+    jfieldID version_field = env->GetFieldID(hit_class, "version", "I");
+    jfieldID mapping_field = env->GetFieldID(hit_class, "mapping", "Ljava/lang/String;");
+    jobjectArray result = env->NewObjectArray(hits.size(), hit_class, NULL);
+    if (result == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < hits.size(); i++) {
+        jobject hit_obj = env->AllocObject(hit_class);
+        env->SetLongField(hit_obj, addr_field, (jlong) hits[i].addr);
+        env->SetLongField(hit_obj, size_field, (jlong) hits[i].file_size);
+        env->SetIntField(hit_obj, class_count_field, (jint) hits[i].class_count);
+        env->SetIntField(hit_obj, version_field, (jint) hits[i].version);
+        jstring mapping = env->NewStringUTF(hits[i].mapping.c_str());
+        env->SetObjectField(hit_obj, mapping_field, mapping);
+        env->SetObjectArrayElement(result, i, hit_obj);
+        env->DeleteLocalRef(mapping);
+        env->DeleteLocalRef(hit_obj);
+    }
+    return result;
+}
 
-        jfieldID stringIdField = env->GetFieldID(dexFileHeadersPointer_class, "pStringIds",
-                                                 "J");
-        env->SetLongField(dexFileItemInfo_obj, stringIdField, (jlong) pDexFile->pStringIds);
+//compare every library's code with its file, return InlinePatch[] sorted by address
+static jobjectArray scan_InlinePatches(JNIEnv *env, jclass obj, jint max_threads) {
+    u8 start = dump_now_ns();
+    std::vector<text_patch> patches;
+    text_scan_stats stats;
+    if (!text_scan_process(max_threads, &patches, &stats)) {
+        return NULL;
+    }
+    LOGV("compared %u MB of code in %u libraries (%u skipped) in %u ms, %u patches",
+         (unsigned int) (stats.bytes >> 20), stats.libraries, stats.skipped,
+         (unsigned int) ((dump_now_ns() - start) / 1000000), (unsigned int) patches.size());
 
-        jfieldID typeIdField = env->GetFieldID(dexFileHeadersPointer_class, "pTypeIds", "J");
-        env->SetLongField(dexFileItemInfo_obj, typeIdField, (jlong) pDexFile->pTypeIds);
+    jclass patch_class = env->FindClass("com/android/reverse/collecter/InlinePatch");
+    if (patch_class == NULL) {
+        return NULL;
+    }
+    jfieldID library_field = env->GetFieldID(patch_class, "library", "Ljava/lang/String;");
+    jfieldID address_field = env->GetFieldID(patch_class, "address", "J");
+    jfieldID length_field = env->GetFieldID(patch_class, "length", "I");
+    jfieldID symbol_field = env->GetFieldID(patch_class, "symbol", "Ljava/lang/String;");
+    jfieldID symbol_addr_field = env->GetFieldID(patch_class, "symbolAddress", "J");
+    jfieldID original_field = env->GetFieldID(patch_class, "original", "[B");
+    jfieldID patched_field = env->GetFieldID(patch_class, "patched", "[B");
+    jobjectArray result = env->NewObjectArray(patches.size(), patch_class, NULL);
+    if (result == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < patches.size(); i++) {
+        const text_patch &patch = patches[i];
+        jobject patch_obj = env->AllocObject(patch_class);
+        jstring library = env->NewStringUTF(patch.library.c_str());
+        jstring symbol = env->NewStringUTF(patch.symbol.c_str());
+        jbyteArray original = env->NewByteArray(patch.original.size());
+        jbyteArray patched = env->NewByteArray(patch.patched.size());
+        env->SetByteArrayRegion(original, 0, patch.original.size(), (const jbyte *) patch.original.data());
+        env->SetByteArrayRegion(patched, 0, patch.patched.size(), (const jbyte *) patch.patched.data());
+        env->SetObjectField(patch_obj, library_field, library);
+        env->SetLongField(patch_obj, address_field, (jlong) patch.addr);
+        env->SetIntField(patch_obj, length_field, (jint) patch.length);
+        env->SetObjectField(patch_obj, symbol_field, symbol);
+        env->SetLongField(patch_obj, symbol_addr_field, (jlong) patch.symbol_addr);
+        env->SetObjectField(patch_obj, original_field, original);
+        env->SetObjectField(patch_obj, patched_field, patched);
+        env->SetObjectArrayElement(result, i, patch_obj);
+        env->DeleteLocalRef(library);
+        env->DeleteLocalRef(symbol);
+        env->DeleteLocalRef(original);
+        env->DeleteLocalRef(patched);
+        env->DeleteLocalRef(patch_obj);
+    }
+    return result;
+}
 
-        jfieldID fieldIdField = env->GetFieldID(dexFileHeadersPointer_class, "pFieldIds", "J");
-        env->SetLongField(dexFileItemInfo_obj, fieldIdField, (jlong) pDexFile->pFieldIds);
+/* hits on their way from the search threads to the listener; the search waits while this many are queued */
+#define SEARCH_QUEUE_LIMIT 1024
+
+struct search_stream {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    std::deque<mem_search_hit> queue;
+    bool done;
+    bool cancelled;         /* the listener threw */
+    const sig_set *set;     /* scanned with instead of the patterns in names when set */
+    std::vector<std::string> names;     /* what a hit's pattern index stands for */
+    mem_search_options options;
+    mem_search_stats stats;
+    bool ok;
+    void *job;              /* of the calling thread, taken on by the search thread */
+};
 
-        jfieldID methodIdField = env->GetFieldID(dexFileHeadersPointer_class, "pMethodIds",
-                                                 "J");
-        env->SetLongField(dexFileItemInfo_obj, methodIdField, (jlong) pDexFile->pMethodIds);
+static bool queue_search_hit(const mem_search_hit *hit, void *arg) {
+    search_stream *stream = (search_stream *) arg;
+    pthread_mutex_lock(&stream->lock);
+    while (stream->queue.size() >= SEARCH_QUEUE_LIMIT && !stream->cancelled) {
+        pthread_cond_wait(&stream->cond, &stream->lock);
+    }
+    bool keep_going = !stream->cancelled;
+    if (keep_going) {
+        stream->queue.push_back(*hit);
+        pthread_cond_broadcast(&stream->cond);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return keep_going;
+}
 
-        jfieldID protoIdField = env->GetFieldID(dexFileHeadersPointer_class, "pProtoIds", "J");
-        env->SetLongField(dexFileItemInfo_obj, protoIdField, (jlong) pDexFile->pProtoIds);
+static void *search_stream_thread(void *arg) {
+    search_stream *stream = (search_stream *) arg;
+    /* so the search sees the job cancelled, and counts its progress, as if it ran on the caller */
+    job_adopt(stream->job);
+    if (stream->set != NULL) {
+        stream->ok = sig_scan_process(stream->set, &stream->options, queue_search_hit, stream, &stream->stats);
+    } else {
+        stream->ok = mem_search_process(stream->names, &stream->options, queue_search_hit, stream,
+                                        &stream->stats);
+    }
+    pthread_mutex_lock(&stream->lock);
+    stream->done = true;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
 
-        jfieldID classdefsField = env->GetFieldID(dexFileHeadersPointer_class, "pClassDefs",
-                                                  "J");
-        env->SetLongField(dexFileItemInfo_obj, classdefsField, (jlong) pDexFile->pClassDefs);
+static jobject new_MemorySearchHit(JNIEnv *env, jclass hit_class, const mem_search_hit &hit, const char *name) {
+    jobject hit_obj = env->AllocObject(hit_class);
+    if (hit_obj == NULL) {
+        return NULL;
+    }
+    jstring name_str = env->NewStringUTF(name);
+    jstring region = env->NewStringUTF(hit.region);
+    jbyteArray context = env->NewByteArray(hit.context.size());
+    env->SetByteArrayRegion(context, 0, hit.context.size(), (const jbyte *) hit.context.data());
+    env->SetLongField(hit_obj, env->GetFieldID(hit_class, "address", "J"), (jlong) hit.addr);
+    env->SetIntField(hit_obj, env->GetFieldID(hit_class, "pattern", "I"), (jint) hit.pattern);
+    env->SetObjectField(hit_obj, env->GetFieldID(hit_class, "name", "Ljava/lang/String;"), name_str);
+    env->SetObjectField(hit_obj, env->GetFieldID(hit_class, "region", "Ljava/lang/String;"), region);
+    env->SetLongField(hit_obj, env->GetFieldID(hit_class, "regionStart", "J"), (jlong) hit.region_start);
+    env->SetLongField(hit_obj, env->GetFieldID(hit_class, "contextAddress", "J"), (jlong) hit.context_addr);
+    env->SetObjectField(hit_obj, env->GetFieldID(hit_class, "context", "[B"), context);
+    env->DeleteLocalRef(name_str);
+    env->DeleteLocalRef(region);
+    env->DeleteLocalRef(context);
+    return hit_obj;
+}
 
-        jfieldID baseAddrField = env->GetFieldID(dexFileHeadersPointer_class, "baseAddr", "J");
-        env->SetLongField(dexFileItemInfo_obj, baseAddrField, (jlong) pDexFile->baseAddr);
+/*
+ * Run the search the stream is set up for on its own thread, so this one, the only one that
+ * may call java, can drain the hits into listener.onHit. Returns the stats as
+ * {regions, bytes, hits, truncated, elapsed}, NULL if the search failed or the listener threw.
+ */
+static jlongArray run_search_stream(JNIEnv *env, search_stream *stream, jobject listener) {
+    jclass hit_class = env->FindClass("com/android/reverse/collecter/MemorySearchHit");
+    if (hit_class == NULL) {
+        return NULL;
+    }
+    jmethodID on_hit = NULL;
+    if (listener != NULL) {
+        jclass listener_class = env->GetObjectClass(listener);
+        on_hit = env->GetMethodID(listener_class, "onHit", "(Lcom/android/reverse/collecter/MemorySearchHit;)V");
+        env->DeleteLocalRef(listener_class);
+        if (on_hit == NULL) {
+            return NULL;
+        }
+    }
 
-        jfieldID classCountField = env->GetFieldID(dexFileHeadersPointer_class, "classCount",
-                                                   "J");
-        env->SetLongField(dexFileItemInfo_obj, classCountField,
-                          pDexFile->pHeader->classDefsSize);
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+    stream->done = false;
+    stream->cancelled = false;
+    stream->ok = false;
+    stream->job = job_current();
+    pthread_t thread;
+    int err = pthread_create(&thread, NULL, search_stream_thread, stream);
+    if (err == 0) {
+        pthread_mutex_lock(&stream->lock);
+        for (;;) {
+            while (stream->queue.empty() && !stream->done) {
+                pthread_cond_wait(&stream->cond, &stream->lock);
+            }
+            if (stream->queue.empty()) {
+                break;
+            }
+            std::deque<mem_search_hit> batch;
+            batch.swap(stream->queue);
+            pthread_cond_broadcast(&stream->cond);
+            pthread_mutex_unlock(&stream->lock);
+            bool threw = false;
+            for (size_t i = 0; i < batch.size() && on_hit != NULL && !threw; i++) {
+                const char *name = batch[i].pattern < stream->names.size() ? stream->names[batch[i].pattern].c_str() : "";
+                jobject hit_obj = new_MemorySearchHit(env, hit_class, batch[i], name);
+                if (hit_obj != NULL) {
+                    env->CallVoidMethod(listener, on_hit, hit_obj);
+                    env->DeleteLocalRef(hit_obj);
+                }
+                threw = env->ExceptionCheck();
+            }
+            /* the copies of the matches would turn up as hits of their own further on */
+            for (size_t i = 0; i < batch.size(); i++) {
+                std::fill(batch[i].context.begin(), batch[i].context.end(), 0);
+            }
+            pthread_mutex_lock(&stream->lock);
+            if (threw) {
+                /* the exception is thrown on once the search has wound down */
+                stream->cancelled = true;
+                on_hit = NULL;
+                pthread_cond_broadcast(&stream->cond);
+            }
+        }
+        pthread_mutex_unlock(&stream->lock);
+        pthread_join(thread, NULL);
+    } else {
+        LOGE("start the search thread failed: %s", strerror(err));
+    }
+    pthread_cond_destroy(&stream->cond);
+    pthread_mutex_destroy(&stream->lock);
+    env->DeleteLocalRef(hit_class);
+    if (!stream->ok || env->ExceptionCheck()) {
+        return NULL;
+    }
+    jlong values[5] = {stream->stats.regions, (jlong) stream->stats.bytes, (jlong) stream->stats.hits,
+                       stream->stats.truncated, (jlong) stream->stats.elapsed_ns};
+    jlongArray array = env->NewLongArray(5);
+    if (array != NULL) {
+        env->SetLongArrayRegion(array, 0, 5, values);
+    }
+    return array;
+}
 
-        return dexFileItemInfo_obj;
+//search the readable regions for byte patterns, handing every hit to listener.onHit(MemorySearchHit) as it turns up
+static jlongArray search_Memory(JNIEnv *env, jclass obj, jobjectArray patterns, jstring perms, jstring path,
+                                jint context, jint max_hits, jint max_threads, jobject listener) {
+    search_stream stream;
+    /* left as text: parsed here, the bytes would be found in the heap by the search */
+    jsize count = env->GetArrayLength(patterns);
+    for (jsize i = 0; i < count; i++) {
+        jstring text = (jstring) env->GetObjectArrayElement(patterns, i);
+        const char *chars = env->GetStringUTFChars(text, NULL);
+        stream.names.push_back(chars);
+        env->ReleaseStringUTFChars(text, chars);
+        env->DeleteLocalRef(text);
+    }
+    stream.set = NULL;
+    const char *perms_chars = perms != NULL ? env->GetStringUTFChars(perms, NULL) : NULL;
+    const char *path_chars = path != NULL ? env->GetStringUTFChars(path, NULL) : NULL;
+    stream.options.perms = perms_chars != NULL ? maps_parse_perms(perms_chars) : 0;
+    stream.options.path_pattern = path_chars;
+    stream.options.select = NULL;
+    stream.options.context = context > 0 ? context : 0;
+    stream.options.max_hits = max_hits > 0 ? max_hits : 0;
+    stream.options.max_threads = max_threads;
+    jlongArray result = run_search_stream(env, &stream, listener);
+    if (path_chars != NULL) {
+        env->ReleaseStringUTFChars(path, path_chars);
     }
+    if (perms_chars != NULL) {
+        env->ReleaseStringUTFChars(perms, perms_chars);
+    }
+    return result;
+}
+
+//compile a signature source file to the set scanSignatures maps, returns null or what is wrong with the source
+static jstring compile_Signatures(JNIEnv *env, jclass obj, jstring source, jstring blob) {
+    const char *source_chars = env->GetStringUTFChars(source, NULL);
+    const char *blob_chars = env->GetStringUTFChars(blob, NULL);
+    u4 sig_count = 0;
+    std::string error;
+    bool ok = sig_set_compile(source_chars, blob_chars, &sig_count, &error);
+    env->ReleaseStringUTFChars(blob, blob_chars);
+    env->ReleaseStringUTFChars(source, source_chars);
+    return ok ? NULL : env->NewStringUTF(error.c_str());
+}
+
+//scan memory for every signature of a compiled set at once, the loaded modules only unless all_regions
+static jlongArray scan_Signatures(JNIEnv *env, jclass obj, jstring blob, jboolean all_regions, jint context,
+                                  jint max_hits, jint max_threads, jobject listener) {
+    const char *blob_chars = env->GetStringUTFChars(blob, NULL);
+    sig_set set;
+    bool opened = sig_set_open(blob_chars, &set);
+    env->ReleaseStringUTFChars(blob, blob_chars);
+    if (!opened) {
+        return NULL;
+    }
+    search_stream stream;
+    stream.set = &set;
+    for (u4 i = 0; i < set.header->sig_count; i++) {
+        stream.names.push_back(sig_set_name(&set, i));
+    }
+    stream.options.perms = 0;
+    stream.options.path_pattern = NULL;
+    stream.options.select = all_regions ? NULL : sig_scan_module_region;
+    stream.options.context = context > 0 ? context : 0;
+    stream.options.max_hits = max_hits > 0 ? max_hits : 0;
+    stream.options.max_threads = max_threads;
+    jlongArray result = run_search_stream(env, &stream, listener);
+    sig_set_close(&set);
+    return result;
+}
+
+//entropy of every window of the selected regions; the whole map goes to map_path, the runs of high entropy come back
+static jobjectArray entropy_Map(JNIEnv *env, jclass obj, jstring perms, jstring path, jint window, jfloat min_entropy,
+                                jint min_windows, jint max_threads, jstring map_path) {
+    jclass run_class = env->FindClass("com/android/reverse/collecter/EntropyRun");
+    if (run_class == NULL) {
+        return NULL;
+    }
+    const char *perms_chars = perms != NULL ? env->GetStringUTFChars(perms, NULL) : NULL;
+    const char *path_chars = path != NULL ? env->GetStringUTFChars(path, NULL) : NULL;
+    mem_entropy_options options;
+    options.perms = perms_chars != NULL ? maps_parse_perms(perms_chars) : 0;
+    options.path_pattern = path_chars;
+    options.max_region_size = 0;
+    options.window = window > 0 ? window : 0;
+    options.max_threads = max_threads;
+    mem_entropy_map map;
+    mem_entropy_stats stats;
+    bool ok = mem_entropy_scan(&options, &map, &stats);
+    if (path_chars != NULL) {
+        env->ReleaseStringUTFChars(path, path_chars);
+    }
+    if (perms_chars != NULL) {
+        env->ReleaseStringUTFChars(perms, perms_chars);
+    }
+    if (ok && map_path != NULL) {
+        const char *map_chars = env->GetStringUTFChars(map_path, NULL);
+        ok = mem_entropy_write(map_chars, &map);
+        env->ReleaseStringUTFChars(map_path, map_chars);
+    }
+    if (!ok) {
+        return NULL;
+    }
+    float threshold = std::min(std::max(min_entropy, 0.0f), 8.0f);
+    std::vector<mem_entropy_run> runs;
+    mem_entropy_runs(&map, (u2) (threshold * MEM_ENTROPY_ONE_BIT), min_windows > 0 ? min_windows : 1, &runs);
+    jobjectArray result = env->NewObjectArray(runs.size(), run_class, NULL);
+    if (result == NULL) {
+        return NULL;
+    }
+    jfieldID start_field = env->GetFieldID(run_class, "start", "J");
+    jfieldID end_field = env->GetFieldID(run_class, "end", "J");
+    jfieldID region_field = env->GetFieldID(run_class, "region", "Ljava/lang/String;");
+    jfieldID region_start_field = env->GetFieldID(run_class, "regionStart", "J");
+    jfieldID mean_field = env->GetFieldID(run_class, "meanEntropy", "F");
+    jfieldID peak_field = env->GetFieldID(run_class, "peakEntropy", "F");
+    for (size_t i = 0; i < runs.size(); i++) {
+        const mem_entropy_region &region = map.regions[runs[i].region];
+        jobject run_obj = env->AllocObject(run_class);
+        if (run_obj == NULL) {
+            return NULL;
+        }
+        jstring region_path = env->NewStringUTF(region.path);
+        env->SetLongField(run_obj, start_field, (jlong) runs[i].start);
+        env->SetLongField(run_obj, end_field, (jlong) runs[i].end);
+        env->SetObjectField(run_obj, region_field, region_path);
+        env->SetLongField(run_obj, region_start_field, (jlong) region.start);
+        env->SetFloatField(run_obj, mean_field, (jfloat) runs[i].mean / MEM_ENTROPY_ONE_BIT);
+        env->SetFloatField(run_obj, peak_field, (jfloat) runs[i].peak / MEM_ENTROPY_ONE_BIT);
+        env->SetObjectArrayElement(result, i, run_obj);
+        env->DeleteLocalRef(region_path);
+        env->DeleteLocalRef(run_obj);
+    }
+    return result;
 }
 
 struct InlineOperation {
@@ -703,36 +1500,12 @@ struct InlineOperation {
     const char *methodSignature;
 };
 
-typedef const InlineOperation *(*dvmGetInlineOpsTablePtr)();
-
 
 static jobject getInlineOperation(JNIEnv *env, jclass obj) {
     int i;
-    void *libdvm = dlopen("libdvm.so", RTLD_LAZY);
-    if (libdvm == NULL) {
-        LOGV("Failed to load libdvm\n");
-        return NULL;
-    }
-    dvmGetInlineOpsTablePtr dvmGetInlineOpsTable = (dvmGetInlineOpsTablePtr) dlsym(libdvm,
-                                                                                   "dvmGetInlineOpsTable");
-    if (dvmGetInlineOpsTable == NULL) {
-        dvmGetInlineOpsTable = (dvmGetInlineOpsTablePtr) dlsym(libdvm, "_Z20dvmGetInlineOpsTablev");
-    }
-    if (dvmGetInlineOpsTable == NULL) {
+    const runtime_symbols *symbols = runtime_symbols_get();
+    if (symbols->dvmGetInlineOpsTable == NULL || symbols->dvmGetInlineOpsTableLength == NULL) {
         LOGV("Failed to load dvmGetInlineOpsTable\n");
-        dlclose(libdvm);
-        return NULL;
-    }
-    dvmGetInlineOpsTableLengthPtr dvmGetInlineOpsTableLength = (dvmGetInlineOpsTableLengthPtr) dlsym(
-            libdvm,
-            "dvmGetInlineOpsTableLength");
-    if (dvmGetInlineOpsTableLength == NULL) {
-        dvmGetInlineOpsTableLength = (dvmGetInlineOpsTableLengthPtr) dlsym(libdvm,
-                                                                           "_Z26dvmGetInlineOpsTableLengthv");
-    }
-    if (dvmGetInlineOpsTableLength == NULL) {
-        printf("Failed to load dvmGetInlineOpsTableLength\n");
-        dlclose(libdvm);
         return NULL;
     }
     jclass stringBuilder_class = env->FindClass("java/lang/StringBuilder");
@@ -742,8 +1515,8 @@ static jobject getInlineOperation(JNIEnv *env, jclass obj) {
                                                       "(Ljava/lang/String;)Ljava/lang/StringBuilder;");
     jmethodID tostring_method = env->GetMethodID(stringBuilder_class, "toString",
                                                  "()Ljava/lang/String;");
-    const InlineOperation *inlineTable = (InlineOperation *) dvmGetInlineOpsTable();
-    int length = dvmGetInlineOpsTableLength();
+    const InlineOperation *inlineTable = (const InlineOperation *) symbols->dvmGetInlineOpsTable();
+    int length = symbols->dvmGetInlineOpsTableLength();
     char *buffer = (char *) malloc(400);
     for (i = 0; i < length; i++) {
         const InlineOperation *item = &inlineTable[i];
@@ -752,88 +1525,295 @@ static jobject getInlineOperation(JNIEnv *env, jclass obj) {
         jstring descror = env->NewStringUTF(buffer);
         env->CallObjectMethod(stringBuilder_obj, stringbuilder_append, descror);
     }
-    dlclose(libdvm);
+    free(buffer);
     return env->CallObjectMethod(stringBuilder_obj, tostring_method);
 }
 
 
-static jobject getSyslinkSnapshot(JNIEnv *env, jclass obj) {
-
-    jclass hashmap_class = env->FindClass("java/util/HashMap");
-    jmethodID init_hashmap_Method = env->GetMethodID(hashmap_class, "<init>", "()V");
-    jmethodID put_method = env->GetMethodID(hashmap_class, "put",
-                                            "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-    jobject hashmap_obj = env->NewObject(hashmap_class, init_hashmap_Method);
-    jclass long_class = env->FindClass("java/lang/Integer");
-    jmethodID init_long_Method = env->GetMethodID(long_class, "<init>", "(I)V");
-
-    FILE *m = NULL;
-    char maps[80];
-    char line[200];
-    char soaddrs[20];
-    char soaddr[10];
-    char soname[60];
-    char prop[10];
-    long soaddval;
-    long base;
-    memset(maps, 0, sizeof(maps));
-    memset(soaddrs, 0, sizeof(soaddrs));
-    memset(soaddr, 0, sizeof(soaddr));
-    sprintf(maps, "/proc/self/maps");
-    m = fopen(maps, "r");
-    if (!m) {
-        LOGE("open maps error");
-        return hashmap_obj;
-    }
-    while (fgets(line, sizeof(line), m)) {
-        int found = 0;
-        struct elf_info einfo;
-        long tmpaddr = 0;
-
-        if (strstr(line, ".so") == NULL)
-            continue;
-        if (strstr(line, "r-xp") == NULL)
-            continue;
-        sscanf(line, "%s %s %*s %*s %*s %s", soaddrs, prop, soname);
-        sscanf(soaddrs, "%[^-]", soaddr);
-
-        jstring so_name_jstr = env->NewStringUTF(soname);
-        jobject syslist_obj = env->NewObject(hashmap_class, init_hashmap_Method);
-        env->CallObjectMethod(hashmap_obj, put_method, so_name_jstr, syslist_obj);
-
-        base = strtoul(soaddr, NULL, 16);
-        get_elf_info(1, base, &einfo);
-
-        Elf32_Rel rel;
-        Elf32_Sym sym;
-        unsigned int i;
-        char *sym_name = NULL;
-        unsigned int fuction_point;
-        struct dyn_info dinfo;
-        get_dyn_info(&einfo, &dinfo);
-        for (i = 0; i < dinfo.nrels; i++) {
-            memcpy((void *) &rel, (void *) ((unsigned int) (dinfo.jmprel + i * sizeof(Elf32_Rel))),
-                   sizeof(Elf32_Rel));
-            if (ELF32_R_SYM(rel.r_info)) {
-                memcpy((void *) &sym,
-                       (void *) (dinfo.symtab + ELF32_R_SYM(rel.r_info) * sizeof(Elf32_Sym)),
-                       sizeof(Elf32_Sym));
-                sym_name = readstr(einfo.pid, dinfo.strtab + sym.st_name);
-                jstring sym_name_jstr = env->NewStringUTF(sym_name);
-                fuction_point = ((einfo.ehdr.e_type == ET_DYN) ? einfo.base : 0) + rel.r_offset;
-                jobject long_obj = env->NewObject(long_class, init_long_Method,
-                                                  fuction_point);
-                env->CallObjectMethod(syslist_obj, put_method, sym_name_jstr, long_obj);
-                env->ReleaseStringUTFChars(sym_name_jstr, sym_name);
-                env->DeleteLocalRef(sym_name_jstr);
-                env->DeleteLocalRef(long_obj);
-            }
+//a slot value for java, where an unreadable one is -1 whatever the pointer size
+static jlong slot_value(uintptr_t value) {
+    return value == GOT_SLOT_UNREADABLE ? -1 : (jlong) value;
+}
+
+//GotSlotChange[] from native changes
+static jobjectArray new_GotSlotChange_array(JNIEnv *env, const std::vector<got_change> &changes) {
+    jclass change_class = env->FindClass("com/android/reverse/collecter/GotSlotChange");
+    if (change_class == NULL) {
+        return NULL;
+    }
+    jfieldID library_field = env->GetFieldID(change_class, "library", "Ljava/lang/String;");
+    jfieldID symbol_field = env->GetFieldID(change_class, "symbol", "Ljava/lang/String;");
+    jfieldID slot_field = env->GetFieldID(change_class, "slot", "J");
+    jfieldID old_value_field = env->GetFieldID(change_class, "oldValue", "J");
+    jfieldID new_value_field = env->GetFieldID(change_class, "newValue", "J");
+    jfieldID time_field = env->GetFieldID(change_class, "time", "J");
+    jobjectArray result = env->NewObjectArray(changes.size(), change_class, NULL);
+    if (result == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < changes.size(); i++) {
+        jobject change_obj = env->AllocObject(change_class);
+        jstring library = env->NewStringUTF(got_name(changes[i].lib));
+        jstring symbol = env->NewStringUTF(got_name(changes[i].sym));
+        env->SetObjectField(change_obj, library_field, library);
+        env->SetObjectField(change_obj, symbol_field, symbol);
+        env->SetLongField(change_obj, slot_field, (jlong) changes[i].slot);
+        env->SetLongField(change_obj, old_value_field, slot_value(changes[i].old_value));
+        env->SetLongField(change_obj, new_value_field, slot_value(changes[i].new_value));
+        env->SetLongField(change_obj, time_field, (jlong) changes[i].time_ms);
+        env->SetObjectArrayElement(result, i, change_obj);
+        env->DeleteLocalRef(library);
+        env->DeleteLocalRef(symbol);
+        env->DeleteLocalRef(change_obj);
+    }
+    return result;
+}
+
+//snapshot the PLT slots of every loaded library, the handle is released by releaseGotSnapshot
+static jlong take_GotSnapshot(JNIEnv *env, jclass obj) {
+    got_snapshot *snapshot = new got_snapshot;
+    if (!got_snapshot_take(snapshot)) {
+        delete snapshot;
+        return 0;
+    }
+    return (jlong) (uintptr_t) snapshot;
+}
+
+static void release_GotSnapshot(JNIEnv *env, jclass obj, jlong handle) {
+    delete (got_snapshot *) (uintptr_t) handle;
+}
+
+//compare the snapshot against the slots as they are now, return only the changed ones as GotSlotChange[]
+static jobjectArray diff_GotSnapshot(JNIEnv *env, jclass obj, jlong handle) {
+    if (handle == 0) {
+        return NULL;
+    }
+    u8 start = dump_now_ns();
+    got_snapshot current;
+    if (!got_snapshot_take(&current)) {
+        return NULL;
+    }
+    std::vector<got_change> changes;
+    got_snapshot_diff((const got_snapshot *) (uintptr_t) handle, &current, &changes);
+    LOGV("got diff: %u changed slots in %u us", (unsigned int) changes.size(),
+         (unsigned int) ((dump_now_ns() - start) / 1000));
+
+    return new_GotSlotChange_array(env, changes);
+}
+
+//start the GOT monitor thread, or change its interval if it runs already
+static jboolean start_GotMonitor(JNIEnv *env, jclass obj, jint interval_ms) {
+    return got_monitor_start(interval_ms > 0 ? interval_ms : GOTMON_DEFAULT_INTERVAL_MS) ? JNI_TRUE : JNI_FALSE;
+}
+
+static void stop_GotMonitor(JNIEnv *env, jclass obj) {
+    got_monitor_stop();
+}
+
+//the changes the monitor logged since the last drain, oldest first
+static jobjectArray drain_GotMonitor(JNIEnv *env, jclass obj) {
+    std::vector<got_change> changes;
+    size_t dropped = got_monitor_drain(&changes);
+    if (dropped > 0) {
+        LOGE("got monitor log overflowed, %u changes dropped", (unsigned int) dropped);
+    }
+    return new_GotSlotChange_array(env, changes);
+}
+
+//start the native trace; events are appended to path in batches until traceStop
+static jboolean start_Trace(JNIEnv *env, jclass obj, jstring path, jint slots) {
+    const char *file_path = env->GetStringUTFChars(path, NULL);
+    bool ok = trace_start(file_path, slots > 0 ? slots : 0);
+    env->ReleaseStringUTFChars(path, file_path);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+//flush and close the trace, returns {records, dropped, bytes, elapsed ns} or null if none was running
+static jlongArray stop_Trace(JNIEnv *env, jclass obj) {
+    trace_stats stats;
+    if (!trace_stop(&stats)) {
+        return NULL;
+    }
+    jlong values[4] = {(jlong) stats.records, (jlong) stats.dropped, (jlong) stats.bytes, (jlong) stats.elapsed_ns};
+    jlongArray array = env->NewLongArray(4);
+    if (array != NULL) {
+        env->SetLongArrayRegion(array, 0, 4, values);
+    }
+    return array;
+}
+
+static void define_TraceEvent(JNIEnv *env, jclass obj, jint event, jstring name) {
+    const char *chars = env->GetStringUTFChars(name, NULL);
+    trace_define(event, chars);
+    env->ReleaseStringUTFChars(name, chars);
+}
+
+//the fast path: two longs of payload, nothing allocated
+static jboolean trace_Event(JNIEnv *env, jclass obj, jint event, jlong arg0, jlong arg1) {
+    jlong payload[2] = {arg0, arg1};
+    return trace_event(event, payload, sizeof(payload), 0) ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean trace_Text(JNIEnv *env, jclass obj, jint event, jstring text) {
+    if (!trace_running() || text == NULL) {
+        return JNI_FALSE;
+    }
+    char buffer[TRACE_TEXT_MAX + 1];
+    jsize chars = env->GetStringLength(text);
+    jsize length = env->GetStringUTFLength(text);
+    if (length > TRACE_TEXT_MAX) {
+        /* a char is 3 bytes of modified UTF-8 at most */
+        chars = std::min(chars, (jsize) (TRACE_TEXT_MAX / 3));
+        length = -1;
+        /* modified UTF-8 has no zero bytes, so what was copied ends at the first one */
+        memset(buffer, 0, sizeof(buffer));
+    }
+    env->GetStringUTFRegion(text, 0, chars, buffer);
+    if (length < 0) {
+        length = strlen(buffer);
+    }
+    return trace_text(event, buffer, length) ? JNI_TRUE : JNI_FALSE;
+}
+
+/* set once in JNI_OnLoad; the job workers attach themselves through it */
+static JavaVM *java_vm = NULL;
+
+static JNIEnv *job_env() {
+    JNIEnv *env = NULL;
+    if (java_vm->GetEnv((void **) &env, JNI_VERSION_1_4) == JNI_OK) {
+        return env;
+    }
+    /* workers live as long as the process, so they stay attached */
+    JavaVMAttachArgs args = {JNI_VERSION_1_4, "zjdroid-job", NULL};
+    if (java_vm->AttachCurrentThread(&env, &args) != JNI_OK) {
+        LOGE("attach a job worker to the vm failed");
+        return NULL;
+    }
+    return env;
+}
+
+//a job is a Runnable, held by a global ref until the job is over
+static bool run_java_job(void *arg) {
+    JNIEnv *env = job_env();
+    if (env == NULL || env->PushLocalFrame(16) != JNI_OK) {
+        return false;
+    }
+    jobject runnable = (jobject) arg;
+    jclass runnable_class = env->GetObjectClass(runnable);
+    env->CallVoidMethod(runnable, env->GetMethodID(runnable_class, "run", "()V"));
+    bool ok = !env->ExceptionCheck();
+    if (!ok) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+    /* what the job left in the frame would pile up on a thread that never returns to java */
+    env->PopLocalFrame(NULL);
+    return ok;
+}
+
+static void release_java_job(void *arg) {
+    JNIEnv *env = job_env();
+    if (env != NULL) {
+        env->DeleteGlobalRef((jobject) arg);
+    }
+}
+
+//queue runnable on the native job pool, return {job id, 1 if a live job with the same key was returned instead}
+static jintArray submit_Job(JNIEnv *env, jclass obj, jstring kind, jstring key, jobject runnable) {
+    jobject ref = env->NewGlobalRef(runnable);
+    if (ref == NULL) {
+        return NULL;
+    }
+    const char *kind_chars = env->GetStringUTFChars(kind, NULL);
+    const char *key_chars = key != NULL ? env->GetStringUTFChars(key, NULL) : NULL;
+    bool existing;
+    u4 id = job_submit(kind_chars, key_chars, run_java_job, ref, release_java_job, &existing);
+    if (key_chars != NULL) {
+        env->ReleaseStringUTFChars(key, key_chars);
+    }
+    env->ReleaseStringUTFChars(kind, kind_chars);
+    jint values[2] = {(jint) id, existing ? 1 : 0};
+    jintArray array = env->NewIntArray(2);
+    if (array != NULL) {
+        env->SetIntArrayRegion(array, 0, 2, values);
+    }
+    return array;
+}
+
+//the job id (every job the engine remembers if id <= 0): running, queued, then finished ones
+static jobjectArray status_Job(JNIEnv *env, jclass obj, jint id) {
+    jclass info_class = env->FindClass("com/android/reverse/collecter/JobInfo");
+    if (info_class == NULL) {
+        return NULL;
+    }
+    std::vector<job_info> infos;
+    if (id > 0) {
+        job_info info;
+        if (job_get(id, &info)) {
+            infos.push_back(info);
+        }
+    } else {
+        job_list(&infos);
+    }
+    jobjectArray result = env->NewObjectArray(infos.size(), info_class, NULL);
+    if (result == NULL) {
+        return NULL;
+    }
+    jfieldID id_field = env->GetFieldID(info_class, "id", "I");
+    jfieldID state_field = env->GetFieldID(info_class, "state", "I");
+    jfieldID kind_field = env->GetFieldID(info_class, "kind", "Ljava/lang/String;");
+    jfieldID key_field = env->GetFieldID(info_class, "key", "Ljava/lang/String;");
+    jfieldID unit_field = env->GetFieldID(info_class, "unit", "Ljava/lang/String;");
+    jfieldID done_field = env->GetFieldID(info_class, "done", "J");
+    jfieldID total_field = env->GetFieldID(info_class, "total", "J");
+    jfieldID cancel_field = env->GetFieldID(info_class, "cancelRequested", "Z");
+    jfieldID wait_field = env->GetFieldID(info_class, "waitNs", "J");
+    jfieldID run_field = env->GetFieldID(info_class, "runNs", "J");
+    for (size_t i = 0; i < infos.size(); i++) {
+        const job_info &info = infos[i];
+        jobject info_obj = env->AllocObject(info_class);
+        if (info_obj == NULL) {
+            return NULL;
         }
-        env->ReleaseStringUTFChars(so_name_jstr, soname);
-        env->DeleteLocalRef(so_name_jstr);
-        env->DeleteLocalRef(syslist_obj);
+        jstring kind = env->NewStringUTF(info.kind.c_str());
+        jstring key = env->NewStringUTF(info.key.c_str());
+        jstring unit = env->NewStringUTF(info.unit.c_str());
+        env->SetIntField(info_obj, id_field, (jint) info.id);
+        env->SetIntField(info_obj, state_field, info.state);
+        env->SetObjectField(info_obj, kind_field, kind);
+        env->SetObjectField(info_obj, key_field, key);
+        env->SetObjectField(info_obj, unit_field, unit);
+        env->SetLongField(info_obj, done_field, (jlong) info.done);
+        env->SetLongField(info_obj, total_field, (jlong) info.total);
+        env->SetBooleanField(info_obj, cancel_field, info.cancel_requested ? JNI_TRUE : JNI_FALSE);
+        env->SetLongField(info_obj, wait_field, (jlong) info.wait_ns);
+        env->SetLongField(info_obj, run_field, (jlong) info.run_ns);
+        env->SetObjectArrayElement(result, i, info_obj);
+        env->DeleteLocalRef(kind);
+        env->DeleteLocalRef(key);
+        env->DeleteLocalRef(unit);
+        env->DeleteLocalRef(info_obj);
     }
-    return hashmap_obj;
+    return result;
+}
+
+static jboolean cancel_Job(JNIEnv *env, jclass obj, jint id) {
+    return id > 0 && job_cancel(id) ? JNI_TRUE : JNI_FALSE;
+}
+
+//for the java side of a job: done of total units so far; nothing outside a job
+static void progress_Job(JNIEnv *env, jclass obj, jstring unit, jlong done, jlong total) {
+    if (job_current() == NULL) {
+        return;
+    }
+    const char *unit_chars = env->GetStringUTFChars(unit, NULL);
+    job_progress_begin(unit_chars, total);
+    job_progress_add(done);
+    env->ReleaseStringUTFChars(unit, unit_chars);
+}
+
+static jboolean cancelled_Job(JNIEnv *env, jclass obj) {
+    return job_cancelled() ? JNI_TRUE : JNI_FALSE;
 }
 
 JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
@@ -842,14 +1822,58 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
     if (vm->GetEnv((void **) &env, JNI_VERSION_1_4) != JNI_OK) {
         return JNI_ERR;
     }
+    java_vm = vm;
+    //the vm entry points are looked up once here, every later dump only calls through them
+    runtime_symbols_init();
 
 
     JNINativeMethod gMethods[] = {{"dumpDexFileByClass",  "(Ljava/lang/Class;I)Ljava/nio/ByteBuffer;",             (void *) dump_ClassObject_DvmDex_MemMap},
                                   {"dumpDexFileByCookie", "(JI)Ljava/nio/ByteBuffer;",                             (void *) dump_DexFile_mCookie_DexOrJar_memMap},
                                   {"dumpMemory",          "(JI)Ljava/nio/ByteBuffer;",                             (void *) dump_Memory},
+                                  {"getDexFileRegion",    "(JI)[J",                                                (void *) getDexFileRegion},
+                                  {"dumpDexFileToFile",   "(JILjava/lang/String;IZ)[J",                            (void *) dump_DexFile_to_file},
+                                  {"readMemory",          "(JI[B)[B",                                              (void *) read_Memory},
+                                  {"dumpMemoryToFile",    "(JJLjava/lang/String;I)[J",                             (void *) dump_Memory_to_file},
+                                  {"snapshotMemory",      "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;J)[J", (void *) snapshot_Memory},
+                                  {"rebuildDexFile",      "(JILjava/lang/String;)[J",                              (void *) rebuild_DexFile},
+                                  {"harvestDexCode",      "(JILjava/lang/String;Ljava/lang/String;I)[J",           (void *) harvest_DexCode},
+                                  {"fixDexFileChecksum",  "(Ljava/lang/String;Z)[J",                               (void *) fix_DexFile_checksum},
+                                  {"benchmarkDexSum",     "(I)[J",                                                 (void *) benchmark_DexSum},
+                                  {"dumpAllDexFiles",     "([JI[Ljava/lang/String;IZ)[J",                          (void *) dump_AllDexFiles},
+                                  {"scanDexFiles",        "(I)[Lcom/android/reverse/collecter/DexMemoryHit;",      (void *) scan_DexFiles},
+                                  {"scanInlinePatches",   "(I)[Lcom/android/reverse/collecter/InlinePatch;",       (void *) scan_InlinePatches},
+                                  {"searchMemory",        "([Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;IIILcom/android/reverse/collecter/MemorySearchListener;)[J", (void *) search_Memory},
+                                  {"compileSignatures",   "(Ljava/lang/String;Ljava/lang/String;)Ljava/lang/String;", (void *) compile_Signatures},
+                                  {"scanSignatures",      "(Ljava/lang/String;ZIIILcom/android/reverse/collecter/MemorySearchListener;)[J", (void *) scan_Signatures},
+                                  {"entropyMap",          "(Ljava/lang/String;Ljava/lang/String;IFIILjava/lang/String;)[Lcom/android/reverse/collecter/EntropyRun;", (void *) entropy_Map},
+                                  {"traceStart",          "(Ljava/lang/String;I)Z",                                (void *) start_Trace},
+                                  {"traceStop",           "()[J",                                                  (void *) stop_Trace},
+                                  {"traceDefineEvent",    "(ILjava/lang/String;)V",                                (void *) define_TraceEvent},
+                                  {"traceEvent",          "(IJJ)Z",                                                (void *) trace_Event},
+                                  {"traceText",           "(ILjava/lang/String;)Z",                                (void *) trace_Text},
+                                  {"jobSubmit",           "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/Runnable;)[I", (void *) submit_Job},
+                                  {"jobStatus",           "(I)[Lcom/android/reverse/collecter/JobInfo;",           (void *) status_Job},
+                                  {"jobCancel",           "(I)Z",                                                  (void *) cancel_Job},
+                                  {"jobProgress",         "(Ljava/lang/String;JJ)V",                               (void *) progress_Job},
+                                  {"jobCancelled",        "()Z",                                                   (void *) cancelled_Job},
                                   {"getHeaderItemPtr",    "(JI)Lcom/android/reverse/smali/DexFileHeadersPointer;", (void *) getHeaderItemPtr},
+                                  {"listDexClasses",      "(JILjava/lang/String;)[B",                              (void *) list_DexClasses},
+                                  {"beginDumpDelta",      "(JILjava/lang/String;)J",                               (void *) begin_DumpDelta},
+                                  {"nextDumpDelta",       "(JLjava/lang/String;)[J",                               (void *) next_DumpDelta},
+                                  {"endDumpDelta",        "(J)V",                                                  (void *) end_DumpDelta},
+                                  {"openDexIndex",        "(JILjava/lang/String;I)[J",                             (void *) open_DexIndex},
+                                  {"findDexIndexClass",   "(JILjava/lang/String;Ljava/lang/String;)I",             (void *) find_DexIndexClass},
+                                  {"findDexIndexString",  "(JILjava/lang/String;Ljava/lang/String;)I",             (void *) find_DexIndexString},
+                                  {"getDexIndexCode",     "(JILjava/lang/String;I)J",                              (void *) get_DexIndexCode},
+                                  {"listDexIndexClasses", "(JILjava/lang/String;Ljava/lang/String;)[B",            (void *) list_DexIndexClasses},
+                                  {"getDexIndexClassOrder", "(JILjava/lang/String;)[I",                            (void *) get_DexIndexClassOrder},
                                   {"getInlineOperation",  "()Ljava/lang/String;",                                  (void *) getInlineOperation},
-                                  {"getSyslinkSnapshot",  "()Ljava/util/HashMap;",                                 (void *) getSyslinkSnapshot},
+                                  {"takeGotSnapshot",     "()J",                                                   (void *) take_GotSnapshot},
+                                  {"diffGotSnapshot",     "(J)[Lcom/android/reverse/collecter/GotSlotChange;",     (void *) diff_GotSnapshot},
+                                  {"releaseGotSnapshot",  "(J)V",                                                  (void *) release_GotSnapshot},
+                                  {"startGotMonitor",     "(I)Z",                                                  (void *) start_GotMonitor},
+                                  {"stopGotMonitor",      "()V",                                                   (void *) stop_GotMonitor},
+                                  {"drainGotMonitor",     "()[Lcom/android/reverse/collecter/GotSlotChange;",      (void *) drain_GotMonitor},
 //                                   { "getMethodInst", "(Ljava/lang/reflect/Method;)Ljava/nio/ByteBuffer;;", (void*) getMethodInst },
     };
     jclass clazz = env->FindClass("com/android/reverse/util/NativeFunction");
@@ -1,9 +1,14 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+#include <map>
 #include "elfinfo.h"
 #include <link.h>
 #include <elf.h>
 #include "util.h"
+#include "mapsindex.h"
 #include <android/log.h>
 
 char * readstr(int pid, unsigned long addr) {
@@ -44,211 +49,581 @@ char * readstr(int pid, unsigned long addr) {
 	return str;
 }
 
-void get_elf_info(int pid, Elf32_Addr base, struct elf_info *einfo) {
+/*
+ * The types of one ELF class. The readers below are templates over it and are only
+ * instantiated for the class of this process (elf_native), so their loops carry no
+ * run-time class checks.
+ */
+template <int CLASS> struct elf_class;
+
+template <> struct elf_class<ELFCLASS32> {
+	typedef Elf32_Ehdr Ehdr;
+	typedef Elf32_Phdr Phdr;
+	typedef Elf32_Dyn Dyn;
+	typedef Elf32_Sym Sym;
+	typedef Elf32_Rel Rel;
+	typedef Elf32_Rela Rela;
+	typedef Elf32_Addr Addr;
+	static u4 r_sym(Elf32_Word info) { return ELF32_R_SYM(info); }
+	static u4 r_type(Elf32_Word info) { return ELF32_R_TYPE(info); }
+};
+
+template <> struct elf_class<ELFCLASS64> {
+	typedef Elf64_Ehdr Ehdr;
+	typedef Elf64_Phdr Phdr;
+	typedef Elf64_Dyn Dyn;
+	typedef Elf64_Sym Sym;
+	typedef Elf64_Rel Rel;
+	typedef Elf64_Rela Rela;
+	typedef Elf64_Addr Addr;
+	static u4 r_sym(Elf64_Xword info) { return ELF64_R_SYM(info); }
+	static u4 r_type(Elf64_Xword info) { return ELF64_R_TYPE(info); }
+};
+
+/* every LP64 android abi uses RELA, the 32-bit ones REL */
+#if defined(__LP64__)
+#define ELF_NATIVE_CLASS ELFCLASS64
+#define ELF_NATIVE_PLTREL DT_RELA
+#else
+#define ELF_NATIVE_CLASS ELFCLASS32
+#define ELF_NATIVE_PLTREL DT_REL
+#endif
+typedef elf_class<ELF_NATIVE_CLASS> elf_native;
+
+/* the relocation that fills a GOT entry with a symbol's address outside the PLT */
+#if defined(__aarch64__)
+#define ELF_R_GLOB_DAT 1025	/* R_AARCH64_GLOB_DAT */
+#elif defined(__arm__)
+#define ELF_R_GLOB_DAT 21	/* R_ARM_GLOB_DAT */
+#elif defined(__x86_64__) || defined(__i386__)
+#define ELF_R_GLOB_DAT 6	/* R_X86_64_GLOB_DAT, R_386_GLOB_DAT */
+#endif
+
+/* bionic leaves .dynamic alone, but a loader may have relocated the pointers in place (glibc does) */
+static ElfW(Addr) dyn_ptr(ElfW(Addr) bias, ElfW(Addr) ptr) {
+	return bias != 0 && ptr >= bias ? ptr : bias + ptr;
+}
+
+void get_elf_info(int pid, ElfW(Addr) base, struct elf_info *einfo) {
 	int i = 0;
+	memset(einfo, 0, sizeof(*einfo));
 	einfo->pid = pid;
 	einfo->base = base;
-	memcpy((void*)&einfo->ehdr, (void*)einfo->base, sizeof(Elf32_Ehdr));
+	memcpy((void*)&einfo->ehdr, (void*)einfo->base, sizeof(ElfW(Ehdr)));
 	einfo->phdr_addr = einfo->base + einfo->ehdr.e_phoff;
 
-	memcpy((void*)&einfo->phdr, (void*)einfo->phdr_addr, sizeof(Elf32_Phdr));
 	for (i = 0; i < einfo->ehdr.e_phnum; i++) {
-		Elf32_Phdr phdr;
-		memcpy((void*)&phdr, (void*)(einfo->phdr_addr + i * sizeof(Elf32_Phdr)),
-				sizeof(Elf32_Phdr));
-	}
-	while (einfo->phdr.p_type != PT_DYNAMIC) {
-		memcpy((void*)&einfo->phdr, (void*)(einfo->phdr_addr += sizeof(Elf32_Phdr)),
-				sizeof(Elf32_Phdr));
+		memcpy((void*)&einfo->phdr, (void*)(einfo->phdr_addr + i * sizeof(ElfW(Phdr))),
+				sizeof(ElfW(Phdr)));
+		if (einfo->phdr.p_type == PT_DYNAMIC)
+			break;
 	}
+	if (i == einfo->ehdr.e_phnum)
+		return;
 	einfo->dynaddr = (IS_DYN(einfo) ? einfo->base : 0) + einfo->phdr.p_vaddr;
-	memcpy((void*)&einfo->dyn, (void*)einfo->dynaddr, sizeof(Elf32_Dyn));
-	while (einfo->dyn.d_tag != DT_PLTGOT) {
-		memcpy((void*)&einfo->dyn, (void*)(einfo->dynaddr + i * sizeof(Elf32_Dyn)),
-				sizeof(Elf32_Dyn));
-		i++;
+	for (i = 0;; i++) {
+		memcpy((void*)&einfo->dyn, (void*)(einfo->dynaddr + i * sizeof(ElfW(Dyn))),
+				sizeof(ElfW(Dyn)));
+		if (einfo->dyn.d_tag == DT_PLTGOT || einfo->dyn.d_tag == DT_NULL)
+			break;
 	}
-	einfo->got = (IS_DYN(einfo) ? einfo->base : 0)
-			+ (Elf32_Word) einfo->dyn.d_un.d_ptr;
-	memcpy((void*)&einfo->map_addr,(void*)(einfo->got + 4), 4);
+	if (einfo->dyn.d_tag != DT_PLTGOT)
+		return;
+	einfo->got = dyn_ptr(IS_DYN(einfo) ? einfo->base : 0, einfo->dyn.d_un.d_ptr);
+	memcpy((void*)&einfo->map_addr, (void*)(einfo->got + sizeof(ElfW(Addr))), sizeof(ElfW(Addr)));
 }
 
 unsigned long find_sym_in_rel(struct elf_info *einfo, char *sym_name) {
-	Elf32_Rel rel;
-	Elf32_Sym sym;
-	unsigned int i;
-	char *str = NULL;
-	unsigned long ret;
-	struct dyn_info dinfo;
-	get_dyn_info(einfo, &dinfo);
-	for (i = 0; i < dinfo.nrels; i++) {
-		memcpy((void*)&rel, (void*)((unsigned long) (dinfo.jmprel + i * sizeof(Elf32_Rel))),
-				sizeof(Elf32_Rel));
-		if (ELF32_R_SYM(rel.r_info)) {
-			memcpy((void*)&sym,
-					(void*)(dinfo.symtab + ELF32_R_SYM(rel.r_info) * sizeof(Elf32_Sym)),
-					sizeof(Elf32_Sym));
-			str = readstr(einfo->pid, dinfo.strtab + sym.st_name);
-			if (strcmp(str, sym_name) == 0) {
-				free(str);
-				break;
-			}
-			free(str);
-		}
-	}
-	if (i == dinfo.nrels)
-		ret = 0;
-	else {
-		ret = (IS_DYN(einfo) ? einfo->base : 0) + rel.r_offset;
-	}
-	return ret;
+	const struct elf_index *index = elf_index_get(einfo->base);
+	if (index == NULL)
+		return 0;
+	return elf_index_find_import(index, sym_name);
 }
 
 void get_dyn_info(struct elf_info *einfo, struct dyn_info *dinfo) {
-	Elf32_Dyn dyn;
+	ElfW(Dyn) dyn;
+	ElfW(Addr) bias = IS_DYN(einfo) ? einfo->base : 0;
 	int i = 0;
-	memcpy((void*)&dyn, (void*)(einfo->dynaddr + i * sizeof(Elf32_Dyn)), sizeof(Elf32_Dyn));
+	memset(dinfo, 0, sizeof(*dinfo));
+	if (einfo->dynaddr == 0)
+		return;
+	memcpy((void*)&dyn, (void*)(einfo->dynaddr + i * sizeof(ElfW(Dyn))), sizeof(ElfW(Dyn)));
 	i++;
 	while (dyn.d_tag) {
 		switch (dyn.d_tag) {
 		case DT_SYMTAB:
-			dinfo->symtab = (IS_DYN(einfo) ? einfo->base : 0) + dyn.d_un.d_ptr;
+			dinfo->symtab = dyn_ptr(bias, dyn.d_un.d_ptr);
 			break;
 		case DT_STRTAB:
-			dinfo->strtab = (IS_DYN(einfo) ? einfo->base : 0) + dyn.d_un.d_ptr;
+			dinfo->strtab = dyn_ptr(bias, dyn.d_un.d_ptr);
 			break;
 		case DT_JMPREL:
-			dinfo->jmprel = (IS_DYN(einfo) ? einfo->base : 0) + dyn.d_un.d_ptr;
+			dinfo->jmprel = dyn_ptr(bias, dyn.d_un.d_ptr);
 			break;
 		case DT_PLTRELSZ:
 			dinfo->totalrelsize = dyn.d_un.d_val;
 			break;
-		case DT_RELAENT:
-			dinfo->relsize = dyn.d_un.d_val;
+		case DT_PLTREL:
+			dinfo->pltrel = dyn.d_un.d_val;
 			break;
-		case DT_RELENT:
-			dinfo->relsize = dyn.d_un.d_val;
+		case DT_REL:
+		case DT_RELA:
+			dinfo->rel = dyn_ptr(bias, dyn.d_un.d_ptr);
+			dinfo->rel_is_rela = dyn.d_tag == DT_RELA;
+			break;
+		case DT_RELSZ:
+		case DT_RELASZ:
+			dinfo->relsz = dyn.d_un.d_val;
+			break;
+		case DT_ANDROID_REL:
+		case DT_ANDROID_RELA:
+			dinfo->packed = dyn_ptr(bias, dyn.d_un.d_ptr);
+			dinfo->packed_is_rela = dyn.d_tag == DT_ANDROID_RELA;
+			break;
+		case DT_ANDROID_RELSZ:
+		case DT_ANDROID_RELASZ:
+			dinfo->packedsz = dyn.d_un.d_val;
+			break;
+		case DT_TEXTREL:
+			dinfo->textrel = true;
+			break;
+		case DT_FLAGS:
+			if (dyn.d_un.d_val & DF_TEXTREL)
+				dinfo->textrel = true;
+			break;
+		case DT_GNU_HASH:
+			dinfo->gnu_hash = dyn_ptr(bias, dyn.d_un.d_ptr);
+			break;
+		case DT_HASH:
+			dinfo->sysv_hash = dyn_ptr(bias, dyn.d_un.d_ptr);
 			break;
 		}
-		memcpy((void*)&dyn, (void*)(einfo->dynaddr + i * sizeof(Elf32_Dyn)), sizeof(Elf32_Dyn));
+		memcpy((void*)&dyn, (void*)(einfo->dynaddr + i * sizeof(ElfW(Dyn))), sizeof(ElfW(Dyn)));
 		i++;
 	}
-	if (dinfo->relsize == 0) {
-		dinfo->relsize = 8;
-	}
+	/* DT_PLTREL says which of the two the PLT entries are, DT_RELENT/DT_RELAENT can be absent */
+	if (dinfo->pltrel == 0)
+		dinfo->pltrel = ELF_NATIVE_PLTREL;
+	dinfo->relsize = dinfo->pltrel == DT_RELA ? sizeof(ElfW(Rela)) : sizeof(ElfW(Rel));
 	dinfo->nrels = dinfo->totalrelsize / dinfo->relsize;
 
 }
 
-bool replace_all_rels(char *libpath, char *fucation_name, void *newFun_ptr) {
-	LOGV("get into replace_all_rels");
-	FILE *m = NULL;
-	char maps[80];
-	char line[200];
-	char soaddrs[20];
-	char soaddr[10];
-	char soname[60];
-	char prop[10];
-	long soaddval;
-	long base;
-	int result = false;
-	memset(maps, 0, sizeof(maps));
-	memset(soaddrs, 0, sizeof(soaddrs));
-	memset(soaddr, 0, sizeof(soaddr));
-	sprintf(maps, "/proc/self/maps");
-	m = fopen(maps, "r");
-	if (!m) {
-		LOGE("open maps error");
-		return result;
-	}
-	while (fgets(line, sizeof(line), m)) {
-		int found = 0;
+u4 elf_gnu_hash(const char *name) {
+	u4 h = 5381;
+	for (const u1 *p = (const u1 *) name; *p; p++)
+		h = h * 33 + *p;
+	return h;
+}
+
+static u4 elf_sysv_hash(const char *name) {
+	u4 h = 0, g;
+	for (const u1 *p = (const u1 *) name; *p; p++) {
+		h = (h << 4) + *p;
+		g = h & 0xf0000000;
+		h ^= g >> 24;
+		h &= ~g;
+	}
+	return h;
+}
+
+static bool import_before(const struct elf_import &a, const struct elf_import &b) {
+	return a.hash < b.hash;
+}
+
+template <typename E>
+static void add_import(struct elf_index *index, u4 sym, typename E::Addr offset) {
+	const typename E::Sym *syms = (const typename E::Sym *) index->dinfo.symtab;
+	struct elf_import import;
+	import.name = (const char *) (index->dinfo.strtab + syms[sym].st_name);
+	import.hash = elf_gnu_hash(import.name);
+	import.slot = index->bias + offset;
+	index->imports.push_back(import);
+}
+
+/*
+ * The relocation tables are walked with a visitor, visit(r_offset, r_info), so the import
+ * table and the text scan share one decoder per format.
+ * R is E::Rel or E::Rela, both start with r_offset and r_info.
+ */
+template <typename E, typename R, typename V>
+static void visit_rels(const R *rels, size_t count, V &visit) {
+	for (size_t i = 0; i < count; i++)
+		visit(rels[i].r_offset, rels[i].r_info);
+}
+
+static ElfW(Sxword) read_sleb128(const u1 **cursor, const u1 *end) {
+	ElfW(Sxword) value = 0;
+	size_t shift = 0;
+	u1 byte;
+	do {
+		if (*cursor >= end)
+			return 0;
+		byte = *(*cursor)++;
+		value |= (ElfW(Sxword)) (byte & 0x7f) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+	if (shift < sizeof(value) * 8 && (byte & 0x40))
+		value |= -((ElfW(Sxword)) 1 << shift);
+	return value;
+}
+
+#define PACKED_GROUPED_BY_INFO		1
+#define PACKED_GROUPED_BY_OFFSET_DELTA	2
+#define PACKED_GROUPED_BY_ADDEND	4
+#define PACKED_GROUP_HAS_ADDEND		8
+
+/*
+ * Walk a DT_ANDROID_REL(A) table: "APS2", the count and first offset, then groups that
+ * share their offset delta, info or addend. The addends are decoded only to keep the
+ * stream in step, the visitors need offsets and infos.
+ */
+template <typename E, bool RELA, typename V>
+static void visit_packed(const u1 *data, size_t size, V &visit) {
+	const u1 *end = data + size;
+	if (size < 4 || memcmp(data, "APS2", 4) != 0)
+		return;
+	data += 4;
+	ElfW(Sxword) count = read_sleb128(&data, end);
+	typename E::Addr offset = read_sleb128(&data, end);
+	for (ElfW(Sxword) done = 0; done < count && data < end;) {
+		ElfW(Sxword) group_size = read_sleb128(&data, end);
+		ElfW(Sxword) flags = read_sleb128(&data, end);
+		ElfW(Sxword) offset_delta = 0;
+		ElfW(Sxword) info = 0;
+		if (flags & PACKED_GROUPED_BY_OFFSET_DELTA)
+			offset_delta = read_sleb128(&data, end);
+		if (flags & PACKED_GROUPED_BY_INFO)
+			info = read_sleb128(&data, end);
+		if (RELA && (flags & PACKED_GROUP_HAS_ADDEND) && (flags & PACKED_GROUPED_BY_ADDEND))
+			read_sleb128(&data, end);
+		if (group_size <= 0)
+			break;
+		for (ElfW(Sxword) i = 0; i < group_size && data < end; i++, done++) {
+			offset += (flags & PACKED_GROUPED_BY_OFFSET_DELTA) ? offset_delta : read_sleb128(&data, end);
+			if (!(flags & PACKED_GROUPED_BY_INFO))
+				info = read_sleb128(&data, end);
+			if (RELA && (flags & PACKED_GROUP_HAS_ADDEND) && !(flags & PACKED_GROUPED_BY_ADDEND))
+				read_sleb128(&data, end);
+			visit(offset, info);
+		}
+	}
+}
+
+/* everything outside the PLT: DT_REL or DT_RELA, and the packed table */
+template <typename E, typename V>
+static void visit_dyn_rels(const struct dyn_info *dinfo, V &visit) {
+	if (dinfo->rel != 0) {
+		if (dinfo->rel_is_rela)
+			visit_rels<E>((const typename E::Rela *) dinfo->rel, dinfo->relsz / sizeof(typename E::Rela), visit);
+		else
+			visit_rels<E>((const typename E::Rel *) dinfo->rel, dinfo->relsz / sizeof(typename E::Rel), visit);
+	}
+	if (dinfo->packed != 0) {
+		if (dinfo->packed_is_rela)
+			visit_packed<E, true>((const u1 *) dinfo->packed, dinfo->packedsz, visit);
+		else
+			visit_packed<E, false>((const u1 *) dinfo->packed, dinfo->packedsz, visit);
+	}
+}
+
+template <typename E, typename V>
+static void visit_plt_rels(const struct dyn_info *dinfo, V &visit) {
+	if (dinfo->jmprel == 0)
+		return;
+	if (dinfo->pltrel == DT_RELA)
+		visit_rels<E>((const typename E::Rela *) dinfo->jmprel, dinfo->nrels, visit);
+	else
+		visit_rels<E>((const typename E::Rel *) dinfo->jmprel, dinfo->nrels, visit);
+}
+
+/* every PLT relocation with a symbol, and the GLOB_DAT ones elsewhere */
+template <typename E>
+struct import_visitor {
+	struct elf_index *index;
+	bool plt;
+
+	void operator()(typename E::Addr offset, ElfW(Xword) info) {
+		u4 sym = E::r_sym(info);
+		if (sym == 0)
+			return;
+#ifdef ELF_R_GLOB_DAT
+		if (!plt && E::r_type(info) != ELF_R_GLOB_DAT)
+			return;
+#else
+		if (!plt)
+			return;
+#endif
+		add_import<E>(index, sym, offset);
+	}
+};
+
+template <typename E>
+static void build_imports(struct elf_index *index) {
+	const struct dyn_info *dinfo = &index->dinfo;
+	if (dinfo->symtab == 0 || dinfo->strtab == 0)
+		return;
+	import_visitor<E> visit;
+	visit.index = index;
+	visit.plt = true;
+	index->imports.reserve(dinfo->nrels);
+	visit_plt_rels<E>(dinfo, visit);
+	visit.plt = false;
+	visit_dyn_rels<E>(dinfo, visit);
+	/* stable, so a name's PLT slot stays ahead of its GLOB_DAT ones */
+	std::stable_sort(index->imports.begin(), index->imports.end(), import_before);
+}
+
+template <typename E>
+struct offset_visitor {
+	ElfW(Addr) bias;
+	std::vector<ElfW(Addr)> *offsets;
+
+	void operator()(typename E::Addr offset, ElfW(Xword) info) {
+		offsets->push_back(bias + offset);
+	}
+};
+
+void elf_index_relocations(const struct elf_index *index, std::vector<ElfW(Addr)> *targets) {
+	offset_visitor<elf_native> visit;
+	visit.bias = index->bias;
+	visit.offsets = targets;
+	visit_plt_rels<elf_native>(&index->dinfo, visit);
+	visit_dyn_rels<elf_native>(&index->dinfo, visit);
+}
+
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<ElfW(Addr), struct elf_index *> indexes;
+
+const struct elf_index *elf_index_get(ElfW(Addr) base) {
+	ElfW(Ehdr) ehdr;
+	memcpy(&ehdr, (void *) base, sizeof(ehdr));
+	if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELF_NATIVE_CLASS)
+		return NULL;
+	pthread_mutex_lock(&index_lock);
+	struct elf_index *&cached = indexes[base];
+	/* another library may have been loaded at the same address since; the old index is kept alive */
+	if (cached == NULL || memcmp(&cached->ehdr, &ehdr, sizeof(ehdr)) != 0) {
 		struct elf_info einfo;
-		long tmpaddr = 0;
+		struct elf_index *index = new elf_index;
+		get_elf_info(1, base, &einfo);
+		get_dyn_info(&einfo, &index->dinfo);
+		index->base = base;
+		index->bias = IS_DYN((&einfo)) ? base : 0;
+		index->ehdr = ehdr;
+		index->symbols_built = false;
+		build_imports<elf_native>(index);
+		cached = index;
+	}
+	struct elf_index *index = cached;
+	pthread_mutex_unlock(&index_lock);
+	return index;
+}
 
-		if (strstr(line, ".so") == NULL)
-			continue;
-		if (strstr(line, "r-xp") == NULL)
+ElfW(Addr) elf_index_find_import(const struct elf_index *index, const char *name) {
+	struct elf_import key;
+	key.hash = elf_gnu_hash(name);
+	std::vector<struct elf_import>::const_iterator it =
+			std::lower_bound(index->imports.begin(), index->imports.end(), key, import_before);
+	for (; it != index->imports.end() && it->hash == key.hash; ++it) {
+		if (strcmp(it->name, name) == 0)
+			return it->slot;
+	}
+	return 0;
+}
+
+template <typename E>
+static ElfW(Addr) defined_symbol(const struct elf_index *index, u4 sym) {
+	const typename E::Sym *syms = (const typename E::Sym *) index->dinfo.symtab;
+	if (syms[sym].st_shndx == SHN_UNDEF)
+		return 0;
+	return index->bias + syms[sym].st_value;
+}
+
+template <typename E>
+static ElfW(Addr) gnu_lookup(const struct elf_index *index, const char *name) {
+	const u4 *table = (const u4 *) index->dinfo.gnu_hash;
+	u4 nbuckets = table[0], symoffset = table[1], bloom_size = table[2], bloom_shift = table[3];
+	/* bloom words are address sized */
+	const typename E::Addr *bloom = (const typename E::Addr *) (table + 4);
+	const u4 *buckets = (const u4 *) (bloom + bloom_size);
+	const u4 *chain = buckets + nbuckets;
+	const typename E::Sym *syms = (const typename E::Sym *) index->dinfo.symtab;
+	const u4 word_bits = sizeof(typename E::Addr) * 8;
+	u4 hash = elf_gnu_hash(name);
+
+	if (nbuckets == 0 || bloom_size == 0)
+		return 0;
+	typename E::Addr word = bloom[(hash / word_bits) % bloom_size];
+	typename E::Addr mask = ((typename E::Addr) 1 << (hash % word_bits)) |
+			((typename E::Addr) 1 << ((hash >> bloom_shift) % word_bits));
+	if ((word & mask) != mask)
+		return 0;
+	u4 sym = buckets[hash % nbuckets];
+	if (sym < symoffset)
+		return 0;
+	for (;; sym++) {
+		u4 chain_hash = chain[sym - symoffset];
+		if ((chain_hash | 1) == (hash | 1) &&
+				strcmp((const char *) (index->dinfo.strtab + syms[sym].st_name), name) == 0)
+			return defined_symbol<E>(index, sym);
+		if (chain_hash & 1)
+			return 0;
+	}
+}
+
+template <typename E>
+static ElfW(Addr) sysv_lookup(const struct elf_index *index, const char *name) {
+	const u4 *table = (const u4 *) index->dinfo.sysv_hash;
+	u4 nbucket = table[0];
+	const u4 *buckets = table + 2;
+	const u4 *chain = buckets + nbucket;
+	const typename E::Sym *syms = (const typename E::Sym *) index->dinfo.symtab;
+
+	if (nbucket == 0)
+		return 0;
+	for (u4 sym = buckets[elf_sysv_hash(name) % nbucket]; sym != STN_UNDEF; sym = chain[sym]) {
+		if (strcmp((const char *) (index->dinfo.strtab + syms[sym].st_name), name) == 0)
+			return defined_symbol<E>(index, sym);
+	}
+	return 0;
+}
+
+ElfW(Addr) elf_index_find_export(const struct elf_index *index, const char *name) {
+	if (index->dinfo.symtab == 0 || index->dinfo.strtab == 0)
+		return 0;
+	if (index->dinfo.gnu_hash != 0)
+		return gnu_lookup<elf_native>(index, name);
+	if (index->dinfo.sysv_hash != 0)
+		return sysv_lookup<elf_native>(index, name);
+	return 0;
+}
+
+/* .dynsym has no size of its own: DT_HASH has it as nchain, DT_GNU_HASH at the end of the last chain */
+template <typename E>
+static u4 dynsym_count(const struct dyn_info *dinfo) {
+	if (dinfo->sysv_hash != 0)
+		return ((const u4 *) dinfo->sysv_hash)[1];
+	if (dinfo->gnu_hash == 0)
+		return 0;
+	const u4 *table = (const u4 *) dinfo->gnu_hash;
+	u4 nbuckets = table[0], symoffset = table[1], bloom_size = table[2];
+	const u4 *buckets = (const u4 *) ((const typename E::Addr *) (table + 4) + bloom_size);
+	const u4 *chain = buckets + nbuckets;
+	u4 last = 0;
+	for (u4 i = 0; i < nbuckets; i++) {
+		if (buckets[i] > last)
+			last = buckets[i];
+	}
+	if (last < symoffset)
+		return symoffset;
+	while (!(chain[last - symoffset] & 1))
+		last++;
+	return last + 1;
+}
+
+static bool symbol_before(const struct elf_symbol &a, const struct elf_symbol &b) {
+	return a.addr < b.addr;
+}
+
+template <typename E>
+static void build_symbols(const struct elf_index *index) {
+	const typename E::Sym *syms = (const typename E::Sym *) index->dinfo.symtab;
+	u4 count = dynsym_count<E>(&index->dinfo);
+	for (u4 i = 1; i < count; i++) {
+		if (syms[i].st_shndx == SHN_UNDEF || syms[i].st_value == 0)
 			continue;
-		if (strstr(line, libpath) != NULL) {
-			found = 1;
-		}
-		if (!found) {
+		u1 type = ELF32_ST_TYPE(syms[i].st_info);
+		if (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE)
 			continue;
-		}
-		sscanf(line, "%s %s %*s %*s %*s %s", soaddrs, prop, soname);
-		sscanf(soaddrs, "%[^-]", soaddr);
-		LOGV("#### %s %s %s\n", soaddr, prop, soname);
-		base = strtoul(soaddr, NULL, 16);
-		get_elf_info(1, base, &einfo);
-		
-		tmpaddr = find_sym_in_rel(&einfo, fucation_name);
-		if (tmpaddr != 0) {
-			memcpy((void*)tmpaddr, (void*)&newFun_ptr, 4);
-            result = true;
-            LOGV(" the function %s is hook sucessfully",fucation_name);
-		} else {
-			LOGV(" the function %s is hook fail",fucation_name);
-		}
-		return result;
+		struct elf_symbol symbol;
+		symbol.addr = index->bias + syms[i].st_value;
+		symbol.size = syms[i].st_size;
+		symbol.name = (const char *) (index->dinfo.strtab + syms[i].st_name);
+		index->symbols.push_back(symbol);
+	}
+	std::sort(index->symbols.begin(), index->symbols.end(), symbol_before);
+}
+
+const struct elf_symbol *elf_index_nearest_symbol(const struct elf_index *index, ElfW(Addr) addr) {
+	if (index->dinfo.symtab == 0 || index->dinfo.strtab == 0)
+		return NULL;
+	pthread_mutex_lock(&index_lock);
+	if (!index->symbols_built) {
+		build_symbols<elf_native>(index);
+		index->symbols_built = true;
+	}
+	pthread_mutex_unlock(&index_lock);
+	struct elf_symbol key;
+	key.addr = addr;
+	std::vector<struct elf_symbol>::const_iterator it =
+			std::upper_bound(index->symbols.begin(), index->symbols.end(), key, symbol_before);
+	if (it == index->symbols.begin())
+		return NULL;
+	return &*--it;
+}
+
+/*
+ * libpath is looked up in the shared maps index: a full path, or just the file name.
+ * The elf header sits at the start of the lowest mapping at file offset 0.
+ */
+static bool find_lib_base(char *libpath, long *base) {
+	uintptr_t addr;
+	if (!maps_module_base(libpath, &addr)) {
+		LOGE("can not find %s in the maps", libpath);
+		return false;
 	}
+	*base = addr;
+	LOGV("#### %s loaded at %lx\n", libpath, *base);
+	return true;
 }
 
-bool replace_certain_rels(char *libpath, char* fucation_name[], u4 newFun_ptr[], int size) {
+bool replace_all_rels(char *libpath, char *fucation_name, void *newFun_ptr) {
 	LOGV("get into replace_all_rels");
-	FILE *m = NULL;
-	char maps[80];
-	char line[200];
-	char soaddrs[20];
-	char soaddr[10];
-	char soname[60];
-	char prop[10];
-	long soaddval;
+	const struct elf_index *index;
 	long base;
-	int result = false;
-	memset(maps, 0, sizeof(maps));
-	memset(soaddrs, 0, sizeof(soaddrs));
-	memset(soaddr, 0, sizeof(soaddr));
-	sprintf(maps, "/proc/self/maps");
-	m = fopen(maps, "r");
-	if (!m) {
-		LOGE("open maps error");
-		return result;
-	}
-	while (fgets(line, sizeof(line), m)) {
-		int found = 0;
-		struct elf_info einfo;
-		long tmpaddr = 0;
+	long tmpaddr = 0;
+	if (!find_lib_base(libpath, &base)) {
+		return false;
+	}
+	index = elf_index_get(base);
+	if (index == NULL) {
+		return false;
+	}
 
-		if (strstr(line, ".so") == NULL)
-			continue;
-		if (strstr(line, "r-xp") == NULL)
-			continue;
-		if (strstr(line, libpath) != NULL) {
-			found = 1;
-		}
-		if (!found) {
-			continue;
-		}
-		sscanf(line, "%s %s %*s %*s %*s %s", soaddrs, prop, soname);
-		sscanf(soaddrs, "%[^-]", soaddr);
-		LOGV("#### %s %s %s\n", soaddr, prop, soname);
-		base = strtoul(soaddr, NULL, 16);
-		puint(base);
-		get_elf_info(1, base, &einfo);
-		int i =0;
-		for(i=0; i<size; i++){
-		   	tmpaddr = find_sym_in_rel(&einfo, fucation_name[i]);
-		    if (tmpaddr != 0) {
-			   memcpy((void*)tmpaddr, (void*)newFun_ptr[i], 4);
-               LOGV(" the function %s is hook sucessfully",fucation_name[i]);
-		    } else {
-		      return result;
-			  LOGV(" the function %s is hook fail",fucation_name[i]);
-		    }
-		}
-		result = true;
-		return result;
+	tmpaddr = elf_index_find_import(index, fucation_name);
+	if (tmpaddr == 0) {
+		LOGV(" the function %s is hook fail",fucation_name);
+		return false;
 	}
+	memcpy((void*)tmpaddr, (void*)&newFun_ptr, sizeof(newFun_ptr));
+	LOGV(" the function %s is hook sucessfully",fucation_name);
+	return true;
 }
 
+bool replace_certain_rels(char *libpath, char* fucation_name[], uintptr_t newFun_ptr[], int size) {
+	LOGV("get into replace_certain_rels");
+	const struct elf_index *index;
+	long base;
+	long tmpaddr = 0;
+	if (!find_lib_base(libpath, &base)) {
+		return false;
+	}
+	puint(base);
+	/* one index for the whole batch, each name is then a hashed lookup */
+	index = elf_index_get(base);
+	if (index == NULL) {
+		return false;
+	}
+	int i =0;
+	for(i=0; i<size; i++){
+		tmpaddr = elf_index_find_import(index, fucation_name[i]);
+		if (tmpaddr == 0) {
+			LOGV(" the function %s is hook fail",fucation_name[i]);
+			return false;
+		}
+		memcpy((void*)tmpaddr, (void*)&newFun_ptr[i], sizeof(newFun_ptr[i]));
+		LOGV(" the function %s is hook sucessfully",fucation_name[i]);
+	}
+	return true;
+}
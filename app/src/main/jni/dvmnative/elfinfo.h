@@ -1,37 +1,114 @@
 #ifndef ELFINFO_H_
 #define ELFINFO_H_
 #include <elf.h>
+#include <link.h>
+#include <vector>
 #include "util.h"
 
+/* older platform headers have no ElfW */
+#ifndef ElfW
+#if defined(__LP64__)
+#define ElfW(type) Elf64_ ## type
+#else
+#define ElfW(type) Elf32_ ## type
+#endif
+#endif
+#ifndef DT_GNU_HASH
+#define DT_GNU_HASH 0x6ffffef5
+#endif
+/* bionic's packed relocations ("APS2" + sleb128), see the linker's packed_reloc_iterator */
+#ifndef DT_ANDROID_REL
+#define DT_ANDROID_REL      0x6000000f
+#define DT_ANDROID_RELSZ    0x60000010
+#define DT_ANDROID_RELA     0x60000011
+#define DT_ANDROID_RELASZ   0x60000012
+#endif
+
+/*
+ * Everything here is in the ELF class of this process (ElfW), the only class a library
+ * loaded into it can have; elfinfo.cpp instantiates its readers for that class only.
+ */
 struct dyn_info {
-	Elf32_Addr symtab;
-	Elf32_Addr strtab;
-	Elf32_Addr jmprel;
-	Elf32_Word totalrelsize;
-	Elf32_Word relsize;
-	Elf32_Word nrels;
+	ElfW(Addr) symtab;
+	ElfW(Addr) strtab;
+	ElfW(Addr) jmprel;
+	ElfW(Word) totalrelsize;
+	ElfW(Word) relsize;
+	ElfW(Word) nrels;
+	ElfW(Addr) gnu_hash;
+	ElfW(Addr) sysv_hash;
+	ElfW(Word) pltrel;		/* DT_REL or DT_RELA, the kind of the DT_JMPREL entries */
+	ElfW(Addr) rel;			/* DT_REL or DT_RELA table and its size */
+	ElfW(Word) relsz;
+	bool rel_is_rela;
+	ElfW(Addr) packed;		/* DT_ANDROID_REL or DT_ANDROID_RELA table and its size */
+	ElfW(Word) packedsz;
+	bool packed_is_rela;
+	bool textrel;			/* DT_TEXTREL or DF_TEXTREL: relocations may patch the code */
 
 };
 
 struct elf_info {
 	int pid;
-	Elf32_Addr base;
-	Elf32_Ehdr ehdr;
-	Elf32_Phdr phdr;
-	Elf32_Dyn dyn;
-	Elf32_Addr dynaddr;
-	Elf32_Word got;
-	Elf32_Addr phdr_addr;
-	Elf32_Addr map_addr;
-	Elf32_Word nchains;
+	ElfW(Addr) base;
+	ElfW(Ehdr) ehdr;
+	ElfW(Phdr) phdr;
+	ElfW(Dyn) dyn;
+	ElfW(Addr) dynaddr;
+	ElfW(Addr) got;
+	ElfW(Addr) phdr_addr;
+	ElfW(Addr) map_addr;
+	ElfW(Word) nchains;
+
+};
+
+/* one imported slot: the name points into the mapped .dynstr, nothing is copied */
+struct elf_import {
+	u4 hash;
+	const char *name;
+	ElfW(Addr) slot;
+};
+
+/* a symbol the library defines, for address to name lookups */
+struct elf_symbol {
+	ElfW(Addr) addr;
+	ElfW(Word) size;
+	const char *name;	/* in the mapped .dynstr */
+};
 
+/*
+ * Per-library lookup tables, built once and cached by load address. Exports are found
+ * through the library's own DT_GNU_HASH/DT_HASH; imports are not in the GNU hash, so
+ * they get a table of their own built in one pass over the PLT relocations and the
+ * GLOB_DAT ones of DT_REL/DT_RELA/DT_ANDROID_REL(A).
+ */
+struct elf_index {
+	ElfW(Addr) base;
+	ElfW(Addr) bias;
+	ElfW(Ehdr) ehdr;
+	struct dyn_info dinfo;
+	std::vector<struct elf_import> imports;	/* sorted by hash, PLT slots first */
+	/* defined symbols by address, only built by the first elf_index_nearest_symbol */
+	mutable std::vector<struct elf_symbol> symbols;
+	mutable bool symbols_built;
 };
 
 #define IS_DYN(_einfo) (_einfo->ehdr.e_type == ET_DYN)
-void get_elf_info(int pid, Elf32_Addr base, struct elf_info *einfo);
+void get_elf_info(int pid, ElfW(Addr) base, struct elf_info *einfo);
 unsigned long find_sym_in_rel(struct elf_info *einfo, char *sym_name);
 void get_dyn_info(struct elf_info *einfo, struct dyn_info *dinfo);
 bool replace_all_rels(char* libpath, char *fucation_name, void *newFun_ptr);
-bool replace_certain_rels(char *libpath, char* fucation_name[], u4 newFun_ptr[], int size);
+bool replace_certain_rels(char *libpath, char* fucation_name[], uintptr_t newFun_ptr[], int size);
 char * readstr(int pid, unsigned long addr);
+u4 elf_gnu_hash(const char *name);
+/* the index of the library whose elf header is at base; never freed, NULL if base is no elf */
+const struct elf_index *elf_index_get(ElfW(Addr) base);
+/* GOT slot of an imported function, 0 if the library does not import it */
+ElfW(Addr) elf_index_find_import(const struct elf_index *index, const char *name);
+/* address of a symbol the library defines, 0 if not found */
+ElfW(Addr) elf_index_find_export(const struct elf_index *index, const char *name);
+/* the defined symbol at or before addr, NULL if there is none */
+const struct elf_symbol *elf_index_nearest_symbol(const struct elf_index *index, ElfW(Addr) addr);
+/* the target address of every relocation of the library, PLT ones included */
+void elf_index_relocations(const struct elf_index *index, std::vector<ElfW(Addr)> *targets);
 #endif
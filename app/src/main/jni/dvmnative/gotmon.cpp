@@ -0,0 +1,260 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <android/log.h>
+#include "gotmon.h"
+#include "dexsum.h"
+#include "dumpfile.h"
+#include "mapsindex.h"
+#include "memread.h"
+
+struct watched_lib {
+    got_library lib;
+    uintptr_t got_start;
+    uintptr_t got_end;
+    u4 hash;
+    std::vector<got_slot> slots;    /* by slot address, values as last seen */
+};
+
+/* guards everything shared with the callers: run state, interval and the log */
+static pthread_mutex_t monitor_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t monitor_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t monitor_thread;
+static bool monitor_running = false;
+static bool monitor_stopping = false;
+static u4 monitor_interval_ms = GOTMON_DEFAULT_INTERVAL_MS;
+static std::deque<got_change> monitor_log;
+static size_t monitor_dropped = 0;
+
+/* only touched by the monitor thread */
+static std::vector<watched_lib> watched;
+static std::vector<u1> got_buffer;
+static u4 watched_generation;
+static u8 maps_read_ns;
+
+static u8 wall_clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (u8) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool slot_addr_before(const got_slot &a, const got_slot &b) {
+    return a.slot < b.slot;
+}
+
+/* the slot span of a library, read through mem_read so an unloaded library cannot fault us */
+static const u1 *read_got(const watched_lib *lib) {
+    size_t length = lib->got_end - lib->got_start;
+    if (got_buffer.size() < length)
+        got_buffer.resize(length);
+    if (mem_read((const void *) lib->got_start, &got_buffer[0], length) != (ssize_t) length)
+        return NULL;
+    return &got_buffer[0];
+}
+
+static bool watch_library(const got_library *library, watched_lib *lib) {
+    lib->lib = *library;
+    lib->slots.clear();
+    if (got_read_library(library, &lib->slots) == 0)
+        return false;
+    std::sort(lib->slots.begin(), lib->slots.end(), slot_addr_before);
+    lib->got_start = lib->slots.front().slot;
+    lib->got_end = lib->slots.back().slot + sizeof(uintptr_t);
+    const u1 *got = read_got(lib);
+    if (got == NULL)
+        return false;
+    lib->hash = adler32(1, got, lib->got_end - lib->got_start);
+    /* the baseline is what the slots hold now, not what they held when read above */
+    for (size_t i = 0; i < lib->slots.size(); i++)
+        memcpy(&lib->slots[i].value, got + (lib->slots[i].slot - lib->got_start), sizeof(uintptr_t));
+    return true;
+}
+
+static bool library_before(const watched_lib &a, const got_library &b) {
+    return a.lib.base < b.base;
+}
+
+static bool base_before(const got_library &a, const got_library &b) {
+    return a.base < b.base;
+}
+
+/* follow the libraries in the maps: keep the known ones, baseline new ones, drop the gone */
+static void sync_libraries() {
+    std::vector<got_library> libs;
+    got_libraries(&libs);
+    std::sort(libs.begin(), libs.end(), base_before);
+    std::vector<watched_lib> next;
+    next.reserve(libs.size());
+    for (size_t i = 0; i < libs.size(); i++) {
+        std::vector<watched_lib>::iterator known =
+                std::lower_bound(watched.begin(), watched.end(), libs[i], library_before);
+        next.push_back(watched_lib());
+        if (known != watched.end() && known->lib.base == libs[i].base && known->lib.path == libs[i].path) {
+            next.back().slots.swap(known->slots);
+            next.back().lib = known->lib;
+            next.back().got_start = known->got_start;
+            next.back().got_end = known->got_end;
+            next.back().hash = known->hash;
+        } else if (!watch_library(&libs[i], &next.back())) {
+            next.pop_back();
+        }
+    }
+    watched.swap(next);
+}
+
+static void check_library(watched_lib *lib, std::vector<got_change> *changes) {
+    const u1 *got = read_got(lib);
+    if (got == NULL)
+        return;
+    u4 hash = adler32(1, got, lib->got_end - lib->got_start);
+    if (hash == lib->hash)
+        return;
+    lib->hash = hash;
+    u8 now = wall_clock_ms();
+    for (size_t i = 0; i < lib->slots.size(); i++) {
+        got_slot *slot = &lib->slots[i];
+        uintptr_t value;
+        memcpy(&value, got + (slot->slot - lib->got_start), sizeof(value));
+        if (value == slot->value)
+            continue;
+        got_change change;
+        change.lib = slot->lib;
+        change.sym = slot->sym;
+        change.slot = slot->slot;
+        change.old_value = slot->value;
+        change.new_value = value;
+        change.time_ms = now;
+        changes->push_back(change);
+        slot->value = value;
+    }
+}
+
+static void monitor_tick() {
+    /*
+     * reading the maps costs more than hashing every GOT, so at short intervals new libraries
+     * are looked for only every GOTMON_MAPS_INTERVAL_MS (or when someone else refreshed them);
+     * one unloaded in between just fails its mem_read until then
+     */
+    u8 now_ns = dump_now_ns();
+    bool maps_read = now_ns - maps_read_ns >= (u8) GOTMON_MAPS_INTERVAL_MS * 1000000;
+    if (maps_read) {
+        maps_refresh();
+        maps_read_ns = now_ns;
+    }
+    u4 generation = maps_generation();
+    if (generation != watched_generation || (maps_read && watched.empty())) {
+        sync_libraries();
+        watched_generation = generation;
+    }
+    std::vector<got_change> changes;
+    for (size_t i = 0; i < watched.size(); i++)
+        check_library(&watched[i], &changes);
+    if (changes.empty())
+        return;
+    pthread_mutex_lock(&monitor_lock);
+    for (size_t i = 0; i < changes.size(); i++) {
+        if (monitor_log.size() >= GOTMON_LOG_SIZE) {
+            monitor_log.pop_front();
+            monitor_dropped++;
+        }
+        monitor_log.push_back(changes[i]);
+    }
+    pthread_mutex_unlock(&monitor_lock);
+    LOGV("got monitor: %u slots changed", (unsigned int) changes.size());
+}
+
+static void *monitor_main(void *arg) {
+    u8 busy_ns = 0;
+    u4 ticks = 0;
+    watched_generation = maps_generation();
+    maps_read_ns = dump_now_ns();
+    sync_libraries();
+    pthread_mutex_lock(&monitor_lock);
+    while (!monitor_stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += monitor_interval_ms / 1000;
+        deadline.tv_nsec += (long) (monitor_interval_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        int waited = 0;
+        while (!monitor_stopping && waited != ETIMEDOUT)
+            waited = pthread_cond_timedwait(&monitor_wake, &monitor_lock, &deadline);
+        if (monitor_stopping)
+            break;
+        pthread_mutex_unlock(&monitor_lock);
+
+        u8 start = dump_now_ns();
+        monitor_tick();
+        busy_ns += dump_now_ns() - start;
+        if (++ticks % 64 == 0) {
+            LOGV("got monitor: %u libraries, %u us per tick", (unsigned int) watched.size(),
+                 (unsigned int) (busy_ns / ticks / 1000));
+        }
+        pthread_mutex_lock(&monitor_lock);
+    }
+    pthread_mutex_unlock(&monitor_lock);
+    std::vector<watched_lib>().swap(watched);
+    std::vector<u1>().swap(got_buffer);
+    return NULL;
+}
+
+bool got_monitor_start(u4 interval_ms) {
+    if (interval_ms < GOTMON_MIN_INTERVAL_MS)
+        interval_ms = GOTMON_MIN_INTERVAL_MS;
+    pthread_mutex_lock(&monitor_lock);
+    monitor_interval_ms = interval_ms;
+    if (monitor_running) {
+        /* the running thread picks the new interval up from its next wait */
+        pthread_mutex_unlock(&monitor_lock);
+        return true;
+    }
+    monitor_stopping = false;
+    int error = pthread_create(&monitor_thread, NULL, monitor_main, NULL);
+    monitor_running = error == 0;
+    pthread_mutex_unlock(&monitor_lock);
+    if (error != 0) {
+        LOGE("start got monitor failed: %s", strerror(error));
+        return false;
+    }
+    LOGV("got monitor started, every %u ms", interval_ms);
+    return true;
+}
+
+void got_monitor_stop() {
+    pthread_mutex_lock(&monitor_lock);
+    if (!monitor_running) {
+        pthread_mutex_unlock(&monitor_lock);
+        return;
+    }
+    monitor_stopping = true;
+    pthread_cond_signal(&monitor_wake);
+    pthread_mutex_unlock(&monitor_lock);
+    pthread_join(monitor_thread, NULL);
+    pthread_mutex_lock(&monitor_lock);
+    monitor_running = false;
+    pthread_mutex_unlock(&monitor_lock);
+    LOGV("got monitor stopped");
+}
+
+bool got_monitor_running() {
+    pthread_mutex_lock(&monitor_lock);
+    bool running = monitor_running;
+    pthread_mutex_unlock(&monitor_lock);
+    return running;
+}
+
+size_t got_monitor_drain(std::vector<got_change> *changes) {
+    pthread_mutex_lock(&monitor_lock);
+    changes->insert(changes->end(), monitor_log.begin(), monitor_log.end());
+    monitor_log.clear();
+    size_t dropped = monitor_dropped;
+    monitor_dropped = 0;
+    pthread_mutex_unlock(&monitor_lock);
+    return dropped;
+}
@@ -0,0 +1,33 @@
+#ifndef GOTMON_H_
+#define GOTMON_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "util.h"
+#include "gotsnap.h"
+
+#define GOTMON_DEFAULT_INTERVAL_MS  1000
+#define GOTMON_MIN_INTERVAL_MS      10
+/* how often the maps are read for libraries loaded since, whatever the interval */
+#define GOTMON_MAPS_INTERVAL_MS     1000
+/* changes kept until drained, the oldest are dropped beyond that */
+#define GOTMON_LOG_SIZE             4096
+
+/*
+ * Opt-in background watch over the GOT of every loaded library. Each tick hashes the span
+ * of each library's import slots (one adler32 pass, vectorized where the cpu allows) and
+ * only walks the slots of a library whose hash moved, logging every changed slot with
+ * the time it was seen. Libraries loaded later are picked up when the maps change, which
+ * is looked at once every GOTMON_MAPS_INTERVAL_MS at most.
+ */
+
+/* start the monitor, or change the interval of the running one */
+bool got_monitor_start(u4 interval_ms);
+
+void got_monitor_stop();
+
+bool got_monitor_running();
+
+/* move the logged changes out, oldest first; returns how many were dropped since the last drain */
+size_t got_monitor_drain(std::vector<got_change> *changes);
+#endif
@@ -0,0 +1,140 @@
+#include <pthread.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <android/log.h>
+#include "gotsnap.h"
+#include "elfinfo.h"
+#include "mapsindex.h"
+#include "memread.h"
+
+static pthread_mutex_t names_lock = PTHREAD_MUTEX_INITIALIZER;
+/* map nodes never move, so the key's c_str() can be handed out as the name */
+static std::unordered_map<std::string, u4> name_ids;
+static std::vector<const char *> names;
+
+/* call with names_lock held */
+static u4 intern_name(const char *name) {
+    std::pair<std::unordered_map<std::string, u4>::iterator, bool> entry =
+            name_ids.insert(std::make_pair(std::string(name), (u4) names.size()));
+    if (entry.second)
+        names.push_back(entry.first->first.c_str());
+    return entry.first->second;
+}
+
+const char *got_name(u4 id) {
+    pthread_mutex_lock(&names_lock);
+    const char *name = id < names.size() ? names[id] : "";
+    pthread_mutex_unlock(&names_lock);
+    return name;
+}
+
+/*
+ * call with names_lock held. The slots are read in one span through mem_read, as the monitor
+ * does, so a library unloaded under us leaves its slots GOT_SLOT_UNREADABLE instead of faulting.
+ */
+static size_t read_lib_slots(const got_library *library, std::vector<got_slot> *slots) {
+    const struct elf_index *index = elf_index_get(library->base);
+    if (index == NULL || index->imports.empty())
+        return 0;
+    uintptr_t got_start = index->imports[0].slot;
+    uintptr_t got_end = got_start;
+    for (size_t i = 0; i < index->imports.size(); i++) {
+        got_start = std::min(got_start, index->imports[i].slot);
+        got_end = std::max(got_end, index->imports[i].slot + sizeof(uintptr_t));
+    }
+    std::vector<u1> got(got_end - got_start);
+    ssize_t got_length = mem_read((const void *) got_start, &got[0], got.size());
+    u4 lib = intern_name(library->path);
+    for (size_t i = 0; i < index->imports.size(); i++) {
+        const struct elf_import &import = index->imports[i];
+        got_slot slot;
+        slot.lib = lib;
+        slot.sym = intern_name(import.name);
+        slot.slot = import.slot;
+        size_t offset = slot.slot - got_start;
+        if (got_length >= (ssize_t) (offset + sizeof(slot.value)))
+            memcpy(&slot.value, &got[offset], sizeof(slot.value));
+        else
+            slot.value = GOT_SLOT_UNREADABLE;
+        slots->push_back(slot);
+    }
+    return index->imports.size();
+}
+
+void got_libraries(std::vector<got_library> *libs) {
+    std::vector<map_region> maps;
+    maps_snapshot(&maps);
+    for (size_t region = 0; region < maps.size(); region++) {
+        got_library lib;
+        lib.path = maps[region].path;
+        if (!(maps[region].perms & MAPS_PERM_EXEC) || strstr(lib.path, ".so") == NULL)
+            continue;
+        /* one entry per library, whichever of its segments is executable */
+        if (region > 0 && maps[region - 1].path == lib.path && (maps[region - 1].perms & MAPS_PERM_EXEC))
+            continue;
+        if (!maps_module_base(lib.path, &lib.base))
+            continue;
+        libs->push_back(lib);
+    }
+}
+
+size_t got_read_library(const got_library *lib, std::vector<got_slot> *slots) {
+    pthread_mutex_lock(&names_lock);
+    size_t count = read_lib_slots(lib, slots);
+    pthread_mutex_unlock(&names_lock);
+    return count;
+}
+
+static bool slot_before(const got_slot &a, const got_slot &b) {
+    if (a.lib != b.lib)
+        return a.lib < b.lib;
+    if (a.sym != b.sym)
+        return a.sym < b.sym;
+    return a.slot < b.slot;
+}
+
+bool got_snapshot_take(got_snapshot *snapshot) {
+    std::vector<got_library> libs;
+    got_libraries(&libs);
+    snapshot->slots.clear();
+    snapshot->lib_count = libs.size();
+    pthread_mutex_lock(&names_lock);
+    for (size_t i = 0; i < libs.size(); i++)
+        read_lib_slots(&libs[i], &snapshot->slots);
+    pthread_mutex_unlock(&names_lock);
+    std::sort(snapshot->slots.begin(), snapshot->slots.end(), slot_before);
+    LOGV("got snapshot: %u slots in %u libraries", (unsigned int) snapshot->slots.size(), snapshot->lib_count);
+    return true;
+}
+
+size_t got_snapshot_diff(const got_snapshot *base, const got_snapshot *current, std::vector<got_change> *changes) {
+    size_t found = 0;
+    std::vector<got_slot>::const_iterator a = base->slots.begin();
+    std::vector<got_slot>::const_iterator b = current->slots.begin();
+    while (a != base->slots.end() && b != current->slots.end()) {
+        if (a->lib != b->lib || a->sym != b->sym) {
+            /* keyed on names only: a reloaded library still matches, wherever its slots are now */
+            if (a->lib < b->lib || (a->lib == b->lib && a->sym < b->sym))
+                ++a;
+            else
+                ++b;
+            continue;
+        }
+        if (a->value != b->value) {
+            got_change change;
+            change.lib = b->lib;
+            change.sym = b->sym;
+            change.slot = b->slot;
+            change.old_value = a->value;
+            change.new_value = b->value;
+            change.time_ms = 0;
+            changes->push_back(change);
+            found++;
+        }
+        ++a;
+        ++b;
+    }
+    return found;
+}
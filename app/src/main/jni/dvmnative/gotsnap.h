@@ -0,0 +1,60 @@
+#ifndef GOTSNAP_H_
+#define GOTSNAP_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "util.h"
+
+/*
+ * A packed record of every PLT relocation slot of every loaded library. Library paths and
+ * symbol names are interned into one process-wide table, so a slot is four words and two
+ * snapshots compare by id without touching a string.
+ */
+/* the value of a slot that couldn't be read, its library unloaded halfway through */
+#define GOT_SLOT_UNREADABLE ((uintptr_t) -1)
+
+struct got_slot {
+    u4 lib;             /* name id of the library path */
+    u4 sym;             /* name id of the imported symbol */
+    uintptr_t slot;     /* address of the GOT entry */
+    uintptr_t value;    /* what the entry held when the snapshot was taken, or GOT_SLOT_UNREADABLE */
+};
+
+struct got_snapshot {
+    std::vector<got_slot> slots;    /* sorted by (lib, sym, slot) */
+    u4 lib_count;
+};
+
+struct got_change {
+    u4 lib;
+    u4 sym;
+    uintptr_t slot;
+    uintptr_t old_value;
+    uintptr_t new_value;
+    u8 time_ms;         /* wall clock of the change when a monitor saw it, 0 from a diff */
+};
+
+struct got_library {
+    const char *path;   /* interned by the maps index */
+    uintptr_t base;
+};
+
+/* the interned string behind a name id, valid for the life of the process */
+const char *got_name(u4 id);
+
+/* every loaded library: one entry per .so with an executable mapping */
+void got_libraries(std::vector<got_library> *libs);
+
+/* append the import slots of one library, with their current values; returns how many */
+size_t got_read_library(const got_library *lib, std::vector<got_slot> *slots);
+
+/* read the PLT slots of every executable .so mapping */
+bool got_snapshot_take(got_snapshot *snapshot);
+
+/*
+ * Slots present in both snapshots (same library path and symbol) whose value differs.
+ * Libraries loaded or unloaded in between are ignored, but one unloaded while a snapshot
+ * read it shows as changes to GOT_SLOT_UNREADABLE. Linear in the two slot counts.
+ */
+size_t got_snapshot_diff(const got_snapshot *base, const got_snapshot *current, std::vector<got_change> *changes);
+#endif
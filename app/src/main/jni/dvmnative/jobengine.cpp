@@ -0,0 +1,262 @@
+#include <pthread.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <android/log.h>
+#include "jobengine.h"
+#include "dumpfile.h"
+
+struct job {
+    u4 id;
+    std::string kind;
+    std::string key;
+    job_fn run;
+    void *arg;
+    job_release_fn release;
+    int state;
+    volatile int cancel;
+    std::string unit;
+    volatile bool counts_bytes;
+    volatile u8 done;
+    volatile u8 total;
+    u8 queued_ns;
+    u8 started_ns;
+    u8 finished_ns;
+};
+
+/* guards the lists and every job's state; the work itself never holds it */
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_ready = PTHREAD_COND_INITIALIZER;
+static std::deque<job *> queued_jobs;
+static std::vector<job *> running_jobs;
+static std::deque<job *> finished_jobs;
+static int workers = 0;
+static int idle_workers = 0;
+static u4 next_job_id = 1;
+
+static pthread_key_t current_job_key;
+static pthread_once_t current_job_once = PTHREAD_ONCE_INIT;
+
+static void create_current_job_key() {
+    pthread_key_create(&current_job_key, NULL);
+}
+
+void *job_current() {
+    pthread_once(&current_job_once, create_current_job_key);
+    return pthread_getspecific(current_job_key);
+}
+
+void job_adopt(void *job) {
+    pthread_once(&current_job_once, create_current_job_key);
+    pthread_setspecific(current_job_key, job);
+}
+
+bool job_cancelled() {
+    job *current = (job *) job_current();
+    return current != NULL && current->cancel;
+}
+
+void job_progress_begin(const char *unit, u8 total) {
+    job *current = (job *) job_current();
+    if (current == NULL)
+        return;
+    pthread_mutex_lock(&job_lock);
+    current->unit = unit;
+    current->counts_bytes = strcmp(unit, "bytes") == 0;
+    current->total = total;
+    current->done = 0;
+    pthread_mutex_unlock(&job_lock);
+}
+
+void job_progress_add(u8 done) {
+    job *current = (job *) job_current();
+    if (current != NULL)
+        __sync_fetch_and_add(&current->done, done);
+}
+
+void job_progress_bytes(u8 bytes) {
+    job *current = (job *) job_current();
+    if (current != NULL && current->counts_bytes)
+        __sync_fetch_and_add(&current->done, bytes);
+}
+
+static void describe(const job *j, u8 now, job_info *info) {
+    info->id = j->id;
+    info->state = j->state;
+    info->kind = j->kind;
+    info->key = j->key;
+    info->unit = j->unit;
+    info->done = j->done;
+    info->total = j->total;
+    info->cancel_requested = j->cancel != 0;
+    u8 started = j->state == JOB_QUEUED ? now : j->started_ns;
+    info->wait_ns = started - j->queued_ns;
+    info->run_ns = j->state == JOB_QUEUED ? 0 : (j->state == JOB_RUNNING ? now : j->finished_ns) - j->started_ns;
+}
+
+static void finish(job *j, int state) {
+    j->state = state;
+    j->finished_ns = dump_now_ns();
+    finished_jobs.push_front(j);
+    while (finished_jobs.size() > JOB_HISTORY) {
+        delete finished_jobs.back();
+        finished_jobs.pop_back();
+    }
+}
+
+static void *worker_main(void *arg) {
+    pthread_mutex_lock(&job_lock);
+    for (;;) {
+        while (queued_jobs.empty()) {
+            idle_workers++;
+            pthread_cond_wait(&job_ready, &job_lock);
+            idle_workers--;
+        }
+        job *j = queued_jobs.front();
+        queued_jobs.pop_front();
+        j->state = JOB_RUNNING;
+        j->started_ns = dump_now_ns();
+        running_jobs.push_back(j);
+        pthread_mutex_unlock(&job_lock);
+
+        LOGV("job %u %s started", j->id, j->kind.c_str());
+        job_adopt(j);
+        bool ok = j->run(j->arg);
+        job_adopt(NULL);
+        j->release(j->arg);
+
+        pthread_mutex_lock(&job_lock);
+        running_jobs.erase(std::find(running_jobs.begin(), running_jobs.end(), j));
+        finish(j, j->cancel ? JOB_CANCELLED : ok ? JOB_DONE : JOB_FAILED);
+        LOGV("job %u %s %s in %u ms", j->id, j->kind.c_str(),
+             j->state == JOB_DONE ? "done" : j->state == JOB_CANCELLED ? "cancelled" : "failed",
+             (unsigned int) ((j->finished_ns - j->started_ns) / 1000000));
+    }
+    return NULL;
+}
+
+static job *find_active(const std::string &key) {
+    for (size_t i = 0; i < running_jobs.size(); i++) {
+        if (running_jobs[i]->key == key && !running_jobs[i]->cancel)
+            return running_jobs[i];
+    }
+    for (size_t i = 0; i < queued_jobs.size(); i++) {
+        if (queued_jobs[i]->key == key)
+            return queued_jobs[i];
+    }
+    return NULL;
+}
+
+u4 job_submit(const char *kind, const char *key, job_fn run, void *arg, job_release_fn release, bool *existing) {
+    pthread_mutex_lock(&job_lock);
+    job *same = key != NULL && key[0] != '\0' ? find_active(key) : NULL;
+    *existing = same != NULL;
+    if (same != NULL) {
+        u4 id = same->id;
+        pthread_mutex_unlock(&job_lock);
+        release(arg);
+        LOGV("%s is job %u already", key, id);
+        return id;
+    }
+    job *j = new job;
+    j->id = next_job_id++;
+    j->kind = kind;
+    j->key = key != NULL ? key : "";
+    j->run = run;
+    j->arg = arg;
+    j->release = release;
+    j->state = JOB_QUEUED;
+    j->cancel = 0;
+    j->counts_bytes = false;
+    j->done = 0;
+    j->total = 0;
+    j->queued_ns = dump_now_ns();
+    j->started_ns = 0;
+    j->finished_ns = 0;
+    queued_jobs.push_back(j);
+    if (idle_workers > 0) {
+        pthread_cond_signal(&job_ready);
+    } else if (workers < JOB_MAX_WORKERS) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_t thread;
+        int error = pthread_create(&thread, &attr, worker_main, NULL);
+        pthread_attr_destroy(&attr);
+        if (error == 0)
+            workers++;
+        else
+            LOGE("start a job worker failed: %s", strerror(error));
+        if (workers == 0) {
+            /* with no worker at all the job would wait forever */
+            u4 id = j->id;
+            queued_jobs.pop_back();
+            finish(j, JOB_FAILED);
+            pthread_mutex_unlock(&job_lock);
+            release(arg);
+            return id;
+        }
+    }
+    u4 id = j->id;
+    pthread_mutex_unlock(&job_lock);
+    return id;
+}
+
+bool job_cancel(u4 id) {
+    pthread_mutex_lock(&job_lock);
+    for (size_t i = 0; i < running_jobs.size(); i++) {
+        if (running_jobs[i]->id == id) {
+            running_jobs[i]->cancel = 1;
+            pthread_mutex_unlock(&job_lock);
+            return true;
+        }
+    }
+    for (std::deque<job *>::iterator it = queued_jobs.begin(); it != queued_jobs.end(); ++it) {
+        if ((*it)->id == id) {
+            job *j = *it;
+            queued_jobs.erase(it);
+            j->cancel = 1;
+            j->started_ns = dump_now_ns();
+            void *arg = j->arg;
+            job_release_fn release = j->release;
+            finish(j, JOB_CANCELLED);
+            pthread_mutex_unlock(&job_lock);
+            release(arg);
+            return true;
+        }
+    }
+    pthread_mutex_unlock(&job_lock);
+    return false;
+}
+
+bool job_get(u4 id, job_info *info) {
+    std::vector<job_info> infos;
+    job_list(&infos);
+    for (size_t i = 0; i < infos.size(); i++) {
+        if (infos[i].id == id) {
+            *info = infos[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void job_list(std::vector<job_info> *infos) {
+    infos->clear();
+    u8 now = dump_now_ns();
+    pthread_mutex_lock(&job_lock);
+    job_info info;
+    for (size_t i = 0; i < running_jobs.size(); i++) {
+        describe(running_jobs[i], now, &info);
+        infos->push_back(info);
+    }
+    for (size_t i = 0; i < queued_jobs.size(); i++) {
+        describe(queued_jobs[i], now, &info);
+        infos->push_back(info);
+    }
+    for (size_t i = 0; i < finished_jobs.size(); i++) {
+        describe(finished_jobs[i], now, &info);
+        infos->push_back(info);
+    }
+    pthread_mutex_unlock(&job_lock);
+}
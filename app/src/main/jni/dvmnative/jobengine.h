@@ -0,0 +1,72 @@
+#ifndef JOBENGINE_H_
+#define JOBENGINE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "util.h"
+
+/* long commands run this many at a time, the rest wait their turn */
+#define JOB_MAX_WORKERS     2
+/* finished jobs kept for job_list */
+#define JOB_HISTORY         32
+
+enum job_state {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED,
+    JOB_CANCELLED,
+};
+
+struct job_info {
+    u4 id;
+    int state;                  /* job_state */
+    std::string kind;
+    std::string key;
+    std::string unit;           /* what done and total count, "" before the job reports any */
+    u8 done;
+    u8 total;
+    bool cancel_requested;
+    u8 wait_ns;                 /* queued until started, or until now */
+    u8 run_ns;                  /* started until finished, or until now */
+};
+
+/* the work of a job, on a worker thread; false if it failed */
+typedef bool (*job_fn)(void *arg);
+/* frees arg once the job is over, run or not */
+typedef void (*job_release_fn)(void *arg);
+
+/*
+ * Queue run(arg) for the worker pool, which grows up to JOB_MAX_WORKERS threads and keeps
+ * them. A job whose key (non-empty) matches one queued or running, and not being cancelled,
+ * isn't queued again: *existing is set, arg released, and the id of that one returned.
+ */
+u4 job_submit(const char *kind, const char *key, job_fn run, void *arg, job_release_fn release, bool *existing);
+
+/*
+ * A queued job is dropped at once; a running one is asked to stop, which the work notices
+ * through job_cancelled at its next check. False if no such job is queued or running.
+ */
+bool job_cancel(u4 id);
+
+bool job_get(u4 id, job_info *info);
+
+/* running, then queued in order, then the finished ones, latest first */
+void job_list(std::vector<job_info> *infos);
+
+/*
+ * For the work a job runs, on its thread or the threads parallel_for starts for it; all of
+ * them do nothing outside a job.
+ */
+bool job_cancelled();
+/* (re)start the count of the job's progress: none of total units ("bytes", "classes", ...) done */
+void job_progress_begin(const char *unit, u8 total);
+void job_progress_add(u8 done);
+/* job_progress_add for the writers and readers below the job, counted only if the job counts "bytes" */
+void job_progress_bytes(u8 bytes);
+
+/* the job of the calling thread, and taking it on from another thread of the same job */
+void *job_current();
+void job_adopt(void *job);
+#endif
@@ -0,0 +1,313 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <android/log.h>
+#include "mapsindex.h"
+
+static pthread_mutex_t maps_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool maps_loaded = false;
+static volatile u4 maps_gen = 0;
+static std::string maps_content;
+static std::vector<map_region> maps_regions;
+/* where the line of each region starts in maps_content */
+static std::vector<u4> maps_lines;
+/* region indexes sorted by (file name, start), for the name queries */
+static std::vector<u4> maps_by_name;
+/* set nodes never move, so the c_str() of an interned path is stable */
+static std::set<std::string> maps_paths;
+
+static const char *intern_path(const char *path, size_t length) {
+    if (length == 0)
+        return "";
+    return maps_paths.insert(std::string(path, length)).first->c_str();
+}
+
+static const char *file_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash != NULL ? slash + 1 : path;
+}
+
+static bool read_maps(std::string *content) {
+    int fd = open("/proc/self/maps", O_RDONLY);
+    if (fd < 0) {
+        LOGE("open maps error: %s", strerror(errno));
+        return false;
+    }
+    content->clear();
+    content->reserve(maps_content.size() + 16 * 1024);
+    char buffer[64 * 1024];
+    for (;;) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        content->append(buffer, count);
+    }
+    close(fd);
+    return true;
+}
+
+static const char *skip_spaces(const char *p) {
+    while (*p == ' ' || *p == '\t')
+        p++;
+    return p;
+}
+
+/* "start-end perms offset dev inode   path", the line ends at '\n' or the final NUL */
+static bool parse_line(const char *line, const char *line_end, map_region *region) {
+    char *p;
+    region->start = (uintptr_t) strtoull(line, &p, 16);
+    if (*p != '-')
+        return false;
+    region->end = (uintptr_t) strtoull(p + 1, &p, 16);
+    const char *perms = skip_spaces(p);
+    if (line_end - perms < 4)
+        return false;
+    region->perms = (perms[0] == 'r' ? MAPS_PERM_READ : 0) | (perms[1] == 'w' ? MAPS_PERM_WRITE : 0) |
+                    (perms[2] == 'x' ? MAPS_PERM_EXEC : 0) | (perms[3] == 's' ? MAPS_PERM_SHARED : 0);
+    region->offset = strtoull(perms + 4, &p, 16);
+    const char *dev = skip_spaces(p);
+    while (dev < line_end && *dev != ' ')
+        dev++;
+    region->inode = strtoull(dev, &p, 10);
+    const char *path = skip_spaces(p);
+    if (path > line_end)
+        path = line_end;
+    region->path = intern_path(path, line_end - path);
+    return true;
+}
+
+static bool name_before(u4 a, u4 b) {
+    int order = strcmp(file_name(maps_regions[a].path), file_name(maps_regions[b].path));
+    if (order != 0)
+        return order < 0;
+    return maps_regions[a].start < maps_regions[b].start;
+}
+
+/* the regions of the lines in data[from, to), their lines counted from data */
+static void parse_lines(const char *data, size_t from, size_t to, std::vector<map_region> *regions,
+                        std::vector<u4> *lines) {
+    const char *line = data + from;
+    const char *end = data + to;
+    while (line < end) {
+        const char *line_end = (const char *) memchr(line, '\n', end - line);
+        if (line_end == NULL)
+            line_end = end;
+        map_region region;
+        if (parse_line(line, line_end, &region)) {
+            regions->push_back(region);
+            lines->push_back(line - data);
+        }
+        line = line_end + 1;
+    }
+}
+
+static bool line_start(const std::string &content, size_t pos) {
+    return pos == 0 || content[pos - 1] == '\n';
+}
+
+/*
+ * Take content in place of maps_content. A map or unmap only touches a few lines, so the
+ * lines both share at the start and at the end keep their regions (those at the end just
+ * move) and only the lines in between are parsed again.
+ */
+static void update_maps(std::string *content) {
+    const std::string &old = maps_content;
+    size_t shortest = std::min(old.size(), content->size());
+    size_t head = 0;
+    while (head < shortest && old[head] == (*content)[head])
+        head++;
+    while (!line_start(*content, head))
+        head--;
+    size_t tail = 0;
+    while (tail < shortest - head && old[old.size() - 1 - tail] == (*content)[content->size() - 1 - tail])
+        tail++;
+    /* from one byte into the shared tail, so the newline before it is shared too */
+    size_t tail_new = std::min(content->size(), content->size() - tail + 1);
+    while (tail_new < content->size() && !line_start(*content, tail_new))
+        tail_new++;
+    size_t tail_old = tail_new - content->size() + old.size();
+
+    std::vector<map_region> regions;
+    std::vector<u4> lines;
+    size_t i = 0;
+    for (; i < maps_regions.size() && maps_lines[i] < head; i++) {
+        regions.push_back(maps_regions[i]);
+        lines.push_back(maps_lines[i]);
+    }
+    parse_lines(content->c_str(), head, tail_new, &regions, &lines);
+    for (; i < maps_regions.size(); i++) {
+        if (maps_lines[i] < tail_old)
+            continue;
+        regions.push_back(maps_regions[i]);
+        lines.push_back(maps_lines[i] - tail_old + tail_new);
+    }
+    maps_content.swap(*content);
+    maps_regions.swap(regions);
+    maps_lines.swap(lines);
+    maps_by_name.resize(maps_regions.size());
+    for (size_t k = 0; k < maps_by_name.size(); k++)
+        maps_by_name[k] = k;
+    std::sort(maps_by_name.begin(), maps_by_name.end(), name_before);
+}
+
+/* call with maps_lock held */
+static bool refresh_locked() {
+    std::string content;
+    if (!read_maps(&content))
+        return false;
+    if (maps_loaded && content == maps_content)
+        return false;
+    update_maps(&content);
+    maps_loaded = true;
+    __sync_fetch_and_add(&maps_gen, 1);
+    return true;
+}
+
+bool maps_refresh() {
+    pthread_mutex_lock(&maps_lock);
+    bool changed = refresh_locked();
+    pthread_mutex_unlock(&maps_lock);
+    return changed;
+}
+
+u4 maps_generation() {
+    return __sync_fetch_and_add(&maps_gen, 0);
+}
+
+static bool start_before(uintptr_t addr, const map_region &region) {
+    return addr < region.start;
+}
+
+static bool find_addr_locked(uintptr_t addr, map_region *region) {
+    std::vector<map_region>::iterator it =
+            std::upper_bound(maps_regions.begin(), maps_regions.end(), addr, start_before);
+    if (it == maps_regions.begin())
+        return false;
+    --it;
+    if (addr >= it->end)
+        return false;
+    *region = *it;
+    return true;
+}
+
+bool maps_find_addr(uintptr_t addr, map_region *region) {
+    pthread_mutex_lock(&maps_lock);
+    if (!maps_loaded)
+        refresh_locked();
+    /* a miss may just be a mapping made since the last refresh */
+    bool found = find_addr_locked(addr, region) || (refresh_locked() && find_addr_locked(addr, region));
+    pthread_mutex_unlock(&maps_lock);
+    return found;
+}
+
+static bool find_next_locked(uintptr_t addr, map_region *region) {
+    std::vector<map_region>::iterator it =
+            std::upper_bound(maps_regions.begin(), maps_regions.end(), addr, start_before);
+    if (it != maps_regions.begin() && addr < (it - 1)->end)
+        --it;
+    if (it == maps_regions.end())
+        return false;
+    *region = *it;
+    return true;
+}
+
+bool maps_find_next(uintptr_t addr, map_region *region) {
+    pthread_mutex_lock(&maps_lock);
+    if (!maps_loaded)
+        refresh_locked();
+    bool found = find_next_locked(addr, region);
+    if (!found || region->start > addr) {
+        map_region fresh;
+        if (refresh_locked() && find_next_locked(addr, &fresh)) {
+            *region = fresh;
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&maps_lock);
+    return found;
+}
+
+bool maps_is_device(const char *path) {
+    if (strcmp(path, "[vvar]") == 0 || strcmp(path, "[vsyscall]") == 0)
+        return true;
+    return strncmp(path, "/dev/", 5) == 0 && strncmp(path, "/dev/ashmem", 11) != 0;
+}
+
+u4 maps_parse_perms(const char *perms) {
+    u4 bits = 0;
+    for (const char *p = perms; *p != '\0'; p++) {
+        if (*p == 'r')
+            bits |= MAPS_PERM_READ;
+        else if (*p == 'w')
+            bits |= MAPS_PERM_WRITE;
+        else if (*p == 'x')
+            bits |= MAPS_PERM_EXEC;
+        else if (*p == 's')
+            bits |= MAPS_PERM_SHARED;
+    }
+    return bits;
+}
+
+struct name_key_before {
+    bool operator()(u4 index, const char *name) const {
+        return strcmp(file_name(maps_regions[index].path), name) < 0;
+    }
+
+    bool operator()(const char *name, u4 index) const {
+        return strcmp(name, file_name(maps_regions[index].path)) < 0;
+    }
+};
+
+static size_t find_name_locked(const char *name, std::vector<map_region> *regions) {
+    const char *key = file_name(name);
+    bool whole_path = key != name;
+    std::pair<std::vector<u4>::iterator, std::vector<u4>::iterator> range =
+            std::equal_range(maps_by_name.begin(), maps_by_name.end(), key, name_key_before());
+    size_t found = 0;
+    for (std::vector<u4>::iterator it = range.first; it != range.second; ++it) {
+        const map_region &region = maps_regions[*it];
+        if (whole_path && strcmp(region.path, name) != 0)
+            continue;
+        regions->push_back(region);
+        found++;
+    }
+    return found;
+}
+
+size_t maps_find_name(const char *name, std::vector<map_region> *regions) {
+    pthread_mutex_lock(&maps_lock);
+    if (!maps_loaded)
+        refresh_locked();
+    size_t found = find_name_locked(name, regions);
+    if (found == 0 && refresh_locked())
+        found = find_name_locked(name, regions);
+    pthread_mutex_unlock(&maps_lock);
+    return found;
+}
+
+bool maps_module_base(const char *name, uintptr_t *base) {
+    std::vector<map_region> regions;
+    maps_find_name(name, &regions);
+    for (size_t i = 0; i < regions.size(); i++) {
+        if (regions[i].offset == 0 && (regions[i].perms & MAPS_PERM_READ)) {
+            *base = regions[i].start;
+            return true;
+        }
+    }
+    return false;
+}
+
+void maps_snapshot(std::vector<map_region> *regions) {
+    pthread_mutex_lock(&maps_lock);
+    refresh_locked();
+    *regions = maps_regions;
+    pthread_mutex_unlock(&maps_lock);
+}
@@ -0,0 +1,58 @@
+#ifndef MAPSINDEX_H_
+#define MAPSINDEX_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "util.h"
+
+#define MAPS_PERM_READ     1
+#define MAPS_PERM_WRITE    2
+#define MAPS_PERM_EXEC     4
+#define MAPS_PERM_SHARED   8
+
+struct map_region {
+    uintptr_t start;
+    uintptr_t end;
+    u8 offset;
+    u8 inode;
+    u4 perms;           /* MAPS_PERM_* */
+    const char *path;   /* interned, stays valid for the life of the process; "" if anonymous */
+};
+
+/*
+ * One index of /proc/self/maps for every native subsystem. A refresh reads the whole file
+ * in one buffered pass (a lookup that misses refreshes too), but only the lines that differ
+ * from the last read are parsed again; paths are interned, so region copies handed out stay
+ * valid across refreshes. All calls are thread safe.
+ */
+
+/* re-read the maps, returns true if the layout changed since the last refresh */
+bool maps_refresh();
+
+/* bumped every time a refresh finds a new layout, whoever triggered it */
+u4 maps_generation();
+
+/* the region containing addr, O(log n) */
+bool maps_find_addr(uintptr_t addr, map_region *region);
+
+/* the region containing addr, or else the first one above it; a hole below it is unmapped */
+bool maps_find_next(uintptr_t addr, map_region *region);
+
+/* device memory can have side effects on read; ashmem is ordinary memory behind a /dev name */
+bool maps_is_device(const char *path);
+
+/* "rwx"-style permission letters ('p' and '-' are ignored) as MAPS_PERM_* bits */
+u4 maps_parse_perms(const char *perms);
+
+/*
+ * regions mapped from name, in address order, O(log n + hits). A name with a '/' must match
+ * the whole path, otherwise it is matched against the file name only ("libc.so").
+ */
+size_t maps_find_name(const char *name, std::vector<map_region> *regions);
+
+/* where a module is loaded: start of its lowest mapping at file offset 0 */
+bool maps_module_base(const char *name, uintptr_t *base);
+
+/* every region, in address order */
+void maps_snapshot(std::vector<map_region> *regions);
+#endif
@@ -0,0 +1,289 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <android/log.h>
+#include "mementropy.h"
+#include "dumpfile.h"
+#include "mapsindex.h"
+#include "memread.h"
+#include "threadpool.h"
+#include "jobengine.h"
+
+/* the same units and buffers as the memory search */
+#define ENTROPY_UNIT_SIZE       (16 * 1024 * 1024)
+#define ENTROPY_BUFFER_SIZE     (1024 * 1024)
+#define ENTROPY_MAX_THREADS     16
+
+struct entropy_unit {
+    uintptr_t start;
+    uintptr_t end;
+    u4 first_window;
+};
+
+struct entropy_context {
+    mem_entropy_map *map;
+    std::vector<entropy_unit> units;
+    volatile size_t next_unit;
+    std::vector<float> clog;        /* c * log2(c) for every count a window can have */
+    size_t page_size;
+    pthread_mutex_t lock;
+    mem_entropy_stats *stats;
+};
+
+static bool select_region(const map_region &region, const mem_entropy_options *options) {
+    u4 perms = options->perms | MAPS_PERM_READ;
+    if ((region.perms & perms) != perms || maps_is_device(region.path))
+        return false;
+    if (options->max_region_size != 0 && region.end - region.start > options->max_region_size)
+        return false;
+    return options->path_pattern == NULL || fnmatch(options->path_pattern, region.path, 0) == 0;
+}
+
+/* four tables in turn, so consecutive equal bytes don't wait on each other's increment */
+static void count_bytes(const u1 *data, size_t length, u4 (*counts)[256]) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        u8 word;
+        memcpy(&word, data + i, 8);
+        counts[0][word & 0xff]++;
+        counts[1][(word >> 8) & 0xff]++;
+        counts[2][(word >> 16) & 0xff]++;
+        counts[3][(word >> 24) & 0xff]++;
+        counts[0][(word >> 32) & 0xff]++;
+        counts[1][(word >> 40) & 0xff]++;
+        counts[2][(word >> 48) & 0xff]++;
+        counts[3][word >> 56]++;
+    }
+    for (; i < length; i++)
+        counts[0][data[i]]++;
+}
+
+/* H = log2(n) - sum(c * log2(c)) / n */
+static u2 window_entropy(const entropy_context *ctx, u4 (*counts)[256], u4 n) {
+    const float *clog = &ctx->clog[0];
+    float sum = 0;
+    for (int b = 0; b < 256; b++)
+        sum += clog[counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b]];
+    float bits = log2f((float) n) - sum / n;
+    if (bits <= 0)
+        return 0;
+    u4 entropy = (u4) (bits * MEM_ENTROPY_ONE_BIT + 0.5f);
+    return std::min(entropy, (u4) (8 * MEM_ENTROPY_ONE_BIT));
+}
+
+static void scan_unit(entropy_context *ctx, const entropy_unit *unit, u1 *buffer, u1 *readable, u8 *bytes,
+                      u8 *unreadable) {
+    u4 window = ctx->map->window;
+    size_t page_size = ctx->page_size;
+    u2 *entropy = &ctx->map->entropy[unit->first_window];
+    u4 counts[4][256];
+    for (uintptr_t chunk = unit->start; chunk < unit->end; chunk += ENTROPY_BUFFER_SIZE) {
+        size_t length = std::min((uintptr_t) ENTROPY_BUFFER_SIZE, unit->end - chunk);
+        if (mem_read_pages((const void *) chunk, buffer, length, readable) == 0) {
+            size_t windows = (length + window - 1) / window;
+            for (size_t i = 0; i < windows; i++)
+                *entropy++ = MEM_ENTROPY_UNREADABLE;
+            *unreadable += windows;
+            continue;
+        }
+        for (size_t w = 0; w < length; w += window) {
+            size_t end = std::min(w + window, length);
+            u4 n = 0;
+            memset(counts, 0, sizeof(counts));
+            /* windows and pages are both powers of two, so one holds whole pieces of the other */
+            for (size_t off = w; off < end;) {
+                size_t page = off / page_size;
+                size_t next = std::min(end, (page + 1) * page_size);
+                if (readable[page >> 3] & (1 << (page & 7))) {
+                    count_bytes(buffer + off, next - off, counts);
+                    n += next - off;
+                }
+                off = next;
+            }
+            if (n == 0) {
+                *entropy++ = MEM_ENTROPY_UNREADABLE;
+                (*unreadable)++;
+            } else {
+                *entropy++ = window_entropy(ctx, counts, n);
+                *bytes += n;
+            }
+        }
+    }
+}
+
+static void entropy_worker(size_t index, void *arg) {
+    entropy_context *ctx = (entropy_context *) arg;
+    std::vector<u1> buffer(ENTROPY_BUFFER_SIZE);
+    std::vector<u1> readable(ENTROPY_BUFFER_SIZE / ctx->page_size / 8 + 1);
+    u8 bytes = 0;
+    u8 unreadable = 0;
+    for (;;) {
+        size_t unit = __sync_fetch_and_add(&ctx->next_unit, 1);
+        if (unit >= ctx->units.size() || job_cancelled())
+            break;
+        scan_unit(ctx, &ctx->units[unit], &buffer[0], &readable[0], &bytes, &unreadable);
+        job_progress_add(ctx->units[unit].end - ctx->units[unit].start);
+    }
+    pthread_mutex_lock(&ctx->lock);
+    ctx->stats->bytes += bytes;
+    ctx->stats->unreadable += unreadable;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+bool mem_entropy_scan(const mem_entropy_options *options, mem_entropy_map *map, mem_entropy_stats *stats) {
+    u8 start = dump_now_ns();
+    memset(stats, 0, sizeof(*stats));
+    map->regions.clear();
+    map->entropy.clear();
+    u4 window = options->window != 0 ? options->window : MEM_ENTROPY_DEFAULT_WINDOW;
+    if (window < MEM_ENTROPY_MIN_WINDOW || window > MEM_ENTROPY_MAX_WINDOW || (window & (window - 1)) != 0) {
+        LOGE("bad entropy window %u", window);
+        return false;
+    }
+    map->window = window;
+    int max_threads = options->max_threads;
+    if (max_threads <= 0)
+        max_threads = threadpool_cpu_count();
+    if (max_threads > ENTROPY_MAX_THREADS)
+        max_threads = ENTROPY_MAX_THREADS;
+
+    entropy_context ctx;
+    ctx.map = map;
+    ctx.next_unit = 0;
+    ctx.page_size = sysconf(_SC_PAGESIZE);
+    ctx.stats = stats;
+    std::vector<map_region> maps;
+    maps_snapshot(&maps);
+    u4 windows = 0;
+    for (size_t i = 0; i < maps.size(); i++) {
+        if (!select_region(maps[i], options))
+            continue;
+        mem_entropy_region region;
+        region.start = maps[i].start;
+        region.end = maps[i].end;
+        region.perms = maps[i].perms;
+        region.path = maps[i].path;
+        region.first_window = windows;
+        map->regions.push_back(region);
+        for (uintptr_t unit_start = region.start; unit_start < region.end; unit_start += ENTROPY_UNIT_SIZE) {
+            entropy_unit unit;
+            unit.start = unit_start;
+            unit.end = std::min(unit_start + ENTROPY_UNIT_SIZE, region.end);
+            unit.first_window = windows + (unit_start - region.start) / window;
+            ctx.units.push_back(unit);
+        }
+        windows += (region.end - region.start + window - 1) / window;
+    }
+    map->entropy.resize(windows);
+    ctx.clog.resize(window + 1);
+    ctx.clog[0] = 0;
+    for (u4 c = 1; c <= window; c++)
+        ctx.clog[c] = c * log2f((float) c);
+
+    u8 total = 0;
+    for (size_t i = 0; i < ctx.units.size(); i++)
+        total += ctx.units[i].end - ctx.units[i].start;
+    job_progress_begin("bytes", total);
+    pthread_mutex_init(&ctx.lock, NULL);
+    parallel_for(max_threads, max_threads, entropy_worker, &ctx);
+    pthread_mutex_destroy(&ctx.lock);
+    /* the windows never reached would read as empty memory */
+    if (job_cancelled())
+        return false;
+    stats->regions = map->regions.size();
+    stats->windows = windows;
+    stats->elapsed_ns = dump_now_ns() - start;
+    LOGV("entropy of %u regions, %llu MB in %u windows of %u in %u ms, %llu unreadable", stats->regions,
+         (unsigned long long) (stats->bytes >> 20), windows, window, (unsigned int) (stats->elapsed_ns / 1000000),
+         (unsigned long long) stats->unreadable);
+    return true;
+}
+
+void mem_entropy_runs(const mem_entropy_map *map, u2 min_entropy, u4 min_windows, std::vector<mem_entropy_run> *runs) {
+    runs->clear();
+    for (size_t r = 0; r < map->regions.size(); r++) {
+        const mem_entropy_region &region = map->regions[r];
+        u4 count = (region.end - region.start + map->window - 1) / map->window;
+        const u2 *entropy = &map->entropy[region.first_window];
+        for (u4 i = 0; i < count;) {
+            if (entropy[i] == MEM_ENTROPY_UNREADABLE || entropy[i] < min_entropy) {
+                i++;
+                continue;
+            }
+            u4 first = i;
+            u8 sum = 0;
+            u2 peak = 0;
+            for (; i < count && entropy[i] != MEM_ENTROPY_UNREADABLE && entropy[i] >= min_entropy; i++) {
+                sum += entropy[i];
+                peak = std::max(peak, entropy[i]);
+            }
+            if (i - first < std::max(min_windows, (u4) 1))
+                continue;
+            mem_entropy_run run;
+            run.start = region.start + (uintptr_t) first * map->window;
+            run.end = std::min(region.start + (uintptr_t) i * map->window, region.end);
+            run.region = r;
+            run.mean = sum / (i - first);
+            run.peak = peak;
+            runs->push_back(run);
+        }
+    }
+}
+
+bool mem_entropy_write(const char *path, const mem_entropy_map *map) {
+    std::vector<mem_entropy_file_region> regions;
+    std::string names;
+    for (size_t i = 0; i < map->regions.size(); i++) {
+        const mem_entropy_region &region = map->regions[i];
+        mem_entropy_file_region file_region;
+        file_region.start = region.start;
+        file_region.end = region.end;
+        file_region.perms = region.perms;
+        file_region.name_off = names.size();
+        file_region.first_window = region.first_window;
+        file_region.window_count = (region.end - region.start + map->window - 1) / map->window;
+        names += region.path;
+        names.push_back('\0');
+        regions.push_back(file_region);
+    }
+    mem_entropy_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MEM_ENTROPY_MAGIC, sizeof(header.magic));
+    header.window = map->window;
+    header.region_count = regions.size();
+    header.window_count = map->entropy.size();
+    header.regions_off = sizeof(header);
+    header.names_off = header.regions_off + regions.size() * sizeof(mem_entropy_file_region);
+    /* aligned, so the entropies can be read in place from a mapping of the file */
+    header.entropy_off = (header.names_off + names.size() + 7) & ~7;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        LOGE("open %s failed: %s", path, strerror(errno));
+        return false;
+    }
+    dump_result result;
+    result.bytes = 0;
+    result.error = 0;
+    if (!regions.empty())
+        dump_write_at(fd, &regions[0], regions.size() * sizeof(mem_entropy_file_region), header.regions_off, &result);
+    if (result.error == 0 && !names.empty())
+        dump_write_at(fd, names.data(), names.size(), header.names_off, &result);
+    if (result.error == 0 && !map->entropy.empty())
+        dump_write_at(fd, &map->entropy[0], map->entropy.size() * sizeof(u2), header.entropy_off, &result);
+    /* the header goes last: a file cut short by an error has no valid magic */
+    if (result.error == 0)
+        dump_write_at(fd, &header, sizeof(header), 0, &result);
+    close(fd);
+    if (result.error != 0) {
+        LOGE("write entropy map to %s failed: %s", path, strerror(result.error));
+        return false;
+    }
+    return true;
+}
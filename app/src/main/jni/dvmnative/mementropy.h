@@ -0,0 +1,92 @@
+#ifndef MEMENTROPY_H_
+#define MEMENTROPY_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "util.h"
+
+#define MEM_ENTROPY_MAGIC           "entmap1"
+/* entropies are kept in 1/4096 bit, so 8 bits a byte is 32768 */
+#define MEM_ENTROPY_ONE_BIT         4096
+#define MEM_ENTROPY_UNREADABLE      0xffff
+#define MEM_ENTROPY_DEFAULT_WINDOW  4096
+#define MEM_ENTROPY_MIN_WINDOW      256
+#define MEM_ENTROPY_MAX_WINDOW      (64 * 1024)
+
+struct mem_entropy_options {
+    u4 perms;                   /* MAPS_PERM_* a region must all have, READ is implied */
+    const char *path_pattern;   /* fnmatch pattern for the region path, NULL for any */
+    u8 max_region_size;         /* 0: no limit */
+    u4 window;                  /* a power of two in [MIN_WINDOW, MAX_WINDOW], 0 for the default */
+    int max_threads;            /* <= 0: one per cpu */
+};
+
+struct mem_entropy_region {
+    uintptr_t start;
+    uintptr_t end;
+    u4 perms;
+    const char *path;           /* interned by the maps index, "" if anonymous */
+    u4 first_window;            /* in mem_entropy_map.entropy; windows start at start, the last may be short */
+};
+
+struct mem_entropy_map {
+    u4 window;
+    std::vector<mem_entropy_region> regions;
+    std::vector<u2> entropy;    /* per window, of its readable bytes; MEM_ENTROPY_UNREADABLE if it has none */
+};
+
+struct mem_entropy_stats {
+    u4 regions;
+    u8 windows;
+    u8 bytes;                   /* of memory read */
+    u8 unreadable;              /* windows */
+    u8 elapsed_ns;
+};
+
+/* windows next to each other in one region, all at or over the threshold */
+struct mem_entropy_run {
+    uintptr_t start;
+    uintptr_t end;
+    size_t region;              /* in mem_entropy_map.regions */
+    u2 mean;
+    u2 peak;
+};
+
+/*
+ * Shannon entropy of every window of every readable region the options select (device
+ * memory never is). Regions are cut into units spread over the threads and read a buffer at
+ * a time through mem_read_pages, so unreadable pages are left out instead of faulting. A
+ * window's byte histogram is counted into four tables in turn, which keeps the increments
+ * independent of each other, and its entropy comes from a table of c*log2(c). False if the
+ * job it runs in is cancelled before every unit is done.
+ */
+bool mem_entropy_scan(const mem_entropy_options *options, mem_entropy_map *map, mem_entropy_stats *stats);
+
+/* runs of windows of at least min_entropy, and at least min_windows of them, in address order */
+void mem_entropy_runs(const mem_entropy_map *map, u2 min_entropy, u4 min_windows, std::vector<mem_entropy_run> *runs);
+
+/*
+ * The map as a file: a mem_entropy_header, the regions, their NUL terminated paths, then
+ * the u2 entropies. Compact enough to keep one for a whole process (2 bytes a window).
+ */
+struct mem_entropy_header {
+    char magic[8];
+    u4 window;
+    u4 region_count;
+    u4 window_count;
+    u4 regions_off;             /* mem_entropy_file_region[region_count] */
+    u4 names_off;
+    u4 entropy_off;             /* u2[window_count] */
+};
+
+struct mem_entropy_file_region {
+    u8 start;
+    u8 end;
+    u4 perms;
+    u4 name_off;                /* from names_off */
+    u4 first_window;
+    u4 window_count;
+};
+
+bool mem_entropy_write(const char *path, const mem_entropy_map *map);
+#endif
@@ -0,0 +1,124 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <android/log.h>
+#include "util.h"
+#include "memread.h"
+#include "mapsindex.h"
+
+/*
+ * process_vm_readv on ourselves is the cheapest faultless copy. Kernels older than 3.2 (and
+ * some seccomp policies) refuse it; /proc/self/mem does the same job one pread at a time.
+ */
+static volatile int use_vm_readv = 1;
+static int self_mem_fd = -1;
+static pthread_once_t self_mem_once = PTHREAD_ONCE_INIT;
+
+static void open_self_mem() {
+    self_mem_fd = open("/proc/self/mem", O_RDONLY);
+    if (self_mem_fd < 0)
+        LOGE("open /proc/self/mem failed: %s", strerror(errno));
+}
+
+static ssize_t read_self_mem(const void *addr, void *buffer, size_t length) {
+    pthread_once(&self_mem_once, open_self_mem);
+    if (self_mem_fd < 0) {
+        errno = ENOSYS;
+        return -1;
+    }
+    size_t done = 0;
+    while (done < length) {
+        ssize_t count = pread64(self_mem_fd, (u1 *) buffer + done, length - done,
+                                (off64_t) (uintptr_t) addr + done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        done += count;
+    }
+    return done > 0 ? (ssize_t) done : -1;
+}
+
+ssize_t mem_read(const void *addr, void *buffer, size_t length) {
+    if (length == 0)
+        return 0;
+#ifdef __NR_process_vm_readv
+    if (use_vm_readv) {
+        struct iovec local = {buffer, length};
+        struct iovec remote = {(void *) addr, length};
+        ssize_t count = syscall(__NR_process_vm_readv, getpid(), &local, 1, &remote, 1, 0);
+        if (count >= 0)
+            return count;
+        if (errno != ENOSYS && errno != EPERM)
+            return -1;
+        use_vm_readv = 0;
+    }
+#endif
+    return read_self_mem(addr, buffer, length);
+}
+
+size_t mem_page_count(const void *addr, size_t length) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t first_page = (uintptr_t) addr & ~(page_size - 1);
+    return ((uintptr_t) addr + length - first_page + page_size - 1) / page_size;
+}
+
+/* set the bits of the pages in [start, end), both relative to the first page */
+static void mark_pages(u1 *readable, size_t first, size_t end) {
+    for (size_t page = first; page < end; page++)
+        readable[page >> 3] |= 1 << (page & 7);
+}
+
+static void zero_range(void *buffer, uintptr_t start, uintptr_t from, uintptr_t to) {
+    if (to > from)
+        memset((u1 *) buffer + (from - start), 0, to - from);
+}
+
+size_t mem_read_pages(const void *addr, void *buffer, size_t length, u1 *readable) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) addr;
+    uintptr_t end = start + length;
+    uintptr_t first_page = start & ~(page_size - 1);
+    memset(readable, 0, (mem_page_count(addr, length) + 7) / 8);
+    size_t pages = 0;
+    uintptr_t pos = start;
+    while (pos < end) {
+        map_region region;
+        if (!maps_find_next(pos, &region) || region.start >= end)
+            break;
+        if (region.start > pos) {
+            zero_range(buffer, start, pos, region.start);
+            pos = region.start;
+        }
+        uintptr_t stop = region.end < end ? region.end : end;
+        if (!(region.perms & MAPS_PERM_READ) || maps_is_device(region.path)) {
+            zero_range(buffer, start, pos, stop);
+            pos = stop;
+            continue;
+        }
+        ssize_t got = mem_read((const void *) pos, (u1 *) buffer + (pos - start), stop - pos);
+        if (got < 0)
+            got = 0;
+        /* mem_read only stops early at a page boundary, the page after it is the bad one */
+        size_t first = (pos - first_page) / page_size;
+        size_t last = (pos + got - first_page + page_size - 1) / page_size;
+        if (pos + got < stop)
+            last = (pos + got - first_page) / page_size;
+        mark_pages(readable, first, last);
+        pages += last - first;
+        pos += got;
+        if (pos < stop) {
+            uintptr_t next = std::min((pos & ~(page_size - 1)) + page_size, stop);
+            zero_range(buffer, start, pos, next);
+            pos = next;
+        }
+    }
+    zero_range(buffer, start, pos, end);
+    return pages;
+}
@@ -0,0 +1,26 @@
+#ifndef MEMREAD_H_
+#define MEMREAD_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "util.h"
+
+/*
+ * Copy length bytes at addr into buffer without touching the mapping directly, so a guard
+ * page, a truncated file mapping or a region unmapped under us costs an error, not a signal.
+ * Returns the bytes copied before the first unreadable page, or -1 with errno set when
+ * nothing could be read.
+ */
+ssize_t mem_read(const void *addr, void *buffer, size_t length);
+
+/* pages touched by [addr, addr + length), the bits of a mem_read_pages bitmap */
+size_t mem_page_count(const void *addr, size_t length);
+
+/*
+ * Copy as much of [addr, addr + length) as can be read. Ranges the maps index says aren't
+ * readable (or are device memory) are never touched, and pages that still fail to copy are
+ * skipped; both come back zero filled. Bit i of readable (LSB first) is set when page i,
+ * counted from the page holding addr, was copied. Returns the number of readable pages.
+ */
+size_t mem_read_pages(const void *addr, void *buffer, size_t length, u1 *readable);
+#endif
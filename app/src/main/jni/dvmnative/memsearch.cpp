@@ -0,0 +1,435 @@
+#include <errno.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <android/log.h>
+#include "memsearch.h"
+#include "dumpfile.h"
+#include "mapsindex.h"
+#include "memread.h"
+#include "threadpool.h"
+#include "jobengine.h"
+
+/* the same units and buffers as the dex scan, for the same reasons */
+#define SEARCH_UNIT_SIZE    (16 * 1024 * 1024)
+#define SEARCH_BUFFER_SIZE  (1024 * 1024)
+#define SEARCH_MAX_THREADS  16
+
+struct search_pattern {
+    const u1 *bytes;        /* copies kept out of the search */
+    const u1 *mask;
+    u4 length;
+    int anchor;             /* the byte memchr looks for, -1 if no byte is fully fixed */
+};
+
+struct search_region {
+    uintptr_t start;
+    uintptr_t end;
+    uintptr_t extent_end;   /* end of the run of adjacent selected regions this one is in */
+    const char *name;
+};
+
+struct search_unit {
+    uintptr_t start;
+    uintptr_t end;
+    size_t region;
+};
+
+struct search_context {
+    mem_matcher matcher;
+    const void *matcher_arg;
+    u4 max_length;
+    std::vector<search_region> regions;
+    std::vector<search_unit> units;
+    volatile size_t next_unit;
+    volatile bool stop;
+    u1 *buffers;
+    size_t page_size;
+    const mem_search_options *options;
+    mem_search_callback callback;
+    void *arg;
+    pthread_mutex_t lock;
+    mem_search_stats *stats;
+};
+
+struct mem_match_sink {
+    search_context *ctx;
+    const search_unit *unit;
+    uintptr_t pos;          /* of the buffer being matched */
+};
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* into bytes[MEM_SEARCH_MAX_PATTERN] and mask[MEM_SEARCH_MAX_PATTERN], as mem_pattern_parse */
+static bool parse_pattern(const char *text, u1 *bytes, u1 *mask, u4 *length) {
+    u4 count = 0;
+    bool fixed = false;
+    const char *p = text;
+    while (*p != '\0') {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+        /* a lone '?' between spaces is a whole wildcard byte */
+        if (count == MEM_SEARCH_MAX_PATTERN)
+            return false;
+        if (p[0] == '?' && (p[1] == ' ' || p[1] == '\0')) {
+            bytes[count] = 0;
+            mask[count] = 0;
+            count++;
+            p++;
+            continue;
+        }
+        if (p[1] == '\0')
+            return false;
+        u1 byte = 0;
+        u1 byte_mask = 0;
+        for (int nibble = 0; nibble < 2; nibble++) {
+            int shift = nibble == 0 ? 4 : 0;
+            if (p[nibble] == '?')
+                continue;
+            int digit = hex_digit(p[nibble]);
+            if (digit < 0)
+                return false;
+            byte |= digit << shift;
+            byte_mask |= 0xf << shift;
+        }
+        fixed = fixed || byte_mask != 0;
+        bytes[count] = byte;
+        mask[count] = byte_mask;
+        count++;
+        p += 2;
+    }
+    *length = count;
+    return fixed;
+}
+
+bool mem_pattern_parse(const char *text, mem_pattern *pattern) {
+    u1 bytes[MEM_SEARCH_MAX_PATTERN];
+    u1 mask[MEM_SEARCH_MAX_PATTERN];
+    u4 length;
+    if (!parse_pattern(text, bytes, mask, &length))
+        return false;
+    pattern->bytes.assign(bytes, bytes + length);
+    pattern->mask.assign(mask, mask + length);
+    return true;
+}
+
+/* how often a byte turns up in code and data, roughly; lower is rarer */
+static int byte_commonness(u1 byte) {
+    if (byte == 0x00)
+        return 4;
+    if (byte == 0xff)
+        return 3;
+    if ((byte >= 'a' && byte <= 'z') || byte == ' ')
+        return 2;
+    if (byte < 0x80)
+        return 1;
+    return 0;
+}
+
+static int choose_anchor(const search_pattern *pattern) {
+    int anchor = -1;
+    for (u4 i = 0; i < pattern->length; i++) {
+        if (pattern->mask[i] != 0xff)
+            continue;
+        if (anchor < 0 || byte_commonness(pattern->bytes[i]) < byte_commonness(pattern->bytes[anchor]))
+            anchor = i;
+    }
+    return anchor;
+}
+
+static bool pattern_matches(const search_pattern *pattern, const u1 *data) {
+    for (u4 i = 0; i < pattern->length; i++) {
+        if ((data[i] & pattern->mask[i]) != pattern->bytes[i])
+            return false;
+    }
+    return true;
+}
+
+static void add_search_region(search_context *ctx, uintptr_t start, uintptr_t end, const char *name) {
+    search_region region;
+    region.start = start;
+    region.end = end;
+    region.extent_end = end;
+    region.name = name;
+    ctx->regions.push_back(region);
+}
+
+static bool select_region(const map_region &region, const mem_search_options *options) {
+    u4 perms = options->perms | MAPS_PERM_READ;
+    if ((region.perms & perms) != perms || maps_is_device(region.path))
+        return false;
+    if (options->path_pattern != NULL && fnmatch(options->path_pattern, region.path, 0) != 0)
+        return false;
+    return options->select == NULL || options->select(&region);
+}
+
+/* keep_out is sorted and its ranges don't overlap */
+static void read_search_regions(search_context *ctx, const std::vector<std::pair<uintptr_t, uintptr_t> > &keep_out) {
+    std::vector<map_region> maps;
+    maps_snapshot(&maps);
+    for (size_t i = 0; i < maps.size(); i++) {
+        const map_region &map = maps[i];
+        if (!select_region(map, ctx->options))
+            continue;
+        /* anonymous mappings get merged, so what is kept out may sit in the middle of a region */
+        uintptr_t start = map.start;
+        for (size_t k = 0; k < keep_out.size() && start < map.end; k++) {
+            if (keep_out[k].second <= start || keep_out[k].first >= map.end)
+                continue;
+            if (keep_out[k].first > start)
+                add_search_region(ctx, start, keep_out[k].first, map.path);
+            start = keep_out[k].second;
+        }
+        if (start < map.end)
+            add_search_region(ctx, start, map.end, map.path);
+    }
+    /* a match may straddle two adjacent mappings */
+    for (size_t i = ctx->regions.size(); i-- > 1;) {
+        if (ctx->regions[i - 1].end == ctx->regions[i].start)
+            ctx->regions[i - 1].extent_end = ctx->regions[i].extent_end;
+    }
+    for (size_t i = 0; i < ctx->regions.size(); i++) {
+        for (uintptr_t start = ctx->regions[i].start; start < ctx->regions[i].end; start += SEARCH_UNIT_SIZE) {
+            search_unit unit;
+            unit.start = start;
+            unit.end = std::min(start + SEARCH_UNIT_SIZE, ctx->regions[i].end);
+            unit.region = i;
+            ctx->units.push_back(unit);
+        }
+    }
+}
+
+/* the match and what can be read around it, without leaving the run of regions it is in */
+static void read_context(search_context *ctx, const search_region *region, mem_search_hit *hit, u4 length) {
+    u4 context = ctx->options->context;
+    uintptr_t from = hit->addr - region->start >= context ? hit->addr - context : region->start;
+    uintptr_t to = std::min(hit->addr + length + context, region->extent_end);
+    std::vector<u1> bytes(to - from);
+    ssize_t got = mem_read((const void *) from, &bytes[0], to - from);
+    if (got < (ssize_t) (hit->addr + length - from)) {
+        /* the bytes before it are on a page that can't be read */
+        from = hit->addr;
+        got = mem_read((const void *) from, &bytes[0], to - from);
+    }
+    hit->context_addr = from;
+    if (got > 0)
+        hit->context.assign((const char *) &bytes[0], got);
+    /* a copy of the match left behind on the heap would be found again further on */
+    std::fill(bytes.begin(), bytes.end(), 0);
+}
+
+bool mem_match_found(mem_match_sink *sink, size_t offset, u4 pattern, u4 length) {
+    search_context *ctx = sink->ctx;
+    if (ctx->stop)
+        return false;
+    const search_region *region = &ctx->regions[sink->unit->region];
+    mem_search_hit hit;
+    hit.addr = sink->pos + offset;
+    hit.pattern = pattern;
+    hit.region = region->name;
+    hit.region_start = region->start;
+    read_context(ctx, region, &hit, length);
+    pthread_mutex_lock(&ctx->lock);
+    if (!ctx->stop) {
+        ctx->stats->hits++;
+        if (!ctx->callback(&hit, ctx->arg) ||
+            (ctx->options->max_hits != 0 && ctx->stats->hits >= ctx->options->max_hits)) {
+            ctx->stop = true;
+            ctx->stats->truncated = true;
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    std::fill(hit.context.begin(), hit.context.end(), 0);
+    return !ctx->stop;
+}
+
+static void match_patterns(const void *matcher, const u1 *data, size_t length, size_t starts, mem_match_sink *sink) {
+    const std::vector<search_pattern> *patterns = (const std::vector<search_pattern> *) matcher;
+    for (size_t p = 0; p < patterns->size(); p++) {
+        const search_pattern *pattern = &(*patterns)[p];
+        if (length < pattern->length)
+            continue;
+        size_t count = std::min(length - pattern->length + 1, starts);
+        if (pattern->anchor < 0) {
+            for (size_t i = 0; i < count; i++) {
+                if (pattern_matches(pattern, data + i) && !mem_match_found(sink, i, p, pattern->length))
+                    return;
+            }
+            continue;
+        }
+        u1 anchor_byte = pattern->bytes[pattern->anchor];
+        const u1 *cursor = data + pattern->anchor;
+        const u1 *last = cursor + count;
+        while (cursor < last) {
+            const u1 *hit = (const u1 *) memchr(cursor, anchor_byte, last - cursor);
+            if (hit == NULL)
+                break;
+            cursor = hit + 1;
+            const u1 *start = hit - pattern->anchor;
+            if (pattern_matches(pattern, start) && !mem_match_found(sink, start - data, p, pattern->length))
+                return;
+        }
+    }
+}
+
+static u8 search_one_unit(search_context *ctx, const search_unit *unit, u1 *buffer) {
+    const search_region *region = &ctx->regions[unit->region];
+    size_t overlap = ctx->max_length - 1;
+    uintptr_t limit = std::min(unit->end + overlap, region->extent_end);
+    uintptr_t pos = unit->start;
+    u8 bytes = 0;
+    while (pos < unit->end && !ctx->stop) {
+        size_t want = std::min((uintptr_t) SEARCH_BUFFER_SIZE, limit - pos);
+        ssize_t got = mem_read((const void *) pos, buffer, want);
+        if (got <= 0) {
+            pos = (pos & ~(ctx->page_size - 1)) + ctx->page_size;
+            continue;
+        }
+        bytes += got;
+        bool more = (size_t) got == want && pos + got < limit;
+        uintptr_t accept_end = more ? std::min(unit->end, pos + got - overlap) : unit->end;
+        mem_match_sink sink;
+        sink.ctx = ctx;
+        sink.unit = unit;
+        sink.pos = pos;
+        ctx->matcher(ctx->matcher_arg, buffer, got, accept_end - pos, &sink);
+        if ((size_t) got < want) {
+            pos += got + ctx->page_size;
+            continue;
+        }
+        if (!more)
+            break;
+        pos += got - overlap;
+    }
+    return bytes;
+}
+
+static void search_worker(size_t index, void *arg) {
+    search_context *ctx = (search_context *) arg;
+    u1 *buffer = ctx->buffers + index * SEARCH_BUFFER_SIZE;
+    while (!ctx->stop) {
+        size_t unit = __sync_fetch_and_add(&ctx->next_unit, 1);
+        if (unit >= ctx->units.size())
+            break;
+        if (job_cancelled()) {
+            /* the hits already passed on stand, the search just ends there */
+            pthread_mutex_lock(&ctx->lock);
+            ctx->stop = true;
+            ctx->stats->truncated = true;
+            pthread_mutex_unlock(&ctx->lock);
+            break;
+        }
+        u8 bytes = search_one_unit(ctx, &ctx->units[unit], buffer);
+        job_progress_add(ctx->units[unit].end - ctx->units[unit].start);
+        pthread_mutex_lock(&ctx->lock);
+        ctx->stats->bytes += bytes;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+bool mem_search_with(mem_matcher matcher, const void *matcher_arg, u4 max_length, const void *keep_out,
+                     size_t keep_out_length, const mem_search_options *options, mem_search_callback callback,
+                     void *arg, mem_search_stats *stats) {
+    u8 start = dump_now_ns();
+    memset(stats, 0, sizeof(*stats));
+    int max_threads = options->max_threads;
+    if (max_threads <= 0)
+        max_threads = threadpool_cpu_count();
+    if (max_threads > SEARCH_MAX_THREADS)
+        max_threads = SEARCH_MAX_THREADS;
+
+    /* the buffers hold copies of whatever they search, so they are kept out of the search */
+    size_t buffers_size = (size_t) max_threads * SEARCH_BUFFER_SIZE;
+    void *buffers = mmap(NULL, buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        LOGE("map search buffers failed: %s", strerror(errno));
+        return false;
+    }
+    std::vector<std::pair<uintptr_t, uintptr_t> > ranges;
+    ranges.push_back(std::make_pair((uintptr_t) buffers, (uintptr_t) buffers + buffers_size));
+    if (keep_out_length != 0)
+        ranges.push_back(std::make_pair((uintptr_t) keep_out, (uintptr_t) keep_out + keep_out_length));
+    std::sort(ranges.begin(), ranges.end());
+
+    search_context ctx;
+    ctx.matcher = matcher;
+    ctx.matcher_arg = matcher_arg;
+    ctx.max_length = std::max(max_length, (u4) 1);
+    ctx.next_unit = 0;
+    ctx.stop = false;
+    ctx.buffers = (u1 *) buffers;
+    ctx.page_size = sysconf(_SC_PAGESIZE);
+    ctx.options = options;
+    ctx.callback = callback;
+    ctx.arg = arg;
+    ctx.stats = stats;
+    read_search_regions(&ctx, ranges);
+    stats->regions = ctx.regions.size();
+    u8 total = 0;
+    for (size_t i = 0; i < ctx.units.size(); i++)
+        total += ctx.units[i].end - ctx.units[i].start;
+    job_progress_begin("bytes", total);
+    pthread_mutex_init(&ctx.lock, NULL);
+    parallel_for(max_threads, max_threads, search_worker, &ctx);
+    pthread_mutex_destroy(&ctx.lock);
+    munmap(buffers, buffers_size);
+    stats->elapsed_ns = dump_now_ns() - start;
+    return true;
+}
+
+bool mem_search_process(const std::vector<std::string> &patterns, const mem_search_options *options,
+                        mem_search_callback callback, void *arg, mem_search_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (patterns.empty())
+        return false;
+    /*
+     * the patterns are exactly what is searched for, so they are parsed straight into a mapping
+     * kept out of the search: parsed anywhere else, a copy would be left on the heap to be found
+     */
+    size_t pattern_bytes = patterns.size() * MEM_SEARCH_MAX_PATTERN * 2;
+    void *mapping = mmap(NULL, pattern_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        LOGE("map search patterns failed: %s", strerror(errno));
+        return false;
+    }
+    u4 max_length = 1;
+    std::vector<search_pattern> compiled;
+    u1 *copy = (u1 *) mapping;
+    for (size_t i = 0; i < patterns.size(); i++) {
+        search_pattern pattern;
+        if (!parse_pattern(patterns[i].c_str(), copy, copy + MEM_SEARCH_MAX_PATTERN, &pattern.length)) {
+            LOGE("bad search pattern \"%s\"", patterns[i].c_str());
+            munmap(mapping, pattern_bytes);
+            return false;
+        }
+        pattern.bytes = copy;
+        pattern.mask = copy + MEM_SEARCH_MAX_PATTERN;
+        pattern.anchor = choose_anchor(&pattern);
+        copy += MEM_SEARCH_MAX_PATTERN * 2;
+        max_length = std::max(max_length, pattern.length);
+        compiled.push_back(pattern);
+    }
+    bool ok = mem_search_with(match_patterns, &compiled, max_length, mapping, pattern_bytes, options, callback, arg,
+                              stats);
+    munmap(mapping, pattern_bytes);
+    if (ok) {
+        LOGV("searched %u regions, %llu MB for %u patterns in %u ms, %llu hits%s", stats->regions,
+             (unsigned long long) (stats->bytes >> 20), (unsigned int) patterns.size(),
+             (unsigned int) (stats->elapsed_ns / 1000000), (unsigned long long) stats->hits,
+             stats->truncated ? " (stopped early)" : "");
+    }
+    return ok;
+}
@@ -0,0 +1,87 @@
+#ifndef MEMSEARCH_H_
+#define MEMSEARCH_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "util.h"
+#include "mapsindex.h"
+
+#define MEM_SEARCH_MAX_PATTERN  256
+
+/* bytes[i] is compared with the memory byte masked by mask[i]; bytes are stored masked */
+struct mem_pattern {
+    std::vector<u1> bytes;
+    std::vector<u1> mask;
+};
+
+struct mem_search_options {
+    u4 perms;                   /* MAPS_PERM_* a region must all have, READ is implied */
+    const char *path_pattern;   /* fnmatch pattern for the region path, NULL for any */
+    bool (*select)(const map_region *region);  /* a further filter, NULL for none */
+    u4 context;                 /* bytes kept on each side of a hit */
+    u4 max_hits;                /* 0: no limit */
+    int max_threads;            /* <= 0: one per cpu */
+};
+
+struct mem_search_hit {
+    uintptr_t addr;
+    u4 pattern;                 /* index in the patterns searched */
+    const char *region;         /* interned by the maps index, "" if anonymous */
+    uintptr_t region_start;
+    uintptr_t context_addr;     /* of the first byte of context */
+    std::string context;        /* the match with up to context bytes each side, as far as readable */
+};
+
+struct mem_search_stats {
+    u4 regions;
+    u8 bytes;                   /* of memory read */
+    u8 hits;
+    bool truncated;             /* stopped at max_hits, by the callback or by cancelling its job */
+    u8 elapsed_ns;
+};
+
+/* called for each hit from the search threads, one at a time; return false to stop the search */
+typedef bool (*mem_search_callback)(const mem_search_hit *hit, void *arg);
+
+/* where a matcher hands its matches to the search */
+struct mem_match_sink;
+
+/* a match of pattern, length bytes long at data + offset; false once the search is stopping */
+bool mem_match_found(mem_match_sink *sink, size_t offset, u4 pattern, u4 length);
+
+/*
+ * Finds the matches in one buffer of memory: those starting in data[0, starts) go to sink,
+ * the bytes after starts are there for the ends of such matches. Called from the search
+ * threads at once, so it must not change what it matches with.
+ */
+typedef void (*mem_matcher)(const void *matcher, const u1 *data, size_t length, size_t starts,
+                            mem_match_sink *sink);
+
+/*
+ * "4c 8b ?? 24 e?" style: two hex digits per byte, '?' for a wildcard nibble, "??" (or a
+ * lone '?') for a wildcard byte, spaces optional. False if it doesn't parse, is all
+ * wildcards or longer than MEM_SEARCH_MAX_PATTERN.
+ */
+bool mem_pattern_parse(const char *text, mem_pattern *pattern);
+
+/*
+ * Search every readable region the options select (device memory never is) for any of
+ * patterns, in the syntax of mem_pattern_parse; false if one doesn't parse. They are parsed
+ * into memory kept out of the search, so the search never finds its own copies. Regions are cut into units spread over the threads and read through per-thread
+ * buffers, so unreadable pages are stepped over instead of faulting. In each buffer the
+ * rarest fixed byte of a pattern is found with memchr, which is vectorized, and the whole
+ * pattern is only verified around it. Hits are handed to callback as they are found, in no
+ * particular order.
+ */
+bool mem_search_process(const std::vector<std::string> &patterns, const mem_search_options *options,
+                        mem_search_callback callback, void *arg, mem_search_stats *stats);
+
+/*
+ * The search behind mem_search_process, with any matcher: max_length is its longest match
+ * and [keep_out, keep_out + keep_out_length), where its data lives, is never searched.
+ */
+bool mem_search_with(mem_matcher matcher, const void *matcher_arg, u4 max_length, const void *keep_out,
+                     size_t keep_out_length, const mem_search_options *options, mem_search_callback callback,
+                     void *arg, mem_search_stats *stats);
+#endif
@@ -0,0 +1,204 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <android/log.h>
+#include "memsnap.h"
+#include "dumpfile.h"
+#include "mapsindex.h"
+#include "memread.h"
+
+/* read and written a chunk at a time, the only buffers that hold page data */
+#define SNAP_CHUNK_SIZE     (1024 * 1024)
+
+struct snap_writer {
+    int fd;
+    size_t page_size;
+    u8 pages_off;
+    std::vector<u1> pending;        /* stored pages not written yet */
+    u4 pending_first;               /* stored page number of pending[0] */
+    u4 stored;
+    std::unordered_multimap<u8, u4> by_hash;
+    std::vector<u4> page_table;
+    std::vector<u1> verify;
+    dump_result result;
+    mem_snapshot_stats *stats;
+};
+
+static u8 page_hash(const u1 *page, size_t length) {
+    u8 hash = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+        u8 word;
+        memcpy(&word, page + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+static bool page_is_zero(const u1 *page, size_t length) {
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+        u8 word;
+        memcpy(&word, page + i, 8);
+        if (word != 0)
+            return false;
+    }
+    return true;
+}
+
+static bool flush_pending(snap_writer *writer) {
+    if (writer->pending.empty())
+        return true;
+    u8 offset = writer->pages_off + (u8) writer->pending_first * writer->page_size;
+    if (!dump_write_at(writer->fd, &writer->pending[0], writer->pending.size(), offset, &writer->result))
+        return false;
+    writer->pending_first = writer->stored;
+    writer->pending.clear();
+    return true;
+}
+
+/* a hash match is only a candidate: the stored page is read back (from the page cache) and compared */
+static bool same_as_stored(snap_writer *writer, u4 number, const u1 *page) {
+    if (number >= writer->pending_first)
+        return memcmp(&writer->pending[(size_t) (number - writer->pending_first) * writer->page_size], page,
+                      writer->page_size) == 0;
+    u8 offset = writer->pages_off + (u8) number * writer->page_size;
+    ssize_t got = pread64(writer->fd, &writer->verify[0], writer->page_size, (off64_t) offset);
+    return got == (ssize_t) writer->page_size && memcmp(&writer->verify[0], page, writer->page_size) == 0;
+}
+
+static u4 store_page(snap_writer *writer, const u1 *page) {
+    u8 hash = page_hash(page, writer->page_size);
+    std::pair<std::unordered_multimap<u8, u4>::iterator, std::unordered_multimap<u8, u4>::iterator> range =
+            writer->by_hash.equal_range(hash);
+    for (std::unordered_multimap<u8, u4>::iterator it = range.first; it != range.second; ++it) {
+        if (same_as_stored(writer, it->second, page)) {
+            writer->stats->duplicate++;
+            return it->second;
+        }
+    }
+    u4 number = writer->stored++;
+    writer->by_hash.insert(std::make_pair(hash, number));
+    writer->pending.insert(writer->pending.end(), page, page + writer->page_size);
+    writer->stats->stored++;
+    if (writer->pending.size() >= SNAP_CHUNK_SIZE)
+        flush_pending(writer);
+    return number;
+}
+
+static void snapshot_region(snap_writer *writer, const map_region &region, std::vector<u1> *buffer,
+                            std::vector<u1> *readable) {
+    size_t page_size = writer->page_size;
+    for (uintptr_t chunk = region.start; chunk < region.end && writer->result.error == 0; chunk += SNAP_CHUNK_SIZE) {
+        size_t length = std::min((uintptr_t) SNAP_CHUNK_SIZE, region.end - chunk);
+        mem_read_pages((const void *) chunk, &(*buffer)[0], length, &(*readable)[0]);
+        for (size_t i = 0; i < length / page_size; i++) {
+            const u1 *page = &(*buffer)[i * page_size];
+            u4 entry;
+            if (!((*readable)[i >> 3] & (1 << (i & 7)))) {
+                entry = MEM_SNAPSHOT_UNREADABLE;
+                writer->stats->unreadable++;
+            } else if (page_is_zero(page, page_size)) {
+                entry = MEM_SNAPSHOT_ZERO;
+                writer->stats->zero++;
+            } else {
+                entry = store_page(writer, page);
+            }
+            writer->page_table.push_back(entry);
+        }
+    }
+}
+
+static bool select_region(const map_region &region, const mem_snapshot_filter *filter) {
+    if ((region.perms & filter->perms) != filter->perms || maps_is_device(region.path))
+        return false;
+    if (filter->max_region_size != 0 && region.end - region.start > filter->max_region_size)
+        return false;
+    return filter->pattern == NULL || fnmatch(filter->pattern, region.path, 0) == 0;
+}
+
+bool mem_snapshot_write(const char *path, const mem_snapshot_filter *filter, mem_snapshot_stats *stats) {
+    u8 start = dump_now_ns();
+    memset(stats, 0, sizeof(*stats));
+    snap_writer writer;
+    writer.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (writer.fd < 0) {
+        LOGE("open %s failed: %s", path, strerror(errno));
+        return false;
+    }
+    writer.page_size = sysconf(_SC_PAGESIZE);
+    /* page aligned, so the stored pages can be mapped straight out of the file */
+    writer.pages_off = (sizeof(mem_snapshot_header) + writer.page_size - 1) & ~(u8) (writer.page_size - 1);
+    writer.pending_first = 0;
+    writer.stored = 0;
+    writer.verify.resize(writer.page_size);
+    writer.result.bytes = 0;
+    writer.result.error = 0;
+    writer.stats = stats;
+
+    std::vector<map_region> maps;
+    maps_snapshot(&maps);
+    std::vector<mem_snapshot_region> regions;
+    std::string names;
+    std::vector<u1> buffer(SNAP_CHUNK_SIZE);
+    std::vector<u1> readable(SNAP_CHUNK_SIZE / writer.page_size / 8 + 1);
+    for (size_t i = 0; i < maps.size() && writer.result.error == 0; i++) {
+        if (!select_region(maps[i], filter))
+            continue;
+        mem_snapshot_region region;
+        region.start = maps[i].start;
+        region.end = maps[i].end;
+        region.file_offset = maps[i].offset;
+        region.first_page = writer.page_table.size();
+        region.perms = maps[i].perms;
+        region.name_off = names.size();
+        names += maps[i].path;
+        names.push_back('\0');
+        regions.push_back(region);
+        snapshot_region(&writer, maps[i], &buffer, &readable);
+    }
+    flush_pending(&writer);
+
+    mem_snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MEM_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.page_size = writer.page_size;
+    header.region_count = regions.size();
+    header.pages_off = writer.pages_off;
+    header.stored_pages = writer.stored;
+    header.index_off = writer.pages_off + (u8) writer.stored * writer.page_size;
+    header.page_table_off = regions.size() * sizeof(mem_snapshot_region);
+    header.names_off = header.page_table_off + writer.page_table.size() * sizeof(u4);
+    header.index_size = header.names_off + names.size();
+    if (writer.result.error == 0 && !regions.empty())
+        dump_write_at(writer.fd, &regions[0], header.page_table_off, header.index_off, &writer.result);
+    if (writer.result.error == 0 && !writer.page_table.empty())
+        dump_write_at(writer.fd, &writer.page_table[0], writer.page_table.size() * sizeof(u4),
+                      header.index_off + header.page_table_off, &writer.result);
+    if (writer.result.error == 0 && !names.empty())
+        dump_write_at(writer.fd, names.data(), names.size(), header.index_off + header.names_off, &writer.result);
+    /* the header goes last: a file cut short by an error has no valid magic */
+    if (writer.result.error == 0)
+        dump_write_at(writer.fd, &header, sizeof(header), 0, &writer.result);
+    close(writer.fd);
+
+    stats->regions = regions.size();
+    stats->pages = writer.page_table.size();
+    stats->bytes = header.index_off + header.index_size;
+    stats->elapsed_ns = dump_now_ns() - start;
+    if (writer.result.error != 0) {
+        LOGE("snapshot to %s failed: %s", path, strerror(writer.result.error));
+        return false;
+    }
+    LOGV("snapshot of %u regions to %s: %llu pages, %llu stored, %llu duplicate, %llu zero, %llu unreadable, "
+         "%llu bytes in %u ms", stats->regions, path, (unsigned long long) stats->pages,
+         (unsigned long long) stats->stored, (unsigned long long) stats->duplicate, (unsigned long long) stats->zero,
+         (unsigned long long) stats->unreadable, (unsigned long long) stats->bytes,
+         (unsigned int) (stats->elapsed_ns / 1000000));
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef MEMSNAP_H_
+#define MEMSNAP_H_
+#include <stdint.h>
+#include <stddef.h>
+#include "util.h"
+
+#define MEM_SNAPSHOT_MAGIC      "memsnp1"
+/* page table values that aren't a stored page */
+#define MEM_SNAPSHOT_ZERO       0xfffffffe
+#define MEM_SNAPSHOT_UNREADABLE 0xffffffff
+
+/*
+ * A snapshot of many regions in one file: the header, the stored pages from pages_off (each
+ * distinct non-zero page once, page_size bytes apiece), then the index at index_off: the
+ * regions, a u4 page table entry for every page of every region (the stored page number,
+ * or one of the values above) and the region names. Page i of a region is entry
+ * first_page + i; stored page n is at pages_off + n * page_size.
+ */
+struct mem_snapshot_header {
+    char magic[8];
+    u4 page_size;
+    u4 region_count;
+    u8 pages_off;
+    u8 stored_pages;
+    u8 index_off;
+    u8 page_table_off;          /* from index_off, like names_off */
+    u8 names_off;
+    u8 index_size;
+};
+
+struct mem_snapshot_region {
+    u8 start;
+    u8 end;
+    u8 file_offset;             /* of the mapping, from /proc/self/maps */
+    u8 first_page;              /* in the page table */
+    u4 perms;                   /* MAPS_PERM_* */
+    u4 name_off;                /* from names_off, NUL terminated; "" if anonymous */
+};
+
+struct mem_snapshot_filter {
+    u4 perms;                   /* MAPS_PERM_* a region must all have */
+    const char *pattern;        /* fnmatch pattern for the path, NULL for any */
+    u8 max_region_size;         /* 0: no limit */
+};
+
+struct mem_snapshot_stats {
+    u4 regions;
+    u8 pages;
+    u8 stored;
+    u8 duplicate;               /* pages found already stored */
+    u8 zero;
+    u8 unreadable;
+    u8 bytes;                   /* of the file */
+    u8 elapsed_ns;
+};
+
+/*
+ * Snapshot every region of the process the filter selects (device memory never is) into
+ * path. Pages are streamed through a fixed buffer; only the page table and the hash of each
+ * stored page stay in memory, so the footprint grows with the page count, not the data.
+ */
+bool mem_snapshot_write(const char *path, const mem_snapshot_filter *filter, mem_snapshot_stats *stats);
+#endif
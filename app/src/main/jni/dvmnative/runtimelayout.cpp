@@ -0,0 +1,200 @@
+#include <pthread.h>
+#include <string.h>
+#include <android/log.h>
+#include "runtimelayout.h"
+#include "memread.h"
+
+#define ART_PROBE_WORDS     32
+#define DVM_PROBE_WORDS     12
+/* the id table pointers after header_: string, type, field, method, proto, class_def */
+#define ART_ID_TABLES       6
+#define LAYOUT_ROWS(rows)   (sizeof(rows) / sizeof(rows[0]))
+
+static const art_dexfile_layout art_dexfile_layouts[] = {
+        /* vtable, begin_, size_, location_ (3), location_checksum_, mem_map_, header_ */
+        {21, 27, 1, 2, 8},
+        /* mem_map_ gone; data_begin_, data_size_ after size_ (data_ ArrayRef from 31) */
+        {28, 36, 1, 2, 9},
+};
+
+static const dvm_dex_layout dvm_dex_layouts[] = {
+        /* pDexFile, pHeader, pResStrings ... pInterfaceCache, memMap */
+        {9,  13, 0, 1, 7},
+        /* isMappedReadOnly before memMap */
+        {14, 19, 0, 1, 8},
+};
+
+template<typename Row>
+struct probed_layout {
+    pthread_mutex_t lock;
+    bool probed;
+    Row row;
+};
+
+static probed_layout<art_dexfile_layout> art_dexfile = {PTHREAD_MUTEX_INITIALIZER, false};
+static probed_layout<dvm_dex_layout> dvm_dex = {PTHREAD_MUTEX_INITIALIZER, false};
+
+/* the row for api, or the newest one older than api as the guess to check */
+template<typename Row>
+static const Row *find_row(const Row *rows, size_t count, int api) {
+    const Row *guess = NULL;
+    for (size_t i = 0; i < count; i++) {
+        if (api >= rows[i].min_api && api <= rows[i].max_api)
+            return &rows[i];
+        if (api > rows[i].max_api)
+            guess = &rows[i];
+    }
+    return guess;
+}
+
+static bool read_words(const void *obj, uintptr_t *words, size_t count) {
+    return obj != NULL && mem_read(obj, words, count * sizeof(uintptr_t)) == (ssize_t) (count * sizeof(uintptr_t));
+}
+
+static bool read_dex_header(uintptr_t begin, art::DexFile::Header *header) {
+    if (begin == 0 || mem_read((const void *) begin, header, sizeof(*header)) != (ssize_t) sizeof(*header))
+        return false;
+    return memcmp(header->magic_, "dex\n", 4) == 0 || memcmp(header->magic_, "cdex", 4) == 0;
+}
+
+static bool art_row_fits(const uintptr_t *words, const art_dexfile_layout *row) {
+    if (row->header + ART_ID_TABLES >= ART_PROBE_WORDS)
+        return false;
+    uintptr_t begin = words[row->begin];
+    art::DexFile::Header header;
+    return read_dex_header(begin, &header) && words[row->size] >= DEX_HEADER_SIZE &&
+           words[row->header] == begin && words[row->header + 1] == begin + header.string_ids_off_;
+}
+
+/* begin_ is the first word pointing at a dex header, header_ the first later one that equals it
+ * and is followed by string_ids_ (data_begin_ equals begin_ too, but isn't) */
+static bool art_search(const uintptr_t *words, art_dexfile_layout *row) {
+    for (u4 begin = 1; begin + 1 < ART_PROBE_WORDS; begin++) {
+        art::DexFile::Header header;
+        if (!read_dex_header(words[begin], &header))
+            continue;
+        row->begin = begin;
+        row->size = begin + 1;
+        for (row->header = begin + 2; row->header + ART_ID_TABLES < ART_PROBE_WORDS; row->header++) {
+            if (art_row_fits(words, row))
+                return true;
+        }
+    }
+    return false;
+}
+
+static bool dvm_row_fits(const uintptr_t *words, const dvm_dex_layout *row) {
+    if (row->mem_map + 1 >= DVM_PROBE_WORDS)
+        return false;
+    uintptr_t addr = words[row->mem_map];
+    uintptr_t length = words[row->mem_map + 1];
+    uintptr_t header = words[row->header];
+    return words[row->dex_file] != 0 && length >= DEX_HEADER_SIZE && header >= addr && header < addr + length;
+}
+
+static bool dvm_search(const uintptr_t *words, dvm_dex_layout *row) {
+    for (row->mem_map = row->header + 1; row->mem_map + 1 < DVM_PROBE_WORDS; row->mem_map++) {
+        if (dvm_row_fits(words, row))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Check (or correct) the row for api against obj, once. Until an object passes, each
+ * call probes again: a stale cookie must not pin a wrong layout.
+ */
+template<typename Row, size_t Words>
+static const Row *probe(probed_layout<Row> *cache, const Row *rows, size_t count, int api, const void *obj,
+                        bool (*fits)(const uintptr_t *, const Row *), bool (*search)(const uintptr_t *, Row *)) {
+    if (__atomic_load_n(&cache->probed, __ATOMIC_ACQUIRE))
+        return &cache->row;
+    pthread_mutex_lock(&cache->lock);
+    const Row *result = NULL;
+    uintptr_t words[Words];
+    const Row *row = find_row(rows, count, api);
+    if (cache->probed) {
+        result = &cache->row;
+    } else if (read_words(obj, words, Words)) {
+        if (row != NULL && fits(words, row)) {
+            cache->row = *row;
+            result = &cache->row;
+        } else {
+            Row found;
+            memset(&found, 0, sizeof(found));
+            if (row != NULL)
+                found = *row;
+            found.min_api = found.max_api = api;
+            if (search(words, &found)) {
+                LOGE("layout for api %d corrected by probing, add a row for it", api);
+                cache->row = found;
+                result = &cache->row;
+            }
+        }
+        if (result != NULL)
+            __atomic_store_n(&cache->probed, true, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (result == NULL)
+        LOGV("no layout fits the object at %p for api %d", obj, api);
+    return result;
+}
+
+static const art_dexfile_layout *art_layout(int api, const void *dex_file) {
+    if (dex_file == NULL)
+        return NULL;
+    return probe<art_dexfile_layout, ART_PROBE_WORDS>(&art_dexfile, art_dexfile_layouts,
+                                                      LAYOUT_ROWS(art_dexfile_layouts), api, dex_file,
+                                                      art_row_fits, art_search);
+}
+
+static const dvm_dex_layout *dvm_layout(int api, const void *dvm_dex_obj) {
+    if (dvm_dex_obj == NULL)
+        return NULL;
+    return probe<dvm_dex_layout, DVM_PROBE_WORDS>(&dvm_dex, dvm_dex_layouts, LAYOUT_ROWS(dvm_dex_layouts), api,
+                                                  dvm_dex_obj, dvm_row_fits, dvm_search);
+}
+
+static uintptr_t word_at(const void *obj, u4 word) {
+    return ((const uintptr_t *) obj)[word];
+}
+
+bool layout_art_dexfile_region(int api, const void *dex_file, const u1 **begin, size_t *size) {
+    const art_dexfile_layout *layout = art_layout(api, dex_file);
+    if (layout == NULL)
+        return false;
+    *begin = (const u1 *) word_at(dex_file, layout->begin);
+    *size = word_at(dex_file, layout->size);
+    return true;
+}
+
+bool layout_art_dexfile_tables(int api, const void *dex_file, dex_tables *tables) {
+    const art_dexfile_layout *layout = art_layout(api, dex_file);
+    if (layout == NULL)
+        return false;
+    tables->base = (const u1 *) word_at(dex_file, layout->begin);
+    tables->header = (const art::DexFile::Header *) word_at(dex_file, layout->header);
+    tables->string_ids = (const art::DexFile::StringId *) word_at(dex_file, layout->header + 1);
+    tables->type_ids = (const art::DexFile::TypeId *) word_at(dex_file, layout->header + 2);
+    tables->field_ids = (const art::DexFile::FieldId *) word_at(dex_file, layout->header + 3);
+    tables->method_ids = (const art::DexFile::MethodId *) word_at(dex_file, layout->header + 4);
+    tables->proto_ids = (const art::DexFile::ProtoId *) word_at(dex_file, layout->header + 5);
+    tables->class_defs = (const art::DexFile::ClassDef *) word_at(dex_file, layout->header + 6);
+    return true;
+}
+
+bool layout_dvm_dex_region(int api, const void *dvm_dex_obj, void **addr, size_t *length) {
+    const dvm_dex_layout *layout = dvm_layout(api, dvm_dex_obj);
+    if (layout == NULL)
+        return false;
+    *addr = (void *) word_at(dvm_dex_obj, layout->mem_map);
+    *length = word_at(dvm_dex_obj, layout->mem_map + 1);
+    return true;
+}
+
+const void *layout_dvm_dex_file(int api, const void *dvm_dex_obj) {
+    const dvm_dex_layout *layout = dvm_layout(api, dvm_dex_obj);
+    if (layout == NULL)
+        return NULL;
+    return (const void *) word_at(dvm_dex_obj, layout->dex_file);
+}
@@ -0,0 +1,40 @@
+#ifndef RUNTIMELAYOUT_H_
+#define RUNTIMELAYOUT_H_
+#include <stdint.h>
+#include <stddef.h>
+#include "util.h"
+#include "dexparse.h"
+
+/*
+ * Where the runtime keeps the fields we read, per API level. Offsets count pointer-size
+ * words, so one row holds for 32 and 64-bit builds alike (size_t, the libc++ string and
+ * the padded u4 checksum are all whole words). A new Android release is one more row.
+ */
+struct art_dexfile_layout {
+    int min_api;
+    int max_api;
+    u4 begin;           /* const uint8_t *begin_, right after the vtable */
+    u4 size;            /* size_t size_ */
+    u4 header;          /* header_, string_ids_ ... class_defs_ follow it word by word */
+};
+
+struct dvm_dex_layout {
+    int min_api;
+    int max_api;
+    u4 dex_file;        /* DexFile *pDexFile */
+    u4 header;          /* const DexHeader *pHeader, lies in the mapping */
+    u4 mem_map;         /* MemMapping memMap: addr, length, baseAddr, baseLength */
+};
+
+/*
+ * The first object of each kind handed in checks the row for the API level: the fields
+ * have to point at what the dex they describe says. A row that doesn't hold is corrected
+ * by searching the object once, and every later lookup is a load at a fixed offset.
+ * These return false when neither the row nor the search fit the object.
+ */
+bool layout_art_dexfile_region(int api, const void *dex_file, const u1 **begin, size_t *size);
+bool layout_art_dexfile_tables(int api, const void *dex_file, dex_tables *tables);
+
+bool layout_dvm_dex_region(int api, const void *dvm_dex, void **addr, size_t *length);
+const void *layout_dvm_dex_file(int api, const void *dvm_dex);
+#endif
@@ -0,0 +1,94 @@
+#include <dlfcn.h>
+#include <pthread.h>
+#include <string.h>
+#include <android/log.h>
+#include "runtimesym.h"
+#include "elfinfo.h"
+#include "mapsindex.h"
+
+#define DVM_LIBRARY "libdvm.so"
+#define ART_LIBRARY "libart.so"
+
+static pthread_once_t runtime_once = PTHREAD_ONCE_INIT;
+static runtime_symbols runtime;
+
+/* every name a symbol has been exported under, c++ mangled on most builds */
+static const char *const decode_indirect_ref_names[] = {"_Z20dvmDecodeIndirectRefP6ThreadP8_jobject",
+                                                        "dvmDecodeIndirectRef", NULL};
+static const char *const thread_self_names[] = {"_Z13dvmThreadSelfv", "dvmThreadSelf", NULL};
+static const char *const inline_ops_table_names[] = {"dvmGetInlineOpsTable", "_Z20dvmGetInlineOpsTablev", NULL};
+static const char *const inline_ops_length_names[] = {"dvmGetInlineOpsTableLength",
+                                                      "_Z26dvmGetInlineOpsTableLengthv", NULL};
+static const char *const art_thread_current_names[] = {"_ZN3art6Thread14CurrentFromGdbEv", NULL};
+static const char *const art_decode_jobject_names[] = {"_ZNK3art6Thread13DecodeJObjectEP8_jobject", NULL};
+
+struct runtime_library {
+    const char *name;
+    void *handle;                       /* RTLD_NOLOAD handle, NULL when dlopen is refused */
+    const struct elf_index *index;      /* the mapped image, NULL when not loaded */
+};
+
+static void open_library(runtime_library *lib, const char *name) {
+    uintptr_t base;
+    lib->name = name;
+    lib->handle = dlopen(name, RTLD_NOW | RTLD_NOLOAD);
+    lib->index = maps_module_base(name, &base) ? elf_index_get(base) : NULL;
+}
+
+static void *resolve(const runtime_library *lib, const char *const names[]) {
+    for (int i = 0; names[i] != NULL; i++) {
+        void *addr = lib->handle != NULL ? dlsym(lib->handle, names[i]) : NULL;
+        /* namespace restrictions hide the system libraries from dlopen, their symbol tables are still mapped */
+        if (addr == NULL && lib->index != NULL)
+            addr = (void *) elf_index_find_export(lib->index, names[i]);
+        if (addr != NULL) {
+            LOGV("resolved %s!%s at %p", lib->name, names[i], addr);
+            return addr;
+        }
+    }
+    if (lib->handle != NULL || lib->index != NULL)
+        LOGE("can not resolve %s in %s", names[0], lib->name);
+    return NULL;
+}
+
+static void resolve_all() {
+    runtime_library dvm, art;
+    open_library(&dvm, DVM_LIBRARY);
+    open_library(&art, ART_LIBRARY);
+    memset(&runtime, 0, sizeof(runtime));
+    runtime.art = art.handle != NULL || art.index != NULL;
+
+    runtime.dvmDecodeIndirectRef = (void *(*)(void *, jobject)) resolve(&dvm, decode_indirect_ref_names);
+    runtime.dvmThreadSelf = (void *(*)()) resolve(&dvm, thread_self_names);
+    runtime.dvmGetInlineOpsTable = (const void *(*)()) resolve(&dvm, inline_ops_table_names);
+    runtime.dvmGetInlineOpsTableLength = (int (*)()) resolve(&dvm, inline_ops_length_names);
+    runtime.artThreadCurrent = (void *(*)()) resolve(&art, art_thread_current_names);
+    runtime.artDecodeJObject = (void *(*)(void *, jobject)) resolve(&art, art_decode_jobject_names);
+
+    /* both libraries stay loaded for the life of the process, the handles only pinned them */
+    if (dvm.handle != NULL)
+        dlclose(dvm.handle);
+    if (art.handle != NULL)
+        dlclose(art.handle);
+}
+
+void runtime_symbols_init() {
+    pthread_once(&runtime_once, resolve_all);
+}
+
+const runtime_symbols *runtime_symbols_get() {
+    pthread_once(&runtime_once, resolve_all);
+    return &runtime;
+}
+
+void *runtime_decode_jobject(jobject obj) {
+    const runtime_symbols *symbols = runtime_symbols_get();
+    if (symbols->art) {
+        if (symbols->artThreadCurrent == NULL || symbols->artDecodeJObject == NULL)
+            return NULL;
+        return symbols->artDecodeJObject(symbols->artThreadCurrent(), obj);
+    }
+    if (symbols->dvmThreadSelf == NULL || symbols->dvmDecodeIndirectRef == NULL)
+        return NULL;
+    return symbols->dvmDecodeIndirectRef(symbols->dvmThreadSelf(), obj);
+}
@@ -0,0 +1,34 @@
+#ifndef RUNTIMESYM_H_
+#define RUNTIMESYM_H_
+#include <jni.h>
+#include "util.h"
+
+/*
+ * Entry points of the running vm, resolved once (JNI_OnLoad) and cached for the life of
+ * the process. Each is looked up with dlsym first and, where the linker namespace hides
+ * the vm library from us (N+), in the mapped image's own symbol table. Whatever is not
+ * there is NULL: the dalvik ones on art and the other way round.
+ */
+struct runtime_symbols {
+    bool art;               /* libart.so is the vm of this process */
+
+    /* libdvm.so */
+    void *(*dvmDecodeIndirectRef)(void *self, jobject jobj);
+    void *(*dvmThreadSelf)();
+    const void *(*dvmGetInlineOpsTable)();
+    int (*dvmGetInlineOpsTableLength)();
+
+    /* libart.so */
+    void *(*artThreadCurrent)();                                /* art::Thread::CurrentFromGdb() */
+    void *(*artDecodeJObject)(void *thread, jobject jobj);      /* art::Thread::DecodeJObject(_jobject*) const */
+};
+
+/* resolve everything, later calls are no-ops; cheap to call from any thread */
+void runtime_symbols_init();
+
+/* the cached entry points, resolving them first if nobody has yet */
+const runtime_symbols *runtime_symbols_get();
+
+/* the object behind a local/global reference, NULL if the vm entry points are missing */
+void *runtime_decode_jobject(jobject obj);
+#endif
@@ -0,0 +1,457 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <android/log.h>
+#include "sigscan.h"
+#include "dumpfile.h"
+
+struct source_sig {
+    std::string name;
+    mem_pattern pattern;
+    u4 anchor_start;
+    u4 anchor_end;
+};
+
+struct build_state {
+    std::map<u1, u4> next;
+    u4 fail;
+    u4 depth;
+    std::vector<u4> outputs;
+};
+
+static bool read_source(const char *path, std::string *text) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    char buffer[64 * 1024];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            break;
+        text->append(buffer, count);
+    }
+    close(fd);
+    return count == 0;
+}
+
+static std::string trim(const std::string &s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return std::string();
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+/* the longest run of fully fixed bytes, at most SIG_MAX_ANCHOR of it */
+static bool choose_anchor(source_sig *sig) {
+    u4 best_start = 0;
+    u4 best_length = 0;
+    const std::vector<u1> &mask = sig->pattern.mask;
+    for (u4 i = 0; i < mask.size();) {
+        if (mask[i] != 0xff) {
+            i++;
+            continue;
+        }
+        u4 start = i;
+        while (i < mask.size() && mask[i] == 0xff)
+            i++;
+        if (i - start > best_length) {
+            best_start = start;
+            best_length = i - start;
+        }
+    }
+    if (best_length > SIG_MAX_ANCHOR)
+        best_length = SIG_MAX_ANCHOR;
+    sig->anchor_start = best_start;
+    sig->anchor_end = best_start + best_length;
+    return best_length != 0;
+}
+
+static bool parse_source(const std::string &text, std::vector<source_sig> *sigs, std::string *error) {
+    size_t line_start = 0;
+    for (u4 line_number = 1; line_start < text.size(); line_number++) {
+        size_t line_end = text.find('\n', line_start);
+        if (line_end == std::string::npos)
+            line_end = text.size();
+        std::string line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        line = trim(line);
+        if (line.empty())
+            continue;
+        source_sig sig;
+        size_t equals = line.find('=');
+        if (equals != std::string::npos)
+            sig.name = trim(line.substr(0, equals));
+        if (sig.name.empty() || !mem_pattern_parse(trim(line.substr(equals + 1)).c_str(), &sig.pattern) ||
+            !choose_anchor(&sig)) {
+            char where[64];
+            snprintf(where, sizeof(where), "line %u: ", line_number);
+            *error = where + line;
+            return false;
+        }
+        sigs->push_back(sig);
+    }
+    return true;
+}
+
+static u4 build_goto(const std::vector<build_state> &states, u4 state, u1 byte) {
+    std::map<u1, u4>::const_iterator it = states[state].next.find(byte);
+    return it != states[state].next.end() ? it->second : SIG_NO_STATE;
+}
+
+/* the trie of the anchors with its failure links; order lists the states breadth first */
+static void build_automaton(const std::vector<source_sig> &sigs, std::vector<build_state> *states,
+                            std::vector<u4> *order) {
+    states->resize(1);
+    (*states)[0].fail = 0;
+    (*states)[0].depth = 0;
+    for (u4 i = 0; i < sigs.size(); i++) {
+        u4 state = 0;
+        for (u4 k = sigs[i].anchor_start; k < sigs[i].anchor_end; k++) {
+            u1 byte = sigs[i].pattern.bytes[k];
+            u4 next = build_goto(*states, state, byte);
+            if (next == SIG_NO_STATE) {
+                next = states->size();
+                build_state child;
+                child.fail = 0;
+                child.depth = (*states)[state].depth + 1;
+                states->push_back(child);
+                (*states)[state].next[byte] = next;
+            }
+            state = next;
+        }
+        (*states)[state].outputs.push_back(i);
+    }
+    order->push_back(0);
+    for (size_t head = 0; head < order->size(); head++) {
+        u4 state = (*order)[head];
+        for (std::map<u1, u4>::const_iterator it = (*states)[state].next.begin(); it != (*states)[state].next.end();
+             ++it) {
+            u4 child = it->second;
+            if (state != 0) {
+                u4 fail = (*states)[state].fail;
+                while (fail != 0 && build_goto(*states, fail, it->first) == SIG_NO_STATE)
+                    fail = (*states)[fail].fail;
+                u4 target = build_goto(*states, fail, it->first);
+                (*states)[child].fail = target != SIG_NO_STATE ? target : 0;
+            }
+            order->push_back(child);
+        }
+    }
+}
+
+static u4 align4(u4 value) {
+    return (value + 3) & ~3u;
+}
+
+static void write_set(const std::vector<source_sig> &sigs, const std::vector<build_state> &states,
+                      const std::vector<u4> &order, std::vector<u1> *out) {
+    u4 state_count = states.size();
+    /* renumbered breadth first, so the shallow states with a dense row come first */
+    std::vector<u4> number(state_count);
+    u4 dense_count = 0;
+    for (u4 i = 0; i < state_count; i++) {
+        number[order[i]] = i;
+        if (states[order[i]].depth <= 1)
+            dense_count = i + 1;
+    }
+    std::vector<sig_state> table(state_count);
+    std::vector<sig_edge> edges;
+    std::vector<u4> outputs;
+    for (u4 i = 0; i < state_count; i++) {
+        const build_state &state = states[order[i]];
+        sig_state *entry = &table[i];
+        entry->fail = number[state.fail];
+        entry->first_output = outputs.size();
+        entry->output_count = state.outputs.size();
+        outputs.insert(outputs.end(), state.outputs.begin(), state.outputs.end());
+        /* failure links lead to shallower states, which come earlier */
+        entry->report = !state.outputs.empty() ? i : i == 0 ? SIG_NO_STATE : table[entry->fail].report;
+    }
+    for (u4 i = 0; i < state_count; i++) {
+        const build_state &state = states[order[i]];
+        table[i].first_edge = edges.size();
+        table[i].edge_count = 0;
+        if (i < dense_count)
+            continue;
+        for (std::map<u1, u4>::const_iterator it = state.next.begin(); it != state.next.end(); ++it) {
+            u4 target = number[it->second];
+            sig_edge edge;
+            edge.byte = it->first;
+            edge.target = target | (table[target].report != SIG_NO_STATE ? SIG_STATE_REPORTS : 0);
+            edges.push_back(edge);
+            table[i].edge_count++;
+        }
+    }
+    std::vector<u4> dense((size_t) dense_count * 256);
+    for (u4 i = 0; i < dense_count; i++) {
+        const build_state &state = states[order[i]];
+        for (u4 byte = 0; byte < 256; byte++) {
+            u4 child = build_goto(states, order[i], byte);
+            if (child != SIG_NO_STATE) {
+                u4 target = number[child];
+                dense[i * 256 + byte] = target | (table[target].report != SIG_NO_STATE ? SIG_STATE_REPORTS : 0);
+            } else {
+                dense[i * 256 + byte] = i == 0 ? 0 : dense[(size_t) number[state.fail] * 256 + byte];
+            }
+        }
+    }
+
+    /* the pairs that go past depth 1, and every pair ending in a one byte anchor */
+    std::vector<u1> stops(SIG_STOPS_SIZE);
+    const std::map<u1, u4> &first = states[0].next;
+    for (std::map<u1, u4>::const_iterator it = first.begin(); it != first.end(); ++it) {
+        const build_state &child = states[it->second];
+        for (std::map<u1, u4>::const_iterator next = child.next.begin(); next != child.next.end(); ++next) {
+            u4 pair = it->first << 8 | next->first;
+            stops[pair >> 3] |= 1 << (pair & 7);
+        }
+        for (u4 before = 0; before < 256 && !child.outputs.empty(); before++) {
+            u4 pair = before << 8 | it->first;
+            stops[pair >> 3] |= 1 << (pair & 7);
+        }
+    }
+
+    std::vector<sig_entry> entries(sigs.size());
+    std::string data;
+    u4 max_length = 0;
+    for (u4 i = 0; i < sigs.size(); i++) {
+        const mem_pattern &pattern = sigs[i].pattern;
+        entries[i].name_off = data.size();
+        data.append(sigs[i].name.c_str(), sigs[i].name.size() + 1);
+        entries[i].bytes_off = data.size();
+        data.append((const char *) &pattern.bytes[0], pattern.bytes.size());
+        entries[i].mask_off = data.size();
+        data.append((const char *) &pattern.mask[0], pattern.mask.size());
+        entries[i].length = pattern.bytes.size();
+        entries[i].anchor_end = sigs[i].anchor_end;
+        max_length = std::max(max_length, entries[i].length);
+    }
+
+    sig_set_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SIG_SET_MAGIC, sizeof(header.magic));
+    header.sig_count = sigs.size();
+    header.state_count = state_count;
+    header.dense_count = dense_count;
+    header.max_length = max_length;
+    header.dense_off = align4(sizeof(header));
+    header.stops_off = header.dense_off + dense.size() * sizeof(u4);
+    header.states_off = header.stops_off + stops.size();
+    header.edges_off = header.states_off + table.size() * sizeof(sig_state);
+    header.edge_count = edges.size();
+    header.outputs_off = header.edges_off + edges.size() * sizeof(sig_edge);
+    header.sigs_off = header.outputs_off + outputs.size() * sizeof(u4);
+    header.data_off = header.sigs_off + entries.size() * sizeof(sig_entry);
+    header.file_size = header.data_off + data.size();
+    out->assign(header.file_size, 0);
+    memcpy(&(*out)[0], &header, sizeof(header));
+    memcpy(&(*out)[header.dense_off], &dense[0], dense.size() * sizeof(u4));
+    memcpy(&(*out)[header.stops_off], &stops[0], stops.size());
+    memcpy(&(*out)[header.states_off], &table[0], table.size() * sizeof(sig_state));
+    if (!edges.empty())
+        memcpy(&(*out)[header.edges_off], &edges[0], edges.size() * sizeof(sig_edge));
+    memcpy(&(*out)[header.outputs_off], &outputs[0], outputs.size() * sizeof(u4));
+    memcpy(&(*out)[header.sigs_off], &entries[0], entries.size() * sizeof(sig_entry));
+    memcpy(&(*out)[header.data_off], data.data(), data.size());
+}
+
+bool sig_set_compile(const char *source_path, const char *blob_path, u4 *sig_count, std::string *error) {
+    u8 start = dump_now_ns();
+    std::string text;
+    if (!read_source(source_path, &text)) {
+        *error = std::string("can't read ") + source_path + ": " + strerror(errno);
+        return false;
+    }
+    std::vector<source_sig> sigs;
+    if (!parse_source(text, &sigs, error))
+        return false;
+    if (sigs.empty()) {
+        *error = std::string("no signatures in ") + source_path;
+        return false;
+    }
+    std::vector<build_state> states;
+    std::vector<u4> order;
+    build_automaton(sigs, &states, &order);
+    std::vector<u1> file;
+    write_set(sigs, states, order, &file);
+
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), ".tmp%d", getpid());
+    std::string tmp_path = std::string(blob_path) + tmp;
+    dump_result result;
+    if (!dump_region_to_file(tmp_path.c_str(), &file[0], file.size(), DUMP_FSYNC_END, &result) ||
+        rename(tmp_path.c_str(), blob_path) != 0) {
+        *error = std::string("write ") + blob_path + " failed: " + strerror(result.error != 0 ? result.error : errno);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    *sig_count = sigs.size();
+    LOGV("compiled %u signatures to %u states (%u dense), %u bytes in %u us", (unsigned int) sigs.size(),
+         (unsigned int) states.size(), ((const sig_set_header *) &file[0])->dense_count, (unsigned int) file.size(),
+         (unsigned int) ((dump_now_ns() - start) / 1000));
+    return true;
+}
+
+static bool section_fits(u4 off, u8 size, u4 file_size) {
+    return (off & 3) == 0 && off <= file_size && size <= file_size - off;
+}
+
+bool sig_set_open(const char *blob_path, sig_set *set) {
+    int fd = open(blob_path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(sig_set_header))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    const sig_set_header *header = (const sig_set_header *) map;
+    bool valid = memcmp(header->magic, SIG_SET_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->file_size == (u8) st.st_size && header->state_count != 0 &&
+                 header->dense_count != 0 && header->dense_count <= header->state_count &&
+                 section_fits(header->dense_off, (u8) header->dense_count * 256 * sizeof(u4), header->file_size) &&
+                 section_fits(header->stops_off, SIG_STOPS_SIZE, header->file_size) &&
+                 section_fits(header->states_off, (u8) header->state_count * sizeof(sig_state), header->file_size) &&
+                 section_fits(header->edges_off, (u8) header->edge_count * sizeof(sig_edge), header->file_size) &&
+                 section_fits(header->sigs_off, (u8) header->sig_count * sizeof(sig_entry), header->file_size) &&
+                 section_fits(header->outputs_off, 0, header->file_size) &&
+                 header->data_off <= header->file_size;
+    if (!valid) {
+        LOGE("%s is not a signature set", blob_path);
+        munmap(map, st.st_size);
+        return false;
+    }
+    set->header = header;
+    set->dense = (const u4 *) ((const u1 *) map + header->dense_off);
+    set->stops = (const u1 *) map + header->stops_off;
+    set->states = (const sig_state *) ((const u1 *) map + header->states_off);
+    set->edges = (const sig_edge *) ((const u1 *) map + header->edges_off);
+    set->outputs = (const u4 *) ((const u1 *) map + header->outputs_off);
+    set->sigs = (const sig_entry *) ((const u1 *) map + header->sigs_off);
+    set->data = (const char *) map + header->data_off;
+    set->size = st.st_size;
+    return true;
+}
+
+void sig_set_close(sig_set *set) {
+    if (set->header != NULL)
+        munmap((void *) set->header, set->size);
+    set->header = NULL;
+}
+
+bool sig_scan_module_region(const map_region *region) {
+    static const char *const suffixes[] = {".so", ".apk", ".jar", ".dex", ".odex", ".oat", ".vdex"};
+    size_t length = strlen(region->path);
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t suffix_length = strlen(suffixes[i]);
+        if (length >= suffix_length && strcmp(region->path + length - suffix_length, suffixes[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* one byte of input: states past the dense rows follow their failure links to one that takes it */
+static inline u4 sig_step(const sig_set *set, u4 state, u1 byte) {
+    u4 dense_count = set->header->dense_count;
+    while (state >= dense_count) {
+        const sig_state *entry = &set->states[state];
+        const sig_edge *edge = set->edges + entry->first_edge;
+        const sig_edge *end = edge + entry->edge_count;
+        for (; edge < end && edge->byte <= byte; edge++) {
+            if (edge->byte == byte)
+                return edge->target;
+        }
+        state = entry->fail;
+    }
+    return set->dense[(size_t) state * 256 + byte];
+}
+
+static bool sig_matches(const sig_set *set, const sig_entry *entry, const u1 *data) {
+    const u1 *bytes = (const u1 *) set->data + entry->bytes_off;
+    const u1 *mask = (const u1 *) set->data + entry->mask_off;
+    for (u4 i = 0; i < entry->length; i++) {
+        if ((data[i] & mask[i]) != bytes[i])
+            return false;
+    }
+    return true;
+}
+
+/* every signature whose anchor ends at data + end, verified whole */
+static bool report_signatures(const sig_set *set, u4 state, const u1 *data, size_t length, size_t end,
+                              size_t starts, mem_match_sink *sink) {
+    for (u4 report = set->states[state].report; report != SIG_NO_STATE;
+         report = set->states[set->states[report].fail].report) {
+        const sig_state *entry = &set->states[report];
+        for (u4 i = 0; i < entry->output_count; i++) {
+            u4 sig = set->outputs[entry->first_output + i];
+            const sig_entry *signature = &set->sigs[sig];
+            if (end < signature->anchor_end)
+                continue;
+            size_t start = end - signature->anchor_end;
+            if (start >= starts || start + signature->length > length || !sig_matches(set, signature, data + start))
+                continue;
+            if (!mem_match_found(sink, start, sig, signature->length))
+                return false;
+        }
+    }
+    return true;
+}
+
+static void match_signatures(const void *matcher, const u1 *data, size_t length, size_t starts,
+                             mem_match_sink *sink) {
+    const sig_set *set = (const sig_set *) matcher;
+    const u1 *stops = set->stops;
+    u4 dense_count = set->header->dense_count;
+    u4 state = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (state < dense_count && i != 0) {
+            /* shallow: skip to the next pair that can leave, the state before it is the last byte's */
+            size_t skip = i;
+            while (skip < length) {
+                u4 pair = data[skip - 1] << 8 | data[skip];
+                if (stops[pair >> 3] & (1 << (pair & 7)))
+                    break;
+                skip++;
+            }
+            if (skip == length)
+                return;
+            if (skip != i)
+                state = set->dense[data[skip - 1]] & ~SIG_STATE_REPORTS;
+            i = skip;
+        }
+        state = sig_step(set, state, data[i]);
+        if (!(state & SIG_STATE_REPORTS))
+            continue;
+        state &= ~SIG_STATE_REPORTS;
+        if (!report_signatures(set, state, data, length, i + 1, starts, sink))
+            return;
+    }
+}
+
+bool sig_scan_process(const sig_set *set, const mem_search_options *options, mem_search_callback callback,
+                      void *arg, mem_search_stats *stats) {
+    /* the set holds every signature, so its mapping is kept out of the scan */
+    bool ok = mem_search_with(match_signatures, set, set->header->max_length, set->header, set->size, options,
+                              callback, arg, stats);
+    if (ok) {
+        LOGV("scanned %u regions, %llu MB for %u signatures in %u ms, %llu hits%s", stats->regions,
+             (unsigned long long) (stats->bytes >> 20), set->header->sig_count,
+             (unsigned int) (stats->elapsed_ns / 1000000), (unsigned long long) stats->hits,
+             stats->truncated ? " (stopped early)" : "");
+    }
+    return ok;
+}
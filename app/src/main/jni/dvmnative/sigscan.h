@@ -0,0 +1,105 @@
+#ifndef SIGSCAN_H_
+#define SIGSCAN_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "util.h"
+#include "memsearch.h"
+
+#define SIG_SET_MAGIC       "sigset1"
+/* on a transition target: the state reached reports signatures */
+#define SIG_STATE_REPORTS   0x80000000
+#define SIG_NO_STATE        0xffffffff
+/* the fixed run of a signature the automaton matches, the rest is verified around it */
+#define SIG_MAX_ANCHOR      16
+#define SIG_STOPS_SIZE      (256 * 256 / 8)
+
+/*
+ * A compiled signature set, mapped as it is: the header, then the sections below at their
+ * offsets. The automaton runs over the anchors of the signatures (their longest run of
+ * fixed bytes). States are numbered breadth first: the root and its children come first
+ * with a full row each, the rest keep sorted edges plus a failure link. Targets carry
+ * SIG_STATE_REPORTS.
+ *
+ * In those shallow states the next one only depends on the last byte, and most bytes keep
+ * the automaton there, so the stops bitmap has bit (b << 8 | c) set for the pairs that can
+ * leave them or report; a scan skips ahead to the next such pair on an 8k table.
+ */
+struct sig_set_header {
+    char magic[8];
+    u4 file_size;
+    u4 sig_count;
+    u4 state_count;
+    u4 dense_count;             /* the root and its children, which have a row in the dense table */
+    u4 max_length;              /* of a signature */
+    u4 dense_off;               /* u4[dense_count][256], failures already followed */
+    u4 stops_off;               /* u1[SIG_STOPS_SIZE] */
+    u4 states_off;              /* sig_state[state_count] */
+    u4 edges_off;               /* sig_edge[edge_count] */
+    u4 edge_count;
+    u4 outputs_off;             /* u4 signature indexes, the runs sig_state points at */
+    u4 sigs_off;                /* sig_entry[sig_count] */
+    u4 data_off;                /* signature bytes, masks and NUL terminated names */
+};
+
+struct sig_state {
+    u4 fail;
+    u4 first_edge;
+    u4 edge_count;
+    u4 first_output;            /* signatures whose anchor ends here */
+    u4 output_count;
+    u4 report;                  /* this or the nearest state up the failure links with outputs, or SIG_NO_STATE */
+};
+
+struct sig_edge {
+    u4 byte;
+    u4 target;
+};
+
+struct sig_entry {
+    u4 name_off;                /* from data_off, like the two below */
+    u4 bytes_off;               /* masked, like mem_pattern */
+    u4 mask_off;
+    u4 length;
+    u4 anchor_end;              /* just past the anchor, from the start of the signature */
+};
+
+struct sig_set {
+    const sig_set_header *header;
+    const u4 *dense;
+    const u1 *stops;
+    const sig_state *states;
+    const sig_edge *edges;
+    const u4 *outputs;
+    const sig_entry *sigs;
+    const char *data;
+    size_t size;                /* of the mapping */
+};
+
+/*
+ * Compile the signature source at source_path, one "name = 4c 8b ?? 24" line each (pattern
+ * syntax of mem_pattern_parse, '#' starts a comment), to a set at blob_path. The file is
+ * written aside and renamed, so a set being scanned with is never changed under it. On a
+ * bad line error says which and nothing is written.
+ */
+bool sig_set_compile(const char *source_path, const char *blob_path, u4 *sig_count, std::string *error);
+
+/* map a compiled set, checking its header and sections fit; nothing else is read or built */
+bool sig_set_open(const char *blob_path, sig_set *set);
+void sig_set_close(sig_set *set);
+
+static inline const char *sig_set_name(const sig_set *set, u4 sig) {
+    return set->data + set->sigs[sig].name_off;
+}
+
+/* libraries and the files the runtime maps dex code from: apk, jar, dex, odex, oat, vdex */
+bool sig_scan_module_region(const map_region *region);
+
+/*
+ * Scan the regions the options select with the set: one pass of the automaton per buffer,
+ * the buffers spread over the threads as in mem_search_process. Hits carry the signature
+ * index as their pattern.
+ */
+bool sig_scan_process(const sig_set *set, const mem_search_options *options, mem_search_callback callback,
+                      void *arg, mem_search_stats *stats);
+#endif
@@ -0,0 +1,262 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <android/log.h>
+#include "textscan.h"
+#include "elfinfo.h"
+#include "gotsnap.h"
+#include "mapsindex.h"
+#include "memread.h"
+#include "threadpool.h"
+
+/* a big libchrome or libart still spreads over the threads */
+#define TEXT_UNIT_SIZE      (4 * 1024 * 1024)
+#define TEXT_BUFFER_SIZE    (1024 * 1024)
+/* difference runs closer than this are one patch: a trampoline rewrites whole instructions */
+#define TEXT_MERGE_GAP      16
+#define TEXT_COMPARE_BLOCK  64
+
+struct text_library {
+    const char *path;
+    const struct elf_index *index;
+    const u1 *file;                     /* the whole file, mapped read-only */
+    size_t file_size;
+    std::vector<ElfW(Addr)> relocs;     /* sorted, only for libraries with text relocations */
+};
+
+struct text_unit {
+    size_t library;
+    uintptr_t addr;
+    const u1 *file;
+    size_t length;
+};
+
+struct text_range {
+    size_t library;
+    uintptr_t addr;
+    uintptr_t end;
+};
+
+struct text_context {
+    std::vector<text_library> libraries;
+    std::vector<text_unit> units;
+    volatile size_t next_unit;
+    pthread_mutex_t lock;
+    std::vector<text_range> ranges;
+};
+
+static bool map_library_file(text_library *lib) {
+    int fd = open(lib->path, O_RDONLY);
+    if (fd < 0) {
+        LOGE("open %s error: %s", lib->path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ElfW(Ehdr))) {
+        close(fd);
+        return false;
+    }
+    void *file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        LOGE("map %s error: %s", lib->path, strerror(errno));
+        return false;
+    }
+    lib->file = (const u1 *) file;
+    lib->file_size = st.st_size;
+    /* a library replaced on disk since it was loaded can't be compared with */
+    if (memcmp(lib->file, &lib->index->ehdr, sizeof(ElfW(Ehdr))) != 0) {
+        LOGV("%s changed on disk, skipped", lib->path);
+        munmap(file, st.st_size);
+        lib->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+static bool add_segments(text_context *ctx, size_t library, text_scan_stats *stats) {
+    text_library *lib = &ctx->libraries[library];
+    const ElfW(Ehdr) *ehdr = &lib->index->ehdr;
+    size_t units = ctx->units.size();
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        ElfW(Phdr) phdr;
+        memcpy(&phdr, (const void *) (lib->index->base + ehdr->e_phoff + i * sizeof(phdr)), sizeof(phdr));
+        if (phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_X) || phdr.p_filesz == 0)
+            continue;
+        if (phdr.p_offset + phdr.p_filesz > lib->file_size)
+            return false;
+        uintptr_t start = lib->index->bias + phdr.p_vaddr;
+        /* execute-only text can't be read back */
+        map_region region;
+        if (!maps_find_addr(start, &region) || !(region.perms & MAPS_PERM_READ))
+            return false;
+        for (size_t offset = 0; offset < phdr.p_filesz; offset += TEXT_UNIT_SIZE) {
+            text_unit unit;
+            unit.library = library;
+            unit.addr = start + offset;
+            unit.file = lib->file + phdr.p_offset + offset;
+            unit.length = std::min((size_t) TEXT_UNIT_SIZE, (size_t) phdr.p_filesz - offset);
+            ctx->units.push_back(unit);
+            stats->bytes += unit.length;
+        }
+    }
+    return ctx->units.size() > units;
+}
+
+static void read_libraries(text_context *ctx, text_scan_stats *stats) {
+    std::vector<got_library> libs;
+    got_libraries(&libs);
+    for (size_t i = 0; i < libs.size(); i++) {
+        text_library lib;
+        lib.path = libs[i].path;
+        lib.index = elf_index_get(libs[i].base);
+        lib.file = NULL;
+        if (lib.index == NULL || !map_library_file(&lib)) {
+            stats->skipped++;
+            continue;
+        }
+        if (lib.index->dinfo.textrel) {
+            elf_index_relocations(lib.index, &lib.relocs);
+            std::sort(lib.relocs.begin(), lib.relocs.end());
+        }
+        ctx->libraries.push_back(lib);
+        if (!add_segments(ctx, ctx->libraries.size() - 1, stats)) {
+            munmap((void *) lib.file, lib.file_size);
+            ctx->libraries.pop_back();
+            stats->skipped++;
+            continue;
+        }
+        stats->libraries++;
+    }
+}
+
+/* give relocated words their file bytes, so only real patches compare unequal */
+static void mask_relocations(const text_library *lib, uintptr_t addr, u1 *memory, const u1 *file, size_t length) {
+    if (lib->relocs.empty())
+        return;
+    std::vector<ElfW(Addr)>::const_iterator it =
+            std::lower_bound(lib->relocs.begin(), lib->relocs.end(), addr > sizeof(ElfW(Addr)) ? addr - sizeof(ElfW(Addr)) : 0);
+    for (; it != lib->relocs.end() && *it < addr + length; ++it) {
+        for (size_t byte = 0; byte < sizeof(ElfW(Addr)); byte++) {
+            uintptr_t at = *it + byte;
+            if (at >= addr && at < addr + length)
+                memory[at - addr] = file[at - addr];
+        }
+    }
+}
+
+static void add_range(std::vector<text_range> *ranges, size_t library, uintptr_t addr, uintptr_t end) {
+    if (!ranges->empty() && ranges->back().library == library && addr - ranges->back().end <= TEXT_MERGE_GAP) {
+        ranges->back().end = end;
+        return;
+    }
+    text_range range;
+    range.library = library;
+    range.addr = addr;
+    range.end = end;
+    ranges->push_back(range);
+}
+
+/* memcmp is the vectorized loop; only a block that differs is looked at byte by byte */
+static void compare_chunk(size_t library, uintptr_t addr, const u1 *memory, const u1 *file, size_t length,
+                          std::vector<text_range> *ranges) {
+    for (size_t block = 0; block < length; block += TEXT_COMPARE_BLOCK) {
+        size_t size = std::min((size_t) TEXT_COMPARE_BLOCK, length - block);
+        if (memcmp(memory + block, file + block, size) == 0)
+            continue;
+        for (size_t i = block; i < block + size; i++) {
+            if (memory[i] != file[i])
+                add_range(ranges, library, addr + i, addr + i + 1);
+        }
+    }
+}
+
+static void compare_unit(text_context *ctx, const text_unit *unit, u1 *buffer, std::vector<text_range> *ranges) {
+    const text_library *lib = &ctx->libraries[unit->library];
+    for (size_t offset = 0; offset < unit->length; offset += TEXT_BUFFER_SIZE) {
+        size_t want = std::min((size_t) TEXT_BUFFER_SIZE, unit->length - offset);
+        ssize_t got = mem_read((const void *) (unit->addr + offset), buffer, want);
+        if (got <= 0)
+            return;
+        mask_relocations(lib, unit->addr + offset, buffer, unit->file + offset, got);
+        compare_chunk(unit->library, unit->addr + offset, buffer, unit->file + offset, got, ranges);
+        if ((size_t) got < want)
+            return;
+    }
+}
+
+static void text_worker(size_t index, void *arg) {
+    text_context *ctx = (text_context *) arg;
+    std::vector<u1> buffer(TEXT_BUFFER_SIZE);
+    std::vector<text_range> ranges;
+    for (;;) {
+        size_t unit = __sync_fetch_and_add(&ctx->next_unit, 1);
+        if (unit >= ctx->units.size())
+            break;
+        compare_unit(ctx, &ctx->units[unit], &buffer[0], &ranges);
+    }
+    pthread_mutex_lock(&ctx->lock);
+    ctx->ranges.insert(ctx->ranges.end(), ranges.begin(), ranges.end());
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static bool range_before(const text_range &a, const text_range &b) {
+    return a.addr < b.addr;
+}
+
+static void describe_patch(const text_context *ctx, const text_range &range, text_patch *patch) {
+    const text_library *lib = &ctx->libraries[range.library];
+    patch->addr = range.addr;
+    patch->length = range.end - range.addr;
+    patch->library = lib->path;
+    patch->symbol_addr = 0;
+    const struct elf_symbol *symbol = elf_index_nearest_symbol(lib->index, range.addr);
+    if (symbol != NULL) {
+        patch->symbol = symbol->name;
+        patch->symbol_addr = symbol->addr;
+    }
+    size_t bytes = std::min((size_t) patch->length, (size_t) TEXT_PATCH_BYTES);
+    u1 memory[TEXT_PATCH_BYTES];
+    ssize_t got = mem_read((const void *) range.addr, memory, bytes);
+    patch->patched.assign((const char *) memory, got > 0 ? got : 0);
+    /* the range lies in a unit, so in the file */
+    for (size_t i = 0; i < ctx->units.size(); i++) {
+        const text_unit &unit = ctx->units[i];
+        if (unit.library == range.library && range.addr >= unit.addr && range.addr < unit.addr + unit.length) {
+            patch->original.assign((const char *) unit.file + (range.addr - unit.addr),
+                                   std::min(bytes, (size_t) (unit.addr + unit.length - range.addr)));
+            break;
+        }
+    }
+}
+
+bool text_scan_process(int max_threads, std::vector<text_patch> *patches, text_scan_stats *stats) {
+    if (max_threads <= 0)
+        max_threads = threadpool_cpu_count();
+    memset(stats, 0, sizeof(*stats));
+
+    text_context ctx;
+    ctx.next_unit = 0;
+    read_libraries(&ctx, stats);
+    pthread_mutex_init(&ctx.lock, NULL);
+    parallel_for(max_threads, max_threads, text_worker, &ctx);
+    pthread_mutex_destroy(&ctx.lock);
+
+    /* the workers' runs come back unordered and split at unit and buffer edges */
+    std::sort(ctx.ranges.begin(), ctx.ranges.end(), range_before);
+    std::vector<text_range> merged;
+    for (size_t i = 0; i < ctx.ranges.size(); i++)
+        add_range(&merged, ctx.ranges[i].library, ctx.ranges[i].addr, ctx.ranges[i].end);
+    for (size_t i = 0; i < merged.size(); i++) {
+        patches->push_back(text_patch());
+        describe_patch(&ctx, merged[i], &patches->back());
+    }
+    for (size_t i = 0; i < ctx.libraries.size(); i++)
+        munmap((void *) ctx.libraries[i].file, ctx.libraries[i].file_size);
+    return true;
+}
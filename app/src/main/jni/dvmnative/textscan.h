@@ -0,0 +1,36 @@
+#ifndef TEXTSCAN_H_
+#define TEXTSCAN_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "util.h"
+
+/* bytes of each side kept in a text_patch */
+#define TEXT_PATCH_BYTES    32
+
+struct text_patch {
+    uintptr_t addr;
+    u4 length;
+    std::string library;
+    std::string symbol;         /* nearest defined symbol at or before addr, empty if none */
+    uintptr_t symbol_addr;
+    std::string original;       /* first bytes of the range in the file */
+    std::string patched;        /* and in memory */
+};
+
+struct text_scan_stats {
+    u4 libraries;               /* compared */
+    u4 skipped;                 /* file gone, replaced or unreadable text */
+    u8 bytes;                   /* of code compared */
+};
+
+/*
+ * Compare the executable segments of every loaded library with its file on disk, on
+ * max_threads threads (<= 0: one per cpu), and report the ranges that differ, i.e.
+ * inline hooks and breakpoints. Relocation targets are left out of the compare for
+ * libraries with text relocations. Patches come back sorted by address, bytes at most
+ * 16 apart merged into one range.
+ */
+bool text_scan_process(int max_threads, std::vector<text_patch> *patches, text_scan_stats *stats);
+#endif
@@ -0,0 +1,68 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <android/log.h>
+#include "util.h"
+#include "threadpool.h"
+#include "jobengine.h"
+
+#define THREADPOOL_MAX_THREADS 16
+
+struct parallel_job {
+    size_t count;
+    volatile size_t next;
+    parallel_task task;
+    void *arg;
+    void *owner;                /* the job parallel_for was called from, taken on by the workers */
+};
+
+int threadpool_cpu_count() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int) cpus : 1;
+}
+
+static void *parallel_worker(void *arg) {
+    parallel_job *job = (parallel_job *) arg;
+    job_adopt(job->owner);
+    for (;;) {
+        size_t index = __sync_fetch_and_add(&job->next, 1);
+        if (index >= job->count)
+            break;
+        job->task(index, job->arg);
+    }
+    return NULL;
+}
+
+void parallel_for(size_t count, int max_threads, parallel_task task, void *arg) {
+    if (count == 0)
+        return;
+    if (max_threads <= 0)
+        max_threads = threadpool_cpu_count();
+    if (max_threads > THREADPOOL_MAX_THREADS)
+        max_threads = THREADPOOL_MAX_THREADS;
+    if ((size_t) max_threads > count)
+        max_threads = (int) count;
+
+    parallel_job job;
+    job.count = count;
+    job.next = 0;
+    job.task = task;
+    job.arg = arg;
+    job.owner = job_current();
+
+    pthread_t threads[THREADPOOL_MAX_THREADS];
+    int started = 0;
+    for (int i = 1; i < max_threads; i++) {
+        int err = pthread_create(&threads[started], NULL, parallel_worker, &job);
+        if (err != 0) {
+            /* the remaining workers just pick up more indexes */
+            LOGE("start worker %d failed: %s", i, strerror(err));
+            break;
+        }
+        started++;
+    }
+    parallel_worker(&job);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
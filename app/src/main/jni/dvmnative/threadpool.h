@@ -0,0 +1,18 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+#include <stddef.h>
+
+typedef void (*parallel_task)(size_t index, void *arg);
+
+/* online cpus, at least 1 */
+int threadpool_cpu_count();
+
+/*
+ * Run task(i, arg) for every i in [0, count) on up to max_threads threads, the caller being
+ * one of them, and return once all of them are done. Indexes are handed out one at a time,
+ * so uneven tasks balance themselves. max_threads <= 0 means one thread per online cpu.
+ * The workers belong to the job of the caller (jobengine.h), so tasks can check for its
+ * cancellation and add to its progress.
+ */
+void parallel_for(size_t count, int max_threads, parallel_task task, void *arg);
+#endif
@@ -0,0 +1,328 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <map>
+#include <string>
+#include <android/log.h>
+#include "tracering.h"
+#include "dumpfile.h"
+
+/* records the consumer copies out and writes at once */
+#define TRACE_BATCH     1024
+
+/* guards starting, stopping and the names; never taken by the producers */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trace_wake = PTHREAD_COND_INITIALIZER;
+static std::map<u2, std::string> trace_names;
+static pthread_t consumer_thread;
+static bool consumer_stopping;
+
+/* the ring: producers only touch these, and only between trace_enter and trace_leave */
+static trace_record *ring;
+static u4 ring_slots;
+static u4 ring_head;
+static volatile int tracing;
+static volatile int writers;
+static volatile u8 dropped;
+
+/* only touched by the consumer, or by trace_stop once it is gone */
+static u4 ring_tail;
+static int trace_fd = -1;
+static trace_file_header header;
+static dump_result write_result;
+static u8 lost;                 /* drained after a failed write */
+
+/* with seq_cst on both sides, trace_stop sees every producer that saw tracing set */
+static bool trace_enter() {
+    __sync_fetch_and_add(&writers, 1);
+    if (__atomic_load_n(&tracing, __ATOMIC_SEQ_CST))
+        return true;
+    __sync_fetch_and_sub(&writers, 1);
+    return false;
+}
+
+static void trace_leave() {
+    __sync_fetch_and_sub(&writers, 1);
+}
+
+/*
+ * Claim count slots in a row. A slot is free for position pos once its seq is pos, and the
+ * consumer frees them in order, so the last of the run being free means all of it is.
+ */
+static bool claim_slots(u4 count, u4 *first) {
+    u4 mask = ring_slots - 1;
+    u4 pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    for (;;) {
+        u4 last = pos + count - 1;
+        s4 diff = (s4) (__atomic_load_n(&ring[last & mask].seq, __ATOMIC_ACQUIRE) - last);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + count, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                *first = pos;
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void fill_record(trace_record *record, u8 now, u4 tid, u2 event, const void *payload, size_t length,
+                        u1 flags) {
+    record->time_ns = now;
+    record->tid = tid;
+    record->event = event;
+    record->length = length;
+    record->flags = flags;
+    memcpy(record->payload, payload, length);
+}
+
+bool trace_event(u2 event, const void *payload, size_t length, u1 flags) {
+    if (!trace_enter())
+        return false;
+    u4 pos;
+    bool claimed = claim_slots(1, &pos);
+    if (claimed) {
+        trace_record *record = &ring[pos & (ring_slots - 1)];
+        fill_record(record, dump_now_ns(), gettid(), event, payload,
+                    length < TRACE_PAYLOAD_SIZE ? length : TRACE_PAYLOAD_SIZE, flags);
+        __atomic_store_n(&record->seq, pos + 1, __ATOMIC_RELEASE);
+    } else {
+        __sync_fetch_and_add(&dropped, 1);
+    }
+    trace_leave();
+    return claimed;
+}
+
+bool trace_text(u2 event, const char *text, size_t length) {
+    if (length > TRACE_TEXT_MAX)
+        length = TRACE_TEXT_MAX;
+    u4 count = length == 0 ? 1 : (length + TRACE_PAYLOAD_SIZE - 1) / TRACE_PAYLOAD_SIZE;
+    if (!trace_enter())
+        return false;
+    /* all the records at once, so a text is never cut by a full ring nor split by other threads */
+    u4 pos;
+    bool claimed = claim_slots(count, &pos);
+    if (claimed) {
+        u8 now = dump_now_ns();
+        u4 tid = gettid();
+        for (u4 i = 0; i < count; i++) {
+            trace_record *record = &ring[(pos + i) & (ring_slots - 1)];
+            size_t offset = (size_t) i * TRACE_PAYLOAD_SIZE;
+            size_t part = length - offset < TRACE_PAYLOAD_SIZE ? length - offset : TRACE_PAYLOAD_SIZE;
+            fill_record(record, now, tid, event, text + offset, part,
+                        TRACE_FLAG_TEXT | (i + 1 < count ? TRACE_FLAG_CONTINUED : 0));
+            __atomic_store_n(&record->seq, pos + i + 1, __ATOMIC_RELEASE);
+        }
+    } else {
+        __sync_fetch_and_add(&dropped, count);
+    }
+    trace_leave();
+    return claimed;
+}
+
+static void write_header() {
+    header.dropped = __atomic_load_n(&dropped, __ATOMIC_RELAXED) + lost;
+    if (write_result.error == 0)
+        dump_write_at(trace_fd, &header, sizeof(header), 0, &write_result);
+}
+
+/* everything committed in a row from the tail, a batch per write; the header follows */
+static size_t drain_ring(trace_record *batch) {
+    u4 mask = ring_slots - 1;
+    size_t total = 0;
+    bool drained = false;
+    while (!drained) {
+        size_t count = 0;
+        while (count < TRACE_BATCH) {
+            trace_record *slot = &ring[ring_tail & mask];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring_tail + 1)
+                break;
+            batch[count] = *slot;
+            batch[count].seq = (u4) (header.record_count + count);
+            __atomic_store_n(&slot->seq, ring_tail + ring_slots, __ATOMIC_RELEASE);
+            ring_tail++;
+            count++;
+        }
+        drained = count < TRACE_BATCH;
+        total += count;
+        if (count == 0)
+            break;
+        u8 offset = header.records_off + header.record_count * sizeof(trace_record);
+        if (write_result.error == 0 &&
+            dump_write_at(trace_fd, batch, count * sizeof(trace_record), offset, &write_result)) {
+            header.record_count += count;
+        } else {
+            lost += count;
+        }
+    }
+    write_header();
+    return total;
+}
+
+static void *consumer_main(void *arg) {
+    trace_record *batch = new trace_record[TRACE_BATCH];
+    size_t drained = 0;
+    pthread_mutex_lock(&trace_lock);
+    while (!consumer_stopping) {
+        /* a ring that was filling up is drained again right away */
+        if (drained >= ring_slots / 4) {
+            pthread_mutex_unlock(&trace_lock);
+            drained = drain_ring(batch);
+            pthread_mutex_lock(&trace_lock);
+            continue;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long) TRACE_FLUSH_MS * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        int waited = 0;
+        while (!consumer_stopping && waited != ETIMEDOUT)
+            waited = pthread_cond_timedwait(&trace_wake, &trace_lock, &deadline);
+        if (consumer_stopping)
+            break;
+        pthread_mutex_unlock(&trace_lock);
+        drained = drain_ring(batch);
+        pthread_mutex_lock(&trace_lock);
+    }
+    pthread_mutex_unlock(&trace_lock);
+    /* the producers are gone by now: this takes the rest */
+    drain_ring(batch);
+    delete[] batch;
+    return NULL;
+}
+
+bool trace_running() {
+    return __atomic_load_n(&tracing, __ATOMIC_RELAXED) != 0;
+}
+
+bool trace_start(const char *path, u4 slots) {
+    if (slots == 0)
+        slots = TRACE_DEFAULT_SLOTS;
+    /* a text has to fit in the ring at once */
+    if (slots < 256 || slots > TRACE_MAX_SLOTS || (slots & (slots - 1)) != 0) {
+        LOGE("bad trace ring size %u", slots);
+        return false;
+    }
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fd >= 0) {
+        pthread_mutex_unlock(&trace_lock);
+        LOGE("a trace is running already");
+        return false;
+    }
+    size_t ring_size = (size_t) slots * sizeof(trace_record);
+    void *mapping = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        pthread_mutex_unlock(&trace_lock);
+        LOGE("map trace ring failed: %s", strerror(errno));
+        return false;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        munmap(mapping, ring_size);
+        pthread_mutex_unlock(&trace_lock);
+        LOGE("open %s failed: %s", path, strerror(errno));
+        return false;
+    }
+    ring = (trace_record *) mapping;
+    ring_slots = slots;
+    for (u4 i = 0; i < slots; i++)
+        ring[i].seq = i;
+    ring_head = 0;
+    ring_tail = 0;
+    dropped = 0;
+    lost = 0;
+    trace_fd = fd;
+    write_result.bytes = 0;
+    write_result.error = 0;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.record_size = sizeof(trace_record);
+    header.records_off = sizeof(trace_file_header);
+    header.start_ns = dump_now_ns();
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.start_realtime_ns = (u8) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    header.pid = getpid();
+    write_header();
+
+    consumer_stopping = false;
+    int error = pthread_create(&consumer_thread, NULL, consumer_main, NULL);
+    if (error != 0) {
+        close(trace_fd);
+        trace_fd = -1;
+        munmap(ring, ring_size);
+        ring = NULL;
+        pthread_mutex_unlock(&trace_lock);
+        LOGE("start the trace consumer failed: %s", strerror(error));
+        return false;
+    }
+    __atomic_store_n(&tracing, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&trace_lock);
+    LOGV("tracing to %s, %u slots", path, slots);
+    return true;
+}
+
+bool trace_stop(trace_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fd < 0) {
+        pthread_mutex_unlock(&trace_lock);
+        return false;
+    }
+    __atomic_store_n(&tracing, 0, __ATOMIC_SEQ_CST);
+    /* an event past trace_enter finishes quickly: it never waits on anything */
+    while (__atomic_load_n(&writers, __ATOMIC_SEQ_CST) != 0)
+        sched_yield();
+    consumer_stopping = true;
+    pthread_cond_signal(&trace_wake);
+    pthread_mutex_unlock(&trace_lock);
+    pthread_join(consumer_thread, NULL);
+
+    pthread_mutex_lock(&trace_lock);
+    std::string names;
+    for (std::map<u2, std::string>::const_iterator it = trace_names.begin(); it != trace_names.end(); ++it) {
+        char id[16];
+        snprintf(id, sizeof(id), "%u ", (unsigned int) it->first);
+        names += id;
+        names += it->second;
+        names += '\n';
+    }
+    header.names_off = header.records_off + header.record_count * sizeof(trace_record);
+    header.names_size = names.size();
+    if (write_result.error == 0 && !names.empty())
+        dump_write_at(trace_fd, names.data(), names.size(), header.names_off, &write_result);
+    write_header();
+    close(trace_fd);
+    trace_fd = -1;
+    munmap(ring, (size_t) ring_slots * sizeof(trace_record));
+    ring = NULL;
+    stats->records = header.record_count;
+    stats->dropped = header.dropped;
+    stats->bytes = header.names_off + header.names_size;
+    stats->elapsed_ns = dump_now_ns() - header.start_ns;
+    int error = write_result.error;
+    pthread_mutex_unlock(&trace_lock);
+    if (error != 0) {
+        LOGE("write the trace failed: %s", strerror(error));
+        return false;
+    }
+    LOGV("trace stopped: %llu records, %llu dropped, %llu bytes", (unsigned long long) stats->records,
+         (unsigned long long) stats->dropped, (unsigned long long) stats->bytes);
+    return true;
+}
+
+void trace_define(u2 event, const char *name) {
+    pthread_mutex_lock(&trace_lock);
+    trace_names[event] = name;
+    pthread_mutex_unlock(&trace_lock);
+}
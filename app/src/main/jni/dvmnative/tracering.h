@@ -0,0 +1,83 @@
+#ifndef TRACERING_H_
+#define TRACERING_H_
+#include <stdint.h>
+#include <stddef.h>
+#include "util.h"
+
+#define TRACE_MAGIC             "ztrace1"
+#define TRACE_PAYLOAD_SIZE      44
+#define TRACE_DEFAULT_SLOTS     16384
+#define TRACE_MAX_SLOTS         (1024 * 1024)
+/* the longest text trace_text keeps, cut into as many records as it takes */
+#define TRACE_TEXT_MAX          1024
+/* how often the consumer wakes to flush the ring */
+#define TRACE_FLUSH_MS          50
+
+/* record flags */
+#define TRACE_FLAG_TEXT         1   /* the payload is UTF-8 */
+#define TRACE_FLAG_CONTINUED    2   /* it goes on in the next record of the same thread */
+
+/* one slot of the ring and one record of the file, 64 bytes */
+struct trace_record {
+    u8 time_ns;                 /* CLOCK_MONOTONIC */
+    u4 seq;                     /* ring bookkeeping in memory, the record's number in the file */
+    u4 tid;
+    u2 event;
+    u1 length;                  /* of payload */
+    u1 flags;
+    u1 payload[TRACE_PAYLOAD_SIZE];
+};
+
+/*
+ * The trace file: this header, then record_count records from records_off, then the event
+ * names as "<id> <name>\n" lines at names_off. The header is rewritten after every batch,
+ * so a process that dies mid-trace leaves a file readable up to its last flush (only the
+ * names are missing).
+ */
+struct trace_file_header {
+    char magic[8];
+    u4 record_size;
+    u4 records_off;
+    u8 record_count;
+    u8 dropped;                 /* events lost to a full ring */
+    u8 start_ns;                /* CLOCK_MONOTONIC, like the records */
+    u8 start_realtime_ns;       /* the wall clock at the same moment */
+    u8 names_off;               /* 0 until the trace is stopped */
+    u4 names_size;
+    u4 pid;
+};
+
+struct trace_stats {
+    u8 records;
+    u8 dropped;
+    u8 bytes;                   /* of the file */
+    u8 elapsed_ns;
+};
+
+/*
+ * Start tracing to path with a ring of slots records (a power of two, 0 for the default).
+ * Any thread can then add events; a consumer thread drains the ring every TRACE_FLUSH_MS
+ * and appends what it found to the file in one write. False if a trace is running already
+ * or the file can't be created.
+ */
+bool trace_start(const char *path, u4 slots);
+
+/* flush what is left, write the names and close the file; false if no trace was running */
+bool trace_stop(trace_stats *stats);
+
+bool trace_running();
+
+/* name an event for the decoder; kept across traces, so ids can be named before a start */
+void trace_define(u2 event, const char *name);
+
+/*
+ * Add an event stamped with the time and the calling thread. Never blocks: the slot is
+ * claimed with a compare and swap on the ring head (a bounded MPSC queue with a sequence
+ * number per slot), and when the ring is full the event is counted as dropped. False if
+ * dropped or not tracing.
+ */
+bool trace_event(u2 event, const void *payload, size_t length, u1 flags);
+
+/* text of any length up to TRACE_TEXT_MAX, in consecutive records marked CONTINUED but the last */
+bool trace_text(u2 event, const char *text, size_t length);
+#endif
@@ -30,11 +30,44 @@ typedef union JValue {
 
 #define LOGTAG "zjdroid"
 
-#define LOGW(...)  __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"W/" __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"E/" __VA_ARGS__)
+/*
+ * Logging below ZJDROID_LOG_LEVEL is compiled out, arguments and all, so hot paths can keep
+ * their LOGV lines: "ndk-build ZJDROID_LOG_LEVEL=2" leaves warnings and errors only. The
+ * arguments are still checked, never evaluated, so what is kept just for them stays used.
+ */
+#define ZJDROID_LOG_VERBOSE 0
+#define ZJDROID_LOG_DEBUG   1
+#define ZJDROID_LOG_WARN    2
+#define ZJDROID_LOG_ERROR   3
+#define ZJDROID_LOG_NONE    4
+#ifndef ZJDROID_LOG_LEVEL
+#define ZJDROID_LOG_LEVEL ZJDROID_LOG_VERBOSE
+#endif
+
+#define LOG_DISCARD(...) do { if (0) __android_log_print(ANDROID_LOG_DEBUG, LOGTAG, __VA_ARGS__); } while (0)
+
+#if ZJDROID_LOG_LEVEL <= ZJDROID_LOG_VERBOSE
 #define LOGV(...) __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"V/" __VA_ARGS__)
-#define LOGD(...)  __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"D/" __VA_ARGS__)
 #define LOGVV(...)  __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"D/" __VA_ARGS__)
+#else
+#define LOGV LOG_DISCARD
+#define LOGVV LOG_DISCARD
+#endif
+#if ZJDROID_LOG_LEVEL <= ZJDROID_LOG_DEBUG
+#define LOGD(...)  __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"D/" __VA_ARGS__)
+#else
+#define LOGD LOG_DISCARD
+#endif
+#if ZJDROID_LOG_LEVEL <= ZJDROID_LOG_WARN
+#define LOGW(...)  __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"W/" __VA_ARGS__)
+#else
+#define LOGW LOG_DISCARD
+#endif
+#if ZJDROID_LOG_LEVEL <= ZJDROID_LOG_ERROR
+#define LOGE(...) __android_log_print(ANDROID_LOG_DEBUG, LOGTAG,"E/" __VA_ARGS__)
+#else
+#define LOGE LOG_DISCARD
+#endif
 
 #define pint(_x)  __android_log_print(ANDROID_LOG_DEBUG, "ELF","[%20s( %04d )]  %-30s = %d (0x%08x)\n",__FUNCTION__,__LINE__, #_x, (int)(_x), (int)(_x))
 #define puint(_x) __android_log_print(ANDROID_LOG_DEBUG, "ELF","[%20s( %04d )]  %-30s = %u (0x%08x)\n",__FUNCTION__,__LINE__, #_x, (unsigned int)(_x), (unsigned int)(_x))
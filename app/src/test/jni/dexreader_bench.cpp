@@ -0,0 +1,147 @@
+/*
+ * Host benchmark of the two ways backsmali reads a dex in memory, in id items per second
+ * over a synthetic dex of a few MB. Every field is read the way BaseDexBuffer asks for it:
+ *
+ *   per field: what NativeFunction.readBytes costs natively per call, the page-checked copy
+ *              of read_Memory into a fresh array; the JNI transition comes on top of it
+ *   pinned:    DexMemoryReader, a copy out of the one view of the whole mapping
+ *
+ *   D=app/src/main/jni/dvmnative
+ *   g++ -std=c++11 -O2 -Iapp/src/test/jni/host -I$D -I$JAVA_HOME/include -I$JAVA_HOME/include/linux \
+ *       app/src/test/jni/dexreader_bench.cpp $D/memread.cpp $D/mapsindex.cpp -lpthread -o dexreader_bench
+ *   ./dexreader_bench [MB]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "dexparse.h"
+#include "memread.h"
+
+/* id items, as in a dex: string_id 4, type_id 4, proto_id 12, method_id 8, class_def 32 bytes */
+#define ITEM_BYTES          (4 + 4 + 12 + 8 + 32)
+/* each string_id points at a short string of this many bytes */
+#define STRING_BYTES        16
+
+struct bench_dex {
+    const u1 *base;
+    u4 items;               /* of each kind */
+    u4 string_ids_off;
+    u4 type_ids_off;
+    u4 proto_ids_off;
+    u4 method_ids_off;
+    u4 class_defs_off;
+    u4 data_off;
+};
+
+typedef void (*read_fn)(const bench_dex *dex, u4 offset, u1 *out, u4 length);
+
+static void read_per_field(const bench_dex *dex, u4 offset, u1 *out, u4 length) {
+    const void *addr = dex->base + offset;
+    std::vector<u1> data(length);
+    std::vector<u1> bitmap((mem_page_count(addr, length) + 7) / 8 + 1);
+    mem_read_pages(addr, &data[0], length, &bitmap[0]);
+    std::vector<u1> array(data);
+    memcpy(out, &array[0], length);
+}
+
+static void read_pinned(const bench_dex *dex, u4 offset, u1 *out, u4 length) {
+    memcpy(out, dex->base + offset, length);
+}
+
+static u4 read_u4(read_fn read, const bench_dex *dex, u4 offset) {
+    u4 value;
+    read(dex, offset, (u1 *) &value, 4);
+    return value;
+}
+
+static u2 read_u2(read_fn read, const bench_dex *dex, u4 offset) {
+    u2 value;
+    read(dex, offset, (u1 *) &value, 2);
+    return value;
+}
+
+static u1 read_u1(read_fn read, const bench_dex *dex, u4 offset) {
+    u1 value;
+    read(dex, offset, &value, 1);
+    return value;
+}
+
+/* every field of every id item, and the length and first byte of every string; a checksum */
+static u4 walk(read_fn read, const bench_dex *dex) {
+    u4 sum = 0;
+    for (u4 i = 0; i < dex->items; i++) {
+        u4 string_off = read_u4(read, dex, dex->string_ids_off + i * 4);
+        sum += read_u1(read, dex, string_off) + read_u1(read, dex, string_off + 1);
+        sum += read_u4(read, dex, dex->type_ids_off + i * 4);
+        for (u4 k = 0; k < 3; k++)
+            sum += read_u4(read, dex, dex->proto_ids_off + i * 12 + k * 4);
+        sum += read_u2(read, dex, dex->method_ids_off + i * 8);
+        sum += read_u2(read, dex, dex->method_ids_off + i * 8 + 2);
+        sum += read_u4(read, dex, dex->method_ids_off + i * 8 + 4);
+        for (u4 k = 0; k < 8; k++)
+            sum += read_u4(read, dex, dex->class_defs_off + i * 32 + k * 4);
+    }
+    return sum;
+}
+
+static void make_dex(size_t megabytes, bench_dex *dex, std::vector<u1> *file) {
+    dex->items = megabytes * 1024 * 1024 / (ITEM_BYTES + STRING_BYTES);
+    dex->string_ids_off = DEX_HEADER_SIZE;
+    dex->type_ids_off = dex->string_ids_off + dex->items * 4;
+    dex->proto_ids_off = dex->type_ids_off + dex->items * 4;
+    dex->method_ids_off = dex->proto_ids_off + dex->items * 12;
+    dex->class_defs_off = dex->method_ids_off + dex->items * 8;
+    dex->data_off = dex->class_defs_off + dex->items * 32;
+    file->assign(dex->data_off + dex->items * STRING_BYTES, 0);
+    u1 *out = &(*file)[0];
+    srand(1);
+    for (u4 i = dex->string_ids_off; i < dex->data_off; i++)
+        out[i] = rand();
+    for (u4 i = 0; i < dex->items; i++) {
+        u4 string_off = dex->data_off + i * STRING_BYTES;
+        memcpy(out + dex->string_ids_off + i * 4, &string_off, 4);
+        out[string_off] = STRING_BYTES - 2;
+        memset(out + string_off + 1, 'a' + i % 26, STRING_BYTES - 2);
+    }
+    dex->base = out;
+}
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* items per second, over as many walks as fit in about a second */
+static double items_per_s(read_fn read, const bench_dex *dex, u4 *sum) {
+    double start = now_s();
+    double elapsed;
+    u4 walks = 0;
+    do {
+        *sum = walk(read, dex);
+        walks++;
+        elapsed = now_s() - start;
+    } while (elapsed < 1.0);
+    return (double) dex->items * 5 * walks / elapsed;
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 8;
+    bench_dex dex;
+    std::vector<u1> file;
+    make_dex(megabytes, &dex, &file);
+    printf("%zu MB dex, %u items of each of 5 id kinds\n", file.size() >> 20, dex.items);
+
+    u4 per_field_sum, pinned_sum;
+    double per_field = items_per_s(read_per_field, &dex, &per_field_sum);
+    double pinned = items_per_s(read_pinned, &dex, &pinned_sum);
+    printf("per field: %12.0f items/s\n", per_field);
+    printf("pinned:    %12.0f items/s  (%.1fx)\n", pinned, pinned / per_field);
+    if (per_field_sum != pinned_sum) {
+        printf("FAIL: the two readers read different bytes\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Host test of dex_scan_process at the seams between the buffers and units a scan reads:
+ * a header planted at every offset in [seam - SCAN_MAGIC_SIZE, seam] must be found once.
+ *
+ *   D=app/src/main/jni/dvmnative
+ *   g++ -std=c++11 -Iapp/src/test/jni/host -I$D -I$JAVA_HOME/include -I$JAVA_HOME/include/linux \
+ *       app/src/test/jni/dexscan_seam_test.cpp $D/dexscan.cpp $D/mapsindex.cpp $D/memread.cpp \
+ *       $D/threadpool.cpp $D/jobengine.cpp $D/dumpfile.cpp -lpthread -o dexscan_seam_test
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <vector>
+#include "dexscan.h"
+#include "dexparse.h"
+
+/* as in dexscan.cpp */
+#define SCAN_UNIT_SIZE      (16 * 1024 * 1024)
+#define SCAN_BUFFER_SIZE    (1024 * 1024)
+#define SCAN_MAGIC_SIZE     8
+
+#define REGION_SIZE         (SCAN_UNIT_SIZE + 2 * SCAN_BUFFER_SIZE)
+#define PLANTED_SIZE        0x78
+
+static void plant(u1 *at) {
+    art::DexFile::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, "dex\n035", 8);
+    header.file_size_ = PLANTED_SIZE;
+    header.header_size_ = DEX_HEADER_SIZE;
+    header.endian_tag_ = DEX_ENDIAN_CONSTANT;
+    header.map_off_ = DEX_HEADER_SIZE;
+    memcpy(at, &header, sizeof(header));
+}
+
+/* the ends of the buffers scan_one_unit reads from a unit starting at 0 */
+static void buffer_seams(size_t unit_end, std::vector<size_t> *seams) {
+    size_t limit = unit_end + SCAN_MAGIC_SIZE - 1;
+    size_t pos = 0;
+    for (;;) {
+        size_t got = std::min((size_t) SCAN_BUFFER_SIZE, limit - pos);
+        seams->push_back(pos + got);
+        if (pos + got >= limit)
+            break;
+        pos += got - (SCAN_MAGIC_SIZE - 1);
+    }
+}
+
+int main() {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    /* guard pages on both sides, so the region is a mapping of its own and starts a unit */
+    u1 *map = (u1 *) mmap(NULL, REGION_SIZE + 2 * page_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    mprotect(map, page_size, PROT_NONE);
+    mprotect(map + page_size + REGION_SIZE, page_size, PROT_NONE);
+    u1 *region = map + page_size;
+
+    std::vector<size_t> seams;
+    buffer_seams(SCAN_UNIT_SIZE, &seams);
+    /* the first seams, the last of the unit and the unit end itself */
+    seams.erase(seams.begin() + 3, seams.end() - 2);
+    seams.push_back(SCAN_UNIT_SIZE);
+    seams.push_back(SCAN_UNIT_SIZE + SCAN_BUFFER_SIZE - (SCAN_MAGIC_SIZE - 1));
+
+    int failures = 0;
+    int planted = 0;
+    for (size_t s = 0; s < seams.size(); s++) {
+        for (size_t offset = seams[s] - SCAN_MAGIC_SIZE; offset <= seams[s]; offset++) {
+            plant(region + offset);
+            std::vector<dex_scan_hit> hits;
+            dex_scan_process(1, &hits);
+            int found = 0;
+            for (size_t i = 0; i < hits.size(); i++) {
+                if (hits[i].addr >= (uintptr_t) region && hits[i].addr < (uintptr_t) region + REGION_SIZE) {
+                    if (hits[i].addr == (uintptr_t) (region + offset))
+                        found++;
+                    else
+                        found += 100;
+                }
+            }
+            if (found != 1) {
+                printf("FAIL: header at 0x%zx (seam 0x%zx) found %d times\n", offset, seams[s], found);
+                failures++;
+            }
+            memset(region + offset, 0, PLANTED_SIZE);
+            planted++;
+        }
+    }
+    printf("%d of %d planted headers found exactly once\n", planted - failures, planted);
+    return failures == 0 ? 0 : 1;
+}
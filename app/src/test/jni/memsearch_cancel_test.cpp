@@ -0,0 +1,149 @@
+/*
+ * Host test that cancelling the job of a streamed search stops it. searchMemory runs the
+ * search on a thread of its own, as this test does, so the JNI thread can hand the hits to
+ * java; that thread must take on the job of the caller, or the search never sees the cancel.
+ * One copy of the pattern is planted per search unit: the search is held at the first hit
+ * until the job is cancelled, and must end before the next unit.
+ *
+ *   D=app/src/main/jni/dvmnative
+ *   g++ -std=c++11 -Iapp/src/test/jni/host -I$D -I$JAVA_HOME/include -I$JAVA_HOME/include/linux \
+ *       app/src/test/jni/memsearch_cancel_test.cpp $D/memsearch.cpp $D/mapsindex.cpp $D/memread.cpp \
+ *       $D/threadpool.cpp $D/jobengine.cpp $D/dumpfile.cpp -lpthread -Wl,-z,now -o memsearch_cancel_test
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <string>
+#include <vector>
+#include "memsearch.h"
+#include "jobengine.h"
+
+#define PLANTED_SIZE        16
+/* as memsearch.cpp cuts regions, the job is checked between two of them */
+#define UNIT_SIZE           (16 * 1024 * 1024)
+#define UNITS               8
+#define PLANTED_OFFSET      0x123
+
+struct cancel_search {
+    std::vector<std::string> patterns;
+    bool adopt;                 /* the search thread takes on the job, as search_stream_thread does */
+    void *job;
+    volatile bool first_hit;
+    volatile bool cancel_sent;
+    int hits;
+    mem_search_stats stats;
+    bool ok;
+    volatile bool finished;
+};
+
+static uintptr_t region_start;
+
+static bool planted_region(const map_region *region) {
+    return region->start <= region_start && region_start < region->end;
+}
+
+static bool hold_first_hit(const mem_search_hit *hit, void *arg) {
+    cancel_search *search = (cancel_search *) arg;
+    search->hits++;
+    search->first_hit = true;
+    while (!search->cancel_sent)
+        usleep(1000);
+    return true;
+}
+
+static void *search_thread(void *arg) {
+    cancel_search *search = (cancel_search *) arg;
+    if (search->adopt)
+        job_adopt(search->job);
+    mem_search_options options;
+    memset(&options, 0, sizeof(options));
+    options.select = planted_region;
+    options.max_threads = 1;
+    search->ok = mem_search_process(search->patterns, &options, hold_first_hit, search, &search->stats);
+    return NULL;
+}
+
+static bool run_search(void *arg) {
+    cancel_search *search = (cancel_search *) arg;
+    search->job = job_current();
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, search_thread, search) == 0)
+        pthread_join(thread, NULL);
+    search->finished = true;
+    return search->ok;
+}
+
+static void release_search(void *arg) {
+}
+
+static bool search_and_cancel(cancel_search *search) {
+    bool existing;
+    u4 id = job_submit("search", "", run_search, search, release_search, &existing);
+    while (!search->first_hit)
+        usleep(1000);
+    bool cancelled = job_cancel(id);
+    search->cancel_sent = true;
+    while (!search->finished)
+        usleep(1000);
+    return cancelled;
+}
+
+int main() {
+    size_t size = (size_t) UNIT_SIZE * UNITS;
+    u1 *region = (u1 *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    region_start = (uintptr_t) region;
+    /* made up at run time with the top bit set, as in memsearch_self_test */
+    u1 planted[PLANTED_SIZE];
+    u4 seed = (u4) getpid() * 2654435761u;
+    for (int i = 0; i < PLANTED_SIZE; i++) {
+        seed = seed * 1103515245u + 12345u;
+        planted[i] = 0x80 | (u1) (seed >> 16);
+    }
+    std::string text;
+    for (int i = 0; i < PLANTED_SIZE; i++) {
+        char byte[4];
+        snprintf(byte, sizeof(byte), i == PLANTED_SIZE / 2 ? "?? " : "%02x ", planted[i]);
+        text += byte;
+    }
+    /* the search may not start at the region start, so every unit it cuts holds one */
+    for (int unit = 0; unit < UNITS; unit++)
+        memcpy(region + (size_t) unit * UNIT_SIZE + PLANTED_OFFSET, planted, PLANTED_SIZE);
+    memset(planted, 0, sizeof(planted));
+
+    int failures = 0;
+    cancel_search adopted;
+    adopted.patterns.assign(1, text);
+    adopted.adopt = true;
+    adopted.first_hit = adopted.cancel_sent = adopted.finished = false;
+    adopted.hits = 0;
+    if (!search_and_cancel(&adopted)) {
+        printf("FAIL: the search job wasn't running when cancelled\n");
+        failures++;
+    } else if (!adopted.stats.truncated || adopted.hits != 1) {
+        printf("FAIL: cancelled search went on: %d of %d hits, truncated %d\n", adopted.hits, UNITS,
+               adopted.stats.truncated);
+        failures++;
+    }
+
+    /* the control: a thread that doesn't take on the job can't be cancelled through it */
+    cancel_search orphan;
+    orphan.patterns.assign(1, text);
+    orphan.adopt = false;
+    orphan.first_hit = orphan.cancel_sent = orphan.finished = false;
+    orphan.hits = 0;
+    search_and_cancel(&orphan);
+    if (orphan.stats.truncated || orphan.hits != UNITS) {
+        printf("FAIL: search outside the job: %d of %d hits, truncated %d\n", orphan.hits, UNITS,
+               orphan.stats.truncated);
+        failures++;
+    }
+    munmap(region, size);
+    printf("%d of 2 searches stopped as their job says\n", 2 - failures);
+    return failures == 0 ? 0 : 1;
+}
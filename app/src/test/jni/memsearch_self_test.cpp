@@ -0,0 +1,88 @@
+/*
+ * Host test that mem_search_process doesn't find its own copies of what it searches for:
+ * bytes planted once in the process must be found exactly once, whatever the threads and
+ * the context kept around a hit. Linked -z now, as the Android linker binds: glibc's lazy
+ * binding saves the vector registers, copies and all, on the stack of the first call.
+ *
+ *   D=app/src/main/jni/dvmnative
+ *   g++ -std=c++11 -Iapp/src/test/jni/host -I$D -I$JAVA_HOME/include -I$JAVA_HOME/include/linux \
+ *       app/src/test/jni/memsearch_self_test.cpp $D/memsearch.cpp $D/mapsindex.cpp $D/memread.cpp \
+ *       $D/threadpool.cpp $D/jobengine.cpp $D/dumpfile.cpp -lpthread -Wl,-z,now -o memsearch_self_test
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string>
+#include <vector>
+#include "memsearch.h"
+
+#define PLANTED_SIZE        16
+/* planted past the start of a page of its own, so the hit can't be in anything else */
+#define PLANTED_OFFSET      0x123
+
+struct hit_count {
+    int hits;
+    uintptr_t addr;
+};
+
+static bool count_hit(const mem_search_hit *hit, void *arg) {
+    hit_count *count = (hit_count *) arg;
+    count->hits++;
+    count->addr = hit->addr;
+    return true;
+}
+
+int main() {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    u1 *region = (u1 *) mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    /*
+     * made up at run time, straight where they are planted: a constant would sit in the binary
+     * too. Every byte has its top bit set, so the hex text of the pattern can't match either.
+     */
+    u1 *planted = region + PLANTED_OFFSET;
+    u4 seed = (u4) getpid() * 2654435761u;
+    for (int i = 0; i < PLANTED_SIZE; i++) {
+        seed = seed * 1103515245u + 12345u;
+        planted[i] = 0x80 | (u1) (seed >> 16);
+    }
+    std::string text;
+    for (int i = 0; i < PLANTED_SIZE; i++) {
+        char byte[4];
+        /* a wildcard in the middle, as the patterns people search with have */
+        snprintf(byte, sizeof(byte), i == PLANTED_SIZE / 2 ? "?? " : "%02x ", planted[i]);
+        text += byte;
+    }
+    std::vector<std::string> patterns(1, text);
+
+    int threads[] = {1, 4, 0};
+    u4 contexts[] = {0, 64};
+    int runs = 0;
+    int failures = 0;
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        for (size_t c = 0; c < sizeof(contexts) / sizeof(contexts[0]); c++) {
+            mem_search_options options;
+            memset(&options, 0, sizeof(options));
+            options.context = contexts[c];
+            options.max_threads = threads[t];
+            hit_count count = {0, 0};
+            mem_search_stats stats;
+            runs++;
+            if (!mem_search_process(patterns, &options, count_hit, &count, &stats)) {
+                printf("FAIL: search with %d threads, context %u failed\n", threads[t], contexts[c]);
+                failures++;
+            } else if (count.hits != 1 || count.addr != (uintptr_t) planted) {
+                printf("FAIL: %d threads, context %u: %d hits, last at %p (planted at %p)\n", threads[t],
+                       contexts[c], count.hits, (void *) count.addr, planted);
+                failures++;
+            }
+        }
+    }
+    munmap(region, page_size);
+    printf("%d of %d searches found the planted bytes exactly once\n", runs - failures, runs);
+    return failures == 0 ? 0 : 1;
+}
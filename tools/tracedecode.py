@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+"""
+Decode a trace written by the "trace" command (files/trace_<time>.bin) to JSON lines or CSV.
+
+    adb pull /data/data/<package>/files/trace_1500000000000.bin
+    python tools/tracedecode.py trace_1500000000000.bin --csv > trace.csv
+
+The layout is trace_file_header and trace_record in app/src/main/jni/dvmnative/tracering.h.
+Texts cut over several records are joined back into one event.
+"""
+import argparse
+import csv
+import json
+import struct
+import sys
+
+MAGIC = b"ztrace1\0"
+HEADER = struct.Struct("<8sIIQQQQQII")
+RECORD = struct.Struct("<QIIHBB44s")
+FLAG_TEXT = 1
+FLAG_CONTINUED = 2
+
+
+def read_trace(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size or data[:8] != MAGIC:
+        raise ValueError("%s is not a trace" % path)
+    (_, record_size, records_off, record_count, dropped, start_ns, start_realtime_ns, names_off, names_size,
+     pid) = HEADER.unpack_from(data)
+    if record_size != RECORD.size:
+        raise ValueError("unknown record size %d" % record_size)
+    names = {}
+    if names_off:
+        for line in data[names_off:names_off + names_size].decode("utf-8", "replace").splitlines():
+            event, _, name = line.partition(" ")
+            names[int(event)] = name
+    info = {"pid": pid, "records": record_count, "dropped": dropped, "start_realtime_ns": start_realtime_ns}
+    # a trace cut short by a crash still has its header up to the last flush
+    record_count = min(record_count, (len(data) - records_off) // record_size)
+
+    def events():
+        text = None
+        for i in range(record_count):
+            time_ns, seq, tid, event, length, flags, payload = RECORD.unpack_from(data, records_off + i * record_size)
+            payload = payload[:length]
+            if flags & FLAG_TEXT:
+                if text is None:
+                    text = [time_ns, tid, event, b""]
+                text[3] += payload
+                if flags & FLAG_CONTINUED:
+                    continue
+                time_ns, tid, event, payload = text
+                text = None
+                value = payload.decode("utf-8", "replace")
+            elif length == 16:
+                value = list(struct.unpack("<qq", payload))
+            else:
+                value = payload.hex() if hasattr(payload, "hex") else payload.encode("hex")
+            yield {
+                "time_ms": (time_ns - start_ns) / 1e6,
+                "tid": tid,
+                "event": event,
+                "name": names.get(event, str(event)),
+                "value": value,
+            }
+
+    return info, events()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("trace")
+    parser.add_argument("--csv", action="store_true", help="CSV instead of JSON lines")
+    args = parser.parse_args()
+    info, events = read_trace(args.trace)
+    sys.stderr.write("pid %(pid)d: %(records)d records, %(dropped)d dropped\n" % info)
+    if args.csv:
+        writer = csv.writer(sys.stdout)
+        writer.writerow(["time_ms", "tid", "event", "name", "value"])
+        for e in events:
+            value = e["value"]
+            if isinstance(value, list):
+                value = " ".join(str(v) for v in value)
+            writer.writerow(["%.3f" % e["time_ms"], e["tid"], e["event"], e["name"], value])
+    else:
+        for e in events:
+            sys.stdout.write(json.dumps(e) + "\n")
+
+
+if __name__ == "__main__":
+    main()